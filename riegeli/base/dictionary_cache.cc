@@ -0,0 +1,134 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/base/dictionary_cache.h"
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+#include "absl/functional/function_ref.h"
+#include "absl/hash/hash.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "riegeli/base/maker.h"
+#include "riegeli/base/shared_ptr.h"
+
+namespace riegeli {
+
+// Before C++17 if a constexpr static data member is ODR-used, its definition at
+// namespace scope is required. Since C++17 these definitions are deprecated:
+// http://en.cppreference.com/w/cpp/language/static
+#if !__cpp_inline_variables
+constexpr size_t DictionaryCache::kDefaultMaxMemory;
+#endif
+
+inline bool DictionaryCache::Entry::Matches(
+    absl::string_view kind, std::initializer_list<int> parameters,
+    absl::string_view data) const {
+  return kind_ == kind &&
+         std::equal(parameters_.begin(), parameters_.end(),
+                    parameters.begin(), parameters.end()) &&
+         data_ == data;
+}
+
+void DictionaryCache::set_max_memory(size_t max_memory) {
+  std::vector<SharedPtr<const Entry>> evicted;
+  absl::MutexLock lock(&mutex_);
+  max_memory_ = max_memory;
+  EvictLocked(evicted);
+}
+
+size_t DictionaryCache::max_memory() const {
+  absl::MutexLock lock(&mutex_);
+  return max_memory_;
+}
+
+DictionaryCache::Stats DictionaryCache::stats() const {
+  absl::MutexLock lock(&mutex_);
+  Stats stats;
+  stats.hits = hits_;
+  stats.misses = misses_;
+  stats.evictions = evictions_;
+  stats.num_entries = entries_.size();
+  stats.memory = memory_;
+  return stats;
+}
+
+void DictionaryCache::Clear() {
+  Lru evicted;
+  absl::MutexLock lock(&mutex_);
+  evicted.swap(lru_);
+  entries_.clear();
+  memory_ = 0;
+}
+
+SharedPtr<const DictionaryCache::Entry> DictionaryCache::GetImpl(
+    absl::string_view kind, std::initializer_list<int> parameters,
+    absl::string_view data, absl::FunctionRef<bool(Entry& entry)> prepare) {
+  const size_t hash = absl::HashOf(
+      kind, absl::Span<const int>(parameters.begin(), parameters.size()), data);
+  {
+    absl::MutexLock lock(&mutex_);
+    const auto iter = entries_.find(hash);
+    if (iter != entries_.end() &&
+        (*iter->second)->Matches(kind, parameters, data)) {
+      ++hits_;
+      lru_.splice(lru_.begin(), lru_, iter->second);
+      return *iter->second;
+    }
+    ++misses_;
+  }
+  // Prepare the structure without holding the lock, because this can be slow.
+  SharedPtr<Entry> entry(riegeli::Maker(hash, kind, parameters, data));
+  if (!prepare(*entry)) return nullptr;
+  SharedPtr<const Entry> result = std::move(entry);
+  std::vector<SharedPtr<const Entry>> evicted;
+  absl::MutexLock lock(&mutex_);
+  if (result->memory() > max_memory_) return result;
+  const auto inserted = entries_.try_emplace(hash);
+  if (!inserted.second) {
+    SharedPtr<const Entry>& existing = *inserted.first->second;
+    // Another thread could have prepared the same entry concurrently. Share it
+    // and discard the new one.
+    if (existing->Matches(kind, parameters, data)) return existing;
+    // Otherwise the hash collides. The new entry replaces the previous one.
+    memory_ -= existing->memory();
+    evicted.push_back(std::move(existing));
+    lru_.erase(inserted.first->second);
+  }
+  lru_.push_front(result);
+  inserted.first->second = lru_.begin();
+  memory_ += result->memory();
+  EvictLocked(evicted);
+  return result;
+}
+
+void DictionaryCache::EvictLocked(
+    std::vector<SharedPtr<const Entry>>& evicted) {
+  while (memory_ > max_memory_) {
+    SharedPtr<const Entry>& entry = lru_.back();
+    entries_.erase(entry->hash_);
+    memory_ -= entry->memory();
+    evicted.push_back(std::move(entry));
+    lru_.pop_back();
+    ++evictions_;
+  }
+}
+
+}  // namespace riegeli
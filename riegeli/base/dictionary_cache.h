@@ -0,0 +1,207 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_BASE_DICTIONARY_CACHE_H_
+#define RIEGELI_BASE_DICTIONARY_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <initializer_list>
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/functional/function_ref.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "riegeli/base/global.h"
+#include "riegeli/base/shared_ptr.h"
+
+namespace riegeli {
+
+// A process-wide cache of structures prepared by compression libraries from
+// dictionary data, e.g. `ZSTD_DDict`, shared by dictionary objects with equal
+// contents.
+//
+// Dictionary objects like `ZstdDictionary` prepare such structures lazily and
+// keep them while the dictionary object is alive. When many dictionary objects
+// are created from the same data, e.g. when a dictionary is loaded from bytes
+// for each reader, `DictionaryCache` avoids preparing the same structure again.
+//
+// An entry is identified by the kind of the prepared structure, by parameters
+// affecting preparation, and by the contents of dictionary data. An entry owns
+// a copy of dictionary data and the structure is prepared from that copy, so
+// the structure may refer to the data.
+//
+// When total memory used by entries exceeds `max_memory()`, least recently used
+// entries are evicted. An evicted entry remains valid while it is referenced.
+class DictionaryCache {
+ public:
+  class Entry;
+
+  // Counters describing the activity of the cache.
+  struct Stats {
+    // Number of `Get()` calls which found the entry.
+    uint64_t hits = 0;
+    // Number of `Get()` calls which prepared the structure.
+    uint64_t misses = 0;
+    // Number of entries evicted because of `max_memory()`.
+    uint64_t evictions = 0;
+    // Number of entries in the cache.
+    size_t num_entries = 0;
+    // Estimated memory used by entries in the cache.
+    size_t memory = 0;
+  };
+
+  static constexpr size_t kDefaultMaxMemory = size_t{64} << 20;
+
+  // Creates an empty `DictionaryCache`.
+  explicit DictionaryCache(size_t max_memory = kDefaultMaxMemory)
+      : max_memory_(max_memory) {}
+
+  DictionaryCache(const DictionaryCache&) = delete;
+  DictionaryCache& operator=(const DictionaryCache&) = delete;
+
+  // Returns the `DictionaryCache` used by dictionaries of compression formats.
+  static DictionaryCache& global() {
+    return Global<DictionaryCache>([] {});
+  }
+
+  // Maximum estimated memory used by entries in the cache. 0 disables caching.
+  //
+  // Lowering the maximum evicts entries as needed.
+  //
+  // Default: `kDefaultMaxMemory` (64M).
+  void set_max_memory(size_t max_memory);
+  size_t max_memory() const;
+
+  // Returns counters describing the activity of the cache.
+  Stats stats() const;
+
+  // Evicts all entries. Does not reset counters.
+  void Clear();
+
+  // Returns an entry holding dictionary `data` and a structure of type `T`
+  // prepared from them, or `nullptr` if preparation failed.
+  //
+  // `kind` identifies the type of the structure and how it is prepared, e.g.
+  // "ZSTD_DDict". `parameters` distinguish structures of the same `kind`
+  // prepared differently from the same data, e.g. for different compression
+  // levels.
+  //
+  // If there is no such entry yet, `prepare(entry_data)` is called, where
+  // `entry_data` is the copy of `data` owned by the entry. It returns
+  // `std::unique_ptr<T, Deleter>`, or `nullptr` on failure, which is not
+  // cached. Then `memory(prepared)` returns the estimated memory used by the
+  // structure, excluding dictionary data.
+  template <typename T, typename Deleter, typename Prepare, typename Memory>
+  SharedPtr<const Entry> Get(absl::string_view kind,
+                             std::initializer_list<int> parameters,
+                             absl::string_view data, Prepare&& prepare,
+                             Memory&& memory);
+
+ private:
+  using Lru = std::list<SharedPtr<const Entry>>;
+
+  SharedPtr<const Entry> GetImpl(absl::string_view kind,
+                                 std::initializer_list<int> parameters,
+                                 absl::string_view data,
+                                 absl::FunctionRef<bool(Entry& entry)> prepare);
+  // Removes least recently used entries until they fit in `max_memory_`,
+  // appending them to `evicted`. They should be destroyed after unlocking.
+  void EvictLocked(std::vector<SharedPtr<const Entry>>& evicted)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  mutable absl::Mutex mutex_;
+  size_t max_memory_ ABSL_GUARDED_BY(mutex_);
+  size_t memory_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Entries in the order of use, most recently used first.
+  Lru lru_ ABSL_GUARDED_BY(mutex_);
+  // Entries by their hash. An entry with a colliding hash replaces the
+  // previous entry.
+  absl::flat_hash_map<size_t, Lru::iterator> entries_ ABSL_GUARDED_BY(mutex_);
+  uint64_t hits_ ABSL_GUARDED_BY(mutex_) = 0;
+  uint64_t misses_ ABSL_GUARDED_BY(mutex_) = 0;
+  uint64_t evictions_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+// An entry of `DictionaryCache`: dictionary data and a structure prepared from
+// them.
+class DictionaryCache::Entry {
+ public:
+  explicit Entry(size_t hash, absl::string_view kind,
+                 std::initializer_list<int> parameters, absl::string_view data)
+      : hash_(hash), kind_(kind), parameters_(parameters), data_(data) {}
+
+  Entry(const Entry&) = delete;
+  Entry& operator=(const Entry&) = delete;
+
+  ~Entry() {
+    if (prepared_ != nullptr) destroy_(prepared_);
+  }
+
+  // Returns the copy of dictionary data owned by the entry.
+  absl::string_view data() const { return data_; }
+
+  // Returns the prepared structure. `T` must be the type given to `Get()`.
+  template <typename T>
+  T* prepared() const {
+    return static_cast<T*>(prepared_);
+  }
+
+ private:
+  friend class DictionaryCache;
+
+  bool Matches(absl::string_view kind, std::initializer_list<int> parameters,
+               absl::string_view data) const;
+
+  // Estimated memory used by the entry.
+  size_t memory() const { return sizeof(Entry) + data_.size() + memory_; }
+
+  size_t hash_;
+  std::string kind_;
+  std::vector<int> parameters_;
+  std::string data_;
+  void* prepared_ = nullptr;
+  void (*destroy_)(void* prepared) = nullptr;
+  // Estimated memory used by `*prepared_`.
+  size_t memory_ = 0;
+};
+
+// Implementation details follow.
+
+template <typename T, typename Deleter, typename Prepare, typename Memory>
+SharedPtr<const DictionaryCache::Entry> DictionaryCache::Get(
+    absl::string_view kind, std::initializer_list<int> parameters,
+    absl::string_view data, Prepare&& prepare, Memory&& memory) {
+  return GetImpl(kind, parameters, data, [&](Entry& entry) {
+    std::unique_ptr<T, Deleter> prepared = prepare(entry.data());
+    if (prepared == nullptr) return false;
+    entry.memory_ = memory(prepared.get());
+    entry.prepared_ = prepared.release();
+    entry.destroy_ = [](void* prepared) {
+      Deleter()(static_cast<T*>(prepared));
+    };
+    return true;
+  });
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_BASE_DICTIONARY_CACHE_H_
@@ -22,8 +22,11 @@
 
 #include "absl/base/thread_annotations.h"
 #include "absl/functional/any_invocable.h"
+#include "absl/functional/function_ref.h"
+#include "absl/synchronization/blocking_counter.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
+#include "riegeli/base/arithmetic.h"
 #include "riegeli/base/assert.h"
 #include "riegeli/base/global.h"
 
@@ -76,5 +79,18 @@ ThreadPool& ThreadPool::global() {
   return Global<ThreadPool>([] {});
 }
 
+void RunInParallel(size_t num_tasks, absl::FunctionRef<void(size_t)> task) {
+  if (num_tasks == 0) return;
+  absl::BlockingCounter pending(IntCast<int>(num_tasks - 1));
+  for (size_t index = 1; index < num_tasks; ++index) {
+    ThreadPool::global().Schedule([task, index, &pending] {
+      task(index);
+      pending.DecrementCount();
+    });
+  }
+  task(0);
+  pending.Wait();
+}
+
 }  // namespace internal
 }  // namespace riegeli
@@ -22,6 +22,7 @@
 #include "absl/base/attributes.h"
 #include "absl/base/thread_annotations.h"
 #include "absl/functional/any_invocable.h"
+#include "absl/functional/function_ref.h"
 #include "absl/synchronization/mutex.h"
 
 namespace riegeli {
@@ -50,6 +51,11 @@ class ThreadPool {
   std::deque<absl::AnyInvocable<void() &&>> tasks_ ABSL_GUARDED_BY(mutex_);
 };
 
+// Runs `task(index)` for each `index` in `[0, num_tasks)`: `task(0)` in the
+// current thread, the others in `ThreadPool::global()`. Returns when all of
+// them finish.
+void RunInParallel(size_t num_tasks, absl::FunctionRef<void(size_t)> task);
+
 }  // namespace internal
 }  // namespace riegeli
 
@@ -27,6 +27,7 @@
 #include "brotli/shared_dictionary.h"
 #include "riegeli/base/arithmetic.h"
 #include "riegeli/base/assert.h"
+#include "riegeli/base/dictionary_cache.h"
 #include "riegeli/base/shared_ptr.h"
 
 namespace riegeli {
@@ -48,13 +49,27 @@ BrotliDictionary::Chunk::PrepareCompressionDictionary() const
              "unprepared native chunk";
       return;
     }
-    owned_compression_dictionary_.reset(BrotliEncoderPrepareDictionary(
-        static_cast<BrotliSharedDictionaryType>(type_), data_.size(),
-        reinterpret_cast<const uint8_t*>(data_.data()), BROTLI_MAX_QUALITY,
-        // `BrotliAllocator` is not supported here because the prepared
-        // dictionary may easily outlive the allocator.
-        nullptr, nullptr, nullptr));
-    compression_dictionary_ = owned_compression_dictionary_.get();
+    owned_compression_dictionary_ = DictionaryCache::global().Get<
+        BrotliEncoderPreparedDictionary, BrotliEncoderDictionaryDeleter>(
+        "BrotliEncoderPreparedDictionary", {static_cast<int>(type_)}, data_,
+        [&](absl::string_view data) {
+          return std::unique_ptr<BrotliEncoderPreparedDictionary,
+                                 BrotliEncoderDictionaryDeleter>(
+              BrotliEncoderPrepareDictionary(
+                  static_cast<BrotliSharedDictionaryType>(type_), data.size(),
+                  reinterpret_cast<const uint8_t*>(data.data()),
+                  BROTLI_MAX_QUALITY,
+                  // `BrotliAllocator` is not supported here because the
+                  // prepared dictionary may easily outlive the allocator.
+                  nullptr, nullptr, nullptr));
+        },
+        [](const BrotliEncoderPreparedDictionary* dictionary) {
+          return BrotliEncoderGetPreparedDictionarySize(dictionary);
+        });
+    if (owned_compression_dictionary_ == nullptr) return;
+    compression_dictionary_ =
+        owned_compression_dictionary_
+            ->prepared<BrotliEncoderPreparedDictionary>();
   });
   return compression_dictionary_;
 }
@@ -33,6 +33,7 @@
 #include "brotli/encode.h"
 #include "brotli/shared_dictionary.h"
 #include "riegeli/base/assert.h"
+#include "riegeli/base/dictionary_cache.h"
 #include "riegeli/base/initializer.h"
 #include "riegeli/base/maker.h"
 #include "riegeli/base/shared_ptr.h"
@@ -215,9 +216,10 @@ class BrotliDictionary::Chunk {
   absl::string_view data_;
 
   mutable absl::once_flag compression_once_;
-  mutable std::unique_ptr<BrotliEncoderPreparedDictionary,
-                          BrotliEncoderDictionaryDeleter>
-      owned_compression_dictionary_;
+  // Owns the `BrotliEncoderPreparedDictionary` unless `type_ == Type::kNative`,
+  // shared through `DictionaryCache::global()` with other chunks with the same
+  // contents.
+  mutable SharedPtr<const DictionaryCache::Entry> owned_compression_dictionary_;
   mutable const BrotliEncoderPreparedDictionary* compression_dictionary_ =
       nullptr;
 };
@@ -112,6 +112,11 @@ void BrotliWriterBase::Initialize(Writer* dest, int compression_level,
       return;
     }
   }
+  if (pledged_size_ != absl::nullopt) {
+    BufferedWriter::SetWriteSizeHintImpl(*pledged_size_);
+    BrotliEncoderSetParameter(compressor_.get(), BROTLI_PARAM_SIZE_HINT,
+                              SaturatingIntCast<uint32_t>(*pledged_size_));
+  }
 }
 
 void BrotliWriterBase::DoneBehindBuffer(absl::string_view src) {
@@ -152,7 +157,7 @@ absl::Status BrotliWriterBase::AnnotateOverDest(absl::Status status) {
 void BrotliWriterBase::SetWriteSizeHintImpl(
     absl::optional<Position> write_size_hint) {
   BufferedWriter::SetWriteSizeHintImpl(write_size_hint);
-  if (ABSL_PREDICT_FALSE(!ok())) return;
+  if (ABSL_PREDICT_FALSE(!ok()) || compressor_ == nullptr) return;
   // Ignore failure if compression already started.
   BrotliEncoderSetParameter(compressor_.get(), BROTLI_PARAM_SIZE_HINT,
                             write_size_hint == absl::nullopt
@@ -180,8 +185,68 @@ inline bool BrotliWriterBase::WriteInternal(absl::string_view src, Writer& dest,
                          std::numeric_limits<Position>::max() - start_pos())) {
     return FailOverflow();
   }
+  if (pledged_size_ != absl::nullopt) {
+    const Position next_pos = start_pos() + src.size();
+    if (compressor_ == nullptr) {
+      if (ABSL_PREDICT_FALSE(!src.empty())) {
+        return Fail(absl::FailedPreconditionError(
+            absl::StrCat("Actual size does not match pledged size: ", next_pos,
+                         " > ", *pledged_size_)));
+      }
+      return true;
+    }
+    if (next_pos >= *pledged_size_) {
+      // Notify `compressor_` that this is the last fragment. This enables
+      // compressing directly to a long enough output buffer.
+      op = BROTLI_OPERATION_FINISH;
+    }
+    if (op == BROTLI_OPERATION_FINISH) {
+      if (ABSL_PREDICT_FALSE(next_pos != *pledged_size_)) {
+        return Fail(absl::FailedPreconditionError(absl::StrCat(
+            "Actual size does not match pledged size: ", next_pos,
+            next_pos > *pledged_size_ ? " > " : " < ", *pledged_size_)));
+      }
+    }
+  }
   size_t available_in = src.size();
   const uint8_t* next_in = reinterpret_cast<const uint8_t*>(src.data());
+  if (start_pos() == 0) {
+    // Nothing was given to `compressor_` yet.
+    if (op == BROTLI_OPERATION_FLUSH && src.empty()) {
+      // Do not begin the stream only to flush it, so that the whole data can
+      // still be compressed in one shot.
+      return true;
+    }
+    if (op == BROTLI_OPERATION_FINISH) {
+      // Ignore failure, compression did not start yet.
+      BrotliEncoderSetParameter(compressor_.get(), BROTLI_PARAM_SIZE_HINT,
+                                SaturatingIntCast<uint32_t>(src.size()));
+      // `BrotliEncoderMaxCompressedSize()` returns 0 if the size is too large.
+      const size_t max_size = BrotliEncoderMaxCompressedSize(src.size());
+      // Ensure that the output buffer is actually long enough.
+      if (reserve_max_size_ && max_size > 0) dest.Push(max_size);
+      if (max_size > 0 && dest.available() >= max_size) {
+        // The whole data are available and the output buffer is long enough,
+        // so compressed data can be written there directly instead of being
+        // copied from an internal buffer of `compressor_`.
+        size_t available_out = dest.available();
+        uint8_t* next_out = reinterpret_cast<uint8_t*>(dest.cursor());
+        if (ABSL_PREDICT_FALSE(!BrotliEncoderCompressStream(
+                compressor_.get(), op, &available_in, &next_in, &available_out,
+                &next_out, nullptr))) {
+          return Fail(
+              absl::InternalError("BrotliEncoderCompressStream() failed"));
+        }
+        dest.set_cursor(reinterpret_cast<char*>(next_out));
+        if (BrotliEncoderIsFinished(compressor_.get())) {
+          move_start_pos(src.size());
+          compressor_.reset();
+          return true;
+        }
+        // Otherwise take the remaining output below.
+      }
+    }
+  }
   size_t available_out = 0;
   for (;;) {
     if (ABSL_PREDICT_FALSE(!BrotliEncoderCompressStream(
@@ -198,6 +263,7 @@ inline bool BrotliWriterBase::WriteInternal(absl::string_view src, Writer& dest,
       }
     } else if (available_in == 0) {
       move_start_pos(src.size());
+      if (op == BROTLI_OPERATION_FINISH) compressor_.reset();
       return true;
     }
   }
@@ -15,6 +15,8 @@
 #ifndef RIEGELI_BROTLI_BROTLI_WRITER_H_
 #define RIEGELI_BROTLI_BROTLI_WRITER_H_
 
+#include <stddef.h>
+
 #include <memory>
 #include <utility>
 
@@ -24,6 +26,7 @@
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 #include "brotli/encode.h"
+#include "riegeli/base/arithmetic.h"
 #include "riegeli/base/assert.h"
 #include "riegeli/base/dependency.h"
 #include "riegeli/base/initializer.h"
@@ -140,11 +143,71 @@ class BrotliWriterBase : public BufferedWriter {
       return allocator_;
     }
 
+    // Exact uncompressed size, or `absl::nullopt` if unknown. This may improve
+    // compression density and performance. Unlike in Zstd, the size is not
+    // stored in the compressed stream.
+    //
+    // If the pledged size turns out to not match reality, compression fails.
+    //
+    // Default: `absl::nullopt`.
+    Options& set_pledged_size(absl::optional<Position> pledged_size) &
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      pledged_size_ = pledged_size;
+      return *this;
+    }
+    Options&& set_pledged_size(absl::optional<Position> pledged_size) &&
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      return std::move(set_pledged_size(pledged_size));
+    }
+    absl::optional<Position> pledged_size() const { return pledged_size_; }
+
+    // If `false`, `BrotliWriter` lets the destination choose buffer sizes.
+    //
+    // If `true`, `BrotliWriter` tries to compress all data in one step:
+    //
+    //  * Flattens uncompressed data if `pledged_size()` is not `absl::nullopt`.
+    //
+    //  * Asks the destination for a flat buffer with the maximum possible
+    //    compressed size, as long as the uncompressed size is known before
+    //    compression begins, e.g. if `pledged_size()` is not `absl::nullopt`.
+    //
+    // If all data are known before compression begins and the destination
+    // buffer is long enough, compressed data are written directly there instead
+    // of being copied from an internal buffer of the compressor.
+    //
+    // This makes compression slightly faster, but increases memory usage.
+    //
+    // Default: `false`.
+    Options& set_reserve_max_size(bool reserve_max_size) &
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      reserve_max_size_ = reserve_max_size;
+      return *this;
+    }
+    Options&& set_reserve_max_size(bool reserve_max_size) &&
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      return std::move(set_reserve_max_size(reserve_max_size));
+    }
+    bool reserve_max_size() const { return reserve_max_size_; }
+
+    // Returns effective `BufferOptions` as overridden by other options:
+    // If `reserve_max_size()` is `true` and `pledged_size()` is not
+    // `absl::nullopt`, then `pledged_size()` overrides `buffer_size()`.
+    BufferOptions effective_buffer_options() const {
+      BufferOptions options = buffer_options();
+      if (reserve_max_size() && pledged_size() != absl::nullopt) {
+        options.set_buffer_size(
+            UnsignedMax(SaturatingIntCast<size_t>(*pledged_size()), size_t{1}));
+      }
+      return options;
+    }
+
    private:
     int compression_level_ = kDefaultCompressionLevel;
     int window_log_ = kDefaultWindowLog;
     BrotliDictionary dictionary_;
     BrotliAllocator allocator_;
+    absl::optional<Position> pledged_size_;
+    bool reserve_max_size_ = false;
   };
 
   // Returns the compressed `Writer`. Unchanged by `Close()`.
@@ -157,14 +220,17 @@ class BrotliWriterBase : public BufferedWriter {
 
   explicit BrotliWriterBase(BufferOptions buffer_options,
                             BrotliDictionary&& dictionary,
-                            BrotliAllocator&& allocator);
+                            BrotliAllocator&& allocator,
+                            absl::optional<Position> pledged_size,
+                            bool reserve_max_size);
 
   BrotliWriterBase(BrotliWriterBase&& that) noexcept;
   BrotliWriterBase& operator=(BrotliWriterBase&& that) noexcept;
 
   void Reset(Closed);
   void Reset(BufferOptions buffer_options, BrotliDictionary&& dictionary,
-             BrotliAllocator&& allocator);
+             BrotliAllocator&& allocator,
+             absl::optional<Position> pledged_size, bool reserve_max_size);
   void Initialize(Writer* dest, int compression_level, int window_log);
   ABSL_ATTRIBUTE_COLD absl::Status AnnotateOverDest(absl::Status status);
 
@@ -189,7 +255,11 @@ class BrotliWriterBase : public BufferedWriter {
 
   BrotliDictionary dictionary_;
   BrotliAllocator allocator_;
+  absl::optional<Position> pledged_size_;
+  bool reserve_max_size_ = false;
   Position initial_compressed_pos_ = 0;
+  // If `ok()` but `compressor_ == nullptr` then `*pledged_size_` has been
+  // reached. In this case the compressed stream is finished.
   std::unique_ptr<BrotliEncoderState, BrotliEncoderStateDeleter> compressor_;
 
   AssociatedReader<BrotliReader<Reader*>> associated_reader_;
@@ -259,17 +329,22 @@ explicit BrotliWriter(Dest&& dest, BrotliWriterBase::Options options =
 
 // Implementation details follow.
 
-inline BrotliWriterBase::BrotliWriterBase(BufferOptions buffer_options,
-                                          BrotliDictionary&& dictionary,
-                                          BrotliAllocator&& allocator)
+inline BrotliWriterBase::BrotliWriterBase(
+    BufferOptions buffer_options, BrotliDictionary&& dictionary,
+    BrotliAllocator&& allocator, absl::optional<Position> pledged_size,
+    bool reserve_max_size)
     : BufferedWriter(buffer_options),
       dictionary_(std::move(dictionary)),
-      allocator_(std::move(allocator)) {}
+      allocator_(std::move(allocator)),
+      pledged_size_(pledged_size),
+      reserve_max_size_(reserve_max_size) {}
 
 inline BrotliWriterBase::BrotliWriterBase(BrotliWriterBase&& that) noexcept
     : BufferedWriter(static_cast<BufferedWriter&&>(that)),
       dictionary_(std::move(that.dictionary_)),
       allocator_(std::move(that.allocator_)),
+      pledged_size_(that.pledged_size_),
+      reserve_max_size_(that.reserve_max_size_),
       initial_compressed_pos_(that.initial_compressed_pos_),
       compressor_(std::move(that.compressor_)),
       associated_reader_(std::move(that.associated_reader_)) {}
@@ -279,6 +354,8 @@ inline BrotliWriterBase& BrotliWriterBase::operator=(
   BufferedWriter::operator=(static_cast<BufferedWriter&&>(that));
   dictionary_ = std::move(that.dictionary_);
   allocator_ = std::move(that.allocator_);
+  pledged_size_ = that.pledged_size_;
+  reserve_max_size_ = that.reserve_max_size_;
   initial_compressed_pos_ = that.initial_compressed_pos_;
   compressor_ = std::move(that.compressor_);
   associated_reader_ = std::move(that.associated_reader_);
@@ -287,6 +364,8 @@ inline BrotliWriterBase& BrotliWriterBase::operator=(
 
 inline void BrotliWriterBase::Reset(Closed) {
   BufferedWriter::Reset(kClosed);
+  pledged_size_ = absl::nullopt;
+  reserve_max_size_ = false;
   initial_compressed_pos_ = 0;
   compressor_.reset();
   dictionary_ = BrotliDictionary();
@@ -296,8 +375,12 @@ inline void BrotliWriterBase::Reset(Closed) {
 
 inline void BrotliWriterBase::Reset(BufferOptions buffer_options,
                                     BrotliDictionary&& dictionary,
-                                    BrotliAllocator&& allocator) {
+                                    BrotliAllocator&& allocator,
+                                    absl::optional<Position> pledged_size,
+                                    bool reserve_max_size) {
   BufferedWriter::Reset(buffer_options);
+  pledged_size_ = pledged_size;
+  reserve_max_size_ = reserve_max_size;
   initial_compressed_pos_ = 0;
   compressor_.reset();
   dictionary_ = std::move(dictionary);
@@ -307,9 +390,10 @@ inline void BrotliWriterBase::Reset(BufferOptions buffer_options,
 
 template <typename Dest>
 inline BrotliWriter<Dest>::BrotliWriter(Initializer<Dest> dest, Options options)
-    : BrotliWriterBase(options.buffer_options(),
+    : BrotliWriterBase(options.effective_buffer_options(),
                        std::move(options.dictionary()),
-                       std::move(options.allocator())),
+                       std::move(options.allocator()), options.pledged_size(),
+                       options.reserve_max_size()),
       dest_(std::move(dest)) {
   Initialize(dest_.get(), options.compression_level(), options.window_log());
 }
@@ -322,9 +406,10 @@ inline void BrotliWriter<Dest>::Reset(Closed) {
 
 template <typename Dest>
 inline void BrotliWriter<Dest>::Reset(Initializer<Dest> dest, Options options) {
-  BrotliWriterBase::Reset(options.buffer_options(),
+  BrotliWriterBase::Reset(options.effective_buffer_options(),
                           std::move(options.dictionary()),
-                          std::move(options.allocator()));
+                          std::move(options.allocator()),
+                          options.pledged_size(), options.reserve_max_size());
   dest_.Reset(std::move(dest));
   Initialize(dest_.get(), options.compression_level(), options.window_log());
 }
@@ -166,7 +166,11 @@ bool BufferedReader::ReadSlow(size_t length, char* dest) {
             !ReadInternal(length_to_read, length_to_read, dest))) {
       return false;
     }
-    return length_to_read >= length;
+    if (length_to_read < length) {
+      // `ReadInternal()` might have increased `exact_size()`.
+      return ReadSlow(length - length_to_read, dest + length_to_read);
+    }
+    return true;
   }
   return Reader::ReadSlow(length, dest);
 }
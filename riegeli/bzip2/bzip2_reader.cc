@@ -17,8 +17,12 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <cstring>
+#include <deque>
+#include <future>
 #include <limits>
 #include <memory>
+#include <string>
 #include <utility>
 
 #include "absl/base/optimization.h"
@@ -28,6 +32,7 @@
 #include "bzlib.h"
 #include "riegeli/base/arithmetic.h"
 #include "riegeli/base/assert.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/base/status.h"
 #include "riegeli/base/types.h"
 #include "riegeli/bytes/buffered_reader.h"
@@ -36,6 +41,483 @@
 
 namespace riegeli {
 
+namespace {
+
+// Magic numbers beginning a block and the end of a stream. They are not
+// aligned to byte boundaries.
+constexpr uint64_t kBlockMagic = 0x314159265359;
+constexpr uint64_t kEndMagic = 0x177245385090;
+constexpr uint64_t kMagicMask = (uint64_t{1} << 48) - 1;
+
+// Length of a magic number followed by a CRC, in bits.
+constexpr size_t kMagicAndCrcBits = 48 + 32;
+
+inline uint32_t RotateLeft1(uint32_t value) {
+  return (value << 1) | (value >> 31);
+}
+
+// Bits of a compressed block, beginning with its magic number.
+//
+// Bits are ordered as in Bzip2: from the most significant bit of each byte.
+struct BlockBits {
+  std::string data;
+  size_t bit_offset = 0;
+  size_t num_bits = 0;
+};
+
+// Returns 8 bits of `src` beginning at `bit_offset`, which must be available.
+inline uint32_t BitsAt(const char* src, size_t bit_offset) {
+  src += bit_offset / 8;
+  const size_t shift = bit_offset % 8;
+  uint32_t bits = uint32_t{static_cast<uint8_t>(src[0])} << shift;
+  if (shift > 0) bits |= uint32_t{static_cast<uint8_t>(src[1])} >> (8 - shift);
+  return bits & 0xff;
+}
+
+inline uint32_t Bits32At(const char* src, size_t bit_offset) {
+  return (BitsAt(src, bit_offset) << 24) | (BitsAt(src, bit_offset + 8) << 16) |
+         (BitsAt(src, bit_offset + 16) << 8) | BitsAt(src, bit_offset + 24);
+}
+
+// Returns the CRC of uncompressed data of a block, stored after its magic
+// number, or 0 if the block is too short to contain it.
+inline uint32_t BlockCrc(const BlockBits& bits) {
+  if (ABSL_PREDICT_FALSE(bits.num_bits < kMagicAndCrcBits)) return 0;
+  return Bits32At(bits.data.data(), bits.bit_offset + 48);
+}
+
+// Accumulates bits in Bzip2 bit order.
+class BitWriter {
+ public:
+  void Reserve(size_t num_bits) {
+    dest_.reserve(dest_.size() + (num_bits + acc_bits_) / 8 + 1);
+  }
+
+  // Writes the lowest `num_bits` bits of `value`, with `num_bits <= 32`.
+  void WriteBits(uint32_t value, size_t num_bits) {
+    acc_ = (acc_ << num_bits) | (value & ((uint64_t{1} << num_bits) - 1));
+    acc_bits_ += num_bits;
+    while (acc_bits_ >= 8) {
+      acc_bits_ -= 8;
+      dest_.push_back(static_cast<char>(acc_ >> acc_bits_));
+    }
+  }
+
+  void WriteBits(const BlockBits& bits) {
+    const char* const src = bits.data.data();
+    size_t bit_offset = bits.bit_offset;
+    const size_t end = bits.bit_offset + bits.num_bits;
+    while (end - bit_offset >= 8) {
+      WriteBits(BitsAt(src, bit_offset), 8);
+      bit_offset += 8;
+    }
+    if (bit_offset < end) {
+      const size_t num_bits = end - bit_offset;
+      const size_t shift = bit_offset % 8;
+      uint32_t byte = uint32_t{static_cast<uint8_t>(src[bit_offset / 8])}
+                      << shift;
+      if (shift + num_bits > 8) {
+        byte |= uint32_t{static_cast<uint8_t>(src[bit_offset / 8 + 1])} >>
+                (8 - shift);
+      }
+      WriteBits((byte & 0xff) >> (8 - num_bits), num_bits);
+    }
+  }
+
+  // Pads the last byte with zeros.
+  std::string Finish() && {
+    if (acc_bits_ > 0) WriteBits(0, 8 - acc_bits_);
+    return std::move(dest_);
+  }
+
+ private:
+  std::string dest_;
+  uint64_t acc_ = 0;
+  size_t acc_bits_ = 0;
+};
+
+// Makes a Bzip2 stream consisting of the given block, which can be
+// decompressed independently. The CRC of the stream is the CRC of the block.
+std::string MakeBlockStream(int level, const BlockBits& bits) {
+  BitWriter writer;
+  writer.Reserve(32 + bits.num_bits + kMagicAndCrcBits);
+  // HeaderMagic: "BZh1" to "BZh9".
+  writer.WriteBits(uint32_t{'B'}, 8);
+  writer.WriteBits(uint32_t{'Z'}, 8);
+  writer.WriteBits(uint32_t{'h'}, 8);
+  writer.WriteBits(static_cast<uint32_t>('0' + level), 8);
+  writer.WriteBits(bits);
+  writer.WriteBits(static_cast<uint32_t>(kEndMagic >> 16), 32);
+  writer.WriteBits(static_cast<uint32_t>(kEndMagic & 0xffff), 16);
+  writer.WriteBits(BlockCrc(bits), 32);
+  return std::move(writer).Finish();
+}
+
+BlockBits MergeBlockBits(const BlockBits& first, const BlockBits& second) {
+  BitWriter writer;
+  writer.Reserve(first.num_bits + second.num_bits);
+  writer.WriteBits(first);
+  writer.WriteBits(second);
+  return BlockBits{std::move(writer).Finish(), 0,
+                   first.num_bits + second.num_bits};
+}
+
+struct DecompressedBlock {
+  // `BZ_OK` on success.
+  int bzlib_code = BZ_OK;
+  std::string data;
+  // Compressed bits, kept for merging with the next block if a spurious magic
+  // number inside a block was taken as a block boundary.
+  BlockBits bits;
+};
+
+DecompressedBlock DecompressBlock(int level, BlockBits bits) {
+  DecompressedBlock block;
+  const std::string stream = MakeBlockStream(level, bits);
+  block.bits = std::move(bits);
+  bz_stream decompressor{};
+  block.bzlib_code = BZ2_bzDecompressInit(&decompressor, 0, 0);
+  if (ABSL_PREDICT_FALSE(block.bzlib_code != BZ_OK)) return block;
+  decompressor.next_in = const_cast<char*>(stream.data());
+  decompressor.avail_in = SaturatingIntCast<unsigned int>(stream.size());
+  // Most blocks do not expand beyond the block size, except through long runs
+  // of the same byte.
+  block.data.resize(size_t{100000} * IntCast<size_t>(level));
+  size_t length = 0;
+  for (;;) {
+    decompressor.next_out = &block.data[length];
+    decompressor.avail_out =
+        SaturatingIntCast<unsigned int>(block.data.size() - length);
+    const int bzlib_code = BZ2_bzDecompress(&decompressor);
+    length = PtrDistance(block.data.data(), decompressor.next_out);
+    if (bzlib_code == BZ_STREAM_END) break;
+    if (ABSL_PREDICT_FALSE(bzlib_code != BZ_OK)) {
+      block.bzlib_code = bzlib_code;
+      break;
+    }
+    if (ABSL_PREDICT_FALSE(decompressor.avail_out > 0)) {
+      // The stream ended before its end marker.
+      block.bzlib_code = BZ_DATA_ERROR;
+      break;
+    }
+    block.data.resize(block.data.size() * 2);
+  }
+  block.data.resize(length);
+  BZ2_bzDecompressEnd(&decompressor);
+  return block;
+}
+
+}  // namespace
+
+// Blocks are located by scanning the compressed stream for magic numbers.
+// A magic number can also occur by chance inside a block. If a block ending
+// at a block magic number fails to decompress, it is merged with the next
+// block. The end of a stream is accepted if the stored CRC of the stream
+// matches the CRCs of its blocks, or if the end of a stream is followed by the
+// end of the source or by the beginning of another stream.
+class Bzip2ReaderBase::ParallelDecompressor {
+ public:
+  enum class Result { kOutput, kEnd, kTruncated, kFailed, kSrcFailed };
+
+  explicit ParallelDecompressor(int parallelism, bool concatenate)
+      : parallelism_(IntCast<size_t>(parallelism)),
+        concatenate_(concatenate) {}
+
+  // Copies up to `max_length` decompressed bytes to `dest`, returning their
+  // length.
+  size_t ReadOutput(size_t max_length, char* dest);
+
+  // Makes the next decompressed block available for `ReadOutput()`, returning
+  // `Result::kOutput`. Otherwise there are no more blocks: `Result::kEnd`
+  // for a clean end, `Result::kTruncated` if the source ended in the middle of
+  // a stream, or `Result::kFailed` or `Result::kSrcFailed` with `status()`.
+  Result NextBlock(Reader& src);
+
+  const absl::Status& status() const { return status_; }
+
+ private:
+  struct Entry {
+    // The decompressed block, or an invalid future for the end of a stream.
+    std::future<DecompressedBlock> block;
+    int level = 0;
+    // The CRC of the block, or the stored CRC of the stream.
+    uint32_t crc = 0;
+  };
+
+  // Scans the compressed stream until the next block or the end of a stream
+  // is found, scheduling its decompression. Returns `false` if nothing more
+  // can be found now.
+  bool ScanNext(Reader& src);
+  bool ScanEnd(Reader& src, size_t magic_pos);
+  void AddBlock(size_t end_pos);
+  bool FailScanning(absl::Status status, bool src_failed);
+
+  size_t parallelism_;
+  bool concatenate_;
+  // Compression level of the current stream, or 0 before a stream header.
+  int level_ = 0;
+  // Compressed data of the current block, beginning with the byte containing
+  // its first bit, or data after a stream header if `!in_block_`.
+  std::string pending_;
+  bool in_block_ = false;
+  // Position of the current block in `pending_`, in bits.
+  size_t block_begin_ = 0;
+  // Magic numbers are searched for at bit positions in `pending_` not smaller
+  // than this.
+  size_t min_magic_pos_ = 0;
+  // The last 8 bytes of `pending_`.
+  uint64_t window_ = 0;
+  // Position of the end magic number in `pending_` if it is found but the
+  // source ended before the stream CRC, otherwise `std::string::npos`.
+  size_t end_magic_pos_ = std::string::npos;
+  // Combined CRC of blocks of the current stream which have been found.
+  uint32_t scanned_stream_crc_ = 0;
+  // If `true`, there are no more blocks to find, and `status_` tells whether
+  // this is a failure.
+  bool scan_finished_ = false;
+  bool src_failed_ = false;
+  absl::Status status_;
+  // Blocks being decompressed and ends of streams, in order.
+  std::deque<Entry> entries_;
+  // Combined CRC of decompressed blocks of the current stream.
+  uint32_t stream_crc_ = 0;
+  std::string output_;
+  size_t output_pos_ = 0;
+};
+
+void Bzip2ReaderBase::ParallelDecompressorDeleter::operator()(
+    ParallelDecompressor* ptr) const {
+  delete ptr;
+}
+
+size_t Bzip2ReaderBase::ParallelDecompressor::ReadOutput(size_t max_length,
+                                                         char* dest) {
+  const size_t length = UnsignedMin(output_.size() - output_pos_, max_length);
+  std::memcpy(dest, output_.data() + output_pos_, length);
+  output_pos_ += length;
+  return length;
+}
+
+Bzip2ReaderBase::ParallelDecompressor::Result
+Bzip2ReaderBase::ParallelDecompressor::NextBlock(Reader& src) {
+  for (;;) {
+    while (entries_.size() < parallelism_ && ScanNext(src)) {
+    }
+    if (entries_.empty()) {
+      if (!scan_finished_) return Result::kTruncated;
+      if (ABSL_PREDICT_TRUE(status_.ok())) return Result::kEnd;
+      return src_failed_ ? Result::kSrcFailed : Result::kFailed;
+    }
+    Entry entry = std::move(entries_.front());
+    entries_.pop_front();
+    if (!entry.block.valid()) {
+      if (ABSL_PREDICT_FALSE(entry.crc != stream_crc_)) {
+        entries_.clear();
+        scan_finished_ = true;
+        status_ = absl::InvalidArgumentError(
+            "Invalid Bzip2-compressed stream: stream CRC mismatch");
+        return Result::kFailed;
+      }
+      stream_crc_ = 0;
+      continue;
+    }
+    DecompressedBlock block = entry.block.get();
+    while (ABSL_PREDICT_FALSE(block.bzlib_code != BZ_OK)) {
+      if (entries_.empty()) ScanNext(src);
+      if (entries_.empty() || !entries_.front().block.valid() ||
+          block.bzlib_code == BZ_MEM_ERROR) {
+        entries_.clear();
+        scan_finished_ = true;
+        status_ = bzip2_internal::Bzip2ErrorToStatus("BZ2_bzDecompress()",
+                                                     block.bzlib_code);
+        return Result::kFailed;
+      }
+      DecompressedBlock next_block = entries_.front().block.get();
+      entries_.pop_front();
+      block = DecompressBlock(entry.level,
+                              MergeBlockBits(block.bits, next_block.bits));
+    }
+    stream_crc_ = RotateLeft1(stream_crc_) ^ entry.crc;
+    output_ = std::move(block.data);
+    output_pos_ = 0;
+    if (!output_.empty()) return Result::kOutput;
+  }
+}
+
+inline bool Bzip2ReaderBase::ParallelDecompressor::FailScanning(
+    absl::Status status, bool src_failed) {
+  scan_finished_ = true;
+  src_failed_ = src_failed;
+  status_ = std::move(status);
+  return false;
+}
+
+bool Bzip2ReaderBase::ParallelDecompressor::ScanNext(Reader& src) {
+  if (scan_finished_) return false;
+  if (end_magic_pos_ != std::string::npos) {
+    const size_t magic_pos = end_magic_pos_;
+    if (ScanEnd(src, magic_pos)) return true;
+    if (end_magic_pos_ != std::string::npos || scan_finished_) return false;
+    // The end magic number occurred by chance inside a block.
+    min_magic_pos_ = magic_pos + 1;
+  } else if (level_ == 0) {
+    // HeaderMagic: "BZh1" to "BZh9".
+    if (!src.Pull(4)) {
+      if (ABSL_PREDICT_FALSE(!src.ok())) {
+        return FailScanning(src.status(), true);
+      }
+      if (concatenate_ && src.available() == 0) scan_finished_ = true;
+      return false;
+    }
+    const char* const header = src.cursor();
+    if (ABSL_PREDICT_FALSE(header[0] != 'B' || header[1] != 'Z' ||
+                           header[2] != 'h' || header[3] < '1' ||
+                           header[3] > '9')) {
+      return FailScanning(bzip2_internal::Bzip2ErrorToStatus(
+                              "BZ2_bzDecompress()", BZ_DATA_ERROR_MAGIC),
+                          false);
+    }
+    level_ = header[3] - '0';
+    src.move_cursor(4);
+    pending_.clear();
+    in_block_ = false;
+    min_magic_pos_ = 0;
+    window_ = 0;
+    scanned_stream_crc_ = 0;
+  }
+  for (;;) {
+    const char* cursor = src.cursor();
+    uint64_t window = window_;
+    size_t end_bit = pending_.size() * 8;
+    uint64_t magic = 0;
+    size_t magic_pos = 0;
+    while (cursor < src.limit()) {
+      window = (window << 8) | uint64_t{static_cast<uint8_t>(*cursor++)};
+      end_bit += 8;
+      if (end_bit < min_magic_pos_ + 48) continue;
+      for (size_t shift = 8; shift-- > 0;) {
+        if (end_bit - 48 < min_magic_pos_ + shift) continue;
+        const uint64_t candidate = (window >> shift) & kMagicMask;
+        if (ABSL_PREDICT_FALSE(candidate == kBlockMagic ||
+                               candidate == kEndMagic)) {
+          magic = candidate;
+          magic_pos = end_bit - 48 - shift;
+          break;
+        }
+      }
+      if (magic != 0) break;
+    }
+    pending_.append(src.cursor(), PtrDistance(src.cursor(), cursor));
+    src.set_cursor(cursor);
+    window_ = window;
+    if (magic == 0) {
+      // The magic number must follow the stream header, and a block cannot be
+      // longer than twice its uncompressed size.
+      if (ABSL_PREDICT_FALSE(
+              (!in_block_ && pending_.size() >= 6) ||
+              pending_.size() > size_t{200000} * IntCast<size_t>(level_))) {
+        return FailScanning(bzip2_internal::Bzip2ErrorToStatus(
+                                "BZ2_bzDecompress()", BZ_DATA_ERROR),
+                            false);
+      }
+      if (!src.Pull()) {
+        if (ABSL_PREDICT_FALSE(!src.ok())) {
+          return FailScanning(src.status(), true);
+        }
+        return false;
+      }
+      continue;
+    }
+    if (ABSL_PREDICT_FALSE(!in_block_ && magic_pos != 0)) {
+      return FailScanning(bzip2_internal::Bzip2ErrorToStatus(
+                              "BZ2_bzDecompress()", BZ_DATA_ERROR),
+                          false);
+    }
+    if (magic == kEndMagic) {
+      if (ScanEnd(src, magic_pos)) return true;
+      if (end_magic_pos_ != std::string::npos || scan_finished_) return false;
+      // The end magic number occurred by chance inside a block.
+      min_magic_pos_ = magic_pos + 1;
+      continue;
+    }
+    if (!in_block_) {
+      in_block_ = true;
+      block_begin_ = 0;
+      min_magic_pos_ = kMagicAndCrcBits;
+      continue;
+    }
+    AddBlock(magic_pos);
+    min_magic_pos_ = block_begin_ + kMagicAndCrcBits;
+    return true;
+  }
+}
+
+bool Bzip2ReaderBase::ParallelDecompressor::ScanEnd(Reader& src,
+                                                    size_t magic_pos) {
+  // The stream ends after the stream CRC, padded to a byte boundary.
+  const size_t stream_end = (magic_pos + kMagicAndCrcBits + 7) / 8;
+  const size_t missing = stream_end - pending_.size();
+  end_magic_pos_ = magic_pos;
+  if (!src.Pull(missing)) {
+    if (ABSL_PREDICT_FALSE(!src.ok())) return FailScanning(src.status(), true);
+    return false;
+  }
+  end_magic_pos_ = std::string::npos;
+  std::string tail = pending_.substr(magic_pos / 8);
+  tail.append(src.cursor(), missing);
+  const uint32_t stored_crc = Bits32At(tail.data(), magic_pos % 8 + 48);
+  uint32_t stream_crc = scanned_stream_crc_;
+  if (in_block_) {
+    stream_crc = RotateLeft1(stream_crc) ^
+                 Bits32At(pending_.data(), block_begin_ + 48);
+  }
+  if (stored_crc != stream_crc) {
+    // The CRC does not confirm the end of the stream, but the CRCs of blocks
+    // are not reliable if a block has been split at a spurious magic number.
+    if (src.Pull(missing + 1)) {
+      if (!concatenate_ || !src.Pull(missing + 10)) return false;
+      const char* const next = src.cursor() + missing;
+      uint64_t next_magic = 0;
+      for (size_t i = 4; i < 10; ++i) {
+        next_magic =
+            (next_magic << 8) | uint64_t{static_cast<uint8_t>(next[i])};
+      }
+      if (!(next[0] == 'B' && next[1] == 'Z' && next[2] == 'h' &&
+            next[3] >= '1' && next[3] <= '9' &&
+            (next_magic == kBlockMagic || next_magic == kEndMagic))) {
+        return false;
+      }
+    } else if (ABSL_PREDICT_FALSE(!src.ok())) {
+      return FailScanning(src.status(), true);
+    }
+  }
+  src.move_cursor(missing);
+  if (in_block_) AddBlock(magic_pos);
+  entries_.push_back(Entry{std::future<DecompressedBlock>(), level_,
+                           stored_crc});
+  level_ = 0;
+  pending_.clear();
+  in_block_ = false;
+  if (!concatenate_) scan_finished_ = true;
+  return true;
+}
+
+void Bzip2ReaderBase::ParallelDecompressor::AddBlock(size_t end_pos) {
+  BlockBits bits{pending_.substr(0, (end_pos + 7) / 8), block_begin_,
+                 end_pos - block_begin_};
+  const uint32_t block_crc = BlockCrc(bits);
+  scanned_stream_crc_ = RotateLeft1(scanned_stream_crc_) ^ block_crc;
+  std::promise<DecompressedBlock> promise;
+  entries_.push_back(Entry{promise.get_future(), level_, block_crc});
+  internal::ThreadPool::global().Schedule(
+      [promise = std::move(promise), level = level_,
+       bits = std::move(bits)]() mutable {
+        promise.set_value(DecompressBlock(level, std::move(bits)));
+      });
+  pending_.erase(0, end_pos / 8);
+  block_begin_ = end_pos % 8;
+}
+
 void Bzip2ReaderBase::Initialize(Reader* src) {
   RIEGELI_ASSERT(src != nullptr)
       << "Failed precondition of Bzip2Reader: null Reader pointer";
@@ -48,6 +530,11 @@ void Bzip2ReaderBase::Initialize(Reader* src) {
 }
 
 inline void Bzip2ReaderBase::InitializeDecompressor() {
+  if (parallelism_ > 0) {
+    parallel_decompressor_.reset(
+        new ParallelDecompressor(parallelism_, concatenate_));
+    return;
+  }
   decompressor_.reset(new bz_stream());
   const int bzlib_code = BZ2_bzDecompressInit(decompressor_.get(), 0, 0);
   if (ABSL_PREDICT_FALSE(bzlib_code != BZ_OK)) {
@@ -64,6 +551,7 @@ void Bzip2ReaderBase::Done() {
   }
   BufferedReader::Done();
   decompressor_.reset();
+  parallel_decompressor_.reset();
 }
 
 inline bool Bzip2ReaderBase::FailOperation(absl::string_view operation,
@@ -109,6 +597,9 @@ bool Bzip2ReaderBase::ReadInternal(size_t min_length, size_t max_length,
          "max_length < min_length";
   RIEGELI_ASSERT(ok())
       << "Failed precondition of BufferedReader::ReadInternal(): " << status();
+  if (parallel_decompressor_ != nullptr) {
+    return ReadInternalParallel(min_length, max_length, dest);
+  }
   Reader& src = *SrcReader();
   truncated_ = false;
   max_length = UnsignedMin(max_length,
@@ -181,6 +672,48 @@ bool Bzip2ReaderBase::ReadInternal(size_t min_length, size_t max_length,
   }
 }
 
+bool Bzip2ReaderBase::ReadInternalParallel(size_t min_length,
+                                           size_t max_length, char* dest) {
+  Reader& src = *SrcReader();
+  truncated_ = false;
+  max_length = UnsignedMin(max_length,
+                           std::numeric_limits<Position>::max() - limit_pos());
+  size_t length_read = 0;
+  for (;;) {
+    length_read += parallel_decompressor_->ReadOutput(max_length - length_read,
+                                                      dest + length_read);
+    if (length_read >= min_length) break;
+    if (ABSL_PREDICT_FALSE(length_read == max_length)) {
+      move_limit_pos(length_read);
+      return FailOverflow();
+    }
+    switch (parallel_decompressor_->NextBlock(src)) {
+      case ParallelDecompressor::Result::kOutput:
+        continue;
+      case ParallelDecompressor::Result::kEnd:
+        parallel_decompressor_.reset();
+        move_limit_pos(length_read);
+        // Avoid `BufferedReader` allocating another buffer.
+        set_exact_size(limit_pos());
+        return false;
+      case ParallelDecompressor::Result::kTruncated:
+        move_limit_pos(length_read);
+        truncated_ = true;
+        return false;
+      case ParallelDecompressor::Result::kFailed:
+        move_limit_pos(length_read);
+        return Fail(parallel_decompressor_->status());
+      case ParallelDecompressor::Result::kSrcFailed:
+        move_limit_pos(length_read);
+        return FailWithoutAnnotation(
+            AnnotateOverSrc(parallel_decompressor_->status()));
+    }
+    RIEGELI_ASSERT_UNREACHABLE() << "Unknown result";
+  }
+  move_limit_pos(length_read);
+  return true;
+}
+
 void Bzip2ReaderBase::ExactSizeReached() {
   if (decompressor_ == nullptr) return;
   char buffer[1];
@@ -219,6 +752,7 @@ bool Bzip2ReaderBase::SeekBehindBuffer(Position new_pos) {
     set_buffer();
     set_limit_pos(0);
     decompressor_.reset();
+    parallel_decompressor_.reset();
     if (ABSL_PREDICT_FALSE(!src.Seek(initial_compressed_pos_))) {
       return FailWithoutAnnotation(AnnotateOverSrc(src.StatusOrAnnotate(
           absl::DataLossError("Bzip2-compressed stream got truncated"))));
@@ -251,6 +785,7 @@ std::unique_ptr<Reader> Bzip2ReaderBase::NewReaderImpl(Position initial_pos) {
           std::move(compressed_reader),
           Bzip2ReaderBase::Options()
               .set_concatenate(concatenate_)
+              .set_parallelism(parallelism_)
               .set_buffer_options(buffer_options()));
   reader->Seek(initial_pos);
   return reader;
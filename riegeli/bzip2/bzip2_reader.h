@@ -60,8 +60,33 @@ class Bzip2ReaderBase : public BufferedReader {
     }
     bool concatenate() const { return concatenate_; }
 
+    // Number of Bzip2 blocks to decompress concurrently in background threads.
+    // `parallelism() == 0` decompresses in the current thread.
+    //
+    // If `parallelism() > 0`, boundaries of blocks are located by scanning the
+    // compressed stream for bit-aligned block magic numbers, each block is
+    // decompressed independently, and decompressed blocks are returned in
+    // order. This pays off for streams consisting of many blocks: each block
+    // holds up to 100 KB times the compression level of uncompressed data.
+    //
+    // Default: 0.
+    Options& set_parallelism(int parallelism) & ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      RIEGELI_ASSERT_GE(parallelism, 0)
+          << "Failed precondition of "
+             "Bzip2ReaderBase::Options::set_parallelism(): "
+             "negative parallelism";
+      parallelism_ = parallelism;
+      return *this;
+    }
+    Options&& set_parallelism(int parallelism) &&
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      return std::move(set_parallelism(parallelism));
+    }
+    int parallelism() const { return parallelism_; }
+
    private:
     bool concatenate_ = false;
+    int parallelism_ = 0;
   };
 
   // Returns the compressed `Reader`. Unchanged by `Close()`.
@@ -86,13 +111,14 @@ class Bzip2ReaderBase : public BufferedReader {
  protected:
   explicit Bzip2ReaderBase(Closed) noexcept : BufferedReader(kClosed) {}
 
-  explicit Bzip2ReaderBase(BufferOptions buffer_options, bool concatenate);
+  explicit Bzip2ReaderBase(BufferOptions buffer_options, bool concatenate,
+                           int parallelism);
 
   Bzip2ReaderBase(Bzip2ReaderBase&& that) noexcept;
   Bzip2ReaderBase& operator=(Bzip2ReaderBase&& that) noexcept;
 
   void Reset(Closed);
-  void Reset(BufferOptions buffer_options, bool concatenate);
+  void Reset(BufferOptions buffer_options, bool concatenate, int parallelism);
   void Initialize(Reader* src);
   ABSL_ATTRIBUTE_COLD absl::Status AnnotateOverSrc(absl::Status status);
 
@@ -114,11 +140,19 @@ class Bzip2ReaderBase : public BufferedReader {
     }
   };
 
+  // State of decompressing blocks in background threads.
+  class ParallelDecompressor;
+  struct ParallelDecompressorDeleter {
+    void operator()(ParallelDecompressor* ptr) const;
+  };
+
   void InitializeDecompressor();
   ABSL_ATTRIBUTE_COLD bool FailOperation(absl::string_view operation,
                                          int bzlib_code);
+  bool ReadInternalParallel(size_t min_length, size_t max_length, char* dest);
 
   bool concatenate_ = false;
+  int parallelism_ = 0;
   // If `true`, the source is truncated (without a clean end of the compressed
   // stream) at the current position. If the source does not grow, `Close()`
   // will fail.
@@ -128,10 +162,14 @@ class Bzip2ReaderBase : public BufferedReader {
   // legitimate, it does not imply that the source is truncated.
   bool stream_had_data_ = false;
   Position initial_compressed_pos_ = 0;
-  // If `ok()` but `decompressor_ == nullptr` then all data have been
-  // decompressed, `exact_size() == limit_pos()`, and `ReadInternal()` must not
-  // be called again.
+  // If `ok()` but `decompressor_ == nullptr` and
+  // `parallel_decompressor_ == nullptr` then all data have been decompressed,
+  // `exact_size() == limit_pos()`, and `ReadInternal()` must not be called
+  // again.
   std::unique_ptr<bz_stream, BZStreamDeleter> decompressor_;
+  // Used instead of `decompressor_` if `parallelism_ > 0`.
+  std::unique_ptr<ParallelDecompressor, ParallelDecompressorDeleter>
+      parallel_decompressor_;
 };
 
 // A `Reader` which decompresses data with Bzip2 after getting it from another
@@ -204,50 +242,61 @@ bool RecognizeBzip2(Reader& src);
 // Implementation details follow.
 
 inline Bzip2ReaderBase::Bzip2ReaderBase(BufferOptions buffer_options,
-                                        bool concatenate)
-    : BufferedReader(buffer_options), concatenate_(concatenate) {}
+                                        bool concatenate, int parallelism)
+    : BufferedReader(buffer_options),
+      concatenate_(concatenate),
+      parallelism_(parallelism) {}
 
 inline Bzip2ReaderBase::Bzip2ReaderBase(Bzip2ReaderBase&& that) noexcept
     : BufferedReader(static_cast<BufferedReader&&>(that)),
       concatenate_(that.concatenate_),
+      parallelism_(that.parallelism_),
       truncated_(that.truncated_),
       stream_had_data_(that.stream_had_data_),
       initial_compressed_pos_(that.initial_compressed_pos_),
-      decompressor_(std::move(that.decompressor_)) {}
+      decompressor_(std::move(that.decompressor_)),
+      parallel_decompressor_(std::move(that.parallel_decompressor_)) {}
 
 inline Bzip2ReaderBase& Bzip2ReaderBase::operator=(
     Bzip2ReaderBase&& that) noexcept {
   BufferedReader::operator=(static_cast<BufferedReader&&>(that));
   concatenate_ = that.concatenate_;
+  parallelism_ = that.parallelism_;
   truncated_ = that.truncated_;
   stream_had_data_ = that.stream_had_data_;
   initial_compressed_pos_ = that.initial_compressed_pos_;
   decompressor_ = std::move(that.decompressor_);
+  parallel_decompressor_ = std::move(that.parallel_decompressor_);
   return *this;
 }
 
 inline void Bzip2ReaderBase::Reset(Closed) {
   BufferedReader::Reset(kClosed);
   concatenate_ = false;
+  parallelism_ = 0;
   truncated_ = false;
   stream_had_data_ = false;
   initial_compressed_pos_ = 0;
   decompressor_.reset();
+  parallel_decompressor_.reset();
 }
 
 inline void Bzip2ReaderBase::Reset(BufferOptions buffer_options,
-                                   bool concatenate) {
+                                   bool concatenate, int parallelism) {
   BufferedReader::Reset(buffer_options);
   concatenate_ = concatenate;
+  parallelism_ = parallelism;
   truncated_ = false;
   stream_had_data_ = false;
   initial_compressed_pos_ = 0;
   decompressor_.reset();
+  parallel_decompressor_.reset();
 }
 
 template <typename Src>
 inline Bzip2Reader<Src>::Bzip2Reader(Initializer<Src> src, Options options)
-    : Bzip2ReaderBase(options.buffer_options(), options.concatenate()),
+    : Bzip2ReaderBase(options.buffer_options(), options.concatenate(),
+                      options.parallelism()),
       src_(std::move(src)) {
   Initialize(src_.get());
 }
@@ -260,7 +309,8 @@ inline void Bzip2Reader<Src>::Reset(Closed) {
 
 template <typename Src>
 inline void Bzip2Reader<Src>::Reset(Initializer<Src> src, Options options) {
-  Bzip2ReaderBase::Reset(options.buffer_options(), options.concatenate());
+  Bzip2ReaderBase::Reset(options.buffer_options(), options.concatenate(),
+                         options.parallelism());
   src_.Reset(std::move(src));
   Initialize(src_.get());
 }
@@ -16,8 +16,11 @@
 
 #include <stddef.h>
 
+#include <deque>
+#include <future>
 #include <limits>
 #include <memory>
+#include <string>
 #include <utility>
 
 #include "absl/base/optimization.h"
@@ -27,6 +30,7 @@
 #include "bzlib.h"
 #include "riegeli/base/arithmetic.h"
 #include "riegeli/base/assert.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/base/status.h"
 #include "riegeli/base/types.h"
 #include "riegeli/bytes/buffered_writer.h"
@@ -44,7 +48,118 @@ constexpr int Bzip2WriterBase::Options::kMaxCompressionLevel;
 constexpr int Bzip2WriterBase::Options::kDefaultCompressionLevel;
 #endif
 
-void Bzip2WriterBase::Initialize(Writer* dest, int compression_level) {
+namespace {
+
+struct CompressedChunk {
+  // `BZ_OK` on success.
+  int bzlib_code = BZ_OK;
+  std::string data;
+};
+
+CompressedChunk CompressChunk(int compression_level, const std::string& src) {
+  CompressedChunk chunk;
+  // The bound of compressed size documented by bzip2.
+  unsigned int length = SaturatingIntCast<unsigned int>(
+      src.size() + src.size() / 100 + 600);
+  chunk.data.resize(length);
+  chunk.bzlib_code = BZ2_bzBuffToBuffCompress(
+      &chunk.data[0], &length, const_cast<char*>(src.data()),
+      SaturatingIntCast<unsigned int>(src.size()), compression_level, 0, 0);
+  chunk.data.resize(chunk.bzlib_code == BZ_OK ? length : 0);
+  return chunk;
+}
+
+}  // namespace
+
+class Bzip2WriterBase::ParallelCompressor {
+ public:
+  explicit ParallelCompressor(int parallelism, int compression_level)
+      : parallelism_(IntCast<size_t>(parallelism)),
+        compression_level_(compression_level),
+        chunk_size_(size_t{100000} * IntCast<size_t>(compression_level)) {}
+
+  // Compresses `src`, writing compressed chunks to `dest` when they are ready.
+  // If `end_stream`, ends the current stream, and writes all remaining
+  // compressed chunks.
+  //
+  // Returns `false` on failure: of `dest`, or with `bzlib_code()`.
+  bool Write(absl::string_view src, Writer& dest, bool end_stream);
+
+  int bzlib_code() const { return bzlib_code_; }
+
+ private:
+  bool ScheduleChunk(Writer& dest);
+  bool WriteChunk(Writer& dest);
+
+  size_t parallelism_;
+  int compression_level_;
+  size_t chunk_size_;
+  // Uncompressed data of the current chunk.
+  std::string chunk_;
+  // If `false`, no chunk has been scheduled yet.
+  bool has_chunks_ = false;
+  // Chunks being compressed, in order.
+  std::deque<std::future<CompressedChunk>> compressed_chunks_;
+  int bzlib_code_ = BZ_OK;
+};
+
+void Bzip2WriterBase::ParallelCompressorDeleter::operator()(
+    ParallelCompressor* ptr) const {
+  delete ptr;
+}
+
+bool Bzip2WriterBase::ParallelCompressor::Write(absl::string_view src,
+                                                Writer& dest,
+                                                bool end_stream) {
+  while (!src.empty()) {
+    if (chunk_.empty()) chunk_.reserve(chunk_size_);
+    const size_t length = UnsignedMin(src.size(), chunk_size_ - chunk_.size());
+    chunk_.append(src.data(), length);
+    src.remove_prefix(length);
+    if (chunk_.size() == chunk_size_) {
+      if (ABSL_PREDICT_FALSE(!ScheduleChunk(dest))) return false;
+    }
+  }
+  if (end_stream) {
+    // If there was no data at all, an empty stream is written.
+    if (!chunk_.empty() || !has_chunks_) {
+      if (ABSL_PREDICT_FALSE(!ScheduleChunk(dest))) return false;
+    }
+    while (!compressed_chunks_.empty()) {
+      if (ABSL_PREDICT_FALSE(!WriteChunk(dest))) return false;
+    }
+  }
+  return true;
+}
+
+bool Bzip2WriterBase::ParallelCompressor::ScheduleChunk(Writer& dest) {
+  while (compressed_chunks_.size() >= parallelism_) {
+    if (ABSL_PREDICT_FALSE(!WriteChunk(dest))) return false;
+  }
+  std::promise<CompressedChunk> promise;
+  compressed_chunks_.push_back(promise.get_future());
+  has_chunks_ = true;
+  internal::ThreadPool::global().Schedule(
+      [promise = std::move(promise), compression_level = compression_level_,
+       chunk = std::move(chunk_)]() mutable {
+        promise.set_value(CompressChunk(compression_level, chunk));
+      });
+  chunk_ = std::string();
+  return true;
+}
+
+bool Bzip2WriterBase::ParallelCompressor::WriteChunk(Writer& dest) {
+  const CompressedChunk chunk = compressed_chunks_.front().get();
+  compressed_chunks_.pop_front();
+  if (ABSL_PREDICT_FALSE(chunk.bzlib_code != BZ_OK)) {
+    bzlib_code_ = chunk.bzlib_code;
+    return false;
+  }
+  return dest.Write(chunk.data);
+}
+
+void Bzip2WriterBase::Initialize(Writer* dest, int compression_level,
+                                 int parallelism) {
   RIEGELI_ASSERT(dest != nullptr)
       << "Failed precondition of Bzip2Writer: null Writer pointer";
   if (ABSL_PREDICT_FALSE(!dest->ok())) {
@@ -52,6 +167,11 @@ void Bzip2WriterBase::Initialize(Writer* dest, int compression_level) {
     return;
   }
   initial_compressed_pos_ = dest->pos();
+  if (parallelism > 0) {
+    parallel_compressor_.reset(
+        new ParallelCompressor(parallelism, compression_level));
+    return;
+  }
   compressor_.reset(new bz_stream());
   const int bzlib_code =
       BZ2_bzCompressInit(compressor_.get(), compression_level, 0, 0);
@@ -73,6 +193,7 @@ void Bzip2WriterBase::DoneBehindBuffer(absl::string_view src) {
 void Bzip2WriterBase::Done() {
   BufferedWriter::Done();
   compressor_.reset();
+  parallel_compressor_.reset();
 }
 
 inline bool Bzip2WriterBase::FailOperation(absl::string_view operation,
@@ -124,6 +245,9 @@ inline bool Bzip2WriterBase::WriteInternal(absl::string_view src, Writer& dest,
                          std::numeric_limits<Position>::max() - start_pos())) {
     return FailOverflow();
   }
+  if (parallel_compressor_ != nullptr) {
+    return WriteInternalParallel(src, dest, flush);
+  }
   compressor_->next_in = const_cast<char*>(src.data());
   for (;;) {
     // If no progress was made, e.g. `compressor_->avail_out == 0` but
@@ -175,6 +299,20 @@ inline bool Bzip2WriterBase::WriteInternal(absl::string_view src, Writer& dest,
   }
 }
 
+bool Bzip2WriterBase::WriteInternalParallel(absl::string_view src,
+                                            Writer& dest, int flush) {
+  if (ABSL_PREDICT_FALSE(
+          !parallel_compressor_->Write(src, dest, flush != BZ_RUN))) {
+    if (ABSL_PREDICT_FALSE(!dest.ok())) {
+      return FailWithoutAnnotation(AnnotateOverDest(dest.status()));
+    }
+    return FailOperation("BZ2_bzBuffToBuffCompress()",
+                         parallel_compressor_->bzlib_code());
+  }
+  move_start_pos(src.size());
+  return true;
+}
+
 bool Bzip2WriterBase::FlushBehindBuffer(absl::string_view src,
                                         FlushType flush_type) {
   RIEGELI_ASSERT_EQ(start_to_limit(), 0u)
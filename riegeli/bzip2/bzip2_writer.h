@@ -68,8 +68,35 @@ class Bzip2WriterBase : public BufferedWriter {
     }
     int compression_level() const { return compression_level_; }
 
+    // Number of chunks to compress concurrently in background threads.
+    // `parallelism() == 0` compresses in the current thread.
+    //
+    // If `parallelism() > 0`, data are split into chunks of 100 KB times the
+    // compression level, and each chunk is compressed independently to a
+    // separate Bzip2 stream, like by `pbzip2`. Decompressing this requires
+    // `Bzip2ReaderBase::Options::set_concatenate(true)` (the `bzip2` and
+    // `pbzip2` tools decompress concatenated streams). `Flush()` ends the
+    // current stream, which makes it effective, at the cost of compression
+    // density.
+    //
+    // Default: 0.
+    Options& set_parallelism(int parallelism) & ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      RIEGELI_ASSERT_GE(parallelism, 0)
+          << "Failed precondition of "
+             "Bzip2WriterBase::Options::set_parallelism(): "
+             "negative parallelism";
+      parallelism_ = parallelism;
+      return *this;
+    }
+    Options&& set_parallelism(int parallelism) &&
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      return std::move(set_parallelism(parallelism));
+    }
+    int parallelism() const { return parallelism_; }
+
    private:
     int compression_level_ = kDefaultCompressionLevel;
+    int parallelism_ = 0;
   };
 
   // Returns the compressed `Writer`. Unchanged by `Close()`.
@@ -85,7 +112,7 @@ class Bzip2WriterBase : public BufferedWriter {
 
   void Reset(Closed);
   void Reset(BufferOptions buffer_options);
-  void Initialize(Writer* dest, int compression_level);
+  void Initialize(Writer* dest, int compression_level, int parallelism);
   ABSL_ATTRIBUTE_COLD absl::Status AnnotateOverDest(absl::Status status);
 
   void DoneBehindBuffer(absl::string_view src) override;
@@ -105,12 +132,22 @@ class Bzip2WriterBase : public BufferedWriter {
     }
   };
 
+  // State of compressing chunks in background threads.
+  class ParallelCompressor;
+  struct ParallelCompressorDeleter {
+    void operator()(ParallelCompressor* ptr) const;
+  };
+
   ABSL_ATTRIBUTE_COLD bool FailOperation(absl::string_view operation,
                                          int bzlib_code);
   bool WriteInternal(absl::string_view src, Writer& dest, int flush);
+  bool WriteInternalParallel(absl::string_view src, Writer& dest, int flush);
 
   Position initial_compressed_pos_ = 0;
   std::unique_ptr<bz_stream, BZStreamDeleter> compressor_;
+  // Used instead of `compressor_` if `Options::parallelism() > 0`.
+  std::unique_ptr<ParallelCompressor, ParallelCompressorDeleter>
+      parallel_compressor_;
 };
 
 // A `Writer` which compresses data with Bzip2 before passing it to another
@@ -130,7 +167,8 @@ class Bzip2WriterBase : public BufferedWriter {
 // closed or no longer used.
 //
 // Because Bzip2 blocks are bit-aligned, `Flush()` is not effective (the effect
-// is usually delayed by one block) and `ReadMode()` is not supported.
+// is usually delayed by one block) unless `Options::parallelism() > 0`, and
+// `ReadMode()` is not supported.
 template <typename Dest = Writer*>
 class Bzip2Writer : public Bzip2WriterBase {
  public:
@@ -185,13 +223,15 @@ inline Bzip2WriterBase::Bzip2WriterBase(BufferOptions buffer_options)
 inline Bzip2WriterBase::Bzip2WriterBase(Bzip2WriterBase&& that) noexcept
     : BufferedWriter(static_cast<BufferedWriter&&>(that)),
       initial_compressed_pos_(that.initial_compressed_pos_),
-      compressor_(std::move(that.compressor_)) {}
+      compressor_(std::move(that.compressor_)),
+      parallel_compressor_(std::move(that.parallel_compressor_)) {}
 
 inline Bzip2WriterBase& Bzip2WriterBase::operator=(
     Bzip2WriterBase&& that) noexcept {
   BufferedWriter::operator=(static_cast<BufferedWriter&&>(that));
   initial_compressed_pos_ = that.initial_compressed_pos_;
   compressor_ = std::move(that.compressor_);
+  parallel_compressor_ = std::move(that.parallel_compressor_);
   return *this;
 }
 
@@ -199,18 +239,21 @@ inline void Bzip2WriterBase::Reset(Closed) {
   BufferedWriter::Reset(kClosed);
   initial_compressed_pos_ = 0;
   compressor_.reset();
+  parallel_compressor_.reset();
 }
 
 inline void Bzip2WriterBase::Reset(BufferOptions buffer_options) {
   BufferedWriter::Reset(buffer_options);
   initial_compressed_pos_ = 0;
   compressor_.reset();
+  parallel_compressor_.reset();
 }
 
 template <typename Dest>
 inline Bzip2Writer<Dest>::Bzip2Writer(Initializer<Dest> dest, Options options)
     : Bzip2WriterBase(options.buffer_options()), dest_(std::move(dest)) {
-  Initialize(dest_.get(), options.compression_level());
+  Initialize(dest_.get(), options.compression_level(),
+             options.parallelism());
 }
 
 template <typename Dest>
@@ -223,7 +266,8 @@ template <typename Dest>
 inline void Bzip2Writer<Dest>::Reset(Initializer<Dest> dest, Options options) {
   Bzip2WriterBase::Reset(options.buffer_options());
   dest_.Reset(std::move(dest));
-  Initialize(dest_.get(), options.compression_level());
+  Initialize(dest_.get(), options.compression_level(),
+             options.parallelism());
 }
 
 template <typename Dest>
@@ -18,10 +18,12 @@
 
 #include "absl/base/attributes.h"
 #include "absl/status/status.h"
+#include "absl/types/optional.h"
 #include "riegeli/base/assert.h"
 #include "riegeli/base/chain.h"
 #include "riegeli/base/maker.h"
 #include "riegeli/base/recycling_pool.h"
+#include "riegeli/base/types.h"
 #include "riegeli/brotli/brotli_writer.h"
 #include "riegeli/bytes/chain_writer.h"
 #include "riegeli/bytes/null_writer.h"
@@ -50,12 +52,15 @@ ABSL_ATTRIBUTE_WEAK std::unique_ptr<Writer> NewBrotliWriter(
 }
 
 std::unique_ptr<Writer> NewCBrotliWriter(
-    Chain* compressed, const CompressorOptions& compressor_options) {
+    Chain* compressed, const CompressorOptions& compressor_options,
+    absl::optional<Position> pledged_size, bool reserve_max_size) {
   return std::make_unique<BrotliWriter<ChainWriter<>>>(
       riegeli::Maker(compressed),
       BrotliWriterBase::Options()
           .set_compression_level(compressor_options.compression_level())
-          .set_window_log(compressor_options.brotli_window_log()));
+          .set_window_log(compressor_options.brotli_window_log())
+          .set_pledged_size(pledged_size)
+          .set_reserve_max_size(reserve_max_size));
 }
 
 }  // namespace chunk_encoding_internal
@@ -17,8 +17,10 @@
 
 #include <memory>
 
+#include "absl/types/optional.h"
 #include "riegeli/base/chain.h"
 #include "riegeli/base/recycling_pool.h"
+#include "riegeli/base/types.h"
 #include "riegeli/bytes/writer.h"
 #include "riegeli/chunk_encoding/compressor_options.h"
 
@@ -39,8 +41,13 @@ std::unique_ptr<Writer> NewBrotliWriter(
 
 // Support for `NewBrotliWriter()`: uses C Brotli, ignores
 // `compressor_options.brotli_encoder()`.
+//
+// `pledged_size` and `reserve_max_size` are passed to
+// `BrotliWriterBase::Options`.
 std::unique_ptr<Writer> NewCBrotliWriter(
-    Chain* compressed, const CompressorOptions& compressor_options);
+    Chain* compressed, const CompressorOptions& compressor_options,
+    absl::optional<Position> pledged_size = absl::nullopt,
+    bool reserve_max_size = false);
 
 }  // namespace chunk_encoding_internal
 }  // namespace riegeli
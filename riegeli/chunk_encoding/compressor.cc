@@ -20,6 +20,8 @@
 #include <utility>
 
 #include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
 #include "absl/types/optional.h"
 #include "riegeli/base/arithmetic.h"
 #include "riegeli/base/assert.h"
@@ -28,6 +30,7 @@
 #include "riegeli/base/object.h"
 #include "riegeli/base/types.h"
 #include "riegeli/bytes/chain_writer.h"
+#include "riegeli/bytes/string_writer.h"
 #include "riegeli/bytes/writer.h"
 #include "riegeli/chunk_encoding/brotli_encoder_selection.h"
 #include "riegeli/chunk_encoding/compressor_options.h"
@@ -39,6 +42,14 @@
 namespace riegeli {
 namespace chunk_encoding_internal {
 
+namespace {
+
+// If the uncompressed size is expected to be at most this, then Brotli and Zstd
+// compress all data in one shot, after they are collected.
+constexpr Position kMaxOneShotSize = Position{16} << 20;
+
+}  // namespace
+
 Compressor::Compressor(CompressorOptions compressor_options,
                        TuningOptions tuning_options)
     : compressor_options_(std::move(compressor_options)),
@@ -59,36 +70,76 @@ void Compressor::Clear() {
 }
 
 inline void Compressor::Initialize() {
+  const absl::optional<Position> size =
+      tuning_options_.pledged_size() != absl::nullopt
+          ? tuning_options_.pledged_size()
+          : tuning_options_.size_hint();
+  // The Brotli encoder selected by `NewBrotliWriter()` cannot be told the
+  // pledged size, so only C Brotli selected explicitly supports this.
+  one_shot_ =
+      size != absl::nullopt && *size <= kMaxOneShotSize &&
+      (compressor_options_.compression_type() == CompressionType::kZstd ||
+       (compressor_options_.compression_type() == CompressionType::kBrotli &&
+        compressor_options_.brotli_encoder() == BrotliEncoder::kCBrotli));
+  if (one_shot_) {
+    writer_ = std::make_unique<StringWriter<>>(&uncompressed_);
+    return;
+  }
+  writer_ = NewCompressingWriter(tuning_options_.pledged_size(), false);
+}
+
+std::unique_ptr<Writer> Compressor::NewCompressingWriter(
+    absl::optional<Position> pledged_size, bool reserve_max_size) {
   switch (compressor_options_.compression_type()) {
     case CompressionType::kNone:
-      writer_ = std::make_unique<ChainWriter<>>(&compressed_);
-      return;
+      return std::make_unique<ChainWriter<>>(&compressed_);
     case CompressionType::kBrotli:
-      writer_ = NewBrotliWriter(&compressed_, compressor_options_,
-                                tuning_options_.recycling_pool_options());
-      return;
+      if (reserve_max_size) {
+        return NewCBrotliWriter(&compressed_, compressor_options_, pledged_size,
+                                reserve_max_size);
+      }
+      return NewBrotliWriter(&compressed_, compressor_options_,
+                             tuning_options_.recycling_pool_options());
     case CompressionType::kZstd:
-      writer_ = std::make_unique<ZstdWriter<ChainWriter<>>>(
+      return std::make_unique<ZstdWriter<ChainWriter<>>>(
           riegeli::Maker(&compressed_),
           ZstdWriterBase::Options()
               .set_compression_level(compressor_options_.compression_level())
               .set_window_log(compressor_options_.zstd_window_log())
-              .set_pledged_size(tuning_options_.pledged_size())
+              .set_pledged_size(pledged_size)
+              .set_reserve_max_size(reserve_max_size)
               .set_recycling_pool_options(
                   tuning_options_.recycling_pool_options()));
-      return;
     case CompressionType::kSnappy:
-      writer_ = std::make_unique<SnappyWriter<ChainWriter<>>>(
+      return std::make_unique<SnappyWriter<ChainWriter<>>>(
           riegeli::Maker(&compressed_),
           SnappyWriterBase::Options().set_compression_level(
               compressor_options_.compression_level()));
-      return;
   }
   RIEGELI_ASSERT_UNREACHABLE()
       << "Unknown compression type: "
       << static_cast<unsigned>(compressor_options_.compression_type());
 }
 
+inline bool Compressor::CompressOneShot() {
+  if (ABSL_PREDICT_FALSE(tuning_options_.pledged_size() != absl::nullopt &&
+                         *tuning_options_.pledged_size() !=
+                             uncompressed_.size())) {
+    return Fail(absl::FailedPreconditionError(absl::StrCat(
+        "Actual size does not match pledged size: ", uncompressed_.size(),
+        uncompressed_.size() > *tuning_options_.pledged_size() ? " > " : " < ",
+        *tuning_options_.pledged_size())));
+  }
+  // With the exact size pledged and the maximum compressed size reserved, the
+  // whole data are compressed in one step, directly to a flat buffer.
+  std::unique_ptr<Writer> writer =
+      NewCompressingWriter(uncompressed_.size(), true);
+  if (ABSL_PREDICT_FALSE(!writer->Write(uncompressed_) || !writer->Close())) {
+    return Fail(writer->status());
+  }
+  return true;
+}
+
 inline void Compressor::SetWriteSizeHint() {
   writer_->SetWriteSizeHint(tuning_options_.pledged_size() != absl::nullopt
                                 ? tuning_options_.pledged_size()
@@ -99,6 +150,7 @@ bool Compressor::EncodeAndClose(Writer& dest) {
   if (ABSL_PREDICT_FALSE(!ok())) return false;
   const Position uncompressed_size = writer().pos();
   if (ABSL_PREDICT_FALSE(!writer().Close())) return Fail(writer().status());
+  if (one_shot_ && ABSL_PREDICT_FALSE(!CompressOneShot())) return false;
   if (compressor_options_.compression_type() != CompressionType::kNone) {
     if (ABSL_PREDICT_FALSE(
             !WriteVarint64(IntCast<uint64_t>(uncompressed_size), dest))) {
@@ -115,6 +167,7 @@ bool Compressor::LengthPrefixedEncodeAndClose(Writer& dest) {
   if (ABSL_PREDICT_FALSE(!ok())) return false;
   const Position uncompressed_size = writer().pos();
   if (ABSL_PREDICT_FALSE(!writer().Close())) return Fail(writer().status());
+  if (one_shot_ && ABSL_PREDICT_FALSE(!CompressOneShot())) return false;
   uint64_t compressed_size = compressed_.size();
   if (compressor_options_.compression_type() != CompressionType::kNone) {
     compressed_size += LengthVarint64(IntCast<uint64_t>(uncompressed_size));
@@ -16,6 +16,7 @@
 #define RIEGELI_CHUNK_ENCODING_COMPRESSOR_H_
 
 #include <memory>
+#include <string>
 #include <utility>
 
 #include "absl/base/attributes.h"
@@ -144,9 +145,16 @@ class Compressor : public Object {
  private:
   void Initialize();
   void SetWriteSizeHint();
+  std::unique_ptr<Writer> NewCompressingWriter(
+      absl::optional<Position> pledged_size, bool reserve_max_size);
+  bool CompressOneShot();
 
   CompressorOptions compressor_options_;
   TuningOptions tuning_options_;
+  // If `true`, `writer_` collects uncompressed data in `uncompressed_`, and
+  // they are compressed at once by `EncodeAndClose()`.
+  bool one_shot_ = false;
+  std::string uncompressed_;
   Chain compressed_;
   std::unique_ptr<Writer> writer_;
 };
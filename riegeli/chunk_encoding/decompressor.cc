@@ -17,16 +17,105 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <memory>
+
 #include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "brotli/decode.h"
+#include "riegeli/base/assert.h"
 #include "riegeli/base/chain.h"
+#include "riegeli/base/recycling_pool.h"
 #include "riegeli/bytes/chain_reader.h"
 #include "riegeli/chunk_encoding/constants.h"
 #include "riegeli/varint/varint_reading.h"
+#include "riegeli/zstd/zstd_reader.h"
+#include "zstd.h"
 
 namespace riegeli {
 namespace chunk_encoding_internal {
 
+namespace {
+
+struct BrotliDecoderStateDeleter {
+  void operator()(BrotliDecoderState* ptr) const {
+    BrotliDecoderDestroyInstance(ptr);
+  }
+};
+
+absl::Status DecompressBrotli(absl::string_view src, absl::Span<char> dest) {
+  const std::unique_ptr<BrotliDecoderState, BrotliDecoderStateDeleter>
+      decompressor(BrotliDecoderCreateInstance(nullptr, nullptr, nullptr));
+  if (ABSL_PREDICT_FALSE(decompressor == nullptr)) {
+    return absl::InternalError("BrotliDecoderCreateInstance() failed");
+  }
+  if (ABSL_PREDICT_FALSE(!BrotliDecoderSetParameter(
+          decompressor.get(), BROTLI_DECODER_PARAM_LARGE_WINDOW,
+          uint32_t{true}))) {
+    return absl::InternalError(
+        "BrotliDecoderSetParameter(BROTLI_DECODER_PARAM_LARGE_WINDOW) failed");
+  }
+  size_t available_in = src.size();
+  const uint8_t* next_in = reinterpret_cast<const uint8_t*>(src.data());
+  size_t available_out = dest.size();
+  uint8_t* next_out = reinterpret_cast<uint8_t*>(dest.data());
+  const BrotliDecoderResult result = BrotliDecoderDecompressStream(
+      decompressor.get(), &available_in, &next_in, &available_out, &next_out,
+      nullptr);
+  switch (result) {
+    case BROTLI_DECODER_RESULT_ERROR:
+      return absl::InvalidArgumentError(
+          absl::StrCat("BrotliDecoderDecompressStream() failed: ",
+                       BrotliDecoderErrorString(
+                           BrotliDecoderGetErrorCode(decompressor.get()))));
+    case BROTLI_DECODER_RESULT_SUCCESS:
+      if (ABSL_PREDICT_FALSE(available_in > 0)) {
+        return absl::InvalidArgumentError(
+            "Brotli-compressed stream is followed by other data");
+      }
+      if (ABSL_PREDICT_FALSE(available_out > 0)) {
+        return absl::InvalidArgumentError(
+            "Uncompressed size smaller than expected");
+      }
+      return absl::OkStatus();
+    case BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT:
+      return absl::InvalidArgumentError(
+          "Brotli-compressed stream got truncated");
+    case BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT:
+      return absl::InvalidArgumentError(
+          "Uncompressed size larger than expected");
+  }
+  RIEGELI_ASSERT_UNREACHABLE()
+      << "Unknown BrotliDecoderResult: " << static_cast<int>(result);
+}
+
+absl::Status DecompressZstd(
+    absl::string_view src, absl::Span<char> dest,
+    const RecyclingPoolOptions& recycling_pool_options) {
+  const RecyclingPool<ZSTD_DCtx, zstd_internal::ZSTD_DCtxDeleter>::Handle
+      decompressor = zstd_internal::GetDecompressor(recycling_pool_options);
+  if (ABSL_PREDICT_FALSE(decompressor == nullptr)) {
+    return absl::InternalError("ZSTD_createDCtx() failed");
+  }
+  const size_t result =
+      ZSTD_decompressDCtx(decompressor.get(), dest.data(), dest.size(),
+                          src.data(), src.size());
+  if (ABSL_PREDICT_FALSE(ZSTD_isError(result))) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "ZSTD_decompressDCtx() failed: ", ZSTD_getErrorName(result)));
+  }
+  if (ABSL_PREDICT_FALSE(result != dest.size())) {
+    return absl::InvalidArgumentError(
+        "Uncompressed size smaller than expected");
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
 absl::optional<uint64_t> UncompressedSize(const Chain& compressed_data,
                                           CompressionType compression_type) {
   if (compression_type == CompressionType::kNone) return compressed_data.size();
@@ -38,5 +127,28 @@ absl::optional<uint64_t> UncompressedSize(const Chain& compressed_data,
   return size;
 }
 
+absl::Status DecompressOneShot(
+    absl::string_view compressed_data, CompressionType compression_type,
+    size_t uncompressed_size,
+    const RecyclingPoolOptions& recycling_pool_options, Chain& dest) {
+  const absl::Span<char> buffer = dest.AppendFixedBuffer(uncompressed_size);
+  absl::Status status;
+  switch (compression_type) {
+    case CompressionType::kBrotli:
+      status = DecompressBrotli(compressed_data, buffer);
+      break;
+    case CompressionType::kZstd:
+      status = DecompressZstd(compressed_data, buffer, recycling_pool_options);
+      break;
+    default:
+      RIEGELI_ASSERT_UNREACHABLE()
+          << "Failed precondition of DecompressOneShot(): "
+             "unsupported compression type: "
+          << static_cast<unsigned>(compression_type);
+  }
+  if (ABSL_PREDICT_FALSE(!status.ok())) dest.RemoveSuffix(uncompressed_size);
+  return status;
+}
+
 }  // namespace chunk_encoding_internal
 }  // namespace riegeli
@@ -15,6 +15,7 @@
 #ifndef RIEGELI_CHUNK_ENCODING_DECOMPRESSOR_H_
 #define RIEGELI_CHUNK_ENCODING_DECOMPRESSOR_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include <utility>
@@ -23,8 +24,10 @@
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 #include "riegeli/base/any.h"
+#include "riegeli/base/arithmetic.h"
 #include "riegeli/base/assert.h"
 #include "riegeli/base/chain.h"
 #include "riegeli/base/dependency.h"
@@ -32,7 +35,9 @@
 #include "riegeli/base/maker.h"
 #include "riegeli/base/object.h"
 #include "riegeli/base/recycling_pool.h"
+#include "riegeli/base/types.h"
 #include "riegeli/brotli/brotli_reader.h"
+#include "riegeli/bytes/chain_reader.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/chunk_encoding/constants.h"
 #include "riegeli/snappy/snappy_reader.h"
@@ -52,6 +57,16 @@ namespace chunk_encoding_internal {
 absl::optional<uint64_t> UncompressedSize(const Chain& compressed_data,
                                           CompressionType compression_type);
 
+// Decompresses `compressed_data` in one shot, appending the result to `dest`
+// as a single flat block.
+//
+// `compression_type` must be `kBrotli` or `kZstd`. Fails unless decompressed
+// data have exactly `uncompressed_size` bytes.
+absl::Status DecompressOneShot(
+    absl::string_view compressed_data, CompressionType compression_type,
+    size_t uncompressed_size,
+    const RecyclingPoolOptions& recycling_pool_options, Chain& dest);
+
 // Options for a `Decompressor`.
 class DecompressorOptions {
  public:
@@ -134,11 +149,19 @@ class Decompressor : public Object {
   void Done() override;
 
  private:
+  // If the uncompressed size is at most this, and the remaining compressed data
+  // are not larger either, then Brotli and Zstd decompress them in one shot.
+  static constexpr size_t kMaxOneShotSize = size_t{16} << 20;
+
   void Initialize(Initializer<Src> src, CompressionType compression_type,
                   const RecyclingPoolOptions& recycling_pool_options);
+  bool InitializeOneShot(Dependency<Reader*, Src>& compressed_reader,
+                         CompressionType compression_type,
+                         size_t uncompressed_size,
+                         const RecyclingPoolOptions& recycling_pool_options);
 
   Any<Reader*>::Inlining<Src, BrotliReader<Src>, ZstdReader<Src>,
-                         SnappyReader<Src>>
+                         SnappyReader<Src>, ChainReader<Chain>>
       decompressed_;
 };
 
@@ -183,6 +206,14 @@ inline void Decompressor<Src>::Initialize(
         absl::InvalidArgumentError("Reading uncompressed size failed")));
     return;
   }
+  if ((compression_type == CompressionType::kBrotli ||
+       compression_type == CompressionType::kZstd) &&
+      uncompressed_size <= kMaxOneShotSize &&
+      InitializeOneShot(compressed_reader, compression_type,
+                        IntCast<size_t>(uncompressed_size),
+                        recycling_pool_options)) {
+    return;
+  }
   switch (compression_type) {
     case CompressionType::kNone:
       RIEGELI_ASSERT_UNREACHABLE() << "kNone handled above";
@@ -205,6 +236,41 @@ inline void Decompressor<Src>::Initialize(
       "Unknown compression type: ", static_cast<unsigned>(compression_type))));
 }
 
+template <typename Src>
+bool Decompressor<Src>::InitializeOneShot(
+    Dependency<Reader*, Src>& compressed_reader,
+    CompressionType compression_type, size_t uncompressed_size,
+    const RecyclingPoolOptions& recycling_pool_options) {
+  Reader& src = *compressed_reader;
+  if (!src.SupportsSize()) return false;
+  const absl::optional<Position> size = src.Size();
+  if (size == absl::nullopt || *size < src.pos() ||
+      *size - src.pos() > kMaxOneShotSize) {
+    return false;
+  }
+  const size_t length = IntCast<size_t>(*size - src.pos());
+  if (!src.Pull(length)) return false;
+  Chain decompressed;
+  {
+    absl::Status status = DecompressOneShot(
+        absl::string_view(src.cursor(), length), compression_type,
+        uncompressed_size, recycling_pool_options, decompressed);
+    if (ABSL_PREDICT_FALSE(!status.ok())) {
+      Fail(src.AnnotateStatus(std::move(status)));
+      return true;
+    }
+  }
+  src.move_cursor(length);
+  if (compressed_reader.IsOwning()) {
+    if (ABSL_PREDICT_FALSE(!src.Close())) {
+      Fail(src.status());
+      return true;
+    }
+  }
+  decompressed_ = riegeli::Maker<ChainReader<Chain>>(std::move(decompressed));
+  return true;
+}
+
 template <typename Src>
 inline Reader& Decompressor<Src>::reader() ABSL_ATTRIBUTE_LIFETIME_BOUND {
   RIEGELI_ASSERT(ok()) << "Failed precondition of Decompressor::reader(): "
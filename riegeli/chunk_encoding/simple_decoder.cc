@@ -20,8 +20,10 @@
 #include <limits>
 #include <vector>
 
+#include "absl/base/macros.h"
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
+#include "absl/types/span.h"
 #include "riegeli/base/arithmetic.h"
 #include "riegeli/base/maker.h"
 #include "riegeli/base/object.h"
@@ -76,18 +78,25 @@ bool SimpleDecoder::Decode(Reader* src, uint64_t num_records,
   }
   limits.clear();
   size_t limit = 0;
+  // Sizes are decoded in batches with `ReadVarint64s()`. The batch size bounds
+  // memory allocated before sizes are validated.
+  uint64_t sizes[256];
   while (limits.size() != num_records) {
-    uint64_t size;
-    if (ABSL_PREDICT_FALSE(!ReadVarint64(sizes_decompressor.reader(), size))) {
+    const absl::Span<uint64_t> batch = absl::MakeSpan(
+        sizes, UnsignedMin(num_records - limits.size(), ABSL_ARRAYSIZE(sizes)));
+    if (ABSL_PREDICT_FALSE(
+            !ReadVarint64s(sizes_decompressor.reader(), batch))) {
       return Fail(sizes_decompressor.reader().StatusOrAnnotate(
           absl::InvalidArgumentError("Reading record size failed")));
     }
-    if (ABSL_PREDICT_FALSE(size > decoded_data_size - limit)) {
-      return Fail(
-          absl::InvalidArgumentError("Decoded data size larger than expected"));
+    for (const uint64_t size : batch) {
+      if (ABSL_PREDICT_FALSE(size > decoded_data_size - limit)) {
+        return Fail(absl::InvalidArgumentError(
+            "Decoded data size larger than expected"));
+      }
+      limit += IntCast<size_t>(size);
+      limits.push_back(limit);
     }
-    limit += IntCast<size_t>(size);
-    limits.push_back(limit);
   }
   if (ABSL_PREDICT_FALSE(!sizes_decompressor.VerifyEndAndClose())) {
     return Fail(sizes_decompressor.status());
@@ -0,0 +1,226 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures throughput of `chunk_encoding_internal::Compressor` and
+// `chunk_encoding_internal::Decompressor` compressing and decompressing a whole
+// buffer at once, compared with streaming, for several sizes.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "absl/base/macros.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/status/status.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "riegeli/base/assert.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/base/maker.h"
+#include "riegeli/brotli/brotli_reader.h"
+#include "riegeli/bytes/chain_reader.h"
+#include "riegeli/bytes/chain_writer.h"
+#include "riegeli/bytes/read_all.h"
+#include "riegeli/bytes/std_io.h"
+#include "riegeli/chunk_encoding/compressor.h"
+#include "riegeli/chunk_encoding/compressor_options.h"
+#include "riegeli/chunk_encoding/constants.h"
+#include "riegeli/chunk_encoding/decompressor.h"
+#include "riegeli/varint/varint_reading.h"
+#include "riegeli/zstd/zstd_reader.h"
+
+ABSL_FLAG(std::vector<std::string>, compressions,
+          std::vector<std::string>({"brotli:6", "zstd:3"}),
+          "Compression options to benchmark, without commas");
+ABSL_FLAG(std::vector<std::string>, sizes,
+          std::vector<std::string>({"65536", "1048576", "2097152", "4194304"}),
+          "Uncompressed sizes to benchmark, in bytes");
+ABSL_FLAG(uint64_t, write_size, uint64_t{64} << 10,
+          "Size of a single Write() call to the Compressor, in bytes");
+ABSL_FLAG(int32_t, repetitions, 5, "Number of times to repeat each benchmark");
+
+namespace {
+
+// Returns text resembling log lines, which compresses moderately well.
+std::string GenerateLogLines(size_t data_size) {
+  static constexpr absl::string_view kWords[] = {
+      "INFO",    "WARNING", "request", "response", "user",  "session",
+      "latency", "bytes",   "served",  "cache",    "miss",  "hit",
+      "backend", "timeout", "retry",   "shard",    "query", "status"};
+  std::string data;
+  data.reserve(data_size + 256);
+  uint32_t random = 1;
+  uint64_t timestamp = 1700000000000;
+  while (data.size() < data_size) {
+    random = random * 1103515245 + 12345;
+    timestamp += (random >> 16) % 1000;
+    absl::StrAppendFormat(&data, "%d ", timestamp);
+    const size_t num_words = 4 + (random >> 8) % 12;
+    for (size_t i = 0; i < num_words; ++i) {
+      random = random * 1103515245 + 12345;
+      const uint32_t choice = random >> 16;
+      if (choice % 4 == 0) {
+        absl::StrAppendFormat(&data, "%d ", choice % 100000);
+      } else {
+        data.append(kWords[choice % ABSL_ARRAYSIZE(kWords)].data(),
+                    kWords[choice % ABSL_ARRAYSIZE(kWords)].size());
+        data.push_back(' ');
+      }
+    }
+    data.back() = '\n';
+  }
+  data.resize(data_size);
+  return data;
+}
+
+// Returns the median of `samples`.
+double Median(std::vector<double>& samples) {
+  std::nth_element(samples.begin(), samples.begin() + samples.size() / 2,
+                   samples.end());
+  return samples[samples.size() / 2];
+}
+
+// Compresses `data` with `riegeli::chunk_encoding_internal::Compressor`,
+// returning the throughput in MB/s. If `one_shot` is `true`, the size is known
+// in advance, which lets the `Compressor` compress the data in one shot.
+double MeasureCompression(
+    absl::string_view data,
+    const riegeli::CompressorOptions& compressor_options, bool one_shot,
+    int repetitions, riegeli::Chain& compressed) {
+  const size_t write_size =
+      std::max(absl::GetFlag(FLAGS_write_size), uint64_t{1});
+  riegeli::chunk_encoding_internal::Compressor::TuningOptions tuning_options;
+  if (one_shot) tuning_options.set_size_hint(data.size());
+  std::vector<double> samples;
+  for (int i = 0; i < repetitions; ++i) {
+    compressed.Clear();
+    riegeli::ChainWriter<> compressed_writer(&compressed);
+    const absl::Time start = absl::Now();
+    riegeli::chunk_encoding_internal::Compressor compressor(compressor_options,
+                                                            tuning_options);
+    for (size_t pos = 0; pos < data.size(); pos += write_size) {
+      RIEGELI_CHECK(compressor.writer().Write(data.substr(pos, write_size)))
+          << compressor.writer().status();
+    }
+    RIEGELI_CHECK(compressor.EncodeAndClose(compressed_writer))
+        << compressor.status();
+    const absl::Duration elapsed = absl::Now() - start;
+    RIEGELI_CHECK(compressed_writer.Close()) << compressed_writer.status();
+    samples.push_back(static_cast<double>(data.size()) /
+                      absl::ToDoubleMicroseconds(elapsed));
+  }
+  return Median(samples);
+}
+
+// Decompresses `compressed`, returning the throughput in MB/s. If `one_shot` is
+// `true`, `riegeli::chunk_encoding_internal::Decompressor` is used, which
+// decompresses in one shot because the uncompressed size is known. Otherwise
+// the decompressing `Reader` is used directly, which decompresses by streaming.
+double MeasureDecompression(absl::string_view data,
+                            const riegeli::Chain& compressed,
+                            riegeli::CompressionType compression_type,
+                            bool one_shot, int repetitions) {
+  std::vector<double> samples;
+  std::string decompressed;
+  for (int i = 0; i < repetitions; ++i) {
+    decompressed.clear();
+    const absl::Time start = absl::Now();
+    if (one_shot) {
+      riegeli::chunk_encoding_internal::Decompressor<riegeli::ChainReader<>>
+          decompressor(riegeli::Maker(&compressed), compression_type);
+      RIEGELI_CHECK(decompressor.ok()) << decompressor.status();
+      const absl::Status status =
+          riegeli::ReadAll(decompressor.reader(), decompressed);
+      RIEGELI_CHECK(status.ok()) << status;
+      RIEGELI_CHECK(decompressor.VerifyEndAndClose()) << decompressor.status();
+    } else {
+      riegeli::ChainReader<> compressed_reader(&compressed);
+      uint64_t uncompressed_size;
+      RIEGELI_CHECK(riegeli::ReadVarint64(compressed_reader, uncompressed_size))
+          << compressed_reader.status();
+      absl::Status status;
+      if (compression_type == riegeli::CompressionType::kBrotli) {
+        status = riegeli::ReadAll(riegeli::BrotliReader(&compressed_reader),
+                                  decompressed);
+      } else {
+        status = riegeli::ReadAll(riegeli::ZstdReader(&compressed_reader),
+                                  decompressed);
+      }
+      RIEGELI_CHECK(status.ok()) << status;
+    }
+    const absl::Duration elapsed = absl::Now() - start;
+    RIEGELI_CHECK(decompressed == data) << "Decompressed data do not match";
+    samples.push_back(static_cast<double>(data.size()) /
+                      absl::ToDoubleMicroseconds(elapsed));
+  }
+  return Median(samples);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  const int repetitions = std::max(absl::GetFlag(FLAGS_repetitions), 1);
+  riegeli::StdOut std_out;
+  std_out.Write(absl::StrFormat("%-12s %10s %12s %12s %12s %12s\n",
+                                "compression", "size", "comp MB/s",
+                                "one-shot", "decomp MB/s", "one-shot"));
+  for (const std::string& compression_str :
+       absl::GetFlag(FLAGS_compressions)) {
+    riegeli::CompressorOptions compressor_options;
+    {
+      const absl::Status status =
+          compressor_options.FromString(compression_str);
+      RIEGELI_CHECK(status.ok()) << status;
+    }
+    RIEGELI_CHECK(compressor_options.compression_type() ==
+                      riegeli::CompressionType::kBrotli ||
+                  compressor_options.compression_type() ==
+                      riegeli::CompressionType::kZstd)
+        << "Only Brotli and Zstd are supported: " << compression_str;
+    // The one-shot path of Brotli requires C Brotli to be selected explicitly.
+    compressor_options.set_brotli_encoder(riegeli::BrotliEncoder::kCBrotli);
+    for (const std::string& size_str : absl::GetFlag(FLAGS_sizes)) {
+      uint64_t size;
+      RIEGELI_CHECK(absl::SimpleAtoi(size_str, &size))
+          << "Invalid size: " << size_str;
+      const std::string data = GenerateLogLines(size);
+      riegeli::Chain streaming_compressed;
+      riegeli::Chain one_shot_compressed;
+      const double streaming_compression =
+          MeasureCompression(data, compressor_options, false, repetitions,
+                             streaming_compressed);
+      const double one_shot_compression = MeasureCompression(
+          data, compressor_options, true, repetitions, one_shot_compressed);
+      const double streaming_decompression = MeasureDecompression(
+          data, one_shot_compressed, compressor_options.compression_type(),
+          false, repetitions);
+      const double one_shot_decompression = MeasureDecompression(
+          data, one_shot_compressed, compressor_options.compression_type(),
+          true, repetitions);
+      std_out.Write(absl::StrFormat(
+          "%-12s %10d %12.1f %12.1f %12.1f %12.1f\n", compression_str, size,
+          streaming_compression, one_shot_compression, streaming_decompression,
+          one_shot_decompression));
+    }
+  }
+  std_out.Close();
+}
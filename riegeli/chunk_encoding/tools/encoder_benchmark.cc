@@ -0,0 +1,184 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures throughput of `SimpleEncoder` and `TransposeEncoder` encoding proto
+// messages given as `google::protobuf::MessageLite`, compared with serializing
+// them to a `Chain` first, for small and large messages.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "google/protobuf/descriptor.pb.h"
+#include "riegeli/base/arithmetic.h"
+#include "riegeli/base/assert.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/bytes/chain_writer.h"
+#include "riegeli/bytes/std_io.h"
+#include "riegeli/chunk_encoding/chunk_encoder.h"
+#include "riegeli/chunk_encoding/compressor_options.h"
+#include "riegeli/chunk_encoding/constants.h"
+#include "riegeli/chunk_encoding/simple_encoder.h"
+#include "riegeli/chunk_encoding/transpose_encoder.h"
+#include "riegeli/messages/message_serialize.h"
+
+ABSL_FLAG(std::string, compression, "uncompressed",
+          "Compression options of encoded chunks");
+ABSL_FLAG(uint64_t, chunk_size, uint64_t{1} << 20,
+          "Approximate total size of records in a chunk, in bytes");
+ABSL_FLAG(int32_t, repetitions, 5, "Number of times to repeat each benchmark");
+
+namespace {
+
+// Returns a message describing a message type with `num_fields` fields.
+google::protobuf::DescriptorProto MakeMessageType(int index, int num_fields) {
+  google::protobuf::DescriptorProto message_type;
+  message_type.set_name(absl::StrCat("Message", index));
+  for (int i = 1; i <= num_fields; ++i) {
+    google::protobuf::FieldDescriptorProto& field = *message_type.add_field();
+    field.set_name(absl::StrCat("field_", i));
+    field.set_number(i);
+    field.set_label(google::protobuf::FieldDescriptorProto::LABEL_OPTIONAL);
+    field.set_type(i % 3 == 0 ? google::protobuf::FieldDescriptorProto::
+                                    TYPE_STRING
+                              : google::protobuf::FieldDescriptorProto::
+                                    TYPE_INT64);
+    field.set_json_name(absl::StrCat("field", i));
+  }
+  return message_type;
+}
+
+// Returns a nested message with `num_message_types` message types, with its
+// size growing with `num_message_types`.
+google::protobuf::FileDescriptorProto MakeMessage(int num_message_types) {
+  google::protobuf::FileDescriptorProto message;
+  message.set_name("benchmark.proto");
+  message.set_package("riegeli.benchmark");
+  message.set_syntax("proto2");
+  for (int i = 0; i < num_message_types; ++i) {
+    *message.add_message_type() = MakeMessageType(i, 4 + i % 16);
+  }
+  return message;
+}
+
+std::unique_ptr<riegeli::ChunkEncoder> NewChunkEncoder(
+    bool transpose, const riegeli::CompressorOptions& compressor_options) {
+  if (transpose) {
+    return std::make_unique<riegeli::TransposeEncoder>(compressor_options);
+  }
+  return std::make_unique<riegeli::SimpleEncoder>(compressor_options);
+}
+
+// Returns the median of `samples`.
+double Median(std::vector<double>& samples) {
+  std::nth_element(samples.begin(), samples.begin() + samples.size() / 2,
+                   samples.end());
+  return samples[samples.size() / 2];
+}
+
+// Encodes `num_records` copies of `message` into a chunk, returning the
+// throughput in MB/s of serialized data. If `serialize_first` is `true`,
+// messages are serialized to a `Chain` which is given to the encoder, otherwise
+// messages are given to the encoder directly.
+double MeasureEncoding(const google::protobuf::MessageLite& message,
+                       size_t num_records, bool transpose,
+                       bool serialize_first,
+                       const riegeli::CompressorOptions& compressor_options,
+                       int repetitions) {
+  std::vector<double> samples;
+  const size_t message_size = message.ByteSizeLong();
+  for (int i = 0; i < repetitions; ++i) {
+    riegeli::Chain dest;
+    riegeli::ChainWriter<> dest_writer(&dest);
+    const absl::Time start = absl::Now();
+    std::unique_ptr<riegeli::ChunkEncoder> encoder =
+        NewChunkEncoder(transpose, compressor_options);
+    for (size_t j = 0; j < num_records; ++j) {
+      if (serialize_first) {
+        riegeli::Chain serialized;
+        const absl::Status status =
+            riegeli::SerializeToChain(message, serialized);
+        RIEGELI_CHECK(status.ok()) << status;
+        RIEGELI_CHECK(encoder->AddRecord(std::move(serialized)))
+            << encoder->status();
+      } else {
+        RIEGELI_CHECK(encoder->AddRecord(message)) << encoder->status();
+      }
+    }
+    riegeli::ChunkType chunk_type;
+    uint64_t num_records_encoded;
+    uint64_t decoded_data_size;
+    RIEGELI_CHECK(encoder->EncodeAndClose(dest_writer, chunk_type,
+                                          num_records_encoded,
+                                          decoded_data_size))
+        << encoder->status();
+    const absl::Duration elapsed = absl::Now() - start;
+    RIEGELI_CHECK(dest_writer.Close()) << dest_writer.status();
+    RIEGELI_CHECK_EQ(decoded_data_size, message_size * num_records)
+        << "Unexpected decoded data size";
+    samples.push_back(static_cast<double>(message_size * num_records) /
+                      absl::ToDoubleMicroseconds(elapsed));
+  }
+  return Median(samples);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  const int repetitions = std::max(absl::GetFlag(FLAGS_repetitions), 1);
+  riegeli::CompressorOptions compressor_options;
+  {
+    const absl::Status status =
+        compressor_options.FromString(absl::GetFlag(FLAGS_compression));
+    RIEGELI_CHECK(status.ok()) << status;
+  }
+  riegeli::StdOut std_out;
+  std_out.Write(absl::StrFormat("%-10s %10s %10s %14s %14s\n", "encoder",
+                                "msg size", "records", "chain MB/s",
+                                "message MB/s"));
+  for (const int num_message_types : {1, 16, 256, 4096}) {
+    const google::protobuf::FileDescriptorProto message =
+        MakeMessage(num_message_types);
+    const size_t message_size = message.ByteSizeLong();
+    const size_t num_records =
+        std::max(size_t{1},
+                 riegeli::IntCast<size_t>(absl::GetFlag(FLAGS_chunk_size)) /
+                     std::max(message_size, size_t{1}));
+    for (const bool transpose : {false, true}) {
+      const double chain_throughput =
+          MeasureEncoding(message, num_records, transpose, true,
+                          compressor_options, repetitions);
+      const double message_throughput =
+          MeasureEncoding(message, num_records, transpose, false,
+                          compressor_options, repetitions);
+      std_out.Write(absl::StrFormat(
+          "%-10s %10d %10d %14.1f %14.1f\n", transpose ? "transpose" : "simple",
+          message_size, num_records, chain_throughput, message_throughput));
+    }
+  }
+  std_out.Close();
+}
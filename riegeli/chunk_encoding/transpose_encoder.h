@@ -20,6 +20,7 @@
 
 #include <limits>
 #include <memory>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -30,6 +31,7 @@
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 #include "absl/types/span.h"
+#include "google/protobuf/message_lite.h"
 #include "riegeli/base/chain.h"
 #include "riegeli/base/compare.h"
 #include "riegeli/base/external_ref.h"
@@ -43,6 +45,7 @@
 #include "riegeli/chunk_encoding/compressor_options.h"
 #include "riegeli/chunk_encoding/constants.h"
 #include "riegeli/chunk_encoding/transpose_internal.h"
+#include "riegeli/messages/message_serialize.h"
 
 namespace riegeli {
 
@@ -130,6 +133,8 @@ class TransposeEncoder : public ChunkEncoder {
   // string. Such records are internally stored separately -- these are not
   // broken down into columns.
   using ChunkEncoder::AddRecord;
+  bool AddRecord(const google::protobuf::MessageLite& record,
+                 SerializeOptions serialize_options) override;
   bool AddRecord(absl::string_view record) override;
   bool AddRecord(const Chain& record) override;
   bool AddRecord(const absl::Cord& record) override;
@@ -361,6 +366,9 @@ class TransposeEncoder : public ChunkEncoder {
   // Counter used to assign unique IDs to the message nodes.
   chunk_encoding_internal::MessageId next_message_id_ =
       chunk_encoding_internal::MessageId::kRoot + 1;
+  // Serialized record added by `AddRecord(const MessageLite&)`. Its capacity
+  // is reused between records.
+  std::string serialized_record_;
 };
 
 }  // namespace riegeli
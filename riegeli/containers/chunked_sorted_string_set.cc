@@ -36,14 +36,33 @@
 #include "riegeli/base/binary_search.h"
 #include "riegeli/base/compare.h"
 #include "riegeli/base/memory_estimator.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/bytes/writer.h"
 #include "riegeli/containers/linear_sorted_string_set.h"
+#include "riegeli/containers/prefix_search_index.h"
 #include "riegeli/varint/varint_reading.h"
 #include "riegeli/varint/varint_writing.h"
 
 namespace riegeli {
 
+namespace chunked_sorted_string_set_internal {
+
+absl::optional<std::string> PrefixSuccessor(absl::string_view prefix) {
+  // Remove trailing '\xff' characters and increment the last character.
+  size_t size = prefix.size();
+  while (size > 0 && static_cast<unsigned char>(prefix[size - 1]) == 0xff) {
+    --size;
+  }
+  if (size == 0) return absl::nullopt;
+  std::string successor(prefix.data(), size);
+  successor.back() =
+      static_cast<char>(static_cast<unsigned char>(successor.back()) + 1);
+  return successor;
+}
+
+}  // namespace chunked_sorted_string_set_internal
+
 // Before C++17 if a constexpr static data member is ODR-used, its definition at
 // namespace scope is required. Since C++17 these definitions are deprecated:
 // http://en.cppreference.com/w/cpp/language/static
@@ -63,11 +82,30 @@ ChunkedSortedStringSet ChunkedSortedStringSet::FromUnsorted(
 
 inline ChunkedSortedStringSet::ChunkedSortedStringSet(
     LinearSortedStringSet&& first_chunk,
-    std::vector<LinearSortedStringSet>&& chunks, size_t size)
+    std::vector<LinearSortedStringSet>&& chunks, size_t size,
+    size_t chunk_size, bool search_index)
     : first_chunk_(std::move(first_chunk)),
       repr_(chunks.empty()
                 ? make_inline_repr(size)
-                : make_allocated_repr(new Repr{std::move(chunks), size})) {}
+                : make_allocated_repr(NewRepr(std::move(chunks), size,
+                                              chunk_size, std::vector<size_t>(),
+                                              search_index))) {}
+
+ChunkedSortedStringSet::Repr* ChunkedSortedStringSet::NewRepr(
+    std::vector<LinearSortedStringSet>&& chunks, size_t size,
+    size_t chunk_size, std::vector<size_t>&& chunk_ranks, bool search_index) {
+  RIEGELI_ASSERT_EQ(chunk_ranks.size(), chunk_size == 0 ? chunks.size() : 0u)
+      << "Failed precondition of ChunkedSortedStringSet::NewRepr(): "
+         "chunk_ranks must be given exactly if chunk_size is not";
+  Repr* const repr = new Repr{std::move(chunks), size, chunk_size,
+                              std::move(chunk_ranks), PrefixSearchIndex()};
+  if (search_index) {
+    repr->search_index = PrefixSearchIndex(
+        repr->chunks.size(),
+        [&](size_t index) { return repr->chunks[index].first(); });
+  }
+  return repr;
+}
 
 void ChunkedSortedStringSet::DeleteAllocatedRepr(uintptr_t repr) {
   delete allocated_repr(repr);
@@ -77,28 +115,295 @@ uintptr_t ChunkedSortedStringSet::CopyAllocatedRepr() const {
   return make_allocated_repr(new Repr(*allocated_repr()));
 }
 
+ChunkedSortedStringSet::FoundChunk ChunkedSortedStringSet::FindChunk(
+    absl::string_view element) const {
+  if (repr_is_inline()) {
+    return FoundChunk{&first_chunk_, ChunkIterator(), 0, false};
+  }
+  // The target chunk is the last chunk whose first element is less than or
+  // equal to the element being searched.
+  //
+  // `BinarySearch()` is biased so that it is easier to search for the chunk
+  // after it, i.e. the first chunk whose first element is greater than the
+  // element being searched (or possibly past the end iterator), and then go
+  // back by one chunk (possibly to `first_chunk_`, even if its first element
+  // is still too large, in which case its `contains()` will return `false`).
+  //
+  // If there is a search index, it determines the chunk, or narrows down
+  // the range of chunks whose first elements need to be compared.
+  const ChunkIterator chunks_begin = allocated_repr()->chunks.cbegin();
+  ChunkIterator search_begin = chunks_begin;
+  ChunkIterator search_end = allocated_repr()->chunks.cend();
+  if (!allocated_repr()->search_index.empty()) {
+    const PrefixSearchIndex::Range range =
+        allocated_repr()->search_index.Find(element);
+    search_end = chunks_begin + range.end;
+    search_begin += range.begin;
+  }
+  const SearchResult<ChunkIterator> chunk = BinarySearch(
+      search_begin, search_end, [&](ChunkIterator current) {
+        return current->first().compare(element);
+      });
+  if (chunk.ordering == 0) {
+    return FoundChunk{&*chunk.found, chunk.found + 1,
+                      IntCast<size_t>(chunk.found - chunks_begin) + 1, true};
+  }
+  if (chunk.found == chunks_begin) {
+    return FoundChunk{&first_chunk_, chunks_begin, 0, false};
+  }
+  return FoundChunk{&chunk.found[-1], chunk.found,
+                    IntCast<size_t>(chunk.found - chunks_begin), false};
+}
+
+ChunkedSortedStringSet::Iterator ChunkedSortedStringSet::MakeIterator(
+    const FoundChunk& found, LinearSortedStringSet::Iterator iterator) const {
+  if (iterator != LinearSortedStringSet::Iterator()) {
+    return Iterator(this, std::move(iterator), found.next_chunk);
+  }
+  if (repr_is_inline() ||
+      found.next_chunk == allocated_repr()->chunks.cend()) {
+    return Iterator();
+  }
+  return Iterator(this, found.next_chunk->cbegin(), found.next_chunk + 1);
+}
+
 bool ChunkedSortedStringSet::contains(absl::string_view element) const {
-  const LinearSortedStringSet* found_linear_set = &first_chunk_;
-  if (repr_is_allocated()) {
-    // The target chunk is the last chunk whose first element is less than or
-    // equal to the element being searched.
-    //
-    // `BinarySearch()` is biased so that it is easier to search for the chunk
-    // after it, i.e. the first chunk whose first element is greater than the
-    // element being searched (or possibly past the end iterator), and then go
-    // back by one chunk (possibly to `first_chunk_`, even if its first element
-    // is still too large, in which case its `contains()` will return `false`).
-    const SearchResult<ChunkIterator> chunk = BinarySearch(
-        allocated_repr()->chunks.cbegin(), allocated_repr()->chunks.cend(),
-        [&](ChunkIterator current) {
-          return current->first().compare(element);
-        });
-    if (chunk.ordering == 0) return true;
-    if (chunk.found != allocated_repr()->chunks.cbegin()) {
-      found_linear_set = &chunk.found[-1];
+  const FoundChunk found = FindChunk(element);
+  if (found.is_first) return true;
+  return found.chunk->contains(element);
+}
+
+ChunkedSortedStringSet::Iterator ChunkedSortedStringSet::lower_bound(
+    absl::string_view element) const {
+  const FoundChunk found = FindChunk(element);
+  if (found.is_first) return MakeIterator(found, found.chunk->cbegin());
+  return MakeIterator(found, found.chunk->lower_bound(element));
+}
+
+ChunkedSortedStringSet::Iterator ChunkedSortedStringSet::upper_bound(
+    absl::string_view element) const {
+  const FoundChunk found = FindChunk(element);
+  return MakeIterator(found, found.chunk->upper_bound(element));
+}
+
+ChunkedSortedStringSet::Range ChunkedSortedStringSet::WithPrefix(
+    absl::string_view prefix) const {
+  Iterator begin = lower_bound(prefix);
+  const absl::optional<std::string> successor =
+      chunked_sorted_string_set_internal::PrefixSuccessor(prefix);
+  if (successor == absl::nullopt) return Range(std::move(begin), Iterator());
+  return Range(std::move(begin), lower_bound(*successor));
+}
+
+size_t ChunkedSortedStringSet::rank(absl::string_view element) const {
+  const FoundChunk found = FindChunk(element);
+  size_t rank = 0;
+  if (found.chunk_index > 0) {
+    rank = allocated_repr()->chunk_size == 0
+               ? allocated_repr()->chunk_ranks[found.chunk_index - 1]
+               : found.chunk_index * allocated_repr()->chunk_size;
+  }
+  if (found.is_first) return rank;
+  return rank + found.chunk->rank(element);
+}
+
+ChunkedSortedStringSet ChunkedSortedStringSet::Union(
+    const ChunkedSortedStringSet& a, const ChunkedSortedStringSet& b,
+    Options options) {
+  options.set_size_hint(a.size() + b.size());
+  return Merge(a, b, true, true, true, std::move(options));
+}
+
+ChunkedSortedStringSet ChunkedSortedStringSet::Intersection(
+    const ChunkedSortedStringSet& a, const ChunkedSortedStringSet& b,
+    Options options) {
+  options.set_size_hint(UnsignedMin(a.size(), b.size()));
+  return Merge(a, b, false, true, false, std::move(options));
+}
+
+ChunkedSortedStringSet ChunkedSortedStringSet::Difference(
+    const ChunkedSortedStringSet& a, const ChunkedSortedStringSet& b,
+    Options options) {
+  options.set_size_hint(a.size());
+  return Merge(a, b, true, false, false, std::move(options));
+}
+
+ChunkedSortedStringSet ChunkedSortedStringSet::FromUnsortedParallel(
+    std::vector<absl::string_view>&& elements, Options options) {
+  // Below this number of elements per thread, parallelism does not pay off.
+  constexpr size_t kMinElementsPerTask = size_t{1} << 14;
+  // Number of sampled elements per bucket. More samples make bucket sizes more
+  // even.
+  constexpr size_t kOversampling = 64;
+
+  const size_t num_elements = elements.size();
+  const size_t num_tasks =
+      UnsignedMax(UnsignedMin(num_elements / kMinElementsPerTask,
+                              IntCast<size_t>(options.parallelism())),
+                  size_t{1});
+  if (num_tasks == 1) {
+    std::sort(elements.begin(), elements.end());
+    Builder builder(std::move(options));
+    for (const absl::string_view element : elements) {
+      builder.InsertNext(element);
+    }
+    return std::move(builder).Build();
+  }
+  // Returns the beginning of the part of `[0, size)` processed by `task`.
+  const auto task_begin = [&](size_t size, size_t task) {
+    return IntCast<size_t>(uint64_t{size} * task / num_tasks);
+  };
+
+  // Elements are sorted with a sample sort. Splitters chosen from a sample of
+  // elements divide elements into `num_tasks` buckets, which are then sorted
+  // and deduplicated independently. Equal elements fall into the same bucket,
+  // so duplicates never cross bucket boundaries.
+  std::vector<absl::string_view> splitters;
+  {
+    std::vector<absl::string_view> sample;
+    const size_t sample_size = num_tasks * kOversampling;
+    sample.reserve(sample_size);
+    for (size_t i = 0; i < sample_size; ++i) {
+      sample.push_back(
+          elements[IntCast<size_t>(uint64_t{i} * num_elements / sample_size)]);
+    }
+    std::sort(sample.begin(), sample.end());
+    splitters.reserve(num_tasks - 1);
+    for (size_t bucket = 1; bucket < num_tasks; ++bucket) {
+      splitters.push_back(sample[bucket * kOversampling]);
     }
   }
-  return found_linear_set->contains(element);
+
+  // Assign each element to a bucket, and count elements of each bucket in each
+  // part of `elements`. `positions[task * num_tasks + bucket]` is the count.
+  std::vector<uint32_t> buckets(num_elements);
+  std::vector<size_t> positions(num_tasks * num_tasks);
+  internal::RunInParallel(num_tasks, [&](size_t task) {
+    std::vector<size_t> counts(num_tasks);
+    for (size_t i = task_begin(num_elements, task);
+         i < task_begin(num_elements, task + 1); ++i) {
+      const size_t bucket = IntCast<size_t>(
+          std::upper_bound(splitters.begin(), splitters.end(), elements[i]) -
+          splitters.begin());
+      buckets[i] = IntCast<uint32_t>(bucket);
+      ++counts[bucket];
+    }
+    std::copy(counts.begin(), counts.end(),
+              positions.begin() + task * num_tasks);
+  });
+
+  // Turn counts into positions where elements of each bucket from each part
+  // are written, so that buckets are contiguous and ordered, and each bucket
+  // preserves the order of parts.
+  std::vector<size_t> bucket_begins(num_tasks + 1);
+  {
+    size_t position = 0;
+    for (size_t bucket = 0; bucket < num_tasks; ++bucket) {
+      bucket_begins[bucket] = position;
+      for (size_t task = 0; task < num_tasks; ++task) {
+        const size_t count = positions[task * num_tasks + bucket];
+        positions[task * num_tasks + bucket] = position;
+        position += count;
+      }
+    }
+    bucket_begins[num_tasks] = position;
+  }
+
+  std::vector<absl::string_view> sorted(num_elements);
+  internal::RunInParallel(num_tasks, [&](size_t task) {
+    std::vector<size_t> task_positions(
+        positions.begin() + task * num_tasks,
+        positions.begin() + (task + 1) * num_tasks);
+    for (size_t i = task_begin(num_elements, task);
+         i < task_begin(num_elements, task + 1); ++i) {
+      sorted[task_positions[buckets[i]]++] = elements[i];
+    }
+  });
+  elements = std::vector<absl::string_view>();
+  buckets = std::vector<uint32_t>();
+
+  // Sort and deduplicate each bucket. Distinct elements of `bucket` are then
+  // `bucket_sizes[bucket]` elements of `sorted` from `bucket_begins[bucket]`.
+  std::vector<size_t> bucket_sizes(num_tasks);
+  internal::RunInParallel(num_tasks, [&](size_t bucket) {
+    const std::vector<absl::string_view>::iterator begin =
+        sorted.begin() + bucket_begins[bucket];
+    const std::vector<absl::string_view>::iterator end =
+        sorted.begin() + bucket_begins[bucket + 1];
+    std::sort(begin, end);
+    bucket_sizes[bucket] = IntCast<size_t>(std::unique(begin, end) - begin);
+  });
+
+  // `bucket_ranks[bucket]` is the number of distinct elements before `bucket`.
+  std::vector<size_t> bucket_ranks(num_tasks + 1);
+  for (size_t bucket = 0; bucket < num_tasks; ++bucket) {
+    bucket_ranks[bucket + 1] = bucket_ranks[bucket] + bucket_sizes[bucket];
+  }
+  const size_t size = bucket_ranks[num_tasks];
+  const size_t chunk_size = options.chunk_size();
+  const size_t num_chunks = (size - 1) / chunk_size + 1;
+
+  // Build chunks. Chunk boundaries are at multiples of `chunk_size`, as in
+  // `Builder`, so the result does not depend on `num_tasks`.
+  LinearSortedStringSet first_chunk;
+  std::vector<LinearSortedStringSet> chunks(num_chunks - 1);
+  internal::RunInParallel(num_tasks, [&](size_t task) {
+    const size_t chunks_begin = task_begin(num_chunks, task);
+    const size_t chunks_end = task_begin(num_chunks, task + 1);
+    if (chunks_begin == chunks_end) return;
+    size_t rank = chunks_begin * chunk_size;
+    size_t bucket = IntCast<size_t>(
+        std::upper_bound(bucket_ranks.begin(), bucket_ranks.end(), rank) -
+        bucket_ranks.begin() - 1);
+    size_t index = bucket_begins[bucket] + (rank - bucket_ranks[bucket]);
+    LinearSortedStringSet::Builder builder;
+    for (size_t chunk_index = chunks_begin; chunk_index < chunks_end;
+         ++chunk_index) {
+      const size_t chunk_end_rank = UnsignedMin(rank + chunk_size, size);
+      for (; rank < chunk_end_rank; ++rank) {
+        while (index == bucket_begins[bucket] + bucket_sizes[bucket]) {
+          ++bucket;
+          index = bucket_begins[bucket];
+        }
+        builder.InsertNext(sorted[index]);
+        ++index;
+      }
+      (chunk_index == 0 ? first_chunk : chunks[chunk_index - 1]) =
+          std::move(builder).Build();
+      builder.Reset();
+    }
+  });
+  return ChunkedSortedStringSet(std::move(first_chunk), std::move(chunks),
+                                size, chunk_size, options.search_index());
+}
+
+ChunkedSortedStringSet ChunkedSortedStringSet::Merge(
+    const ChunkedSortedStringSet& a, const ChunkedSortedStringSet& b,
+    bool keep_only_a, bool keep_both, bool keep_only_b, Options options) {
+  Builder builder(std::move(options));
+  Iterator a_iter = a.cbegin();
+  Iterator b_iter = b.cbegin();
+  while (a_iter != a.cend() && b_iter != b.cend()) {
+    const int ordering = a_iter->compare(*b_iter);
+    if (ordering < 0) {
+      if (keep_only_a) builder.InsertNext(*a_iter);
+      ++a_iter;
+    } else if (ordering > 0) {
+      if (keep_only_b) builder.InsertNext(*b_iter);
+      ++b_iter;
+    } else {
+      if (keep_both) builder.InsertNext(*a_iter);
+      ++a_iter;
+      ++b_iter;
+    }
+  }
+  if (keep_only_a) {
+    for (; a_iter != a.cend(); ++a_iter) builder.InsertNext(*a_iter);
+  }
+  if (keep_only_b) {
+    for (; b_iter != b.cend(); ++b_iter) builder.InsertNext(*b_iter);
+  }
+  return std::move(builder).Build();
 }
 
 bool ChunkedSortedStringSet::Equal(const ChunkedSortedStringSet& a,
@@ -220,8 +525,19 @@ absl::Status ChunkedSortedStringSet::DecodeImpl(Reader& src,
     return absl::OkStatus();
   }
 
+  // `chunk_size` remains the size of `first_chunk` if all chunks except the
+  // last one have this size. Otherwise it becomes 0, and `chunk_ranks` is
+  // filled.
+  size_t chunk_size = decode_state.size;
+  std::vector<size_t> chunk_ranks;
   std::vector<LinearSortedStringSet> chunks(IntCast<size_t>(num_chunks - 1));
   for (LinearSortedStringSet& chunk : chunks) {
+    const size_t rank = decode_state.size;
+    if (chunk_size != 0 && rank != chunk_size * (chunk_ranks.size() + 1)) {
+      // The previous chunk has a different size.
+      chunk_size = 0;
+    }
+    chunk_ranks.push_back(rank);
     {
       const absl::Status status = chunk.Decode(src, linear_options);
       if (ABSL_PREDICT_FALSE(!status.ok())) {
@@ -234,9 +550,12 @@ absl::Status ChunkedSortedStringSet::DecodeImpl(Reader& src,
           "(empty chunk)"));
     }
   }
+  if (chunk_size != 0) chunk_ranks = std::vector<size_t>();
   first_chunk_ = std::move(first_chunk);
-  DeleteRepr(std::exchange(repr_, make_allocated_repr(new Repr{
-                                      std::move(chunks), decode_state.size})));
+  DeleteRepr(std::exchange(
+      repr_, make_allocated_repr(NewRepr(
+                 std::move(chunks), decode_state.size, chunk_size,
+                 std::move(chunk_ranks), options.search_index()))));
   return absl::OkStatus();
 }
 
@@ -266,7 +585,8 @@ ChunkedSortedStringSet::Iterator::operator++() {
 ChunkedSortedStringSet::Builder::Builder(Options options)
     : size_(0),
       chunk_size_(options.chunk_size()),
-      remaining_current_chunk_size_(chunk_size_) {
+      remaining_current_chunk_size_(chunk_size_),
+      search_index_(options.search_index()) {
   if (options.size_hint() > 0) {
     chunks_.reserve((options.size_hint() - 1) / chunk_size_);
   }
@@ -277,6 +597,7 @@ ChunkedSortedStringSet::Builder::Builder(Builder&& that) noexcept
       chunk_size_(that.chunk_size_),
       remaining_current_chunk_size_(
           std::exchange(that.remaining_current_chunk_size_, that.chunk_size_)),
+      search_index_(that.search_index_),
       first_chunk_(std::exchange(that.first_chunk_, absl::nullopt)),
       chunks_(std::move(that.chunks_)),
       current_builder_(std::move(that.current_builder_)) {}
@@ -287,6 +608,7 @@ ChunkedSortedStringSet::Builder& ChunkedSortedStringSet::Builder::operator=(
   chunk_size_ = that.chunk_size_;
   remaining_current_chunk_size_ =
       std::exchange(that.remaining_current_chunk_size_, that.chunk_size_);
+  search_index_ = that.search_index_;
   first_chunk_ = std::exchange(that.first_chunk_, absl::nullopt);
   chunks_ = std::move(that.chunks_);
   current_builder_ = std::move(that.current_builder_);
@@ -299,6 +621,7 @@ void ChunkedSortedStringSet::Builder::Reset(Options options) {
   size_ = 0;
   chunk_size_ = options.chunk_size();
   remaining_current_chunk_size_ = chunk_size_;
+  search_index_ = options.search_index();
   first_chunk_ = absl::nullopt;
   chunks_.clear();
   current_builder_.Reset();
@@ -388,7 +711,7 @@ ChunkedSortedStringSet ChunkedSortedStringSet::Builder::Build() && {
     chunks_.push_back(std::move(linear_set));
   }
   return ChunkedSortedStringSet(*std::move(first_chunk_), std::move(chunks_),
-                                size_);
+                                size_, chunk_size_, search_index_);
 }
 
 }  // namespace riegeli
@@ -41,6 +41,7 @@
 #include "riegeli/bytes/reader.h"
 #include "riegeli/bytes/writer.h"
 #include "riegeli/containers/linear_sorted_string_set.h"
+#include "riegeli/containers/prefix_search_index.h"
 
 namespace riegeli {
 
@@ -85,12 +86,52 @@ class ChunkedSortedStringSet : public WithCompare<ChunkedSortedStringSet> {
     }
     size_t size_hint() const { return size_hint_; }
 
+    // If `true`, builds a `PrefixSearchIndex` of first elements of chunks,
+    // which makes `contains()` faster for large sets, at the cost of 16 bytes
+    // per chunk.
+    //
+    // Default: `false`.
+    Options& set_search_index(bool search_index) &
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      search_index_ = search_index;
+      return *this;
+    }
+    Options&& set_search_index(bool search_index) &&
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      return std::move(set_search_index(search_index));
+    }
+    bool search_index() const { return search_index_; }
+
+    // Number of threads used by `FromUnsorted()` to sort elements and to build
+    // chunks. `parallelism() == 0` builds the set in the current thread.
+    //
+    // The resulting set does not depend on `parallelism()`. Other ways of
+    // building the set ignore `parallelism()`.
+    //
+    // Default: 0.
+    Options& set_parallelism(int parallelism) & ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      RIEGELI_ASSERT_GE(parallelism, 0)
+          << "Failed precondition of "
+             "ChunkedSortedStringSet::Options::set_parallelism(): "
+             "negative parallelism";
+      parallelism_ = parallelism;
+      return *this;
+    }
+    Options&& set_parallelism(int parallelism) &&
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      return std::move(set_parallelism(parallelism));
+    }
+    int parallelism() const { return parallelism_; }
+
    private:
     size_t chunk_size_ = kDefaultChunkSize;
     size_t size_hint_ = 0;
+    bool search_index_ = false;
+    int parallelism_ = 0;
   };
 
   class Iterator;
+  class Range;
   class Builder;
   class NextInsertIterator;
 
@@ -152,8 +193,24 @@ class ChunkedSortedStringSet : public WithCompare<ChunkedSortedStringSet> {
     }
     size_t max_encoded_chunk_size() const { return max_encoded_chunk_size_; }
 
+    // If `true`, builds a `PrefixSearchIndex` of first elements of chunks,
+    // like `Options::search_index()`. The index is not encoded.
+    //
+    // Default: `false`.
+    DecodeOptions& set_search_index(bool search_index) &
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      search_index_ = search_index;
+      return *this;
+    }
+    DecodeOptions&& set_search_index(bool search_index) &&
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      return std::move(set_search_index(search_index));
+    }
+    bool search_index() const { return search_index_; }
+
    private:
     bool validate_ = false;
+    bool search_index_ = false;
     size_t max_num_chunks_ = std::vector<LinearSortedStringSet>().max_size();
     size_t max_encoded_chunk_size_ = CompactString::max_size();
   };
@@ -198,6 +255,10 @@ class ChunkedSortedStringSet : public WithCompare<ChunkedSortedStringSet> {
   // If `Src` supports random access iteration,
   // `std::distance(begin(src), end(src))` is automatically used as
   // `Options::size_hint()`.
+  //
+  // If `Options::parallelism() > 0`, elements are copied rather than moved,
+  // and the strings yielded by iteration over `src` must remain valid until
+  // `FromUnsorted()` returns, e.g. they must not be temporaries.
   template <
       typename Src,
       std::enable_if_t<IsIterableOf<Src, absl::string_view>::value, int> = 0>
@@ -235,8 +296,65 @@ class ChunkedSortedStringSet : public WithCompare<ChunkedSortedStringSet> {
   // Returns `true` if `element` is present in the set.
   //
   // Time complexity: `O(log(size / chunk_size) + chunk_size)`.
+  //
+  // With `search_index()`, searching for the chunk usually compares only
+  // fixed-width prefixes stored in a contiguous array, instead of first
+  // elements of chunks.
   bool contains(absl::string_view element) const;
 
+  // Returns an iterator to the first element which is not less than
+  // `element`, or `end()` if there is none.
+  //
+  // Time complexity: `O(log(size / chunk_size) + chunk_size)`.
+  Iterator lower_bound(absl::string_view element) const;
+
+  // Returns an iterator to the first element which is greater than `element`,
+  // or `end()` if there is none.
+  //
+  // Time complexity: `O(log(size / chunk_size) + chunk_size)`.
+  Iterator upper_bound(absl::string_view element) const;
+
+  // Returns the range of elements which start with `prefix`.
+  //
+  // Time complexity of finding the range:
+  // `O(log(size / chunk_size) + chunk_size)`.
+  Range WithPrefix(absl::string_view prefix) const;
+
+  // Returns the number of elements which are less than `element`.
+  //
+  // Time complexity: `O(log(size / chunk_size) + chunk_size)`.
+  size_t rank(absl::string_view element) const;
+
+  // Returns the set of elements present in `a` or `b`.
+  //
+  // Elements are merged one at a time in the sorted order, without decoding
+  // whole chunks.
+  //
+  // Time complexity: `O(a.size() + b.size())`.
+  static ChunkedSortedStringSet Union(const ChunkedSortedStringSet& a,
+                                      const ChunkedSortedStringSet& b,
+                                      Options options = Options());
+
+  // Returns the set of elements present in both `a` and `b`.
+  //
+  // Elements are merged one at a time in the sorted order, without decoding
+  // whole chunks.
+  //
+  // Time complexity: `O(a.size() + b.size())`.
+  static ChunkedSortedStringSet Intersection(const ChunkedSortedStringSet& a,
+                                             const ChunkedSortedStringSet& b,
+                                             Options options = Options());
+
+  // Returns the set of elements present in `a` but not in `b`.
+  //
+  // Elements are merged one at a time in the sorted order, without decoding
+  // whole chunks.
+  //
+  // Time complexity: `O(a.size() + b.size())`.
+  static ChunkedSortedStringSet Difference(const ChunkedSortedStringSet& a,
+                                           const ChunkedSortedStringSet& b,
+                                           Options options = Options());
+
   friend bool operator==(const ChunkedSortedStringSet& a,
                          const ChunkedSortedStringSet& b) {
     return Equal(a, b);
@@ -292,6 +410,8 @@ class ChunkedSortedStringSet : public WithCompare<ChunkedSortedStringSet> {
     friend void RiegeliRegisterSubobjects(const Repr* self,
                                           MemoryEstimator& memory_estimator) {
       memory_estimator.RegisterSubobjects(&self->chunks);
+      memory_estimator.RegisterSubobjects(&self->chunk_ranks);
+      memory_estimator.RegisterSubobjects(&self->search_index);
     }
 
     // Invariants:
@@ -299,11 +419,55 @@ class ChunkedSortedStringSet : public WithCompare<ChunkedSortedStringSet> {
     //   none of `chunks` is `empty()`
     std::vector<LinearSortedStringSet> chunks;
     size_t size = 0;
+    // The number of elements in each chunk except the last one, or 0 if chunks
+    // have varying sizes.
+    size_t chunk_size = 0;
+    // If `chunk_size == 0`, `chunk_ranks[i]` is the number of elements before
+    // `chunks[i]`. Otherwise empty.
+    std::vector<size_t> chunk_ranks;
+    // Index of first elements of `chunks`, or empty if the index was not
+    // requested.
+    PrefixSearchIndex search_index;
+  };
+
+  // The result of `FindChunk()`.
+  struct FoundChunk {
+    // The chunk which contains the searched element if it is present.
+    const LinearSortedStringSet* chunk;
+    // The chunk after `chunk`, or `ChunkIterator()` if `repr_is_inline()`.
+    ChunkIterator next_chunk;
+    // Index of `chunk`, where `first_chunk_` has index 0.
+    size_t chunk_index;
+    // If `true`, the searched element is the first element of `chunk`.
+    bool is_first;
   };
 
   explicit ChunkedSortedStringSet(LinearSortedStringSet&& first_chunk,
                                   std::vector<LinearSortedStringSet>&& chunks,
-                                  size_t size);
+                                  size_t size, size_t chunk_size,
+                                  bool search_index);
+
+  static Repr* NewRepr(std::vector<LinearSortedStringSet>&& chunks,
+                       size_t size, size_t chunk_size,
+                       std::vector<size_t>&& chunk_ranks, bool search_index);
+
+  // Finds the last chunk whose first element is less than or equal to
+  // `element`, or `first_chunk_` if there is none.
+  FoundChunk FindChunk(absl::string_view element) const;
+
+  // Returns an `Iterator` pointing to `iterator` in `found.chunk`, or to the
+  // beginning of the next chunk if `iterator` is `end()`.
+  Iterator MakeIterator(const FoundChunk& found,
+                        LinearSortedStringSet::Iterator iterator) const;
+
+  // Implements `FromUnsorted()` for `options.parallelism() > 0`.
+  static ChunkedSortedStringSet FromUnsortedParallel(
+      std::vector<absl::string_view>&& elements, Options options);
+
+  static ChunkedSortedStringSet Merge(const ChunkedSortedStringSet& a,
+                                      const ChunkedSortedStringSet& b,
+                                      bool keep_only_a, bool keep_both,
+                                      bool keep_only_b, Options options);
 
   static constexpr uintptr_t kEmptyRepr = 1;
   static bool repr_is_inline(uintptr_t repr) { return (repr & 1) == 1; }
@@ -451,11 +615,60 @@ class ChunkedSortedStringSet::Iterator : public WithEqual<Iterator> {
                                  : set->allocated_repr()->chunks.cbegin()),
         set_(set) {}
 
+  explicit Iterator(const ChunkedSortedStringSet* set,
+                    LinearSortedStringSet::Iterator current_iterator,
+                    ChunkIterator next_chunk_iterator)
+      : current_iterator_(std::move(current_iterator)),
+        next_chunk_iterator_(next_chunk_iterator),
+        set_(set) {}
+
   LinearSortedStringSet::Iterator current_iterator_;
   ChunkIterator next_chunk_iterator_ = ChunkIterator();
   const ChunkedSortedStringSet* set_ = nullptr;
 };
 
+// A range of consecutive elements of a `ChunkedSortedStringSet`, returned by
+// `ChunkedSortedStringSet::WithPrefix()`.
+//
+// The `Range` is valid while the `ChunkedSortedStringSet` is valid.
+class ChunkedSortedStringSet::Range {
+ public:
+  using value_type = absl::string_view;
+  using reference = value_type;
+  using const_reference = reference;
+  using iterator = Iterator;
+  using const_iterator = iterator;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+
+  // An empty range.
+  Range() = default;
+
+  Range(const Range& that) = default;
+  Range& operator=(const Range& that) = default;
+
+  Range(Range&& that) noexcept = default;
+  Range& operator=(Range&& that) noexcept = default;
+
+  // Iteration over the range.
+  Iterator begin() const { return begin_; }
+  Iterator cbegin() const { return begin(); }
+  Iterator end() const { return end_; }
+  Iterator cend() const { return end(); }
+
+  // Returns `true` if the range is empty.
+  bool empty() const { return begin_ == end_; }
+
+ private:
+  friend class ChunkedSortedStringSet;  // For `Range()`.
+
+  explicit Range(Iterator begin, Iterator end)
+      : begin_(std::move(begin)), end_(std::move(end)) {}
+
+  Iterator begin_;
+  Iterator end_;
+};
+
 // Builds a `ChunkedSortedStringSet` from a sorted sequence of strings.
 class ChunkedSortedStringSet::Builder {
  public:
@@ -542,6 +755,7 @@ class ChunkedSortedStringSet::Builder {
   size_t size_;
   size_t chunk_size_;
   size_t remaining_current_chunk_size_;
+  bool search_index_;
 
   // Invariant: if `first_chunk_ == absl::nullopt` then `chunks_.empty()`
   absl::optional<LinearSortedStringSet> first_chunk_;
@@ -618,6 +832,18 @@ class ChunkedSortedStringSet::NextInsertIterator {
 
 // Implementation details follow.
 
+namespace chunked_sorted_string_set_internal {
+
+// Returns the shortest string which is greater than all strings starting with
+// `prefix`, or `absl::nullopt` if there is no such string, i.e. if `prefix`
+// consists only of '\xff' characters.
+//
+// Elements which start with `prefix` are followed by the first element which
+// is not less than the successor.
+absl::optional<std::string> PrefixSuccessor(absl::string_view prefix);
+
+}  // namespace chunked_sorted_string_set_internal
+
 template <typename Src,
           std::enable_if_t<IsIterableOf<Src, absl::string_view>::value, int>>
 ChunkedSortedStringSet ChunkedSortedStringSet::FromSorted(Src&& src,
@@ -653,6 +879,12 @@ inline ChunkedSortedStringSet ChunkedSortedStringSet::FromUnsorted(
           std::random_access_iterator_tag>::value) {
     options.set_size_hint(std::distance(iter, end_iter));
   }
+  if (options.parallelism() > 0) {
+    std::vector<absl::string_view> elements;
+    elements.reserve(options.size_hint());
+    for (; iter != end_iter; ++iter) elements.emplace_back(*iter);
+    return FromUnsortedParallel(std::move(elements), std::move(options));
+  }
   std::vector<SrcIterator> iterators;
   iterators.reserve(options.size_hint());
   for (; iter != end_iter; ++iter) iterators.push_back(iter);
@@ -0,0 +1,274 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/containers/chunked_sorted_string_set_view.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/arithmetic.h"
+#include "riegeli/base/assert.h"
+#include "riegeli/base/binary_search.h"
+#include "riegeli/base/external_data.h"
+#include "riegeli/base/external_ref.h"
+#include "riegeli/base/memory_estimator.h"
+#include "riegeli/containers/chunked_sorted_string_set.h"
+#include "riegeli/containers/linear_sorted_string_set.h"
+#include "riegeli/containers/prefix_search_index.h"
+#include "riegeli/varint/varint_reading.h"
+
+namespace riegeli {
+
+absl::Status ChunkedSortedStringSetView::Decode(absl::string_view encoded,
+                                                DecodeOptions options) {
+  const char* ptr = encoded.data();
+  const char* const limit = ptr + encoded.size();
+  uint64_t num_chunks;
+  {
+    const absl::optional<const char*> next =
+        ReadVarint64(ptr, limit, num_chunks);
+    if (next == absl::nullopt) {
+      return absl::InvalidArgumentError(
+          "Malformed ChunkedSortedStringSet encoding (num_chunks)");
+    }
+    ptr = *next;
+  }
+  if (ABSL_PREDICT_FALSE(num_chunks > options.max_num_chunks())) {
+    return absl::ResourceExhaustedError(absl::StrCat(
+        "Maximum ChunkedSortedStringSet number of chunks exceeded: ",
+        num_chunks, " > ", options.max_num_chunks()));
+  }
+  // Each chunk takes at least one byte, which bounds the allocation below.
+  if (ABSL_PREDICT_FALSE(num_chunks > PtrDistance(ptr, limit))) {
+    return absl::InvalidArgumentError(
+        "Malformed ChunkedSortedStringSet encoding (num_chunks)");
+  }
+
+  LinearSortedStringSet::DecodeState decode_state;
+  const LinearSortedStringSet::DecodeOptions linear_options =
+      LinearSortedStringSet::DecodeOptions()
+          .set_validate(options.validate())
+          .set_decode_state(&decode_state);
+  std::vector<absl::string_view> chunks;
+  chunks.reserve(IntCast<size_t>(num_chunks));
+  // `chunk_size` remains the size of the first chunk if all chunks except the
+  // last one have this size. Otherwise it becomes 0, and `chunk_ranks` is
+  // filled.
+  size_t chunk_size = 0;
+  std::vector<size_t> chunk_ranks;
+  chunk_ranks.reserve(IntCast<size_t>(num_chunks));
+  while (chunks.size() < num_chunks) {
+    uint64_t encoded_size;
+    {
+      const absl::optional<const char*> next =
+          ReadVarint64(ptr, limit, encoded_size);
+      if (next == absl::nullopt) {
+        return absl::InvalidArgumentError(
+            "Malformed LinearSortedStringSet encoding (encoded_size)");
+      }
+      ptr = *next;
+    }
+    if (ABSL_PREDICT_FALSE(encoded_size > options.max_encoded_chunk_size())) {
+      return absl::ResourceExhaustedError(absl::StrCat(
+          "Maximum LinearSortedStringSet encoded length exceeded: ",
+          encoded_size, " > ", options.max_encoded_chunk_size()));
+    }
+    if (ABSL_PREDICT_FALSE(encoded_size > PtrDistance(ptr, limit))) {
+      return absl::InvalidArgumentError(
+          "Malformed LinearSortedStringSet encoding (encoded)");
+    }
+    if (ABSL_PREDICT_FALSE(encoded_size == 0)) {
+      return absl::InvalidArgumentError(
+          chunks.empty() ? "Malformed ChunkedSortedStringSet encoding "
+                           "(empty first chunk)"
+                         : "Malformed ChunkedSortedStringSet encoding "
+                           "(empty chunk)");
+    }
+    const absl::string_view chunk(ptr, IntCast<size_t>(encoded_size));
+    ptr += IntCast<size_t>(encoded_size);
+    const size_t rank = decode_state.size;
+    {
+      const absl::Status status =
+          LinearSortedStringSet::ValidateEncoded(chunk, linear_options);
+      if (ABSL_PREDICT_FALSE(!status.ok())) {
+        return status;
+      }
+    }
+    if (chunks.size() == 1) {
+      chunk_size = rank;
+    } else if (chunk_size != 0 && rank != chunk_size * chunks.size()) {
+      // The previous chunk has a different size.
+      chunk_size = 0;
+    }
+    chunk_ranks.push_back(rank);
+    chunks.push_back(chunk);
+  }
+  if (ABSL_PREDICT_FALSE(ptr != limit)) {
+    return absl::InvalidArgumentError(
+        "Malformed ChunkedSortedStringSet encoding (trailing data)");
+  }
+  if (chunk_size != 0) chunk_ranks = std::vector<size_t>();
+
+  PrefixSearchIndex search_index;
+  if (options.search_index() && chunks.size() > 1) {
+    search_index = PrefixSearchIndex(chunks.size() - 1, [&](size_t index) {
+      return LinearSortedStringSet::FirstImpl(chunks[index + 1]);
+    });
+  }
+  storage_ = ExternalStorage(nullptr, nullptr);
+  chunks_ = std::move(chunks);
+  size_ = decode_state.size;
+  chunk_size_ = chunk_size;
+  chunk_ranks_ = std::move(chunk_ranks);
+  search_index_ = std::move(search_index);
+  return absl::OkStatus();
+}
+
+absl::Status ChunkedSortedStringSetView::DecodeOwned(ExternalRef encoded,
+                                                     DecodeOptions options) {
+  ExternalData data = ExternalData(std::move(encoded));
+  {
+    const absl::Status status = Decode(data.substr, std::move(options));
+    if (ABSL_PREDICT_FALSE(!status.ok())) {
+      return status;
+    }
+  }
+  storage_ = std::move(data.storage);
+  return absl::OkStatus();
+}
+
+ChunkedSortedStringSetView::FoundChunk ChunkedSortedStringSetView::FindChunk(
+    absl::string_view element) const {
+  RIEGELI_ASSERT(!empty())
+      << "Failed precondition of ChunkedSortedStringSetView::FindChunk(): "
+         "empty set";
+  // This is analogous to `ChunkedSortedStringSet::FindChunk()`, with chunks
+  // after the first one being searched.
+  const ChunkIterator chunks_begin = chunks_.cbegin() + 1;
+  ChunkIterator search_begin = chunks_begin;
+  ChunkIterator search_end = chunks_.cend();
+  if (!search_index_.empty()) {
+    const PrefixSearchIndex::Range range = search_index_.Find(element);
+    search_end = chunks_begin + range.end;
+    search_begin += range.begin;
+  }
+  const SearchResult<ChunkIterator> chunk = BinarySearch(
+      search_begin, search_end, [&](ChunkIterator current) {
+        return LinearSortedStringSet::FirstImpl(*current).compare(element);
+      });
+  const size_t found_index = IntCast<size_t>(chunk.found - chunks_.cbegin());
+  if (chunk.ordering == 0) return FoundChunk{found_index, true};
+  return FoundChunk{found_index - 1, false};
+}
+
+ChunkedSortedStringSetView::Iterator ChunkedSortedStringSetView::MakeIterator(
+    size_t chunk_index, LinearSortedStringSet::Iterator iterator) const {
+  if (iterator != LinearSortedStringSet::Iterator()) {
+    return Iterator(this, std::move(iterator), chunk_index + 1);
+  }
+  if (chunk_index + 1 == chunks_.size()) return Iterator();
+  return Iterator(this,
+                  LinearSortedStringSet::BeginImpl(chunks_[chunk_index + 1]),
+                  chunk_index + 2);
+}
+
+bool ChunkedSortedStringSetView::contains(absl::string_view element) const {
+  if (empty()) return false;
+  const FoundChunk found = FindChunk(element);
+  if (found.is_first) return true;
+  return LinearSortedStringSet::ContainsImpl(chunks_[found.chunk_index],
+                                             element);
+}
+
+ChunkedSortedStringSetView::Iterator ChunkedSortedStringSetView::lower_bound(
+    absl::string_view element) const {
+  if (empty()) return Iterator();
+  const FoundChunk found = FindChunk(element);
+  const absl::string_view chunk = chunks_[found.chunk_index];
+  if (found.is_first) {
+    return MakeIterator(found.chunk_index,
+                        LinearSortedStringSet::BeginImpl(chunk));
+  }
+  return MakeIterator(found.chunk_index,
+                      LinearSortedStringSet::LowerBoundImpl(chunk, element));
+}
+
+ChunkedSortedStringSetView::Iterator ChunkedSortedStringSetView::upper_bound(
+    absl::string_view element) const {
+  if (empty()) return Iterator();
+  const FoundChunk found = FindChunk(element);
+  return MakeIterator(found.chunk_index,
+                      LinearSortedStringSet::UpperBoundImpl(
+                          chunks_[found.chunk_index], element));
+}
+
+ChunkedSortedStringSetView::Range ChunkedSortedStringSetView::WithPrefix(
+    absl::string_view prefix) const {
+  Iterator begin = lower_bound(prefix);
+  const absl::optional<std::string> successor =
+      chunked_sorted_string_set_internal::PrefixSuccessor(prefix);
+  if (successor == absl::nullopt) return Range(std::move(begin), Iterator());
+  return Range(std::move(begin), lower_bound(*successor));
+}
+
+size_t ChunkedSortedStringSetView::rank(absl::string_view element) const {
+  if (empty()) return 0;
+  const FoundChunk found = FindChunk(element);
+  const size_t rank = chunk_size_ == 0 ? chunk_ranks_[found.chunk_index]
+                                       : found.chunk_index * chunk_size_;
+  if (found.is_first) return rank;
+  return rank + LinearSortedStringSet::RankImpl(chunks_[found.chunk_index],
+                                                element);
+}
+
+size_t ChunkedSortedStringSetView::EstimateMemory() const {
+  MemoryEstimator memory_estimator;
+  memory_estimator.RegisterMemory(sizeof(ChunkedSortedStringSetView));
+  memory_estimator.RegisterSubobjects(this);
+  return memory_estimator.TotalMemory();
+}
+
+ChunkedSortedStringSetView::Iterator&
+ChunkedSortedStringSetView::Iterator::operator++() {
+  RIEGELI_ASSERT(current_iterator_ != LinearSortedStringSet::Iterator())
+      << "Failed precondition of "
+         "ChunkedSortedStringSetView::Iterator::operator++: "
+         "iterator is end()";
+  ++current_iterator_;
+  if (ABSL_PREDICT_TRUE(current_iterator_ !=
+                        LinearSortedStringSet::Iterator())) {
+    // Staying in the same chunk.
+    return *this;
+  }
+  if (ABSL_PREDICT_FALSE(next_chunk_index_ == view_->chunks_.size())) {
+    // Reached the end.
+    return *this;
+  }
+  // Moving to the next chunk.
+  current_iterator_ =
+      LinearSortedStringSet::BeginImpl(view_->chunks_[next_chunk_index_]);
+  ++next_chunk_index_;
+  return *this;
+}
+
+}  // namespace riegeli
@@ -0,0 +1,328 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_CONTAINERS_CHUNKED_SORTED_STRING_SET_VIEW_H_
+#define RIEGELI_CONTAINERS_CHUNKED_SORTED_STRING_SET_VIEW_H_
+
+#include <stddef.h>
+
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "riegeli/base/assert.h"
+#include "riegeli/base/compare.h"
+#include "riegeli/base/external_data.h"
+#include "riegeli/base/external_ref.h"
+#include "riegeli/containers/chunked_sorted_string_set.h"
+#include "riegeli/containers/linear_sorted_string_set.h"
+#include "riegeli/containers/prefix_search_index.h"
+
+namespace riegeli {
+
+// A read-only view of a `ChunkedSortedStringSet` in its encoded form, as
+// written by `ChunkedSortedStringSet::Encode()`.
+//
+// In contrast to `ChunkedSortedStringSet::Decode()`, `Decode()` does not copy
+// the encoded chunks. It only validates the encoding and remembers where chunks
+// begin, so it is fast even for large sets, e.g. when the encoded data are
+// memory-mapped. Lookups operate directly on the encoded data.
+class ChunkedSortedStringSetView {
+ public:
+  using DecodeOptions = ChunkedSortedStringSet::DecodeOptions;
+
+  class Iterator;
+  class Range;
+
+  using value_type = absl::string_view;
+  using reference = value_type;
+  using const_reference = reference;
+  using iterator = Iterator;
+  using const_iterator = iterator;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+
+  // An empty set.
+  ChunkedSortedStringSetView() = default;
+
+  ChunkedSortedStringSetView(ChunkedSortedStringSetView&& that) = default;
+  ChunkedSortedStringSetView& operator=(ChunkedSortedStringSetView&& that) =
+      default;
+
+  // Makes `*this` a view of the encoded form of a `ChunkedSortedStringSet`.
+  //
+  // `encoded` is not owned and must be kept alive while the view is used.
+  //
+  // If the result is not `absl::OkStatus()`, `*this` is unchanged.
+  absl::Status Decode(absl::string_view encoded,
+                      DecodeOptions options = DecodeOptions());
+
+  // Makes `*this` a view of the encoded form of a `ChunkedSortedStringSet`.
+  //
+  // The object owning `encoded` is kept alive by the view. It is shared rather
+  // than copied unless `ExternalRef` decides that copying is cheaper.
+  //
+  // If the result is not `absl::OkStatus()`, `*this` is unchanged.
+  absl::Status DecodeOwned(ExternalRef encoded,
+                           DecodeOptions options = DecodeOptions());
+
+  // Iteration over the set.
+  Iterator begin() const;
+  Iterator cbegin() const;
+  Iterator end() const;
+  Iterator cend() const;
+
+  // Returns `true` if the set is empty.
+  bool empty() const { return chunks_.empty(); }
+
+  // Returns the number of elements.
+  size_t size() const { return size_; }
+
+  // Returns `true` if `element` is present in the set.
+  //
+  // Time complexity: `O(log(size / chunk_size) + chunk_size)`.
+  bool contains(absl::string_view element) const;
+
+  // Returns an iterator to the first element which is not less than
+  // `element`, or `end()` if there is none.
+  //
+  // Time complexity: `O(log(size / chunk_size) + chunk_size)`.
+  Iterator lower_bound(absl::string_view element) const;
+
+  // Returns an iterator to the first element which is greater than `element`,
+  // or `end()` if there is none.
+  //
+  // Time complexity: `O(log(size / chunk_size) + chunk_size)`.
+  Iterator upper_bound(absl::string_view element) const;
+
+  // Returns the range of elements which start with `prefix`.
+  //
+  // Time complexity of finding the range:
+  // `O(log(size / chunk_size) + chunk_size)`.
+  Range WithPrefix(absl::string_view prefix) const;
+
+  // Returns the number of elements which are less than `element`.
+  //
+  // Time complexity: `O(log(size / chunk_size) + chunk_size)`.
+  size_t rank(absl::string_view element) const;
+
+  // Estimates the amount of memory used by this `ChunkedSortedStringSetView`,
+  // including `sizeof(ChunkedSortedStringSetView)` but excluding the encoded
+  // data.
+  size_t EstimateMemory() const;
+
+  // Support `EstimateMemory()`.
+  template <typename MemoryEstimator>
+  friend void RiegeliRegisterSubobjects(const ChunkedSortedStringSetView* self,
+                                        MemoryEstimator& memory_estimator) {
+    memory_estimator.RegisterSubobjects(&self->chunks_);
+    memory_estimator.RegisterSubobjects(&self->chunk_ranks_);
+    memory_estimator.RegisterSubobjects(&self->search_index_);
+  }
+
+ private:
+  using ChunkIterator = std::vector<absl::string_view>::const_iterator;
+
+  // The result of `FindChunk()`.
+  struct FoundChunk {
+    // Index of the chunk which contains the searched element if it is present.
+    size_t chunk_index;
+    // If `true`, the searched element is the first element of the chunk.
+    bool is_first;
+  };
+
+  // Finds the last chunk whose first element is less than or equal to
+  // `element`, or the first chunk if there is none.
+  //
+  // Precondition: `!empty()`
+  FoundChunk FindChunk(absl::string_view element) const;
+
+  // Returns an `Iterator` pointing to `iterator` in the chunk with
+  // `chunk_index`, or to the beginning of the next chunk if `iterator` is
+  // `end()`.
+  Iterator MakeIterator(size_t chunk_index,
+                        LinearSortedStringSet::Iterator iterator) const;
+
+  // Owns the encoded data if they were given to `DecodeOwned()`.
+  ExternalStorage storage_{nullptr, nullptr};
+  // Encoded chunks, in the representation of `LinearSortedStringSet`.
+  //
+  // Invariant: none of `chunks_` is empty.
+  std::vector<absl::string_view> chunks_;
+  size_t size_ = 0;
+  // The number of elements in each chunk except the last one, or 0 if chunks
+  // have varying sizes.
+  size_t chunk_size_ = 0;
+  // If `chunk_size_ == 0`, `chunk_ranks_[i]` is the number of elements before
+  // `chunks_[i]`. Otherwise empty.
+  std::vector<size_t> chunk_ranks_;
+  // Index of first elements of `chunks_` except the first one, or empty if the
+  // index was not requested.
+  PrefixSearchIndex search_index_;
+};
+
+// Iterates over a `ChunkedSortedStringSetView` in the sorted order.
+class ChunkedSortedStringSetView::Iterator : public WithEqual<Iterator> {
+ public:
+  // `iterator_concept` is only `std::input_iterator_tag` because the
+  // `std::forward_iterator` requirement and above require references to remain
+  // valid while the range exists.
+  using iterator_concept = std::input_iterator_tag;
+  // `iterator_category` is only `std::input_iterator_tag` also because the
+  // `LegacyForwardIterator` requirement and above require `reference` to be
+  // a true reference type.
+  using iterator_category = std::input_iterator_tag;
+  using value_type = absl::string_view;
+  using reference = value_type;
+  using difference_type = ptrdiff_t;
+
+  class pointer {
+   public:
+    reference* operator->() { return &ref_; }
+    const reference* operator->() const { return &ref_; }
+
+   private:
+    friend class Iterator;
+    explicit pointer(reference ref) : ref_(ref) {}
+    reference ref_;
+  };
+
+  // A sentinel value, equal to `end()`.
+  Iterator() = default;
+
+  Iterator(const Iterator& that) = default;
+  Iterator& operator=(const Iterator& that) = default;
+
+  Iterator(Iterator&& that) noexcept = default;
+  Iterator& operator=(Iterator&& that) noexcept = default;
+
+  // Returns the current element.
+  //
+  // The `absl::string_view` is valid until the next non-const operation on this
+  // `Iterator` (the string it points to is conditionally owned by `Iterator`).
+  reference operator*() const {
+    RIEGELI_ASSERT(current_iterator_ != LinearSortedStringSet::Iterator())
+        << "Failed precondition of "
+           "ChunkedSortedStringSetView::Iterator::operator*: "
+           "iterator is end()";
+    return *current_iterator_;
+  }
+
+  pointer operator->() const {
+    RIEGELI_ASSERT(current_iterator_ != LinearSortedStringSet::Iterator())
+        << "Failed precondition of "
+           "ChunkedSortedStringSetView::Iterator::operator->: "
+           "iterator is end()";
+    return pointer(**this);
+  }
+
+  Iterator& operator++();
+  Iterator operator++(int) {
+    const Iterator tmp = *this;
+    ++*this;
+    return tmp;
+  }
+
+  // Iterators can be compared even if they are associated with different
+  // `ChunkedSortedStringSetView` objects. All `end()` values are equal, while
+  // all other values are not equal.
+  friend bool operator==(const Iterator& a, const Iterator& b) {
+    return a.current_iterator_ == b.current_iterator_;
+  }
+
+ private:
+  friend class ChunkedSortedStringSetView;  // For `Iterator()`.
+
+  explicit Iterator(const ChunkedSortedStringSetView* view,
+                    LinearSortedStringSet::Iterator current_iterator,
+                    size_t next_chunk_index)
+      : current_iterator_(std::move(current_iterator)),
+        next_chunk_index_(next_chunk_index),
+        view_(view) {}
+
+  LinearSortedStringSet::Iterator current_iterator_;
+  size_t next_chunk_index_ = 0;
+  const ChunkedSortedStringSetView* view_ = nullptr;
+};
+
+// A range of consecutive elements of a `ChunkedSortedStringSetView`, returned
+// by `ChunkedSortedStringSetView::WithPrefix()`.
+//
+// The `Range` is valid while the `ChunkedSortedStringSetView` is valid.
+class ChunkedSortedStringSetView::Range {
+ public:
+  using value_type = absl::string_view;
+  using reference = value_type;
+  using const_reference = reference;
+  using iterator = Iterator;
+  using const_iterator = iterator;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+
+  // An empty range.
+  Range() = default;
+
+  Range(const Range& that) = default;
+  Range& operator=(const Range& that) = default;
+
+  Range(Range&& that) noexcept = default;
+  Range& operator=(Range&& that) noexcept = default;
+
+  // Iteration over the range.
+  Iterator begin() const { return begin_; }
+  Iterator cbegin() const { return begin(); }
+  Iterator end() const { return end_; }
+  Iterator cend() const { return end(); }
+
+  // Returns `true` if the range is empty.
+  bool empty() const { return begin_ == end_; }
+
+ private:
+  friend class ChunkedSortedStringSetView;  // For `Range()`.
+
+  explicit Range(Iterator begin, Iterator end)
+      : begin_(std::move(begin)), end_(std::move(end)) {}
+
+  Iterator begin_;
+  Iterator end_;
+};
+
+// Implementation details follow.
+
+inline ChunkedSortedStringSetView::Iterator ChunkedSortedStringSetView::begin()
+    const {
+  if (empty()) return Iterator();
+  return Iterator(this, LinearSortedStringSet::BeginImpl(chunks_.front()), 1);
+}
+
+inline ChunkedSortedStringSetView::Iterator
+ChunkedSortedStringSetView::cbegin() const {
+  return begin();
+}
+
+inline ChunkedSortedStringSetView::Iterator ChunkedSortedStringSetView::end()
+    const {
+  return Iterator();
+}
+
+inline ChunkedSortedStringSetView::Iterator ChunkedSortedStringSetView::cend()
+    const {
+  return end();
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_CONTAINERS_CHUNKED_SORTED_STRING_SET_VIEW_H_
@@ -29,6 +29,7 @@
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/escaping.h"
+#include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
@@ -149,7 +150,11 @@ absl::string_view LinearSortedStringSet::first() const {
   RIEGELI_ASSERT(!empty())
       << "Failed precondition of LinearSortedStringSet::first(): "
          "empty set";
-  const absl::string_view encoded_view = encoded_;
+  return FirstImpl(encoded_);
+}
+
+absl::string_view LinearSortedStringSet::FirstImpl(
+    absl::string_view encoded_view) {
   uint64_t tagged_length;
   const absl::optional<const char*> ptr =
       ReadVarint64(encoded_view.data(),
@@ -167,9 +172,14 @@ absl::string_view LinearSortedStringSet::first() const {
 }
 
 bool LinearSortedStringSet::contains(absl::string_view element) const {
+  return ContainsImpl(encoded_, element);
+}
+
+bool LinearSortedStringSet::ContainsImpl(absl::string_view encoded,
+                                         absl::string_view element) {
   // Length of the prefix shared between `element` and `*iterator`.
   size_t common_length = 0;
-  for (SplitElementIterator iterator = split_elements().cbegin();
+  for (SplitElementIterator iterator = SplitElementIterator(encoded);
        iterator != SplitElementIterator(); ++iterator) {
     // It would be incorrect to assume that if
     // `found.prefix().size() < common_length` then `*iterator > element`
@@ -247,6 +257,52 @@ bool LinearSortedStringSet::contains(absl::string_view element) const {
   return false;  // Not found.
 }
 
+LinearSortedStringSet::Iterator LinearSortedStringSet::lower_bound(
+    absl::string_view element) const {
+  return LowerBoundImpl(encoded_, element);
+}
+
+LinearSortedStringSet::Iterator LinearSortedStringSet::LowerBoundImpl(
+    absl::string_view encoded, absl::string_view element) {
+  Iterator iterator(encoded);
+  while (iterator != Iterator() && *iterator < element) ++iterator;
+  return iterator;
+}
+
+LinearSortedStringSet::Iterator LinearSortedStringSet::upper_bound(
+    absl::string_view element) const {
+  return UpperBoundImpl(encoded_, element);
+}
+
+LinearSortedStringSet::Iterator LinearSortedStringSet::UpperBoundImpl(
+    absl::string_view encoded, absl::string_view element) {
+  Iterator iterator(encoded);
+  while (iterator != Iterator() && *iterator <= element) ++iterator;
+  return iterator;
+}
+
+LinearSortedStringSet::Range LinearSortedStringSet::WithPrefix(
+    absl::string_view prefix) const {
+  Iterator begin = lower_bound(prefix);
+  Iterator end = begin;
+  while (end != Iterator() && absl::StartsWith(*end, prefix)) ++end;
+  return Range(std::move(begin), std::move(end));
+}
+
+size_t LinearSortedStringSet::rank(absl::string_view element) const {
+  return RankImpl(encoded_, element);
+}
+
+size_t LinearSortedStringSet::RankImpl(absl::string_view encoded,
+                                       absl::string_view element) {
+  size_t rank = 0;
+  for (Iterator iterator(encoded);
+       iterator != Iterator() && *iterator < element; ++iterator) {
+    ++rank;
+  }
+  return rank;
+}
+
 bool LinearSortedStringSet::Equal(const LinearSortedStringSet& a,
                                   const LinearSortedStringSet& b) {
   return std::equal(a.cbegin(), a.cend(), b.cbegin(), b.cend());
@@ -285,28 +341,8 @@ absl::Status LinearSortedStringSet::EncodeImpl(Writer& dest) const {
   return absl::OkStatus();
 }
 
-absl::Status LinearSortedStringSet::DecodeImpl(Reader& src,
-                                               DecodeOptions options) {
-  uint64_t encoded_size;
-  if (ABSL_PREDICT_FALSE(!ReadVarint64(src, encoded_size))) {
-    return src.StatusOrAnnotate(
-        absl::InvalidArgumentError("Malformed LinearSortedStringSet encoding "
-                                   "(encoded_size)"));
-  }
-  if (ABSL_PREDICT_FALSE(encoded_size > options.max_encoded_size())) {
-    return src.AnnotateStatus(absl::ResourceExhaustedError(absl::StrCat(
-        "Maximum LinearSortedStringSet encoded length exceeded: ", encoded_size,
-        " > ", options.max_encoded_size())));
-  }
-  CompactString encoded(IntCast<size_t>(encoded_size));
-  if (ABSL_PREDICT_FALSE(
-          !src.Read(IntCast<size_t>(encoded_size), encoded.data()))) {
-    return src.StatusOrAnnotate(
-        absl::InvalidArgumentError("Malformed LinearSortedStringSet encoding "
-                                   "(encoded)"));
-  }
-
-  // Validate `encoded` and update `*options.decode_state()`.
+absl::Status LinearSortedStringSet::ValidateEncoded(absl::string_view encoded,
+                                                    DecodeOptions options) {
   size_t size = 0;
   size_t current_length = 0;
   CompactString current_if_validated_and_shared;
@@ -314,17 +350,16 @@ absl::Status LinearSortedStringSet::DecodeImpl(Reader& src,
       options.decode_state() == nullptr
           ? absl::nullopt
           : absl::optional<absl::string_view>(options.decode_state()->last);
-  const absl::string_view encoded_view = encoded;
-  const char* ptr = encoded_view.data();
-  const char* const limit = ptr + encoded_view.size();
+  const char* ptr = encoded.data();
+  const char* const limit = ptr + encoded.size();
   while (ptr != limit) {
     uint64_t tagged_length;
     {
       const absl::optional<const char*> next =
           ReadVarint64(ptr, limit, tagged_length);
       if (next == absl::nullopt) {
-        return src.AnnotateStatus(absl::InvalidArgumentError(
-            "Malformed LinearSortedStringSet encoding (tagged_length)"));
+        return absl::InvalidArgumentError(
+            "Malformed LinearSortedStringSet encoding (tagged_length)");
       } else {
         ptr = *next;
       }
@@ -333,18 +368,18 @@ absl::Status LinearSortedStringSet::DecodeImpl(Reader& src,
     if ((tagged_length & 1) == 0) {
       // `shared_length == 0` and is not stored.
       if (ABSL_PREDICT_FALSE(unshared_length > PtrDistance(ptr, limit))) {
-        return src.AnnotateStatus(absl::InvalidArgumentError(
-            "Malformed LinearSortedStringSet encoding (unshared)"));
+        return absl::InvalidArgumentError(
+            "Malformed LinearSortedStringSet encoding (unshared)");
       }
       current_length = IntCast<size_t>(unshared_length);
       if (options.validate()) {
         if (ABSL_PREDICT_TRUE(current_if_validated != absl::nullopt) &&
             ABSL_PREDICT_FALSE(absl::string_view(ptr, current_length) <=
                                *current_if_validated)) {
-          return src.AnnotateStatus(absl::InvalidArgumentError(absl::StrCat(
+          return absl::InvalidArgumentError(absl::StrCat(
               "Elements are not sorted and unique: new \"",
               absl::CHexEscape(absl::string_view(ptr, current_length)),
-              "\" <= last \"", absl::CHexEscape(*current_if_validated), "\"")));
+              "\" <= last \"", absl::CHexEscape(*current_if_validated), "\""));
         }
         current_if_validated_and_shared.clear();
         current_if_validated = absl::string_view(ptr, current_length);
@@ -356,22 +391,22 @@ absl::Status LinearSortedStringSet::DecodeImpl(Reader& src,
         const absl::optional<const char*> next =
             ReadVarint64(ptr, limit, shared_length);
         if (next == absl::nullopt) {
-          return src.AnnotateStatus(absl::InvalidArgumentError(
-              "Malformed LinearSortedStringSet encoding (shared_length)"));
+          return absl::InvalidArgumentError(
+              "Malformed LinearSortedStringSet encoding (shared_length)");
         } else {
           ptr = *next;
         }
       }
       // Compare `>=` instead of `>`, before `++shared_length`.
       if (ABSL_PREDICT_FALSE(shared_length >= current_length)) {
-        return src.AnnotateStatus(absl::InvalidArgumentError(
+        return absl::InvalidArgumentError(
             "Malformed LinearSortedStringSet encoding "
-            "(shared_length larger than previous element)"));
+            "(shared_length larger than previous element)");
       }
       ++shared_length;
       if (ABSL_PREDICT_FALSE(unshared_length > PtrDistance(ptr, limit))) {
-        return src.AnnotateStatus(absl::InvalidArgumentError(
-            "Malformed LinearSortedStringSet encoding (unshared)"));
+        return absl::InvalidArgumentError(
+            "Malformed LinearSortedStringSet encoding (unshared)");
       }
       current_length = IntCast<size_t>(shared_length + unshared_length);
       if (options.validate()) {
@@ -381,13 +416,13 @@ absl::Status LinearSortedStringSet::DecodeImpl(Reader& src,
                 absl::string_view(
                     current_if_validated->data() + shared_length,
                     current_if_validated->size() - shared_length))) {
-          return src.AnnotateStatus(absl::InvalidArgumentError(absl::StrCat(
+          return absl::InvalidArgumentError(absl::StrCat(
               "Elements are not sorted and unique: new \"",
               absl::CHexEscape(
                   absl::StrCat(absl::string_view(current_if_validated->data(),
                                                  shared_length),
                                absl::string_view(ptr, unshared_length))),
-              "\" <= last \"", absl::CHexEscape(*current_if_validated), "\"")));
+              "\" <= last \"", absl::CHexEscape(*current_if_validated), "\""));
         }
         // The unshared part of the next element will be written here.
         char* current_unshared;
@@ -421,6 +456,36 @@ absl::Status LinearSortedStringSet::DecodeImpl(Reader& src,
       }
     }
   }
+  return absl::OkStatus();
+}
+
+absl::Status LinearSortedStringSet::DecodeImpl(Reader& src,
+                                               DecodeOptions options) {
+  uint64_t encoded_size;
+  if (ABSL_PREDICT_FALSE(!ReadVarint64(src, encoded_size))) {
+    return src.StatusOrAnnotate(
+        absl::InvalidArgumentError("Malformed LinearSortedStringSet encoding "
+                                   "(encoded_size)"));
+  }
+  if (ABSL_PREDICT_FALSE(encoded_size > options.max_encoded_size())) {
+    return src.AnnotateStatus(absl::ResourceExhaustedError(absl::StrCat(
+        "Maximum LinearSortedStringSet encoded length exceeded: ", encoded_size,
+        " > ", options.max_encoded_size())));
+  }
+  CompactString encoded(IntCast<size_t>(encoded_size));
+  if (ABSL_PREDICT_FALSE(
+          !src.Read(IntCast<size_t>(encoded_size), encoded.data()))) {
+    return src.StatusOrAnnotate(
+        absl::InvalidArgumentError("Malformed LinearSortedStringSet encoding "
+                                   "(encoded)"));
+  }
+
+  {
+    absl::Status status = ValidateEncoded(encoded, options);
+    if (ABSL_PREDICT_FALSE(!status.ok())) {
+      return src.AnnotateStatus(std::move(status));
+    }
+  }
   encoded_ = std::move(encoded);
   return absl::OkStatus();
 }
@@ -52,6 +52,7 @@ namespace riegeli {
 class LinearSortedStringSet : public WithCompare<LinearSortedStringSet> {
  public:
   class Iterator;
+  class Range;
   class SplitElement;
   class SplitElementIterator;
   class SplitElements;
@@ -208,6 +209,28 @@ class LinearSortedStringSet : public WithCompare<LinearSortedStringSet> {
   // Time complexity: `O(size)`.
   bool contains(absl::string_view element) const;
 
+  // Returns an iterator to the first element which is not less than
+  // `element`, or `end()` if there is none.
+  //
+  // Time complexity: `O(size)`.
+  Iterator lower_bound(absl::string_view element) const;
+
+  // Returns an iterator to the first element which is greater than `element`,
+  // or `end()` if there is none.
+  //
+  // Time complexity: `O(size)`.
+  Iterator upper_bound(absl::string_view element) const;
+
+  // Returns the range of elements which start with `prefix`.
+  //
+  // Time complexity: `O(size)`.
+  Range WithPrefix(absl::string_view prefix) const;
+
+  // Returns the number of elements which are less than `element`.
+  //
+  // Time complexity: `O(size)`.
+  size_t rank(absl::string_view element) const;
+
   friend bool operator==(const LinearSortedStringSet& a,
                          const LinearSortedStringSet& b) {
     return Equal(a, b);
@@ -252,8 +275,29 @@ class LinearSortedStringSet : public WithCompare<LinearSortedStringSet> {
   absl::Status Decode(Src&& src, DecodeOptions options = DecodeOptions());
 
  private:
+  // For `*Impl()` and `ValidateEncoded()`.
+  friend class ChunkedSortedStringSetView;
+
   explicit LinearSortedStringSet(CompactString&& encoded);
 
+  // Implementations of operations on `encoded_`, which are also applicable to
+  // encoded data not owned by a `LinearSortedStringSet`. `encoded` must have
+  // been validated with `ValidateEncoded()`.
+  static Iterator BeginImpl(absl::string_view encoded);
+  static absl::string_view FirstImpl(absl::string_view encoded);
+  static bool ContainsImpl(absl::string_view encoded,
+                           absl::string_view element);
+  static Iterator LowerBoundImpl(absl::string_view encoded,
+                                 absl::string_view element);
+  static Iterator UpperBoundImpl(absl::string_view encoded,
+                                 absl::string_view element);
+  static size_t RankImpl(absl::string_view encoded, absl::string_view element);
+
+  // Validates the structure of `encoded`, which is the representation stored
+  // in `encoded_`, and updates `*options.decode_state()`.
+  static absl::Status ValidateEncoded(absl::string_view encoded,
+                                      DecodeOptions options);
+
   static bool Equal(const LinearSortedStringSet& a,
                     const LinearSortedStringSet& b);
   static StrongOrdering Compare(const LinearSortedStringSet& a,
@@ -373,6 +417,48 @@ class LinearSortedStringSet::Iterator : public WithEqual<Iterator> {
   CompactString current_if_shared_;
 };
 
+// A range of consecutive elements of a `LinearSortedStringSet`, returned by
+// `LinearSortedStringSet::WithPrefix()`.
+//
+// The `Range` is valid while the `LinearSortedStringSet` is valid.
+class LinearSortedStringSet::Range {
+ public:
+  using value_type = absl::string_view;
+  using reference = value_type;
+  using const_reference = reference;
+  using iterator = Iterator;
+  using const_iterator = iterator;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+
+  // An empty range.
+  Range() = default;
+
+  Range(const Range& that) = default;
+  Range& operator=(const Range& that) = default;
+
+  Range(Range&& that) noexcept = default;
+  Range& operator=(Range&& that) noexcept = default;
+
+  // Iteration over the range.
+  Iterator begin() const { return begin_; }
+  Iterator cbegin() const { return begin(); }
+  Iterator end() const { return end_; }
+  Iterator cend() const { return end(); }
+
+  // Returns `true` if the range is empty.
+  bool empty() const { return begin_ == end_; }
+
+ private:
+  friend class LinearSortedStringSet;  // For `Range()`.
+
+  explicit Range(Iterator begin, Iterator end)
+      : begin_(std::move(begin)), end_(std::move(end)) {}
+
+  Iterator begin_;
+  Iterator end_;
+};
+
 // Represents an element as the concatenation of two `absl::string_view` values:
 // prefix and suffix. This is more efficient than a single `absl::string_view`
 // but less convenient.
@@ -472,7 +558,8 @@ class LinearSortedStringSet::SplitElementIterator
   }
 
  private:
-  friend class SplitElements;  // For `SplitElementIterator()`.
+  friend class LinearSortedStringSet;  // For `SplitElementIterator()`.
+  friend class SplitElements;          // For `SplitElementIterator()`.
 
   explicit SplitElementIterator(absl::string_view encoded)
       : cursor_(encoded.data()), limit_(encoded.data() + encoded.size()) {
@@ -731,6 +818,11 @@ inline LinearSortedStringSet::Iterator LinearSortedStringSet::begin() const {
   return Iterator(encoded_);
 }
 
+inline LinearSortedStringSet::Iterator LinearSortedStringSet::BeginImpl(
+    absl::string_view encoded) {
+  return Iterator(encoded);
+}
+
 inline LinearSortedStringSet::Iterator LinearSortedStringSet::cbegin() const {
   return begin();
 }
@@ -0,0 +1,117 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/containers/prefix_search_index.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/functional/function_ref.h"
+#include "absl/numeric/bits.h"
+#include "absl/strings/match.h"
+#include "absl/strings/string_view.h"
+#include "riegeli/base/arithmetic.h"
+#include "riegeli/base/assert.h"
+#include "riegeli/endian/endian_reading.h"
+
+namespace riegeli {
+
+namespace {
+
+inline size_t SharedLength(absl::string_view a, absl::string_view b) {
+  const size_t min_length = UnsignedMin(a.size(), b.size());
+  size_t length = 0;
+  while (length < min_length && a[length] == b[length]) ++length;
+  return length;
+}
+
+}  // namespace
+
+PrefixSearchIndex::PrefixSearchIndex(
+    size_t size, absl::FunctionRef<absl::string_view(size_t)> key_at)
+    : size_(size) {
+  if (size_ == 0) return;
+  {
+    const absl::string_view first = key_at(0);
+    shared_prefix_ =
+        std::string(first.substr(0, SharedLength(first, key_at(size_ - 1))));
+  }
+  fragments_.resize(size_ + 1);
+  positions_.resize(size_ + 1);
+  // Visit nodes in order, which assigns consecutive positions to them.
+  // `node` is the next node to descend from, or 0 to ascend.
+  size_t position = 0;
+  size_t node = 1;
+  for (;;) {
+    while (node <= size_) node *= 2;
+    // Ascend while coming from the right child.
+    node >>= IntCast<size_t>(absl::countr_one(node)) + 1;
+    if (node == 0) break;
+    const absl::string_view key = key_at(position);
+    RIEGELI_ASSERT(absl::StartsWith(key, shared_prefix_))
+        << "Failed precondition of PrefixSearchIndex: keys not sorted";
+    fragments_[node] = Fragment(key.substr(shared_prefix_.size()));
+    positions_[node] = position;
+    ++position;
+    node = 2 * node + 1;
+  }
+  RIEGELI_ASSERT_EQ(position, size_)
+      << "PrefixSearchIndex construction did not visit all nodes";
+}
+
+inline uint64_t PrefixSearchIndex::Fragment(absl::string_view suffix) {
+  if (suffix.size() >= sizeof(uint64_t)) return ReadBigEndian64(suffix.data());
+  char buffer[sizeof(uint64_t)] = {};
+  if (!suffix.empty()) memcpy(buffer, suffix.data(), suffix.size());
+  return ReadBigEndian64(buffer);
+}
+
+inline size_t PrefixSearchIndex::LowerBound(uint64_t fragment) const {
+  size_t node = 1;
+  while (node <= size_) {
+    node = 2 * node + (fragments_[node] < fragment ? 1 : 0);
+  }
+  // Ascend to the last node where the search went left.
+  node >>= IntCast<size_t>(absl::countr_one(node)) + 1;
+  return Position(node);
+}
+
+inline size_t PrefixSearchIndex::UpperBound(uint64_t fragment) const {
+  size_t node = 1;
+  while (node <= size_) {
+    node = 2 * node + (fragments_[node] <= fragment ? 1 : 0);
+  }
+  // Ascend to the last node where the search went left.
+  node >>= IntCast<size_t>(absl::countr_one(node)) + 1;
+  return Position(node);
+}
+
+PrefixSearchIndex::Range PrefixSearchIndex::Find(
+    absl::string_view element) const {
+  if (ABSL_PREDICT_FALSE(!absl::StartsWith(element, shared_prefix_))) {
+    // All keys start with `shared_prefix_`, so they are all greater or all
+    // less than `element`.
+    if (element < shared_prefix_) return Range{0, 0};
+    return Range{size_, size_};
+  }
+  const uint64_t fragment = Fragment(element.substr(shared_prefix_.size()));
+  return Range{LowerBound(fragment), UpperBound(fragment)};
+}
+
+}  // namespace riegeli
@@ -0,0 +1,121 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_CONTAINERS_PREFIX_SEARCH_INDEX_H_
+#define RIEGELI_CONTAINERS_PREFIX_SEARCH_INDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "absl/functional/function_ref.h"
+#include "absl/strings/string_view.h"
+
+namespace riegeli {
+
+// A compact index over a sorted sequence of strings (keys), which narrows down
+// the range of keys to compare with a searched string without touching the
+// keys themselves.
+//
+// The index stores a fixed-width fragment of each key: 8 bytes following the
+// prefix shared by all keys. Fragments are laid out in the Eytzinger order
+// (the breadth-first order of a balanced binary search tree) in a contiguous
+// array, so that a search touches few cache lines, and the first levels of
+// the tree stay in the cache between searches.
+//
+// The index costs 16 bytes per key, plus the shared prefix.
+class PrefixSearchIndex {
+ public:
+  // A range of key positions: `[begin, end)`.
+  struct Range {
+    size_t begin;
+    size_t end;
+  };
+
+  // An empty index.
+  PrefixSearchIndex() = default;
+
+  // Builds an index of `size` keys. `key_at(i)` returns the key at position
+  // `i`. Keys must be sorted.
+  explicit PrefixSearchIndex(
+      size_t size, absl::FunctionRef<absl::string_view(size_t)> key_at);
+
+  PrefixSearchIndex(const PrefixSearchIndex& that) = default;
+  PrefixSearchIndex& operator=(const PrefixSearchIndex& that) = default;
+
+  PrefixSearchIndex(PrefixSearchIndex&& that) = default;
+  PrefixSearchIndex& operator=(PrefixSearchIndex&& that) = default;
+
+  // Returns `true` if the index is empty.
+  bool empty() const { return size_ == 0; }
+
+  // Returns the number of indexed keys.
+  size_t size() const { return size_; }
+
+  // Returns the range of positions of keys which the index cannot distinguish
+  // from `element`. Keys before `begin` are less than `element`, keys from
+  // `end` are greater than `element`, and keys in `[begin, end)` need to be
+  // compared with `element` to find out.
+  //
+  // Often `begin == end`, which means that `begin` keys are less than
+  // `element`, and the remaining keys are greater.
+  //
+  // Time complexity: `O(log(size))`.
+  Range Find(absl::string_view element) const;
+
+  // Support `EstimateMemory()`.
+  template <typename MemoryEstimator>
+  friend void RiegeliRegisterSubobjects(const PrefixSearchIndex* self,
+                                        MemoryEstimator& memory_estimator) {
+    memory_estimator.RegisterSubobjects(&self->shared_prefix_);
+    memory_estimator.RegisterSubobjects(&self->fragments_);
+    memory_estimator.RegisterSubobjects(&self->positions_);
+  }
+
+ private:
+  // Returns the fragment of a key or element after `shared_prefix_`:
+  // its first 8 bytes as big endian, padded with zeros.
+  static uint64_t Fragment(absl::string_view suffix);
+
+  // Returns the number of keys whose fragment is less than `fragment`.
+  size_t LowerBound(uint64_t fragment) const;
+  // Returns the number of keys whose fragment is less than or equal to
+  // `fragment`.
+  size_t UpperBound(uint64_t fragment) const;
+  // Returns the position of the key at Eytzinger node `node` (1-based), or
+  // `size_` if `node == 0`.
+  size_t Position(size_t node) const {
+    return node == 0 ? size_ : positions_[node];
+  }
+
+  size_t size_ = 0;
+  // The prefix shared by all keys.
+  std::string shared_prefix_;
+  // Fragments of keys in the Eytzinger order, 1-based: `fragments_[0]` is
+  // unused, children of `fragments_[i]` are `fragments_[2 * i]` and
+  // `fragments_[2 * i + 1]`.
+  //
+  // Invariant: if `size_ > 0` then `fragments_.size() == size_ + 1`.
+  std::vector<uint64_t> fragments_;
+  // Positions of keys corresponding to `fragments_`.
+  //
+  // Invariant: `positions_.size() == fragments_.size()`.
+  std::vector<size_t> positions_;
+};
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_CONTAINERS_PREFIX_SEARCH_INDEX_H_
@@ -0,0 +1,123 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures latency of `ChunkedSortedStringSet::contains()` with and without
+// `search_index()`, for several set sizes, using URL-like elements.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "riegeli/base/assert.h"
+#include "riegeli/bytes/std_io.h"
+#include "riegeli/containers/chunked_sorted_string_set.h"
+
+ABSL_FLAG(std::vector<std::string>, set_sizes,
+          std::vector<std::string>({"1000", "100000", "1000000", "10000000"}),
+          "Numbers of elements of sets to benchmark");
+ABSL_FLAG(uint64_t, chunk_size,
+          riegeli::ChunkedSortedStringSet::Options::kDefaultChunkSize,
+          "Number of elements encoded together");
+ABSL_FLAG(uint64_t, num_lookups, 1000000,
+          "Number of lookups in each repetition");
+ABSL_FLAG(int32_t, repetitions, 5, "Number of times to repeat each benchmark");
+
+namespace {
+
+// Returns a URL-like string derived from `index`. Strings share a long common
+// prefix, and are spread among hosts and paths.
+std::string MakeElement(uint64_t index) {
+  const uint64_t hash = index * 0x9e3779b97f4a7c15;
+  return absl::StrFormat("https://www.example%u.com/%x/%u", hash % 997,
+                         hash >> 40, index);
+}
+
+// Returns the median latency of `set.contains()` in ns per lookup, and checks
+// that it returns `expected` for all `queries`.
+double Measure(const riegeli::ChunkedSortedStringSet& set,
+               const std::vector<std::string>& queries, bool expected,
+               int repetitions) {
+  std::vector<double> samples;
+  for (int i = 0; i < repetitions; ++i) {
+    size_t num_found = 0;
+    const absl::Time start = absl::Now();
+    for (const std::string& query : queries) {
+      if (set.contains(query)) ++num_found;
+    }
+    const absl::Duration elapsed = absl::Now() - start;
+    RIEGELI_CHECK_EQ(num_found, expected ? queries.size() : 0u)
+        << "Unexpected result of contains()";
+    samples.push_back(absl::ToDoubleNanoseconds(elapsed) /
+                      static_cast<double>(queries.size()));
+  }
+  std::nth_element(samples.begin(), samples.begin() + samples.size() / 2,
+                   samples.end());
+  return samples[samples.size() / 2];
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  const size_t chunk_size = absl::GetFlag(FLAGS_chunk_size);
+  const size_t num_lookups = std::max(absl::GetFlag(FLAGS_num_lookups),
+                                      uint64_t{1});
+  const int repetitions = std::max(absl::GetFlag(FLAGS_repetitions), 1);
+  riegeli::StdOut std_out;
+  std_out.Write(absl::StrFormat("%10s %6s %12s %12s %12s\n", "size", "index",
+                                "hit ns", "miss ns", "memory"));
+  for (const std::string& set_size_str : absl::GetFlag(FLAGS_set_sizes)) {
+    size_t set_size;
+    RIEGELI_CHECK(absl::SimpleAtoi(set_size_str, &set_size) && set_size > 0)
+        << "Invalid set size: " << set_size_str;
+    std::vector<std::string> elements;
+    elements.reserve(set_size);
+    for (size_t i = 0; i < set_size; ++i) {
+      elements.push_back(MakeElement(2 * i));
+    }
+    std::vector<std::string> hits;
+    std::vector<std::string> misses;
+    hits.reserve(num_lookups);
+    misses.reserve(num_lookups);
+    uint64_t random = 1;
+    for (size_t i = 0; i < num_lookups; ++i) {
+      random = random * 6364136223846793005 + 1442695040888963407;
+      const uint64_t index = (random >> 16) % set_size;
+      hits.push_back(MakeElement(2 * index));
+      misses.push_back(MakeElement(2 * index + 1));
+    }
+    for (const bool search_index : {false, true}) {
+      const riegeli::ChunkedSortedStringSet set =
+          riegeli::ChunkedSortedStringSet::FromUnsorted(
+              elements, riegeli::ChunkedSortedStringSet::Options()
+                            .set_chunk_size(chunk_size)
+                            .set_search_index(search_index));
+      const double hit_latency = Measure(set, hits, true, repetitions);
+      const double miss_latency = Measure(set, misses, false, repetitions);
+      std_out.Write(absl::StrFormat("%10u %6s %12.1f %12.1f %12u\n", set_size,
+                                    search_index ? "yes" : "no", hit_latency,
+                                    miss_latency, set.EstimateMemory()));
+    }
+  }
+  std_out.Close();
+}
@@ -0,0 +1,114 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures throughput of `ChunkedSortedStringSet::FromUnsorted()` depending on
+// `Options::parallelism()`, using URL-like elements with duplicates.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "riegeli/base/assert.h"
+#include "riegeli/bytes/std_io.h"
+#include "riegeli/containers/chunked_sorted_string_set.h"
+
+ABSL_FLAG(uint64_t, num_elements, 10000000,
+          "Number of elements, including duplicates");
+ABSL_FLAG(double, duplicate_fraction, 0.1,
+          "Expected fraction of elements which are duplicates");
+ABSL_FLAG(std::vector<std::string>, parallelism,
+          std::vector<std::string>({"0", "1", "2", "4", "8", "16"}),
+          "Values of Options::parallelism() to benchmark");
+ABSL_FLAG(uint64_t, chunk_size,
+          riegeli::ChunkedSortedStringSet::Options::kDefaultChunkSize,
+          "Number of elements encoded together");
+ABSL_FLAG(int32_t, repetitions, 3, "Number of times to repeat each benchmark");
+
+namespace {
+
+// Returns a URL-like string derived from `index`.
+std::string MakeElement(uint64_t index) {
+  const uint64_t hash = index * 0x9e3779b97f4a7c15;
+  return absl::StrFormat("https://www.example%u.com/%x/%u", hash % 997,
+                         hash >> 40, index);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  const size_t num_elements = absl::GetFlag(FLAGS_num_elements);
+  const double duplicate_fraction =
+      std::min(std::max(absl::GetFlag(FLAGS_duplicate_fraction), 0.0), 0.99);
+  const size_t chunk_size = absl::GetFlag(FLAGS_chunk_size);
+  const int repetitions = std::max(absl::GetFlag(FLAGS_repetitions), 1);
+
+  const uint64_t num_distinct = std::max(
+      static_cast<uint64_t>(static_cast<double>(num_elements) *
+                            (1.0 - duplicate_fraction)),
+      uint64_t{1});
+  std::vector<std::string> elements;
+  elements.reserve(num_elements);
+  uint64_t random = 1;
+  for (size_t i = 0; i < num_elements; ++i) {
+    random = random * 6364136223846793005 + 1442695040888963407;
+    elements.push_back(MakeElement((random >> 16) % num_distinct));
+  }
+
+  riegeli::StdOut std_out;
+  std_out.Write(absl::StrFormat("%11s %10s %14s %8s\n", "parallelism",
+                                "seconds", "elements/s", "speedup"));
+  riegeli::ChunkedSortedStringSet reference;
+  double reference_seconds = 0.0;
+  for (const std::string& parallelism_str : absl::GetFlag(FLAGS_parallelism)) {
+    int parallelism;
+    RIEGELI_CHECK(absl::SimpleAtoi(parallelism_str, &parallelism) &&
+                  parallelism >= 0)
+        << "Invalid parallelism: " << parallelism_str;
+    std::vector<double> samples;
+    riegeli::ChunkedSortedStringSet set;
+    for (int i = 0; i < repetitions; ++i) {
+      const absl::Time start = absl::Now();
+      set = riegeli::ChunkedSortedStringSet::FromUnsorted(
+          elements, riegeli::ChunkedSortedStringSet::Options()
+                        .set_chunk_size(chunk_size)
+                        .set_parallelism(parallelism));
+      samples.push_back(absl::ToDoubleSeconds(absl::Now() - start));
+    }
+    std::nth_element(samples.begin(), samples.begin() + samples.size() / 2,
+                     samples.end());
+    const double seconds = samples[samples.size() / 2];
+    if (reference_seconds == 0.0) {
+      reference = std::move(set);
+      reference_seconds = seconds;
+    } else {
+      RIEGELI_CHECK(set == reference)
+          << "FromUnsorted() result depends on parallelism";
+    }
+    std_out.Write(absl::StrFormat(
+        "%11d %10.3f %14.0f %7.2fx\n", parallelism, seconds,
+        static_cast<double>(num_elements) / seconds,
+        reference_seconds / seconds));
+  }
+  std_out.Close();
+}
@@ -0,0 +1,372 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/csv/csv_parallel_reading.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <future>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/arithmetic.h"
+#include "riegeli/base/assert.h"
+#include "riegeli/base/parallelism.h"
+#include "riegeli/base/types.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/reader_factory.h"
+#include "riegeli/csv/csv_reader.h"
+#include "riegeli/csv/csv_record.h"
+
+namespace riegeli {
+
+namespace {
+
+// Records parsed from a byte range, together with what is needed to verify
+// that the range began at a record boundary.
+template <typename Record>
+struct ParsedRange {
+  // Where parsing began: the speculated record boundary.
+  Position begin = 0;
+  // The speculated beginning of the next range. Parsing stopped at the first
+  // record boundary at or after `speculated_end`.
+  Position speculated_end = 0;
+  // Where parsing ended.
+  Position end = 0;
+  // The number of lines between `begin` and `end`.
+  int64_t num_lines = 0;
+  // If `true`, parsing failed, and the range must be parsed again with
+  // sequential context to report the failure or to recover.
+  bool failed = false;
+  std::vector<Record> records;
+};
+
+// Returns the position after the first line terminator which ends at or after
+// `boundary`, or the end of the source.
+//
+// Precondition: `boundary > 0`
+Position SpeculateRecordBoundary(Reader& src, Position boundary) {
+  if (ABSL_PREDICT_FALSE(!src.Seek(boundary - 1))) return src.pos();
+  for (;;) {
+    if (ABSL_PREDICT_FALSE(!src.Pull())) return src.pos();
+    const char* ptr = src.cursor();
+    while (ptr != src.limit()) {
+      if (*ptr == '\n') {
+        src.set_cursor(ptr + 1);
+        return src.pos();
+      }
+      if (*ptr == '\r') {
+        src.set_cursor(ptr + 1);
+        if (src.Pull() && *src.cursor() == '\n') src.move_cursor(1);
+        return src.pos();
+      }
+      ++ptr;
+    }
+    src.set_cursor(ptr);
+  }
+}
+
+// Reads records from `csv_reader` until reaching a record boundary at or after
+// `end`.
+//
+// Returns `false` if reading failed or was cancelled by the recovery function.
+template <typename Record>
+bool ReadRecordsUntil(CsvReaderBase& csv_reader, Position end,
+                      std::vector<Record>& records) {
+  Reader& src = *csv_reader.SrcReader();
+  Record record;
+  while (src.pos() < end) {
+    if (!csv_reader.HasNextRecord() || src.pos() >= end) break;
+    if (ABSL_PREDICT_FALSE(!csv_reader.ReadRecord(record))) return false;
+    records.push_back(std::move(record));
+  }
+  return csv_reader.ok();
+}
+
+template <typename Record>
+void ParseRange(const ReaderFactoryBase& reader_factory, Position boundary,
+                Position next_boundary, Position size, bool speculate_begin,
+                const CsvReaderBase::Options& csv_options,
+                ParsedRange<Record>& range) {
+  range.begin = boundary;
+  range.speculated_end = next_boundary;
+  const std::unique_ptr<Reader> src = reader_factory.NewReader(boundary);
+  if (ABSL_PREDICT_FALSE(src == nullptr)) {
+    range.failed = true;
+    return;
+  }
+  range.begin =
+      speculate_begin ? SpeculateRecordBoundary(*src, boundary) : boundary;
+  range.speculated_end = next_boundary >= size
+                             ? size
+                             : SpeculateRecordBoundary(*src, next_boundary);
+  if (ABSL_PREDICT_FALSE(!src->Seek(range.begin))) {
+    range.failed = true;
+    return;
+  }
+  CsvReader<Reader*> csv_reader(src.get(), csv_options);
+  if (ABSL_PREDICT_FALSE(!ReadRecordsUntil(csv_reader, range.speculated_end,
+                                           range.records))) {
+    range.failed = true;
+    return;
+  }
+  range.end = src->pos();
+  range.num_lines = csv_reader.line_number() - 1;
+}
+
+// Delivers records of ranges to the callback from background threads, and
+// tracks when all deliveries are complete.
+template <typename Record>
+class UnorderedDelivery {
+ public:
+  explicit UnorderedDelivery(
+      absl::FunctionRef<absl::Status(uint64_t, Record&)> callback,
+      size_t max_pending)
+      : callback_(callback), max_pending_(max_pending) {}
+
+  ~UnorderedDelivery() {
+    absl::MutexLock lock(
+        &mutex_, absl::Condition(
+                     +[](size_t* num_pending) { return *num_pending == 0; },
+                     &num_pending_));
+  }
+
+  void Deliver(uint64_t record_index, std::vector<Record>&& records) {
+    {
+      absl::MutexLock lock(&mutex_,
+                           absl::Condition(this, &UnorderedDelivery::HasRoom));
+      ++num_pending_;
+    }
+    internal::ThreadPool::global().Schedule(
+        [this, record_index, records = std::move(records)]() mutable {
+          absl::Status status;
+          for (Record& record : records) {
+            {
+              absl::MutexLock lock(&mutex_);
+              if (ABSL_PREDICT_FALSE(!status_.ok())) break;
+            }
+            status = callback_(record_index++, record);
+            if (ABSL_PREDICT_FALSE(!status.ok())) break;
+          }
+          absl::MutexLock lock(&mutex_);
+          if (ABSL_PREDICT_FALSE(!status.ok()) && status_.ok()) {
+            status_ = std::move(status);
+          }
+          --num_pending_;
+        });
+  }
+
+  absl::Status status() {
+    absl::MutexLock lock(&mutex_);
+    return status_;
+  }
+
+  absl::Status Finish() {
+    absl::MutexLock lock(
+        &mutex_, absl::Condition(
+                     +[](size_t* num_pending) { return *num_pending == 0; },
+                     &num_pending_));
+    return status_;
+  }
+
+ private:
+  bool HasRoom() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return num_pending_ < max_pending_;
+  }
+
+  absl::FunctionRef<absl::Status(uint64_t, Record&)> callback_;
+  size_t max_pending_;
+  absl::Mutex mutex_;
+  size_t num_pending_ ABSL_GUARDED_BY(mutex_) = 0;
+  absl::Status status_ ABSL_GUARDED_BY(mutex_);
+};
+
+template <typename Record>
+absl::Status ReadSequentially(
+    Reader& src, absl::FunctionRef<absl::Status(uint64_t, Record&)> callback,
+    CsvReaderBase::Options&& csv_options) {
+  CsvReader<Reader*> csv_reader(&src, std::move(csv_options));
+  Record record;
+  while (csv_reader.ReadRecord(record)) {
+    absl::Status status = callback(csv_reader.last_record_index(), record);
+    if (ABSL_PREDICT_FALSE(!status.ok())) return status;
+  }
+  return csv_reader.status();
+}
+
+template <typename Record>
+absl::Status ReadInParallel(
+    Reader& src, absl::FunctionRef<absl::Status(uint64_t, Record&)> callback,
+    CsvParallelReadingOptions&& options) {
+  if (options.parallelism() == 0 || !src.SupportsRandomAccess()) {
+    return ReadSequentially(src, callback, std::move(options.csv_options()));
+  }
+  const absl::optional<Position> size = src.Size();
+  if (ABSL_PREDICT_FALSE(size == absl::nullopt)) return src.status();
+
+  // The header, if any, and a UTF-8 BOM are read sequentially.
+  CsvReaderBase::Options range_options = options.csv_options();
+  range_options.set_recovery(nullptr);
+  CsvReaderBase::Options resume_options;
+  Position begin;
+  int64_t line_number;
+  {
+    CsvReader<Reader*> csv_reader(&src, options.csv_options());
+    if (ABSL_PREDICT_FALSE(!csv_reader.ok())) return csv_reader.status();
+    begin = src.pos();
+    line_number = csv_reader.line_number();
+    if (csv_reader.has_header()) {
+      range_options.required_header() = absl::nullopt;
+      range_options.set_assumed_header(csv_reader.header());
+    }
+    range_options.set_preserve_utf8_bom(true);
+    resume_options = range_options;
+    resume_options.set_recovery(std::move(options.csv_options().recovery()));
+  }
+
+  ReaderFactory<Reader*> reader_factory(&src);
+  if (ABSL_PREDICT_FALSE(!reader_factory.ok())) return reader_factory.status();
+  const size_t max_pending = IntCast<size_t>(options.parallelism());
+  absl::optional<UnorderedDelivery<Record>> unordered_delivery;
+  if (!options.ordered()) unordered_delivery.emplace(callback, max_pending);
+
+  // Ranges being parsed, in the order of the file.
+  std::deque<std::future<ParsedRange<Record>>> pending_ranges;
+  Position next_boundary = begin;
+  const auto schedule_range = [&] {
+    const Position boundary = next_boundary;
+    next_boundary = boundary + UnsignedMin(options.range_size(),
+                                           *size - boundary);
+    std::promise<ParsedRange<Record>>* const promise =
+        new std::promise<ParsedRange<Record>>();
+    pending_ranges.push_back(promise->get_future());
+    internal::ThreadPool::global().Schedule(
+        [&reader_factory, boundary, next_boundary = next_boundary,
+         size = *size, speculate_begin = boundary != begin, &range_options,
+         promise] {
+          ParsedRange<Record> range;
+          ParseRange(reader_factory, boundary, next_boundary, size,
+                     speculate_begin, range_options, range);
+          promise->set_value(std::move(range));
+          delete promise;
+        });
+  };
+
+  absl::Status status;
+  // If `true`, reading was cancelled by the recovery function.
+  bool cancelled = false;
+  uint64_t record_index = 0;
+  Position pos = begin;
+  for (;;) {
+    while (status.ok() && !cancelled &&
+           pending_ranges.size() < max_pending && next_boundary < *size) {
+      schedule_range();
+    }
+    if (pending_ranges.empty()) break;
+    ParsedRange<Record> range = pending_ranges.front().get();
+    pending_ranges.pop_front();
+    // After a failure or cancellation, remaining ranges are only waited for.
+    if (ABSL_PREDICT_FALSE(!status.ok() || cancelled)) continue;
+    // The range is covered by records of previous ranges.
+    if (range.speculated_end <= pos) continue;
+    if (ABSL_PREDICT_FALSE(range.failed || range.begin != pos)) {
+      // The range did not begin at a record boundary, or parsing it failed.
+      // Parse it again from the actual boundary, with the actual record index
+      // and line number, so that failures are reported and recovered from as
+      // in sequential reading.
+      const std::unique_ptr<Reader> range_src = reader_factory.NewReader(pos);
+      if (ABSL_PREDICT_FALSE(range_src == nullptr)) {
+        status = reader_factory.status();
+        continue;
+      }
+      CsvReader<Reader*> csv_reader(range_src.get(), resume_options);
+      csv_internal::ResumeAt(csv_reader, record_index, line_number);
+      range.records.clear();
+      const bool range_ok = ReadRecordsUntil(csv_reader, range.speculated_end,
+                                             range.records);
+      if (ABSL_PREDICT_FALSE(!csv_reader.ok())) {
+        status = csv_reader.status();
+        continue;
+      }
+      cancelled = !range_ok;
+      range.begin = pos;
+      range.end = range_src->pos();
+      range.num_lines = csv_reader.line_number() - line_number;
+    }
+    const uint64_t range_record_index = record_index;
+    record_index += range.records.size();
+    line_number += range.num_lines;
+    pos = range.end;
+    if (unordered_delivery == absl::nullopt) {
+      uint64_t index = range_record_index;
+      for (Record& record : range.records) {
+        status = callback(index++, record);
+        if (ABSL_PREDICT_FALSE(!status.ok())) break;
+      }
+    } else {
+      status = unordered_delivery->status();
+      if (ABSL_PREDICT_TRUE(status.ok())) {
+        unordered_delivery->Deliver(range_record_index,
+                                    std::move(range.records));
+      }
+    }
+  }
+  if (unordered_delivery != absl::nullopt) {
+    absl::Status delivery_status = unordered_delivery->Finish();
+    if (status.ok()) status = std::move(delivery_status);
+  }
+  if (ABSL_PREDICT_FALSE(!reader_factory.Close())) {
+    if (status.ok()) status = reader_factory.status();
+  }
+  if (ABSL_PREDICT_FALSE(!status.ok())) return status;
+  if (ABSL_PREDICT_FALSE(!src.Seek(pos))) return src.status();
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+absl::Status ReadCsvRecordsInParallel(
+    Reader& src,
+    absl::FunctionRef<absl::Status(uint64_t record_index,
+                                   std::vector<std::string>& record)>
+        callback,
+    CsvParallelReadingOptions options) {
+  return ReadInParallel<std::vector<std::string>>(src, callback,
+                                                  std::move(options));
+}
+
+absl::Status ReadCsvRecordsInParallel(
+    Reader& src,
+    absl::FunctionRef<absl::Status(uint64_t record_index, CsvRecord& record)>
+        callback,
+    CsvParallelReadingOptions options) {
+  RIEGELI_ASSERT(options.csv_options().required_header() != absl::nullopt ||
+                 options.csv_options().assumed_header() != absl::nullopt)
+      << "Failed precondition of ReadCsvRecordsInParallel(CsvRecord): "
+         "CsvReaderBase::Options::required_header() != nullopt or "
+         "assumed_header() != nullopt is required";
+  return ReadInParallel<CsvRecord>(src, callback, std::move(options));
+}
+
+}  // namespace riegeli
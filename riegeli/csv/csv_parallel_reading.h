@@ -0,0 +1,187 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_CSV_CSV_PARALLEL_READING_H_
+#define RIEGELI_CSV_CSV_PARALLEL_READING_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/attributes.h"
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "riegeli/base/assert.h"
+#include "riegeli/base/initializer.h"
+#include "riegeli/base/reset.h"
+#include "riegeli/base/types.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/csv/csv_reader.h"
+#include "riegeli/csv/csv_record.h"
+
+namespace riegeli {
+
+class CsvParallelReadingOptions {
+ public:
+  CsvParallelReadingOptions() noexcept {}
+
+  // Options for interpreting the CSV file, as for `CsvReader`.
+  //
+  // If `csv_options().recovery() != nullptr`, the recovery function is called
+  // from the thread which called `ReadCsvRecordsInParallel()`.
+  //
+  // Default: `CsvReaderBase::Options()`.
+  CsvParallelReadingOptions& set_csv_options(
+      Initializer<CsvReaderBase::Options> csv_options) &
+      ABSL_ATTRIBUTE_LIFETIME_BOUND {
+    riegeli::Reset(csv_options_, std::move(csv_options));
+    return *this;
+  }
+  CsvParallelReadingOptions&& set_csv_options(
+      Initializer<CsvReaderBase::Options> csv_options) &&
+      ABSL_ATTRIBUTE_LIFETIME_BOUND {
+    return std::move(set_csv_options(std::move(csv_options)));
+  }
+  CsvReaderBase::Options& csv_options() ABSL_ATTRIBUTE_LIFETIME_BOUND {
+    return csv_options_;
+  }
+  const CsvReaderBase::Options& csv_options() const
+      ABSL_ATTRIBUTE_LIFETIME_BOUND {
+    return csv_options_;
+  }
+
+  // Maximum number of byte ranges being parsed concurrently. Larger
+  // parallelism can increase throughput, up to a point where it no longer
+  // matters; smaller parallelism reduces memory usage.
+  //
+  // `parallelism() == 0` reads the file sequentially on the calling thread.
+  //
+  // Default: 8.
+  CsvParallelReadingOptions& set_parallelism(int parallelism) &
+      ABSL_ATTRIBUTE_LIFETIME_BOUND {
+    RIEGELI_ASSERT_GE(parallelism, 0)
+        << "Failed precondition of "
+           "CsvParallelReadingOptions::set_parallelism(): "
+           "negative parallelism";
+    parallelism_ = parallelism;
+    return *this;
+  }
+  CsvParallelReadingOptions&& set_parallelism(int parallelism) &&
+      ABSL_ATTRIBUTE_LIFETIME_BOUND {
+    return std::move(set_parallelism(parallelism));
+  }
+  int parallelism() const { return parallelism_; }
+
+  // Approximate size of a byte range parsed as a unit. Actual ranges are
+  // adjusted to record boundaries.
+  //
+  // Records of a range are held in memory until they are delivered, so memory
+  // usage is proportional to `parallelism() * range_size()`.
+  //
+  // `range_size` must be positive.
+  //
+  // Default: `kDefaultRangeSize` (8M).
+  static constexpr Position kDefaultRangeSize = Position{8} << 20;
+  CsvParallelReadingOptions& set_range_size(Position range_size) &
+      ABSL_ATTRIBUTE_LIFETIME_BOUND {
+    RIEGELI_ASSERT_GT(range_size, 0u)
+        << "Failed precondition of "
+           "CsvParallelReadingOptions::set_range_size(): "
+           "range size out of range";
+    range_size_ = range_size;
+    return *this;
+  }
+  CsvParallelReadingOptions&& set_range_size(Position range_size) &&
+      ABSL_ATTRIBUTE_LIFETIME_BOUND {
+    return std::move(set_range_size(range_size));
+  }
+  Position range_size() const { return range_size_; }
+
+  // If `true`, records are delivered in the order of the file, one at a time,
+  // on the thread which called `ReadCsvRecordsInParallel()`.
+  //
+  // If `false`, records of different ranges may be delivered out of order and
+  // concurrently from background threads, which avoids waiting for slower
+  // ranges. Records of a single range are still delivered in order. Record
+  // indices allow to restore the order if needed.
+  //
+  // Default: `true`.
+  CsvParallelReadingOptions& set_ordered(bool ordered) &
+      ABSL_ATTRIBUTE_LIFETIME_BOUND {
+    ordered_ = ordered;
+    return *this;
+  }
+  CsvParallelReadingOptions&& set_ordered(bool ordered) &&
+      ABSL_ATTRIBUTE_LIFETIME_BOUND {
+    return std::move(set_ordered(ordered));
+  }
+  bool ordered() const { return ordered_; }
+
+ private:
+  CsvReaderBase::Options csv_options_;
+  int parallelism_ = 8;
+  Position range_size_ = kDefaultRangeSize;
+  bool ordered_ = true;
+};
+
+// Reads all records of a CSV file, parsing byte ranges of the file
+// concurrently, and calls `callback` for each record together with its index.
+//
+// Record indices and line numbers reported in errors are the same as with
+// `CsvReader`: the record count does not include the header, and lines are
+// counted from the beginning of `src`.
+//
+// `src` should support random access, so that byte ranges can be read by
+// independent `Reader`s (`Reader::NewReader()` or its emulation by
+// `ReaderFactory`). Otherwise reading falls back to `CsvReader` on the calling
+// thread.
+//
+// Boundaries between ranges are resolved speculatively: a range is assumed to
+// begin after the first line terminator following its nominal start, and the
+// assumption is verified when the previous range is parsed. If a quoted field
+// spanned the boundary, the range is parsed again from the actual record
+// boundary, so the result is always the same as of sequential reading, but
+// files with many multi-line fields gain less from parallelism.
+//
+// If `callback` returns a failed status, reading stops and this status is
+// returned.
+//
+// `ReadCsvRecordsInParallel()` reads from the current position of `src` and
+// leaves it at the position after the last record read.
+//
+// The overload with `CsvRecord` requires the header to be requested or
+// assumed, i.e. `options.csv_options().required_header() != absl::nullopt ||
+//                   options.csv_options().assumed_header() != absl::nullopt`.
+//
+// Return values:
+//  * `absl::OkStatus()` - success, all records were delivered
+//  * other              - failure of reading or a status returned by
+//                         `callback`
+absl::Status ReadCsvRecordsInParallel(
+    Reader& src,
+    absl::FunctionRef<absl::Status(uint64_t record_index,
+                                   std::vector<std::string>& record)>
+        callback,
+    CsvParallelReadingOptions options = CsvParallelReadingOptions());
+absl::Status ReadCsvRecordsInParallel(
+    Reader& src,
+    absl::FunctionRef<absl::Status(uint64_t record_index, CsvRecord& record)>
+        callback,
+    CsvParallelReadingOptions options = CsvParallelReadingOptions());
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_CSV_CSV_PARALLEL_READING_H_
@@ -598,6 +598,13 @@ inline bool ReadStandaloneRecord(CsvReaderBase& csv_reader,
   return csv_reader.ReadRecordInternal(record);
 }
 
+void ResumeAt(CsvReaderBase& csv_reader, uint64_t record_index,
+              int64_t line_number) {
+  csv_reader.record_index_ = record_index;
+  csv_reader.last_line_number_ = line_number;
+  csv_reader.line_number_ = line_number;
+}
+
 }  // namespace csv_internal
 
 bool CsvReaderBase::ReadRecord(std::vector<std::string>& record) {
@@ -48,6 +48,12 @@ namespace csv_internal {
 bool ReadStandaloneRecord(CsvReaderBase& csv_reader,
                           std::vector<std::string>& record);
 
+// Makes a `CsvReader` which starts reading at a record boundary in the middle
+// of a file report record indices and line numbers relative to the beginning of
+// the file.
+void ResumeAt(CsvReaderBase& csv_reader, uint64_t record_index,
+              int64_t line_number);
+
 }  // namespace csv_internal
 
 // Template parameter independent part of `CsvReader`.
@@ -468,6 +474,9 @@ class CsvReaderBase : public Object {
  private:
   friend bool csv_internal::ReadStandaloneRecord(
       CsvReaderBase& csv_reader, std::vector<std::string>& record);
+  friend void csv_internal::ResumeAt(CsvReaderBase& csv_reader,
+                                     uint64_t record_index,
+                                     int64_t line_number);
 
   enum class CharClass : uint8_t {
     kOther,
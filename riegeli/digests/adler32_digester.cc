@@ -19,6 +19,7 @@
 #include "absl/base/optimization.h"
 #include "absl/strings/string_view.h"
 #include "riegeli/base/arithmetic.h"
+#include "riegeli/base/types.h"
 #include "zconf.h"
 #include "zlib.h"
 
@@ -39,4 +40,18 @@ void Adler32Digester::Write(absl::string_view src) {
       IntCast<z_size_t>(src.size())));
 }
 
+void Adler32Digester::Concat(const Adler32Digester& that, Position length) {
+#ifdef Z_LARGE64
+  adler_ = IntCast<uint32_t>(adler32_combine64(IntCast<uLong>(adler_),
+                                               IntCast<uLong>(that.adler_),
+                                               IntCast<z_off64_t>(length)));
+#else
+  // `z_off_t` can be 32-bit. `adler32_combine()` depends only on `length`
+  // modulo 65521, which fits.
+  adler_ = IntCast<uint32_t>(
+      adler32_combine(IntCast<uLong>(adler_), IntCast<uLong>(that.adler_),
+                      IntCast<z_off_t>(length % 65521)));
+#endif
+}
+
 }  // namespace riegeli
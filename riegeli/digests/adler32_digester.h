@@ -18,6 +18,7 @@
 #include <stdint.h>
 
 #include "absl/strings/string_view.h"
+#include "riegeli/base/types.h"
 
 namespace riegeli {
 
@@ -35,6 +36,15 @@ class Adler32Digester {
   void Write(absl::string_view src);
   uint32_t Digest() { return adler_; }
 
+  // Returns a digester for data following data digested by `*this`, which can
+  // be digested independently and then appended with `Concat()`. Used by
+  // `ParallelDigest()`.
+  Adler32Digester NewRangeDigester() const { return Adler32Digester(); }
+
+  // Appends data digested by `that`, which was returned by `NewRangeDigester()`
+  // and then digested `length` bytes, as if they were digested by `*this`.
+  void Concat(const Adler32Digester& that, Position length);
+
  private:
   uint32_t adler_;
 };
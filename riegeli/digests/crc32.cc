@@ -0,0 +1,280 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/digests/crc32.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "absl/strings/string_view.h"
+#include "riegeli/base/types.h"
+#include "riegeli/endian/endian_reading.h"
+
+#if defined(__x86_64__) && defined(__PCLMUL__) && defined(__SSE4_1__)
+// PCLMULQDQ is enabled at compile time.
+#define RIEGELI_INTERNAL_CRC32_PCLMUL 1
+#define RIEGELI_INTERNAL_CRC32_PCLMUL_TARGET
+#elif defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+// PCLMULQDQ is detected at runtime.
+#define RIEGELI_INTERNAL_CRC32_PCLMUL 1
+#define RIEGELI_INTERNAL_CRC32_PCLMUL_DISPATCH 1
+#define RIEGELI_INTERNAL_CRC32_PCLMUL_TARGET \
+  __attribute__((target("pclmul,sse4.1")))
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+// CRC32 instructions are enabled at compile time.
+#define RIEGELI_INTERNAL_CRC32_ARM 1
+#endif
+
+#if RIEGELI_INTERNAL_CRC32_PCLMUL
+#include <immintrin.h>
+#if RIEGELI_INTERNAL_CRC32_PCLMUL_DISPATCH
+#include <cpuid.h>
+#endif
+#elif RIEGELI_INTERNAL_CRC32_ARM
+#include <arm_acle.h>
+#endif
+
+namespace riegeli {
+
+namespace {
+
+// The polynomial in the reflected representation, without the x^32 term.
+constexpr uint32_t kPolynomial = 0xedb88320;
+
+// `slices[k][byte]` is the CRC32 register after processing `byte` followed by
+// `k` zero bytes, starting from 0.
+struct Crc32Tables {
+  uint32_t slices[8][256];
+};
+
+constexpr Crc32Tables MakeCrc32Tables() {
+  Crc32Tables tables{};
+  for (uint32_t byte = 0; byte < 256; ++byte) {
+    uint32_t crc = byte;
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc >> 1) ^ ((crc & 1) != 0 ? kPolynomial : 0);
+    }
+    tables.slices[0][byte] = crc;
+  }
+  for (size_t k = 1; k < 8; ++k) {
+    for (uint32_t byte = 0; byte < 256; ++byte) {
+      const uint32_t previous = tables.slices[k - 1][byte];
+      tables.slices[k][byte] =
+          (previous >> 8) ^ tables.slices[0][previous & 0xff];
+    }
+  }
+  return tables;
+}
+
+constexpr Crc32Tables kCrc32Tables = MakeCrc32Tables();
+
+// The functions below update the CRC32 register, i.e. the CRC32 without its
+// initial and final inversion.
+
+inline uint32_t UpdateWithTables(uint32_t crc, const char* src,
+                                 size_t length) {
+  const auto& slices = kCrc32Tables.slices;
+  while (length >= 8) {
+    const uint32_t low = ReadLittleEndian32(src) ^ crc;
+    const uint32_t high = ReadLittleEndian32(src + 4);
+    crc = slices[7][low & 0xff] ^ slices[6][(low >> 8) & 0xff] ^
+          slices[5][(low >> 16) & 0xff] ^ slices[4][low >> 24] ^
+          slices[3][high & 0xff] ^ slices[2][(high >> 8) & 0xff] ^
+          slices[1][(high >> 16) & 0xff] ^ slices[0][high >> 24];
+    src += 8;
+    length -= 8;
+  }
+  while (length > 0) {
+    crc = (crc >> 8) ^ slices[0][(crc ^ static_cast<uint8_t>(*src)) & 0xff];
+    ++src;
+    --length;
+  }
+  return crc;
+}
+
+#if RIEGELI_INTERNAL_CRC32_PCLMUL
+
+// Folding with carry-less multiplication, as described in "Fast CRC
+// Computation for Generic Polynomials Using PCLMULQDQ Instruction" by Intel.
+//
+// Constants are x^n mod P for various n, bit-reflected and shifted left by 1,
+// and the Barrett reduction constant floor(x^64 / P).
+
+RIEGELI_INTERNAL_CRC32_PCLMUL_TARGET inline __m128i Fold(__m128i data,
+                                                         __m128i constants,
+                                                         __m128i next) {
+  return _mm_xor_si128(
+      _mm_xor_si128(_mm_clmulepi64_si128(data, constants, 0x00),
+                    _mm_clmulepi64_si128(data, constants, 0x11)),
+      next);
+}
+
+RIEGELI_INTERNAL_CRC32_PCLMUL_TARGET inline __m128i Load(const char* src) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+}
+
+// Precondition: `length >= 64`
+RIEGELI_INTERNAL_CRC32_PCLMUL_TARGET uint32_t
+UpdateWithPclmul(uint32_t crc, const char* src, size_t length) {
+  // Folding across 4 blocks of 16 bytes: x^(4*128+32) and x^(4*128-32).
+  const __m128i fold_by_4 = _mm_set_epi64x(0x1c6e41596, 0x154442bd4);
+  // Folding across 1 block of 16 bytes: x^(128+32) and x^(128-32).
+  const __m128i fold_by_1 = _mm_set_epi64x(0x0ccaa009e, 0x1751997d0);
+  // Folding 64 bits to 32 bits: x^64.
+  const __m128i fold_64 = _mm_set_epi64x(0, 0x163cd6124);
+  // Barrett reduction: P and floor(x^64 / P).
+  const __m128i barrett = _mm_set_epi64x(0x1f7011641, 0x1db710641);
+  const __m128i low_32_bits = _mm_set_epi32(0, 0, 0, -1);
+
+  __m128i x0 =
+      _mm_xor_si128(Load(src), _mm_cvtsi32_si128(static_cast<int>(crc)));
+  __m128i x1 = Load(src + 16);
+  __m128i x2 = Load(src + 32);
+  __m128i x3 = Load(src + 48);
+  src += 64;
+  length -= 64;
+  while (length >= 64) {
+    x0 = Fold(x0, fold_by_4, Load(src));
+    x1 = Fold(x1, fold_by_4, Load(src + 16));
+    x2 = Fold(x2, fold_by_4, Load(src + 32));
+    x3 = Fold(x3, fold_by_4, Load(src + 48));
+    src += 64;
+    length -= 64;
+  }
+  x0 = Fold(x0, fold_by_1, x1);
+  x0 = Fold(x0, fold_by_1, x2);
+  x0 = Fold(x0, fold_by_1, x3);
+  while (length >= 16) {
+    x0 = Fold(x0, fold_by_1, Load(src));
+    src += 16;
+    length -= 16;
+  }
+
+  // Fold 128 bits to 64 bits.
+  x0 = _mm_xor_si128(_mm_srli_si128(x0, 8),
+                     _mm_clmulepi64_si128(x0, fold_by_1, 0x10));
+  // Fold 64 bits to 32 bits.
+  x0 = _mm_xor_si128(
+      _mm_srli_si128(x0, 4),
+      _mm_clmulepi64_si128(_mm_and_si128(x0, low_32_bits), fold_64, 0x00));
+  // Reduce 64 bits to 32 bits.
+  __m128i reduced = _mm_clmulepi64_si128(_mm_and_si128(x0, low_32_bits),
+                                         barrett, 0x10);
+  reduced = _mm_clmulepi64_si128(_mm_and_si128(reduced, low_32_bits), barrett,
+                                 0x00);
+  crc =
+      static_cast<uint32_t>(_mm_extract_epi32(_mm_xor_si128(x0, reduced), 1));
+
+  return UpdateWithTables(crc, src, length);
+}
+
+#if RIEGELI_INTERNAL_CRC32_PCLMUL_DISPATCH
+
+bool CpuSupportsPclmul() {
+  unsigned eax, ebx, ecx, edx;
+  return __get_cpuid(1, &eax, &ebx, &ecx, &edx) != 0 &&
+         (ecx & bit_PCLMUL) != 0 && (ecx & bit_SSE4_1) != 0;
+}
+
+#endif  // RIEGELI_INTERNAL_CRC32_PCLMUL_DISPATCH
+
+#elif RIEGELI_INTERNAL_CRC32_ARM
+
+inline uint32_t UpdateWithArmCrc32(uint32_t crc, const char* src,
+                                   size_t length) {
+  while (length >= 8) {
+    crc = __crc32d(crc, ReadLittleEndian64(src));
+    src += 8;
+    length -= 8;
+  }
+  if (length >= 4) {
+    crc = __crc32w(crc, ReadLittleEndian32(src));
+    src += 4;
+    length -= 4;
+  }
+  if (length >= 2) {
+    crc = __crc32h(crc, ReadLittleEndian16(src));
+    src += 2;
+    length -= 2;
+  }
+  if (length > 0) crc = __crc32b(crc, static_cast<uint8_t>(*src));
+  return crc;
+}
+
+#endif
+
+inline uint32_t Update(uint32_t crc, const char* src, size_t length) {
+#if RIEGELI_INTERNAL_CRC32_PCLMUL
+  // Below 64 bytes folding does not pay off.
+  if (length < 64) return UpdateWithTables(crc, src, length);
+#if RIEGELI_INTERNAL_CRC32_PCLMUL_DISPATCH
+  static const bool kCpuSupportsPclmul = CpuSupportsPclmul();
+  if (!kCpuSupportsPclmul) return UpdateWithTables(crc, src, length);
+#endif
+  return UpdateWithPclmul(crc, src, length);
+#elif RIEGELI_INTERNAL_CRC32_ARM
+  return UpdateWithArmCrc32(crc, src, length);
+#else
+  return UpdateWithTables(crc, src, length);
+#endif
+}
+
+// Returns a * b mod P, in the reflected representation.
+constexpr uint32_t MultiplyModPolynomial(uint32_t a, uint32_t b) {
+  uint32_t product = 0;
+  for (uint32_t mask = uint32_t{1} << 31; mask != 0; mask >>= 1) {
+    if ((a & mask) != 0) product ^= b;
+    b = (b >> 1) ^ ((b & 1) != 0 ? kPolynomial : 0);
+  }
+  return product;
+}
+
+// `powers[k]` is x^(2^k) mod P, in the reflected representation.
+//
+// The multiplicative order of x modulo P divides 2^32 - 1, hence
+// x^(2^(k+32)) = x^(2^k) mod P.
+struct PowersOfX {
+  uint32_t powers[32];
+};
+
+constexpr PowersOfX MakePowersOfX() {
+  PowersOfX powers_of_x{};
+  uint32_t power = uint32_t{1} << 30;  // x^1
+  for (size_t k = 0; k < 32; ++k) {
+    powers_of_x.powers[k] = power;
+    power = MultiplyModPolynomial(power, power);
+  }
+  return powers_of_x;
+}
+
+constexpr PowersOfX kPowersOfX = MakePowersOfX();
+
+}  // namespace
+
+uint32_t ExtendCrc32(uint32_t crc, absl::string_view src) {
+  return ~Update(~crc, src.data(), src.size());
+}
+
+uint32_t ConcatCrc32(uint32_t crc1, uint32_t crc2, Position length2) {
+  // Multiply `crc1` by x^(8 * length2).
+  uint32_t power = uint32_t{1} << 31;  // x^0
+  for (size_t k = 3; length2 != 0; length2 >>= 1, ++k) {
+    if ((length2 & 1) != 0) {
+      power = MultiplyModPolynomial(kPowersOfX.powers[k % 32], power);
+    }
+  }
+  return MultiplyModPolynomial(power, crc1) ^ crc2;
+}
+
+}  // namespace riegeli
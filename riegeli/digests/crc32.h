@@ -0,0 +1,44 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_DIGESTS_CRC32_H_
+#define RIEGELI_DIGESTS_CRC32_H_
+
+#include <stdint.h>
+
+#include "absl/strings/string_view.h"
+#include "riegeli/base/types.h"
+
+namespace riegeli {
+
+// CRC32 with the polynomial used e.g. by gzip, zip, and png, computed without
+// depending on the CRC32 implementation of the linked zlib.
+//
+// On x86-64 this uses carry-less multiplication (PCLMULQDQ) if the CPU
+// supports it, detected at runtime unless enabled at compile time. On AArch64
+// this uses CRC32 instructions if enabled at compile time. Otherwise this uses
+// tables processing 8 bytes at a time.
+
+// Returns the CRC32 of data with CRC32 `crc` followed by `src`.
+//
+// The CRC32 of empty data is 0.
+uint32_t ExtendCrc32(uint32_t crc, absl::string_view src);
+
+// Returns the CRC32 of data with CRC32 `crc1` followed by data with CRC32
+// `crc2` and length `length2`.
+uint32_t ConcatCrc32(uint32_t crc1, uint32_t crc2, Position length2);
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_DIGESTS_CRC32_H_
@@ -16,27 +16,18 @@
 
 #include <stdint.h>
 
-#include "absl/base/optimization.h"
 #include "absl/strings/string_view.h"
-#include "riegeli/base/arithmetic.h"
-#include "zconf.h"
-#include "zlib.h"
+#include "riegeli/base/types.h"
+#include "riegeli/digests/crc32.h"
 
 namespace riegeli {
 
-Crc32Digester::Crc32Digester(uint32_t seed) : crc_(seed) {
-  // This checks CPU features.
-  crc32_z(0, nullptr, 0);
+void Crc32Digester::Write(absl::string_view src) {
+  crc_ = ExtendCrc32(crc_, src);
 }
 
-void Crc32Digester::Write(absl::string_view src) {
-  if (ABSL_PREDICT_FALSE(src.empty())) {
-    // `crc32_z(state, nullptr, 0)` exceptionally returns 0, not `state`.
-    return;
-  }
-  crc_ = IntCast<uint32_t>(crc32_z(IntCast<uLong>(crc_),
-                                   reinterpret_cast<const Bytef*>(src.data()),
-                                   IntCast<z_size_t>(src.size())));
+void Crc32Digester::Concat(const Crc32Digester& that, Position length) {
+  crc_ = ConcatCrc32(crc_, that.crc_, length);
 }
 
 }  // namespace riegeli
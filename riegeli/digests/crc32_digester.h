@@ -18,6 +18,7 @@
 #include <stdint.h>
 
 #include "absl/strings/string_view.h"
+#include "riegeli/base/types.h"
 
 namespace riegeli {
 
@@ -29,11 +30,14 @@ namespace riegeli {
 //
 // This polynomial is used e.g. by gzip, zip, and png:
 // https://en.wikipedia.org/wiki/Cyclic_redundancy_check#Polynomial_representations_of_cyclic_redundancy_checks
+//
+// This uses `ExtendCrc32()`, independent of the CRC32 implementation of the
+// linked zlib.
 class Crc32Digester {
  public:
   Crc32Digester() : Crc32Digester(0) {}
 
-  explicit Crc32Digester(uint32_t seed);
+  explicit Crc32Digester(uint32_t seed) : crc_(seed) {}
 
   Crc32Digester(const Crc32Digester& that) = default;
   Crc32Digester& operator=(const Crc32Digester& that) = default;
@@ -41,6 +45,15 @@ class Crc32Digester {
   void Write(absl::string_view src);
   uint32_t Digest() { return crc_; }
 
+  // Returns a digester for data following data digested by `*this`, which can
+  // be digested independently and then appended with `Concat()`. Used by
+  // `ParallelDigest()`.
+  Crc32Digester NewRangeDigester() const { return Crc32Digester(); }
+
+  // Appends data digested by `that`, which was returned by `NewRangeDigester()`
+  // and then digested `length` bytes, as if they were digested by `*this`.
+  void Concat(const Crc32Digester& that, Position length);
+
  private:
   uint32_t crc_;
 };
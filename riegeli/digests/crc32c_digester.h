@@ -28,6 +28,7 @@
 #include "absl/types/optional.h"
 #include "riegeli/base/arithmetic.h"
 #include "riegeli/base/byte_fill.h"
+#include "riegeli/base/types.h"
 
 namespace riegeli {
 
@@ -54,6 +55,19 @@ class Crc32cDigester {
   void Write(ByteFill src);
   uint32_t Digest() { return crc_; }
 
+  // Returns a digester for data following data digested by `*this`, which can
+  // be digested independently and then appended with `Concat()`. Used by
+  // `ParallelDigest()`.
+  Crc32cDigester NewRangeDigester() const { return Crc32cDigester(); }
+
+  // Appends data digested by `that`, which was returned by `NewRangeDigester()`
+  // and then digested `length` bytes, as if they were digested by `*this`.
+  void Concat(const Crc32cDigester& that, Position length) {
+    crc_ = static_cast<uint32_t>(
+        absl::ConcatCrc32c(absl::crc32c_t{crc_}, absl::crc32c_t{that.crc_},
+                           IntCast<size_t>(length)));
+  }
+
  private:
   uint32_t crc_;
 };
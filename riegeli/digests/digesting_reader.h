@@ -107,6 +107,9 @@ class DigestingReaderBase : public Reader {
 // `DigesterHandle<uint32_t>` (not owned), `Crc32cDigester` (owned),
 // `AnyDigester<uint32_t>` (maybe owned).
 //
+// Several digests can be computed in a single pass with `MultiDigester`, e.g.
+// `MultiDigester<Crc32cDigester, Sha256Digester>`.
+//
 // The `Src` template parameter specifies the type of the object providing and
 // possibly owning the original `Reader`. `Src` must support
 // `Dependency<Reader*, Src>`, e.g. `Reader*` (not owned, default),
@@ -116,6 +116,9 @@ class DigestingWriterBase : public Writer {
 // `DigesterHandle<uint32_t>` (not owned), `Crc32cDigester` (owned),
 // `AnyDigester<uint32_t>>` (maybe owned).
 //
+// Several digests can be computed in a single pass with `MultiDigester`, e.g.
+// `MultiDigester<Crc32cDigester, Sha256Digester>`.
+//
 // The `Dest` template parameter specifies the type of the object providing and
 // possibly owning the original `Writer`. `Dest` must support
 // `Dependency<Writer*, Dest>`, e.g. `Writer*` (not owned, default),
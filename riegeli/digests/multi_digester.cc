@@ -0,0 +1,67 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/digests/multi_digester.h"
+
+#include <stddef.h>
+
+#include <atomic>
+
+#include "absl/base/optimization.h"
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "absl/types/span.h"
+#include "riegeli/base/parallelism.h"
+#include "riegeli/base/types.h"
+#include "riegeli/digests/digester_handle.h"
+
+namespace riegeli {
+
+// Before C++17 if a constexpr static data member is ODR-used, its definition at
+// namespace scope is required. Since C++17 these definitions are deprecated:
+// http://en.cppreference.com/w/cpp/language/static
+#if !__cpp_inline_variables
+constexpr size_t MultiDigesterBase::Options::kMinParallelSize;
+#endif
+
+bool MultiDigesterBase::WriteToAll(
+    absl::Span<const DigesterBaseHandle> digesters, Position size,
+    absl::FunctionRef<bool(DigesterBaseHandle)> write) const {
+  if (!parallel_ || size < Options::kMinParallelSize ||
+      digesters.size() < 2) {
+    bool ok = true;
+    for (const DigesterBaseHandle digester : digesters) {
+      if (ABSL_PREDICT_FALSE(!write(digester))) ok = false;
+    }
+    return ok;
+  }
+  std::atomic<bool> ok(true);
+  internal::RunInParallel(digesters.size(), [&](size_t index) {
+    if (ABSL_PREDICT_FALSE(!write(digesters[index]))) {
+      ok.store(false, std::memory_order_relaxed);
+    }
+  });
+  return ok.load(std::memory_order_relaxed);
+}
+
+absl::Status MultiDigesterBase::StatusOfAll(
+    absl::Span<const DigesterBaseHandle> digesters) {
+  for (const DigesterBaseHandle digester : digesters) {
+    absl::Status status = digester.status();
+    if (ABSL_PREDICT_FALSE(!status.ok())) return status;
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace riegeli
@@ -0,0 +1,217 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_DIGESTS_MULTI_DIGESTER_H_
+#define RIEGELI_DIGESTS_MULTI_DIGESTER_H_
+
+#include <stddef.h>
+
+#include <array>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "absl/base/attributes.h"
+#include "absl/functional/function_ref.h"
+#include "absl/meta/type_traits.h"
+#include "absl/status/status.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "riegeli/base/byte_fill.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/base/dependency.h"
+#include "riegeli/base/initializer.h"
+#include "riegeli/base/maker.h"
+#include "riegeli/base/types.h"
+#include "riegeli/digests/digester_handle.h"
+
+namespace riegeli {
+
+// Template parameter independent part of `MultiDigester`.
+class MultiDigesterBase {
+ public:
+  class Options {
+   public:
+    Options() noexcept {}
+
+    // If `true`, fragments of at least `kMinParallelSize` bytes are digested
+    // by all digesters concurrently: by one digester in the current thread,
+    // and by the others in background threads. This pays off when more than
+    // one digester is expensive, e.g. SHA-256 together with SHA-512.
+    //
+    // If `false`, each fragment is digested by all digesters one after
+    // another, while it is hot in the cache.
+    //
+    // Default: `false`.
+    static constexpr size_t kMinParallelSize = size_t{64} << 10;
+    Options& set_parallel(bool parallel) & ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      parallel_ = parallel;
+      return *this;
+    }
+    Options&& set_parallel(bool parallel) && ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      return std::move(set_parallel(parallel));
+    }
+    bool parallel() const { return parallel_; }
+
+   private:
+    bool parallel_ = false;
+  };
+
+ protected:
+  explicit MultiDigesterBase(Options options)
+      : parallel_(options.parallel()) {}
+
+  MultiDigesterBase(const MultiDigesterBase& that) = default;
+  MultiDigesterBase& operator=(const MultiDigesterBase& that) = default;
+
+  // Calls `write(digester)` for each of `digesters`, concurrently if
+  // `parallel()` and `size` is large enough. Returns `true` if all calls
+  // returned `true`.
+  bool WriteToAll(absl::Span<const DigesterBaseHandle> digesters,
+                  Position size,
+                  absl::FunctionRef<bool(DigesterBaseHandle)> write) const;
+
+  // Returns the first failure status of `digesters`, or `absl::OkStatus()`.
+  static absl::Status StatusOfAll(
+      absl::Span<const DigesterBaseHandle> digesters);
+
+ private:
+  bool parallel_;
+};
+
+// A digester which feeds the same data to several digesters, and returns all
+// their digests together as a `std::tuple`.
+//
+// This computes several digests in a single pass over the data, e.g. CRC32C
+// for transport and SHA-256 for content addressing with a single
+// `DigestingReader` or `DigestingWriter`, instead of stacking them.
+//
+// Each of `Digesters` must support `Dependency<DigesterBaseHandle, Digester>`,
+// and must have a non-`void` digest type. Calls to `SetWriteSizeHint()` and
+// `Close()` are propagated to owned digesters.
+template <typename... Digesters>
+class MultiDigester : public MultiDigesterBase {
+ public:
+  static_assert(sizeof...(Digesters) > 0,
+                "MultiDigester requires at least one digester");
+
+  // Default-constructs all `Digesters`.
+  template <
+      typename DependentDummy = void,
+      std::enable_if_t<
+          absl::conjunction<std::is_void<DependentDummy>,
+                            std::is_default_constructible<Digesters>...>::value,
+          int> = 0>
+  explicit MultiDigester(Options options = Options())
+      : MultiDigester(riegeli::Maker<Digesters>()..., std::move(options)) {}
+
+  // Will digest with `digesters...`.
+  explicit MultiDigester(Initializer<Digesters>... digesters,
+                         Options options = Options())
+      : MultiDigesterBase(std::move(options)),
+        digesters_(std::move(digesters)...) {}
+
+  MultiDigester(const MultiDigester& that) = default;
+  MultiDigester& operator=(const MultiDigester& that) = default;
+
+  MultiDigester(MultiDigester&& that) = default;
+  MultiDigester& operator=(MultiDigester&& that) = default;
+
+  void SetWriteSizeHint(absl::optional<Position> write_size_hint) {
+    const std::array<DigesterBaseHandle, sizeof...(Digesters)> digesters =
+        OwnedDigesters();
+    for (DigesterBaseHandle digester : digesters) {
+      if (digester != nullptr) digester.SetWriteSizeHint(write_size_hint);
+    }
+  }
+
+  bool Write(absl::string_view src) {
+    return WriteToAll(AllDigesters(), src.size(),
+                      [&](DigesterBaseHandle digester) {
+                        return digester.Write(src);
+                      });
+  }
+  bool Write(const Chain& src) {
+    return WriteToAll(AllDigesters(), src.size(),
+                      [&](DigesterBaseHandle digester) {
+                        return digester.Write(src);
+                      });
+  }
+  bool Write(const absl::Cord& src) {
+    return WriteToAll(AllDigesters(), src.size(),
+                      [&](DigesterBaseHandle digester) {
+                        return digester.Write(src);
+                      });
+  }
+  bool Write(ByteFill src) {
+    return WriteToAll(AllDigesters(), src.size(),
+                      [&](DigesterBaseHandle digester) {
+                        return digester.Write(src);
+                      });
+  }
+
+  bool Close() {
+    const std::array<DigesterBaseHandle, sizeof...(Digesters)> digesters =
+        OwnedDigesters();
+    bool ok = true;
+    for (DigesterBaseHandle digester : digesters) {
+      if (digester != nullptr && !digester.Close()) ok = false;
+    }
+    return ok;
+  }
+
+  absl::Status status() const { return StatusOfAll(AllDigesters()); }
+
+  // Returns digests of all `Digesters`, in their order.
+  std::tuple<DigestOf<Digesters>...> Digest() {
+    return DigestImpl(std::index_sequence_for<Digesters...>());
+  }
+
+ private:
+  std::array<DigesterBaseHandle, sizeof...(Digesters)> AllDigesters() const {
+    return AllDigestersImpl(std::index_sequence_for<Digesters...>());
+  }
+  template <size_t... indices>
+  std::array<DigesterBaseHandle, sizeof...(Digesters)> AllDigestersImpl(
+      std::index_sequence<indices...>) const {
+    return {{DigesterBaseHandle(std::get<indices>(digesters_).get())...}};
+  }
+
+  // Returns digesters which are owned, with `nullptr` in place of the others.
+  std::array<DigesterBaseHandle, sizeof...(Digesters)> OwnedDigesters() const {
+    return OwnedDigestersImpl(std::index_sequence_for<Digesters...>());
+  }
+  template <size_t... indices>
+  std::array<DigesterBaseHandle, sizeof...(Digesters)> OwnedDigestersImpl(
+      std::index_sequence<indices...>) const {
+    return {{(std::get<indices>(digesters_).IsOwning()
+                  ? DigesterBaseHandle(std::get<indices>(digesters_).get())
+                  : DigesterBaseHandle())...}};
+  }
+
+  template <size_t... indices>
+  std::tuple<DigestOf<Digesters>...> DigestImpl(
+      std::index_sequence<indices...>) {
+    return std::tuple<DigestOf<Digesters>...>(
+        std::get<indices>(digesters_).get().Digest()...);
+  }
+
+  std::tuple<Dependency<DigesterBaseHandle, Digesters>...> digesters_;
+};
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_DIGESTS_MULTI_DIGESTER_H_
@@ -0,0 +1,122 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/digests/parallel_digest.h"
+
+#include <stddef.h>
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/arithmetic.h"
+#include "riegeli/base/parallelism.h"
+#include "riegeli/base/types.h"
+#include "riegeli/bytes/reader.h"
+
+namespace riegeli {
+namespace parallel_digest_internal {
+
+namespace {
+
+// Reads `length` bytes from `reader`, calling `write_range(range_index, ...)`
+// with consecutive fragments.
+absl::Status DigestRange(
+    Reader& reader, Position length, size_t range_index,
+    absl::FunctionRef<void(size_t, absl::string_view)> write_range) {
+  while (length > 0) {
+    if (reader.available() == 0 &&
+        ABSL_PREDICT_FALSE(
+            !reader.Pull(1, SaturatingIntCast<size_t>(length)))) {
+      if (ABSL_PREDICT_FALSE(!reader.ok())) return reader.status();
+      return reader.AnnotateStatus(
+          absl::DataLossError("Source ended before its size"));
+    }
+    const size_t fragment_length = UnsignedMin(reader.available(), length);
+    write_range(range_index,
+                absl::string_view(reader.cursor(), fragment_length));
+    reader.move_cursor(fragment_length);
+    length -= fragment_length;
+  }
+  if (ABSL_PREDICT_FALSE(!reader.Close())) return reader.status();
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+absl::Status DigestRanges(
+    Reader& src, Position range_size, int parallelism,
+    absl::FunctionRef<void(absl::string_view)> write,
+    absl::FunctionRef<void(size_t)> start_ranges,
+    absl::FunctionRef<void(size_t, absl::string_view)> write_range) {
+  if (parallelism <= 1 || !src.SupportsNewReader()) {
+    src.SetReadAllHint(true);
+    do {
+      if (src.available() > 0) {
+        write(absl::string_view(src.cursor(), src.available()));
+        src.move_cursor(src.available());
+      }
+    } while (src.Pull());
+    if (ABSL_PREDICT_FALSE(!src.ok())) return src.status();
+    return absl::OkStatus();
+  }
+
+  const Position begin_pos = src.pos();
+  const absl::optional<Position> size = src.Size();
+  if (ABSL_PREDICT_FALSE(size == absl::nullopt)) return src.status();
+  const Position length = SaturatingSub(*size, begin_pos);
+  const size_t num_ranges =
+      length == 0 ? size_t{0} : IntCast<size_t>((length - 1) / range_size + 1);
+  start_ranges(num_ranges);
+
+  std::vector<absl::Status> statuses(num_ranges);
+  std::atomic<size_t> next_range_index(0);
+  // `src.status()` must not be read while `src.NewReader()` can be called
+  // concurrently, so its failure is only recorded here.
+  std::atomic<bool> src_failed(false);
+  internal::RunInParallel(
+      UnsignedMin(IntCast<size_t>(parallelism), num_ranges), [&](size_t) {
+        for (;;) {
+          const size_t range_index =
+              next_range_index.fetch_add(1, std::memory_order_relaxed);
+          if (range_index >= num_ranges) return;
+          const Position range_begin = begin_pos + range_index * range_size;
+          const std::unique_ptr<Reader> reader = src.NewReader(range_begin);
+          if (ABSL_PREDICT_FALSE(reader == nullptr)) {
+            src_failed.store(true, std::memory_order_relaxed);
+            return;
+          }
+          statuses[range_index] = DigestRange(
+              *reader, UnsignedMin(range_size, *size - range_begin),
+              range_index, write_range);
+        }
+      });
+  if (ABSL_PREDICT_FALSE(src_failed.load(std::memory_order_relaxed))) {
+    return src.status();
+  }
+  for (absl::Status& status : statuses) {
+    if (ABSL_PREDICT_FALSE(!status.ok())) return std::move(status);
+  }
+  if (ABSL_PREDICT_FALSE(!src.Seek(*size))) return src.status();
+  return absl::OkStatus();
+}
+
+}  // namespace parallel_digest_internal
+}  // namespace riegeli
@@ -0,0 +1,228 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_DIGESTS_PARALLEL_DIGEST_H_
+#define RIEGELI_DIGESTS_PARALLEL_DIGEST_H_
+
+#include <stddef.h>
+
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/base/attributes.h"
+#include "absl/functional/function_ref.h"
+#include "absl/meta/type_traits.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "riegeli/base/assert.h"
+#include "riegeli/base/types.h"
+#include "riegeli/bytes/reader.h"
+
+namespace riegeli {
+
+class ParallelDigestOptions {
+ public:
+  ParallelDigestOptions() noexcept {}
+
+  // Maximum number of ranges digested concurrently. `parallelism() <= 1`
+  // digests sequentially in the current thread.
+  //
+  // Default: `std::thread::hardware_concurrency()`.
+  ParallelDigestOptions& set_parallelism(int parallelism) &
+      ABSL_ATTRIBUTE_LIFETIME_BOUND {
+    parallelism_ = parallelism;
+    return *this;
+  }
+  ParallelDigestOptions&& set_parallelism(int parallelism) &&
+      ABSL_ATTRIBUTE_LIFETIME_BOUND {
+    return std::move(set_parallelism(parallelism));
+  }
+  int parallelism() const { return parallelism_; }
+
+  // Length of a range digested by a single digester. It is rounded up to a
+  // multiple of `RangeAlignment()` of the digester, if the digester has it.
+  //
+  // Larger ranges reduce the overhead per range, smaller ranges balance the
+  // load between threads better.
+  //
+  // Default: `kDefaultRangeSize` (8M).
+  static constexpr Position kDefaultRangeSize = Position{8} << 20;
+  ParallelDigestOptions& set_range_size(Position range_size) &
+      ABSL_ATTRIBUTE_LIFETIME_BOUND {
+    RIEGELI_ASSERT_GT(range_size, 0u)
+        << "Failed precondition of ParallelDigestOptions::set_range_size(): "
+           "zero range size";
+    range_size_ = range_size;
+    return *this;
+  }
+  ParallelDigestOptions&& set_range_size(Position range_size) &&
+      ABSL_ATTRIBUTE_LIFETIME_BOUND {
+    return std::move(set_range_size(range_size));
+  }
+  Position range_size() const { return range_size_; }
+
+ private:
+  int parallelism_ = static_cast<int>(std::thread::hardware_concurrency());
+  Position range_size_ = kDefaultRangeSize;
+};
+
+// `SupportsParallelDigest<Digester>::value` is `true` if `Digester` can be
+// used with `ParallelDigest()`.
+
+template <typename T, typename Enable = void>
+struct SupportsParallelDigest : std::false_type {};
+
+template <typename T>
+struct SupportsParallelDigest<
+    T, absl::void_t<decltype(std::declval<T&>().Concat(
+                        std::declval<const T&>().NewRangeDigester(),
+                        std::declval<Position>())),
+                    decltype(std::declval<T&>().Write(
+                        std::declval<absl::string_view>())),
+                    decltype(std::declval<T&>().Digest())>>
+    : std::true_type {};
+
+// Digests data from the current position of `src` to its end with `digester`,
+// and returns the digest. On success `src` is positioned at its end.
+//
+// If `src.SupportsNewReader()`, data are split into ranges which are read by
+// `src.NewReader()` and digested concurrently by digesters returned by
+// `digester.NewRangeDigester()`, and then appended to `digester` with
+// `digester.Concat()`. Otherwise data are digested sequentially.
+//
+// `Digester` must support `Write(absl::string_view)` and `Digest()` like a
+// digester for `DigestingReader` (handles are not supported), and also:
+// ```
+//   // Returns a digester for data following data digested by `*this`, which
+//   // can be digested independently and then appended with `Concat()`.
+//   Digester NewRangeDigester() const;
+//
+//   // Appends data digested by `that`, which was returned by
+//   // `NewRangeDigester()` and then digested `length` bytes, as if they were
+//   // digested by `*this`.
+//   void Concat(Digester&& that, Position length);
+//
+//   // Optional. If present, ranges start at multiples of `RangeAlignment()`
+//   // relative to the initial position of `src`. If absent, 1 is assumed.
+//   Position RangeAlignment() const;
+// ```
+//
+// This is provided by `Crc32cDigester`, `Crc32Digester`, `Adler32Digester`,
+// and `TreeDigester`. Cryptographic hashes can be digested in parallel as
+// leaves of a `TreeDigester`, which defines a different digest.
+template <typename Digester,
+          std::enable_if_t<SupportsParallelDigest<Digester>::value, int> = 0>
+absl::StatusOr<
+    absl::remove_cvref_t<decltype(std::declval<Digester&>().Digest())>>
+ParallelDigest(Reader& src, Digester digester,
+               ParallelDigestOptions options = ParallelDigestOptions());
+
+// Like above, with a default-constructed `Digester`.
+template <typename Digester,
+          std::enable_if_t<SupportsParallelDigest<Digester>::value, int> = 0>
+absl::StatusOr<
+    absl::remove_cvref_t<decltype(std::declval<Digester&>().Digest())>>
+ParallelDigest(Reader& src,
+               ParallelDigestOptions options = ParallelDigestOptions());
+
+// Implementation details follow.
+
+namespace parallel_digest_internal {
+
+template <typename T, typename Enable = void>
+struct HasRangeAlignment : std::false_type {};
+
+template <typename T>
+struct HasRangeAlignment<
+    T, absl::void_t<decltype(std::declval<const T&>().RangeAlignment())>>
+    : std::true_type {};
+
+template <typename Digester,
+          std::enable_if_t<HasRangeAlignment<Digester>::value, int> = 0>
+inline Position RangeAlignment(const Digester& digester) {
+  return digester.RangeAlignment();
+}
+
+template <typename Digester,
+          std::enable_if_t<!HasRangeAlignment<Digester>::value, int> = 0>
+inline Position RangeAlignment(ABSL_ATTRIBUTE_UNUSED const Digester& digester) {
+  return 1;
+}
+
+// Reads data from the current position of `src` to its end.
+//
+// If data are digested sequentially, calls `write()` with consecutive
+// fragments.
+//
+// Otherwise calls `start_ranges()` with the number of ranges, and then
+// `write_range()` with consecutive fragments of each range, concurrently for
+// different ranges. Each range except the last one has `range_size` bytes.
+absl::Status DigestRanges(
+    Reader& src, Position range_size, int parallelism,
+    absl::FunctionRef<void(absl::string_view)> write,
+    absl::FunctionRef<void(size_t)> start_ranges,
+    absl::FunctionRef<void(size_t, absl::string_view)> write_range);
+
+}  // namespace parallel_digest_internal
+
+template <typename Digester,
+          std::enable_if_t<SupportsParallelDigest<Digester>::value, int>>
+absl::StatusOr<
+    absl::remove_cvref_t<decltype(std::declval<Digester&>().Digest())>>
+ParallelDigest(Reader& src, Digester digester, ParallelDigestOptions options) {
+  const Position alignment =
+      parallel_digest_internal::RangeAlignment(digester);
+  RIEGELI_ASSERT_GT(alignment, 0u)
+      << "Failed precondition of ParallelDigest(): zero range alignment";
+  const Position range_size =
+      (options.range_size() - 1) / alignment * alignment + alignment;
+  std::vector<Digester> range_digesters;
+  std::vector<Position> range_lengths;
+  if (absl::Status status = parallel_digest_internal::DigestRanges(
+          src, range_size, options.parallelism(),
+          [&](absl::string_view fragment) { digester.Write(fragment); },
+          [&](size_t num_ranges) {
+            range_digesters.reserve(num_ranges);
+            for (size_t i = 0; i < num_ranges; ++i) {
+              range_digesters.push_back(digester.NewRangeDigester());
+            }
+            range_lengths.assign(num_ranges, 0);
+          },
+          [&](size_t range_index, absl::string_view fragment) {
+            range_digesters[range_index].Write(fragment);
+            range_lengths[range_index] += fragment.size();
+          });
+      ABSL_PREDICT_FALSE(!status.ok())) {
+    return status;
+  }
+  for (size_t i = 0; i < range_digesters.size(); ++i) {
+    digester.Concat(std::move(range_digesters[i]), range_lengths[i]);
+  }
+  return digester.Digest();
+}
+
+template <typename Digester,
+          std::enable_if_t<SupportsParallelDigest<Digester>::value, int>>
+absl::StatusOr<
+    absl::remove_cvref_t<decltype(std::declval<Digester&>().Digest())>>
+ParallelDigest(Reader& src, ParallelDigestOptions options) {
+  return ParallelDigest(src, Digester(), std::move(options));
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_DIGESTS_PARALLEL_DIGEST_H_
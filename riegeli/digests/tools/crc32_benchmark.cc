@@ -0,0 +1,121 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures throughput of `ExtendCrc32()` compared to `crc32_z()` of the linked
+// zlib, for aligned and unaligned inputs of various sizes.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "riegeli/base/arithmetic.h"
+#include "riegeli/base/assert.h"
+#include "riegeli/bytes/std_io.h"
+#include "riegeli/digests/crc32.h"
+#include "zconf.h"
+#include "zlib.h"
+
+ABSL_FLAG(std::vector<std::string>, sizes,
+          std::vector<std::string>({"16", "64", "256", "4096", "65536",
+                                    "1048576", "16777216"}),
+          "Input sizes in bytes to benchmark");
+ABSL_FLAG(uint64_t, bytes_per_measurement, uint64_t{1} << 30,
+          "Number of bytes to digest for each measurement");
+ABSL_FLAG(int32_t, repetitions, 3, "Number of times to repeat each benchmark");
+
+namespace {
+
+// Returns the median number of bytes per second of digesting `data` with
+// `crc_function`.
+template <typename CrcFunction>
+double MeasureBytesPerSecond(absl::string_view data, uint64_t iterations,
+                             int repetitions, CrcFunction crc_function) {
+  std::vector<double> samples;
+  uint32_t crc = 0;
+  for (int i = 0; i < repetitions; ++i) {
+    const absl::Time start = absl::Now();
+    for (uint64_t j = 0; j < iterations; ++j) crc = crc_function(crc, data);
+    samples.push_back(static_cast<double>(data.size() * iterations) /
+                      absl::ToDoubleSeconds(absl::Now() - start));
+  }
+  // Keep the computation from being optimized away.
+  RIEGELI_CHECK_NE(crc, 0x12345678u) << "Unlucky CRC32";
+  std::nth_element(samples.begin(), samples.begin() + samples.size() / 2,
+                   samples.end());
+  return samples[samples.size() / 2];
+}
+
+uint32_t ZlibCrc32(uint32_t crc, absl::string_view src) {
+  return riegeli::IntCast<uint32_t>(
+      crc32_z(crc, reinterpret_cast<const Bytef*>(src.data()), src.size()));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  const uint64_t bytes_per_measurement =
+      absl::GetFlag(FLAGS_bytes_per_measurement);
+  const int repetitions = std::max(absl::GetFlag(FLAGS_repetitions), 1);
+
+  std::vector<size_t> sizes;
+  size_t max_size = 0;
+  for (const std::string& size_str : absl::GetFlag(FLAGS_sizes)) {
+    size_t size;
+    RIEGELI_CHECK(absl::SimpleAtoi(size_str, &size) && size > 0)
+        << "Invalid size: " << size_str;
+    sizes.push_back(size);
+    max_size = std::max(max_size, size);
+  }
+  // One more byte for unaligned inputs.
+  std::string buffer(max_size + 1, '\0');
+  uint64_t random = 1;
+  for (char& byte : buffer) {
+    random = random * 6364136223846793005 + 1442695040888963407;
+    byte = static_cast<char>(random >> 56);
+  }
+
+  riegeli::StdOut std_out;
+  std_out.Write(absl::StrFormat("%10s %9s %14s %14s %8s\n", "size",
+                                "alignment", "ExtendCrc32", "crc32_z",
+                                "speedup"));
+  for (const size_t size : sizes) {
+    const uint64_t iterations =
+        std::max(bytes_per_measurement / size, uint64_t{1});
+    for (const size_t offset : {size_t{0}, size_t{1}}) {
+      const absl::string_view data(buffer.data() + offset, size);
+      RIEGELI_CHECK_EQ(riegeli::ExtendCrc32(0, data), ZlibCrc32(0, data))
+          << "ExtendCrc32() differs from crc32_z()";
+      const double riegeli_speed = MeasureBytesPerSecond(
+          data, iterations, repetitions, riegeli::ExtendCrc32);
+      const double zlib_speed =
+          MeasureBytesPerSecond(data, iterations, repetitions, ZlibCrc32);
+      std_out.Write(absl::StrFormat(
+          "%10u %9s %9.2f GB/s %9.2f GB/s %7.2fx\n", size,
+          offset == 0 ? "aligned" : "unaligned", riegeli_speed * 1e-9,
+          zlib_speed * 1e-9, riegeli_speed / zlib_speed));
+    }
+  }
+  std_out.Close();
+}
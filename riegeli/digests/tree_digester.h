@@ -0,0 +1,204 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_DIGESTS_TREE_DIGESTER_H_
+#define RIEGELI_DIGESTS_TREE_DIGESTER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "absl/meta/type_traits.h"
+#include "absl/strings/string_view.h"
+#include "riegeli/base/arithmetic.h"
+#include "riegeli/base/assert.h"
+#include "riegeli/base/types.h"
+
+namespace riegeli {
+
+namespace tree_digester_internal {
+
+// Appends the representation of a digest of a leaf to `dest`: integers and
+// arrays of integers in little endian, arrays of `char` as is.
+
+template <typename T, std::enable_if_t<std::is_unsigned<T>::value, int> = 0>
+inline void AppendDigest(T digest, std::string& dest) {
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    dest.push_back(
+        static_cast<char>(static_cast<uint64_t>(digest) >> (i * 8)));
+  }
+}
+
+template <size_t size>
+inline void AppendDigest(const std::array<char, size>& digest,
+                         std::string& dest) {
+  dest.append(digest.data(), size);
+}
+
+template <typename T, size_t size,
+          std::enable_if_t<std::is_unsigned<T>::value, int> = 0>
+inline void AppendDigest(const std::array<T, size>& digest, std::string& dest) {
+  for (const T element : digest) AppendDigest(element, dest);
+}
+
+}  // namespace tree_digester_internal
+
+// A digester computing a hash tree (Merkle tree) of depth 2 with another
+// digester, for `DigestingReader`, `DigestingWriter`, and `ParallelDigest()`.
+//
+// Data are split into leaves of `leaf_size()` bytes, except that the last leaf
+// can be shorter. The digest is the digest of the concatenation of digests of
+// leaves followed by the total length as 8 bytes in little endian. Digests of
+// leaves are represented as bytes: integers and arrays of integers in little
+// endian, arrays of `char` as is.
+//
+// Each leaf and the root are digested by a copy of the `leaf_digester` given
+// to the constructor, so `LeafDigester` must be copyable.
+//
+// Leaves are independent of each other, so `ParallelDigest()` digests them
+// concurrently, e.g. with `TreeDigester<Sha256Digester>` or
+// `TreeDigester<HighwayHash256Digester>`. The digest differs from the digest
+// of the same data by `LeafDigester` alone, and depends on `leaf_size()`.
+template <typename LeafDigester>
+class TreeDigester {
+ public:
+  // The type of the digest.
+  using DigestType = absl::remove_cvref_t<
+      decltype(std::declval<LeafDigester&>().Digest())>;
+
+  static constexpr Position kDefaultLeafSize = Position{1} << 20;
+
+  explicit TreeDigester(Position leaf_size = kDefaultLeafSize,
+                        const LeafDigester& leaf_digester = LeafDigester())
+      : leaf_size_(leaf_size),
+        initial_digester_(leaf_digester),
+        current_digester_(leaf_digester) {
+    RIEGELI_ASSERT_GT(leaf_size, 0u)
+        << "Failed precondition of TreeDigester: zero leaf size";
+  }
+
+  TreeDigester(const TreeDigester& that) = default;
+  TreeDigester& operator=(const TreeDigester& that) = default;
+
+  TreeDigester(TreeDigester&& that) = default;
+  TreeDigester& operator=(TreeDigester&& that) = default;
+
+  // Returns the length of a leaf.
+  Position leaf_size() const { return leaf_size_; }
+
+  void Write(absl::string_view src);
+  DigestType Digest();
+
+  // Returns a digester for data following data digested by `*this`, which can
+  // be digested independently and then appended with `Concat()`. Used by
+  // `ParallelDigest()`.
+  TreeDigester NewRangeDigester() const {
+    return TreeDigester(leaf_size_, initial_digester_);
+  }
+
+  // Appends data digested by `that`, which was returned by `NewRangeDigester()`
+  // and then digested `length` bytes, as if they were digested by `*this`.
+  //
+  // Precondition: the length digested by `*this` is a multiple of
+  // `RangeAlignment()`.
+  void Concat(TreeDigester&& that, Position length);
+
+  // Ranges digested by `NewRangeDigester()` must start at leaf boundaries.
+  Position RangeAlignment() const { return leaf_size_; }
+
+ private:
+  // Appends the digest of the current leaf to `leaf_digests_`, and starts a
+  // new leaf.
+  void FinishLeaf();
+
+  Position leaf_size_;
+  // A copy of the digester given to the constructor, in its initial state.
+  LeafDigester initial_digester_;
+  // Digests the current leaf.
+  LeafDigester current_digester_;
+  // The length of the current leaf digested so far.
+  Position current_length_ = 0;
+  // The total length digested so far.
+  Position length_ = 0;
+  // Digests of finished leaves.
+  std::string leaf_digests_;
+};
+
+// Implementation details follow.
+
+// Before C++17 if a constexpr static data member is ODR-used, its definition at
+// namespace scope is required. Since C++17 these definitions are deprecated:
+// http://en.cppreference.com/w/cpp/language/static
+#if !__cpp_inline_variables
+template <typename LeafDigester>
+constexpr Position TreeDigester<LeafDigester>::kDefaultLeafSize;
+#endif
+
+template <typename LeafDigester>
+void TreeDigester<LeafDigester>::Write(absl::string_view src) {
+  while (!src.empty()) {
+    const size_t length =
+        UnsignedMin(src.size(), leaf_size_ - current_length_);
+    current_digester_.Write(src.substr(0, length));
+    src.remove_prefix(length);
+    current_length_ += length;
+    length_ += length;
+    if (current_length_ == leaf_size_) FinishLeaf();
+  }
+}
+
+template <typename LeafDigester>
+void TreeDigester<LeafDigester>::FinishLeaf() {
+  tree_digester_internal::AppendDigest(current_digester_.Digest(),
+                                       leaf_digests_);
+  current_digester_ = initial_digester_;
+  current_length_ = 0;
+}
+
+template <typename LeafDigester>
+typename TreeDigester<LeafDigester>::DigestType
+TreeDigester<LeafDigester>::Digest() {
+  LeafDigester root_digester = initial_digester_;
+  root_digester.Write(leaf_digests_);
+  std::string trailer;
+  if (current_length_ > 0) {
+    tree_digester_internal::AppendDigest(current_digester_.Digest(), trailer);
+  }
+  tree_digester_internal::AppendDigest(uint64_t{length_}, trailer);
+  root_digester.Write(trailer);
+  return root_digester.Digest();
+}
+
+template <typename LeafDigester>
+void TreeDigester<LeafDigester>::Concat(TreeDigester&& that,
+                                        Position length) {
+  RIEGELI_ASSERT_EQ(current_length_, 0u)
+      << "Failed precondition of TreeDigester::Concat(): "
+         "not at a leaf boundary";
+  RIEGELI_ASSERT_EQ(that.length_, length)
+      << "Failed precondition of TreeDigester::Concat(): "
+         "length does not match the digested data";
+  leaf_digests_.append(that.leaf_digests_);
+  current_digester_ = std::move(that.current_digester_);
+  current_length_ = that.current_length_;
+  length_ += length;
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_DIGESTS_TREE_DIGESTER_H_
@@ -0,0 +1,228 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/endian/stream_vbyte_reading.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __SSSE3__
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#endif
+
+#include "absl/base/optimization.h"
+#include "absl/types/span.h"
+#include "riegeli/base/buffer.h"
+#include "riegeli/base/global.h"  // IWYU pragma: keep
+#include "riegeli/bytes/reader.h"
+
+namespace riegeli {
+
+namespace {
+
+// Returns the number of data bytes of a group of 4 numbers with the given
+// control byte.
+inline size_t GroupLength(uint8_t control) {
+  return size_t{4} + (control & 3) + ((control >> 2) & 3) +
+         ((control >> 4) & 3) + (control >> 6);
+}
+
+inline uint32_t ReadValue(const char* src, size_t length) {
+  uint32_t value = 0;
+  for (size_t i = 0; i < length; ++i) {
+    value |= uint32_t{static_cast<uint8_t>(src[i])} << (i * 8);
+  }
+  return value;
+}
+
+// Transforms decoded values to numbers.
+class PlainValues {
+ public:
+  uint32_t Next(uint32_t value) { return value; }
+
+#ifdef __SSSE3__
+  __m128i Next(__m128i values) { return values; }
+#endif
+};
+
+class DeltaValues {
+ public:
+  uint32_t Next(uint32_t value) {
+    previous_ += (value >> 1) ^ (~(value & 1) + 1);
+    return previous_;
+  }
+
+#ifdef __SSSE3__
+  __m128i Next(__m128i values) {
+    // Decode zigzag.
+    values = _mm_xor_si128(
+        _mm_srli_epi32(values, 1),
+        _mm_sub_epi32(_mm_setzero_si128(),
+                      _mm_and_si128(values, _mm_set1_epi32(1))));
+    // Compute prefix sums.
+    values = _mm_add_epi32(values, _mm_slli_si128(values, 4));
+    values = _mm_add_epi32(values, _mm_slli_si128(values, 8));
+    values = _mm_add_epi32(values, _mm_set1_epi32(static_cast<int>(previous_)));
+    previous_ = static_cast<uint32_t>(
+        _mm_cvtsi128_si32(_mm_shuffle_epi32(values, 0xff)));
+    return values;
+  }
+#endif
+
+ private:
+  uint32_t previous_ = 0;
+};
+
+#ifdef __SSSE3__
+
+// For each control byte, a shuffle which moves bytes of each number to its
+// lane, and clears remaining bytes.
+class StreamVByteShuffles {
+ public:
+  StreamVByteShuffles();
+
+  const __m128i& operator[](uint8_t control) const {
+    return shuffles_[control];
+  }
+
+ private:
+  __m128i shuffles_[256];
+};
+
+StreamVByteShuffles::StreamVByteShuffles() {
+  for (size_t control = 0; control < 256; ++control) {
+    alignas(__m128i) int8_t pattern[16];
+    int8_t src_index = 0;
+    for (size_t lane = 0; lane < 4; ++lane) {
+      const size_t length = ((control >> (lane * 2)) & 3) + 1;
+      for (size_t i = 0; i < 4; ++i) {
+        pattern[lane * 4 + i] = i < length ? src_index++ : int8_t{-1};
+      }
+    }
+    shuffles_[control] =
+        _mm_load_si128(reinterpret_cast<const __m128i*>(pattern));
+  }
+}
+
+#endif
+
+// Decodes complete groups of 4 numbers from `control[]` and `cursor[]` while
+// the data of the next group is available before `limit`, advancing `control`,
+// `cursor`, and `dest`, stopping before `control_limit`.
+template <typename Values>
+inline void DecodeGroups(const uint8_t*& control,
+                         const uint8_t* const control_limit,
+                         const char*& cursor, const char* const limit,
+                         uint32_t*& dest, Values& values) {
+#ifdef __SSSE3__
+  {
+    const StreamVByteShuffles& shuffles = Global<const StreamVByteShuffles>();
+    // Groups are decoded while 16 bytes can be loaded.
+    while (control < control_limit &&
+           limit - cursor >= static_cast<ptrdiff_t>(sizeof(__m128i))) {
+      const __m128i data =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(cursor));
+      _mm_storeu_si128(
+          reinterpret_cast<__m128i*>(dest),
+          values.Next(_mm_shuffle_epi8(data, shuffles[*control])));
+      cursor += GroupLength(*control);
+      ++control;
+      dest += 4;
+    }
+  }
+#endif
+  while (control < control_limit &&
+         limit - cursor >= static_cast<ptrdiff_t>(GroupLength(*control))) {
+    for (size_t shift = 0; shift < 8; shift += 2) {
+      const size_t length = ((*control >> shift) & 3) + 1;
+      *dest++ = values.Next(ReadValue(cursor, length));
+      cursor += length;
+    }
+    ++control;
+  }
+}
+
+template <typename Values>
+bool ReadStreamVByte32sImpl(Reader& src, absl::Span<uint32_t> dest) {
+  const size_t control_length = (dest.size() + 3) / 4;
+  const uint8_t* control;
+  Buffer control_buffer;
+  if (src.available() >= control_length) {
+    control = reinterpret_cast<const uint8_t*>(src.cursor());
+    size_t data_length = 0;
+    for (size_t i = 0; i < control_length; ++i) {
+      data_length += GroupLength(control[i]);
+    }
+    if (src.available() - control_length >= data_length) {
+      // All data are available in the buffer, hence control bytes can be used
+      // in place: the buffer will not be invalidated by reading more data.
+      src.move_cursor(control_length);
+    } else {
+      control = nullptr;
+    }
+  } else {
+    control = nullptr;
+  }
+  if (control == nullptr) {
+    control_buffer.Reset(control_length);
+    if (ABSL_PREDICT_FALSE(!src.Read(control_length, control_buffer.data()))) {
+      return false;
+    }
+    control = reinterpret_cast<const uint8_t*>(control_buffer.data());
+  }
+
+  Values values;
+  uint32_t* dest_ptr = dest.data();
+  const uint8_t* const control_limit = control + dest.size() / 4;
+  for (;;) {
+    const char* cursor = src.cursor();
+    DecodeGroups(control, control_limit, cursor, src.limit(), dest_ptr,
+                 values);
+    src.set_cursor(cursor);
+    if (control == control_limit) break;
+    if (ABSL_PREDICT_FALSE(!src.Pull(GroupLength(*control), 16))) {
+      return false;
+    }
+  }
+
+  // Decode the last incomplete group.
+  const size_t remaining = dest.size() % 4;
+  if (remaining > 0) {
+    size_t lengths[3];
+    size_t group_length = 0;
+    for (size_t i = 0; i < remaining; ++i) {
+      lengths[i] = ((*control >> (i * 2)) & 3) + 1;
+      group_length += lengths[i];
+    }
+    if (ABSL_PREDICT_FALSE(!src.Pull(group_length))) return false;
+    for (size_t i = 0; i < remaining; ++i) {
+      *dest_ptr++ = values.Next(ReadValue(src.cursor(), lengths[i]));
+      src.move_cursor(lengths[i]);
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+bool ReadStreamVByte32s(Reader& src, absl::Span<uint32_t> dest) {
+  return ReadStreamVByte32sImpl<PlainValues>(src, dest);
+}
+
+bool ReadDeltaStreamVByte32s(Reader& src, absl::Span<uint32_t> dest) {
+  return ReadStreamVByte32sImpl<DeltaValues>(src, dest);
+}
+
+}  // namespace riegeli
@@ -0,0 +1,60 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_ENDIAN_STREAM_VBYTE_READING_H_
+#define RIEGELI_ENDIAN_STREAM_VBYTE_READING_H_
+
+#include <stdint.h>
+
+#include "absl/types/span.h"
+#include "riegeli/bytes/reader.h"
+
+namespace riegeli {
+
+// Reads an array of numbers in the Stream VByte encoding, as written by
+// `WriteStreamVByte32s()`.
+//
+// The number of values is not stored in the encoding, it is taken from
+// `dest.size()`.
+//
+// Return values:
+//  * `true`                     - success (`dest[]` is filled)
+//  * `false` (when `src.ok()`)  - source ends
+//                                 (`src` position is undefined,
+//                                 `dest[]` is undefined)
+//  * `false` (when `!src.ok()`) - failure
+//                                 (`src` position is undefined,
+//                                 `dest[]` is undefined)
+bool ReadStreamVByte32s(Reader& src, absl::Span<uint32_t> dest);
+
+// Reads an array of numbers in the delta Stream VByte encoding, as written by
+// `WriteDeltaStreamVByte32s()`: differences between consecutive numbers
+// (the first one relative to 0), zigzag-encoded, in the Stream VByte encoding.
+//
+// The number of values is not stored in the encoding, it is taken from
+// `dest.size()`.
+//
+// Return values:
+//  * `true`                     - success (`dest[]` is filled)
+//  * `false` (when `src.ok()`)  - source ends
+//                                 (`src` position is undefined,
+//                                 `dest[]` is undefined)
+//  * `false` (when `!src.ok()`) - failure
+//                                 (`src` position is undefined,
+//                                 `dest[]` is undefined)
+bool ReadDeltaStreamVByte32s(Reader& src, absl::Span<uint32_t> dest);
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_ENDIAN_STREAM_VBYTE_READING_H_
@@ -0,0 +1,130 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/endian/stream_vbyte_writing.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "absl/base/optimization.h"
+#include "absl/types/span.h"
+#include "riegeli/base/arithmetic.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/endian/endian_writing.h"
+
+namespace riegeli {
+
+namespace {
+
+// Transforms numbers to the values being encoded.
+class PlainValues {
+ public:
+  uint32_t Next(uint32_t value) { return value; }
+};
+
+class DeltaValues {
+ public:
+  uint32_t Next(uint32_t value) {
+    const uint32_t delta = value - previous_;
+    previous_ = value;
+    return (delta << 1) ^
+           static_cast<uint32_t>(static_cast<int32_t>(delta) >> 31);
+  }
+
+ private:
+  uint32_t previous_ = 0;
+};
+
+// Returns the number of bytes of `value` minus 1.
+inline uint32_t LengthCode(uint32_t value) {
+  return static_cast<uint32_t>(value > 0xff) +
+         static_cast<uint32_t>(value > 0xffff) +
+         static_cast<uint32_t>(value > 0xffffff);
+}
+
+template <typename Values>
+size_t LengthStreamVByte32sImpl(absl::Span<const uint32_t> src) {
+  size_t length = (src.size() + 3) / 4;
+  Values values;
+  for (const uint32_t value : src) {
+    length += size_t{LengthCode(values.Next(value))} + 1;
+  }
+  return length;
+}
+
+template <typename Values>
+bool WriteStreamVByte32sImpl(absl::Span<const uint32_t> src, Writer& dest) {
+  // Write control bytes.
+  {
+    Values values;
+    size_t index = 0;
+    size_t remaining_control_length = (src.size() + 3) / 4;
+    while (remaining_control_length > 0) {
+      if (ABSL_PREDICT_FALSE(!dest.Push(1, remaining_control_length))) {
+        return false;
+      }
+      const size_t length =
+          UnsignedMin(dest.available(), remaining_control_length);
+      char* cursor = dest.cursor();
+      char* const limit = cursor + length;
+      do {
+        const size_t group_end = UnsignedMin(index + 4, src.size());
+        uint32_t control = 0;
+        for (size_t shift = 0; index < group_end; ++index, shift += 2) {
+          control |= LengthCode(values.Next(src[index])) << shift;
+        }
+        *cursor++ = static_cast<char>(control);
+      } while (cursor < limit);
+      dest.set_cursor(cursor);
+      remaining_control_length -= length;
+    }
+  }
+  // Write data bytes.
+  Values values;
+  for (const uint32_t number : src) {
+    const uint32_t value = values.Next(number);
+    const size_t length = size_t{LengthCode(value)} + 1;
+    if (ABSL_PREDICT_FALSE(!dest.Push(length))) return false;
+    if (ABSL_PREDICT_TRUE(dest.available() >= sizeof(uint32_t))) {
+      // Write all 4 bytes, and keep only the needed ones.
+      WriteLittleEndian32(value, dest.cursor());
+    } else {
+      for (size_t i = 0; i < length; ++i) {
+        dest.cursor()[i] = static_cast<char>(value >> (i * 8));
+      }
+    }
+    dest.move_cursor(length);
+  }
+  return true;
+}
+
+}  // namespace
+
+bool WriteStreamVByte32s(absl::Span<const uint32_t> src, Writer& dest) {
+  return WriteStreamVByte32sImpl<PlainValues>(src, dest);
+}
+
+bool WriteDeltaStreamVByte32s(absl::Span<const uint32_t> src, Writer& dest) {
+  return WriteStreamVByte32sImpl<DeltaValues>(src, dest);
+}
+
+size_t LengthStreamVByte32s(absl::Span<const uint32_t> src) {
+  return LengthStreamVByte32sImpl<PlainValues>(src);
+}
+
+size_t LengthDeltaStreamVByte32s(absl::Span<const uint32_t> src) {
+  return LengthStreamVByte32sImpl<DeltaValues>(src);
+}
+
+}  // namespace riegeli
@@ -0,0 +1,62 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_ENDIAN_STREAM_VBYTE_WRITING_H_
+#define RIEGELI_ENDIAN_STREAM_VBYTE_WRITING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "absl/types/span.h"
+#include "riegeli/bytes/writer.h"
+
+namespace riegeli {
+
+// Writes an array of numbers in the Stream VByte encoding.
+//
+// The encoding consists of control bytes, one per 4 numbers, with 2 bits per
+// number (starting from the least significant bits) storing the number of
+// bytes of the number minus 1, followed by numbers in a Little Endian encoding,
+// each with 1 to 4 bytes. Small numbers take less space, while control bytes
+// being separate from data allow to decode the numbers with SIMD instructions.
+//
+// The number of values is not written, it must be known when reading.
+//
+// Return values:
+//  * `true`  - success (`dest.ok()`)
+//  * `false` - failure (`!dest.ok()`)
+bool WriteStreamVByte32s(absl::Span<const uint32_t> src, Writer& dest);
+
+// Writes an array of numbers in the delta Stream VByte encoding: differences
+// between consecutive numbers (the first one relative to 0), zigzag-encoded, in
+// the Stream VByte encoding.
+//
+// This is suitable for sorted or clustered numbers, e.g. ids or timestamps.
+// Differences are taken modulo 2^32, so any numbers are supported.
+//
+// The number of values is not written, it must be known when reading.
+//
+// Return values:
+//  * `true`  - success (`dest.ok()`)
+//  * `false` - failure (`!dest.ok()`)
+bool WriteDeltaStreamVByte32s(absl::Span<const uint32_t> src, Writer& dest);
+
+// Returns the length needed to write an array of numbers in the (delta)
+// Stream VByte encoding.
+size_t LengthStreamVByte32s(absl::Span<const uint32_t> src);
+size_t LengthDeltaStreamVByte32s(absl::Span<const uint32_t> src);
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_ENDIAN_STREAM_VBYTE_WRITING_H_
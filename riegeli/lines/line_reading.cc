@@ -15,12 +15,19 @@
 #include "riegeli/lines/line_reading.h"
 
 #include <stddef.h>
+#include <stdint.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include <cstring>
 #include <string>
+#include <vector>
 
 #include "absl/base/attributes.h"
 #include "absl/base/optimization.h"
+#include "absl/numeric/bits.h"  // IWYU pragma: keep
 #include "absl/status/status.h"
 #include "absl/strings/cord.h"
 #include "absl/strings/str_cat.h"
@@ -205,6 +212,98 @@ inline bool ReadLineInternal(Reader& src, Dest& dest, ReadLineOptions options) {
   return src.ok();
 }
 
+// Appends to `dest` the line from `line_begin` to `newline`, followed by a line
+// terminator of `newline_length` bytes, and moves `line_begin` after the line
+// terminator.
+//
+// Returns `false` if the line exceeds `options.max_length()`.
+inline bool AppendLine(const char*& line_begin, const char* newline,
+                       size_t newline_length, ReadLineOptions options,
+                       std::vector<absl::string_view>& dest) {
+  size_t length = PtrDistance(line_begin, newline);
+  if (options.keep_newline()) length += newline_length;
+  if (ABSL_PREDICT_FALSE(length > options.max_length())) return false;
+  dest.emplace_back(line_begin, length);
+  line_begin = newline + newline_length;
+  return true;
+}
+
+// Interprets a LF, or a CR if `options.newline() == ReadNewline::kAny`, found
+// at `ptr`.
+//
+// Returns `false` if scanning must stop before the line beginning at
+// `line_begin`.
+inline bool FoundNewlineChar(const char*& line_begin, const char* ptr,
+                             const char* limit, ReadLineOptions options,
+                             std::vector<absl::string_view>& dest) {
+  // A LF after a CR which has been interpreted as CR-LF.
+  if (ptr < line_begin) return true;
+  if (*ptr == '\n') {
+    if (options.newline() == ReadNewline::kCrLfOrLf && ptr > line_begin &&
+        ptr[-1] == '\r') {
+      return AppendLine(line_begin, ptr - 1, 2, options, dest);
+    }
+    return AppendLine(line_begin, ptr, 1, options, dest);
+  }
+  // Whether a LF follows the CR is not known yet.
+  if (ABSL_PREDICT_FALSE(ptr + 1 == limit)) return false;
+  return AppendLine(line_begin, ptr, ptr[1] == '\n' ? 2 : 1, options, dest);
+}
+
+// Appends to `dest` complete lines from `line_begin` to `limit`.
+//
+// Returns the beginning of the first line which has not been appended.
+inline const char* ScanLines(const char* line_begin, const char* limit,
+                             ReadLineOptions options,
+                             std::vector<absl::string_view>& dest) {
+  const bool cr_is_newline = options.newline() == ReadNewline::kAny;
+  const char* ptr = line_begin;
+#ifdef __SSE2__
+  const __m128i lf = _mm_set1_epi8('\n');
+  const __m128i cr = _mm_set1_epi8('\r');
+  while (PtrDistance(ptr, limit) >= sizeof(__m128i)) {
+    const __m128i data =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+    __m128i matches = _mm_cmpeq_epi8(data, lf);
+    if (cr_is_newline) {
+      matches = _mm_or_si128(matches, _mm_cmpeq_epi8(data, cr));
+    }
+    // Each bit of `mask` corresponds to a byte of `data` which is a newline
+    // character.
+    uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(matches));
+    while (mask != 0) {
+      if (ABSL_PREDICT_FALSE(!FoundNewlineChar(line_begin,
+                                               ptr + absl::countr_zero(mask),
+                                               limit, options, dest))) {
+        return line_begin;
+      }
+      mask &= mask - 1;
+    }
+    ptr += sizeof(__m128i);
+  }
+#endif
+  if (cr_is_newline) {
+    for (; ptr < limit; ++ptr) {
+      if (*ptr == '\n' || *ptr == '\r') {
+        if (ABSL_PREDICT_FALSE(
+                !FoundNewlineChar(line_begin, ptr, limit, options, dest))) {
+          return line_begin;
+        }
+      }
+    }
+  } else {
+    while ((ptr = static_cast<const char*>(
+                std::memchr(ptr, '\n', PtrDistance(ptr, limit)))) != nullptr) {
+      if (ABSL_PREDICT_FALSE(
+              !FoundNewlineChar(line_begin, ptr, limit, options, dest))) {
+        return line_begin;
+      }
+      ++ptr;
+    }
+  }
+  return line_begin;
+}
+
 }  // namespace
 
 bool ReadLine(Reader& src, absl::string_view& dest, ReadLineOptions options) {
@@ -305,6 +404,27 @@ bool ReadLine(Reader& src, absl::Cord& dest, ReadLineOptions options) {
   return ReadLineInternal(src, dest, options);
 }
 
+bool ReadLines(Reader& src, std::vector<absl::string_view>& dest,
+               ReadLineOptions options) {
+  dest.clear();
+  if (ABSL_PREDICT_FALSE(!src.Pull())) return false;
+  const char* const line_begin =
+      ScanLines(src.cursor(), src.limit(), options, dest);
+  if (ABSL_PREDICT_TRUE(!dest.empty())) {
+    src.set_cursor(line_begin);
+    return true;
+  }
+  // The buffer does not contain a complete line. Let `ReadLine()` pull more
+  // data, and handle a line without a terminator and failures.
+  absl::string_view line;
+  if (ABSL_PREDICT_FALSE(!ReadLine(src, line, options))) {
+    if (ABSL_PREDICT_FALSE(!src.ok())) dest.push_back(line);
+    return false;
+  }
+  dest.push_back(line);
+  return true;
+}
+
 void SkipUtf8Bom(Reader& src) {
   if (src.Pull(kUtf8Bom.size()) &&
       absl::string_view(src.cursor(), kUtf8Bom.size()) == kUtf8Bom) {
@@ -20,6 +20,7 @@
 #include <limits>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/base/attributes.h"
 #include "absl/strings/cord.h"
@@ -116,6 +117,31 @@ bool ReadLine(Reader& src, Chain& dest,
 bool ReadLine(Reader& src, absl::Cord& dest,
               ReadLineOptions options = ReadLineOptions());
 
+// Reads all complete lines which are available in the buffer of `src`, or a
+// single line if the buffer does not contain a complete line.
+//
+// This amortizes the overhead of `ReadLine()` over many lines, which matters
+// for short lines. Lines are scanned for terminators 16 bytes at a time when
+// SSE2 is available.
+//
+// `dest` is cleared and filled with lines pointing to the buffer of `src`, or
+// to data owned by `src`. They are valid until the next non-const operation on
+// `src`.
+//
+// Line terminator after the last line is optional.
+//
+// Warning: if `options.newline()` is `ReadNewline::kAny`, for lines terminated
+// with CR, `ReadLines()` reads ahead one character after the CR, as
+// `ReadLine()` does.
+//
+// Return values:
+//  * `true`                     - success (`dest` is not empty)
+//  * `false` (when `src.ok()`)  - source ends (`dest` is empty)
+//  * `false` (when `!src.ok()`) - failure (`dest` contains the partial line
+//                                 read before the failure)
+bool ReadLines(Reader& src, std::vector<absl::string_view>& dest,
+               ReadLineOptions options = ReadLineOptions());
+
 // Skips UTF-8 BOM if it is present.
 void SkipUtf8Bom(Reader& src);
 
@@ -0,0 +1,135 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compares throughput of reading lines one at a time with `ReadLine()` and in
+// batches with `ReadLines()`, for several line lengths and newline modes.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/functional/function_ref.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "riegeli/base/assert.h"
+#include "riegeli/bytes/std_io.h"
+#include "riegeli/bytes/string_reader.h"
+#include "riegeli/lines/line_reading.h"
+#include "riegeli/lines/newline.h"
+
+ABSL_FLAG(std::vector<std::string>, line_lengths,
+          std::vector<std::string>({"8", "32", "100", "1000"}),
+          "Average lengths of lines to benchmark, excluding line terminators");
+ABSL_FLAG(uint64_t, data_size, uint64_t{64} << 20,
+          "Size of data to read in each repetition, in bytes");
+ABSL_FLAG(int32_t, repetitions, 5, "Number of times to repeat each benchmark");
+
+namespace {
+
+// Returns lines of lengths uniformly distributed around `line_length`,
+// terminated by `newline`.
+std::string GenerateLines(size_t line_length, absl::string_view newline,
+                          size_t data_size) {
+  std::string data;
+  data.reserve(data_size + line_length * 2 + newline.size());
+  uint32_t random = 1;
+  while (data.size() < data_size) {
+    random = random * 1103515245 + 12345;
+    const size_t length = line_length / 2 + (random >> 8) % (line_length + 1);
+    for (size_t i = 0; i < length; ++i) {
+      data.push_back(static_cast<char>('a' + (i + random) % 26));
+    }
+    data.append(newline.data(), newline.size());
+  }
+  return data;
+}
+
+// Returns the median throughput of `read_lines()` in MB/s.
+double Measure(absl::string_view data, int repetitions,
+               absl::FunctionRef<size_t(riegeli::Reader&)> read_lines) {
+  std::vector<double> samples;
+  size_t num_lines = 0;
+  for (int i = 0; i < repetitions; ++i) {
+    riegeli::StringReader<> src(data);
+    const absl::Time start = absl::Now();
+    const size_t lines = read_lines(src);
+    const absl::Duration elapsed = absl::Now() - start;
+    RIEGELI_CHECK(src.Close()) << src.status();
+    RIEGELI_CHECK(i == 0 || lines == num_lines)
+        << "Inconsistent number of lines";
+    num_lines = lines;
+    samples.push_back(static_cast<double>(data.size()) /
+                      absl::ToDoubleMicroseconds(elapsed));
+  }
+  std::nth_element(samples.begin(), samples.begin() + samples.size() / 2,
+                   samples.end());
+  return samples[samples.size() / 2];
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  struct NewlineMode {
+    absl::string_view name;
+    riegeli::ReadNewline newline;
+    absl::string_view representation;
+  };
+  const NewlineMode kNewlineModes[] = {
+      {"kLf", riegeli::ReadNewline::kLf, "\n"},
+      {"kCrLfOrLf", riegeli::ReadNewline::kCrLfOrLf, "\r\n"},
+      {"kAny", riegeli::ReadNewline::kAny, "\r\n"},
+  };
+  const size_t data_size = absl::GetFlag(FLAGS_data_size);
+  const int repetitions = std::max(absl::GetFlag(FLAGS_repetitions), 1);
+  riegeli::StdOut std_out;
+  std_out.Write(absl::StrFormat("%-10s %8s %18s %18s\n", "newline", "length",
+                                "ReadLine() MB/s", "ReadLines() MB/s"));
+  for (const std::string& line_length_str : absl::GetFlag(FLAGS_line_lengths)) {
+    size_t line_length;
+    RIEGELI_CHECK(absl::SimpleAtoi(line_length_str, &line_length))
+        << "Invalid line length: " << line_length_str;
+    for (const NewlineMode& mode : kNewlineModes) {
+      const std::string data =
+          GenerateLines(line_length, mode.representation, data_size);
+      const double one_at_a_time =
+          Measure(data, repetitions, [&](riegeli::Reader& src) {
+            size_t num_lines = 0;
+            absl::string_view line;
+            while (riegeli::ReadLine(src, line, mode.newline)) ++num_lines;
+            return num_lines;
+          });
+      const double batched =
+          Measure(data, repetitions, [&](riegeli::Reader& src) {
+            size_t num_lines = 0;
+            std::vector<absl::string_view> lines;
+            while (riegeli::ReadLines(src, lines, mode.newline)) {
+              num_lines += lines.size();
+            }
+            return num_lines;
+          });
+      std_out.Write(absl::StrFormat("%-10s %8u %18.1f %18.1f\n", mode.name,
+                                    line_length, one_at_a_time, batched));
+    }
+  }
+  std_out.Close();
+}
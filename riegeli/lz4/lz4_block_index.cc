@@ -0,0 +1,373 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "riegeli/lz4/lz4_block_index.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <limits>
+#include <string>
+
+#include "absl/base/optimization.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "riegeli/base/arithmetic.h"
+#include "riegeli/base/assert.h"
+#include "riegeli/base/types.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/endian/endian_reading.h"
+#include "riegeli/endian/endian_writing.h"
+#include "riegeli/lz4/lz4_xxh32.h"
+
+namespace riegeli {
+namespace lz4_internal {
+
+// Before C++17 if a constexpr static data member is ODR-used, its definition at
+// namespace scope is required. Since C++17 these definitions are deprecated:
+// http://en.cppreference.com/w/cpp/language/static
+#if !__cpp_inline_variables
+constexpr size_t Lz4BlockIndex::kMaxNumBlocks;
+#endif
+
+namespace {
+
+// `LZ4F_MAGIC_SKIPPABLE_START | 0xc`
+constexpr uint32_t kSkippableFrameMagic = 0x184d2a5c;
+// "LZ4I"
+constexpr uint32_t kIndexMagic = 0x49345a4c;
+
+constexpr size_t kSkippableFrameHeaderSize = 8;
+constexpr size_t kEntrySize = 8;
+constexpr size_t kFooterSize = 10;
+
+// `LZ4F_MAGICNUMBER`
+constexpr uint32_t kFrameMagic = 0x184d2204;
+
+// Sizes of parts of an Lz4 frame.
+constexpr size_t kMinHeaderSize = 7;
+constexpr size_t kContentSizeSize = 8;
+constexpr size_t kDictIdSize = 4;
+constexpr size_t kMaxHeaderSize = 19;
+constexpr size_t kBlockSizeSize = 4;
+constexpr size_t kChecksumSize = 4;
+constexpr size_t kMaxBlockSize = size_t{4} << 20;
+
+// Bits of the flags byte of the frame header.
+constexpr uint8_t kBlockIndependenceFlag = 0x20;
+constexpr uint8_t kBlockChecksumFlag = 0x10;
+constexpr uint8_t kContentSizeFlag = 0x08;
+constexpr uint8_t kContentChecksumFlag = 0x04;
+constexpr uint8_t kDictIdFlag = 0x01;
+// Bit of the block size field.
+constexpr uint32_t kUncompressedBlockFlag = 0x80000000;
+
+// Returns the size of a frame header with the given flags byte.
+size_t HeaderSize(uint8_t flags) {
+  size_t header_size = kMinHeaderSize;
+  if ((flags & kContentSizeFlag) != 0) header_size += kContentSizeSize;
+  if ((flags & kDictIdFlag) != 0) header_size += kDictIdSize;
+  return header_size;
+}
+
+// Returns the decompressed size of a compressed Lz4 block, found by parsing
+// its sequences without decompressing them, or `absl::nullopt` if the block is
+// malformed.
+absl::optional<size_t> BlockDecompressedSize(absl::string_view block) {
+  const char* cursor = block.data();
+  const char* const limit = block.data() + block.size();
+  size_t size = 0;
+  for (;;) {
+    if (ABSL_PREDICT_FALSE(cursor == limit)) return absl::nullopt;
+    const uint8_t token = static_cast<uint8_t>(*cursor++);
+    size_t literal_length = token >> 4;
+    if (literal_length == 15) {
+      uint8_t byte;
+      do {
+        if (ABSL_PREDICT_FALSE(cursor == limit)) return absl::nullopt;
+        byte = static_cast<uint8_t>(*cursor++);
+        literal_length += byte;
+      } while (byte == 255);
+    }
+    if (ABSL_PREDICT_FALSE(literal_length > PtrDistance(cursor, limit))) {
+      return absl::nullopt;
+    }
+    cursor += literal_length;
+    size += literal_length;
+    // The last sequence consists only of literals.
+    if (cursor == limit) return size;
+    // Skip the match offset.
+    if (ABSL_PREDICT_FALSE(PtrDistance(cursor, limit) < 2)) {
+      return absl::nullopt;
+    }
+    cursor += 2;
+    size_t match_length = token & 15;
+    if (match_length == 15) {
+      uint8_t byte;
+      do {
+        if (ABSL_PREDICT_FALSE(cursor == limit)) return absl::nullopt;
+        byte = static_cast<uint8_t>(*cursor++);
+        match_length += byte;
+      } while (byte == 255);
+    }
+    size += match_length + 4;
+    if (ABSL_PREDICT_FALSE(size > kMaxBlockSize)) return absl::nullopt;
+  }
+}
+
+// Returns `true` if `footer` is a footer of an index stored in a skippable
+// frame of `frame_size` bytes.
+bool IsFooter(const char* footer, uint32_t frame_size) {
+  return ReadLittleEndian32(footer + 6) == kIndexMagic &&
+         Position{ReadLittleEndian32(footer)} * kEntrySize + kFooterSize ==
+             frame_size;
+}
+
+}  // namespace
+
+bool Lz4BlockIndex::Write(size_t header_size, absl::Span<const Entry> entries,
+                          size_t trailer_size, Writer& dest) {
+  RIEGELI_ASSERT_LE(entries.size(), kMaxNumBlocks)
+      << "Failed precondition of Lz4BlockIndex::Write(): "
+         "too many blocks";
+  const size_t frame_size = entries.size() * kEntrySize + kFooterSize;
+  if (ABSL_PREDICT_FALSE(!WriteLittleEndian32(kSkippableFrameMagic, dest) ||
+                         !WriteLittleEndian32(IntCast<uint32_t>(frame_size),
+                                              dest))) {
+    return false;
+  }
+  for (const Entry& entry : entries) {
+    if (ABSL_PREDICT_FALSE(
+            !WriteLittleEndian32(entry.compressed_size, dest) ||
+            !WriteLittleEndian32(entry.decompressed_size, dest))) {
+      return false;
+    }
+  }
+  if (ABSL_PREDICT_FALSE(!dest.Push(kFooterSize))) return false;
+  char* const cursor = dest.cursor();
+  WriteLittleEndian32(IntCast<uint32_t>(entries.size()), cursor);
+  cursor[4] = static_cast<char>(IntCast<uint8_t>(header_size));
+  cursor[5] = static_cast<char>(IntCast<uint8_t>(trailer_size));
+  WriteLittleEndian32(kIndexMagic, cursor + 6);
+  dest.move_cursor(kFooterSize);
+  return true;
+}
+
+absl::optional<Lz4BlockIndex> Lz4BlockIndex::Read(Reader& src,
+                                                  Position initial_pos) {
+  const absl::optional<Position> size = src.Size();
+  if (ABSL_PREDICT_FALSE(size == absl::nullopt) || *size < initial_pos ||
+      *size - initial_pos < kSkippableFrameHeaderSize + kFooterSize) {
+    return absl::nullopt;
+  }
+  if (ABSL_PREDICT_FALSE(!src.Seek(*size - kFooterSize) ||
+                         !src.Pull(kFooterSize))) {
+    return absl::nullopt;
+  }
+  const uint32_t num_blocks = ReadLittleEndian32(src.cursor());
+  const size_t header_size = static_cast<uint8_t>(src.cursor()[4]);
+  const size_t trailer_size = static_cast<uint8_t>(src.cursor()[5]);
+  if (ReadLittleEndian32(src.cursor() + 6) != kIndexMagic ||
+      num_blocks > kMaxNumBlocks || header_size < kMinHeaderSize ||
+      header_size > kMaxHeaderSize ||
+      (trailer_size != kBlockSizeSize &&
+       trailer_size != kBlockSizeSize + kChecksumSize)) {
+    return absl::nullopt;
+  }
+  const Position frame_size = Position{num_blocks} * kEntrySize + kFooterSize;
+  if (*size - initial_pos < kSkippableFrameHeaderSize + frame_size) {
+    return absl::nullopt;
+  }
+  const Position index_pos = *size - (kSkippableFrameHeaderSize + frame_size);
+  if (ABSL_PREDICT_FALSE(!src.Seek(index_pos) ||
+                         !src.Pull(kSkippableFrameHeaderSize))) {
+    return absl::nullopt;
+  }
+  if (ReadLittleEndian32(src.cursor()) != kSkippableFrameMagic ||
+      ReadLittleEndian32(src.cursor() + 4) != frame_size) {
+    return absl::nullopt;
+  }
+  src.move_cursor(kSkippableFrameHeaderSize);
+  Lz4BlockIndex index;
+  index.compressed_starts_.reserve(size_t{num_blocks} + 1);
+  index.decompressed_starts_.reserve(size_t{num_blocks} + 1);
+  Position compressed_pos = header_size;
+  Position decompressed_pos = 0;
+  index.compressed_starts_.push_back(compressed_pos);
+  index.decompressed_starts_.push_back(decompressed_pos);
+  for (uint32_t i = 0; i < num_blocks; ++i) {
+    if (ABSL_PREDICT_FALSE(!src.Pull(kEntrySize))) return absl::nullopt;
+    compressed_pos += ReadLittleEndian32(src.cursor());
+    decompressed_pos += ReadLittleEndian32(src.cursor() + 4);
+    src.move_cursor(kEntrySize);
+    index.compressed_starts_.push_back(compressed_pos);
+    index.decompressed_starts_.push_back(decompressed_pos);
+  }
+  // Blocks and the trailer must exactly fill the space before the index.
+  if (compressed_pos + trailer_size != index_pos - initial_pos) {
+    return absl::nullopt;
+  }
+  // The frame must have independent blocks and a header of the stored size.
+  if (ABSL_PREDICT_FALSE(!src.Seek(initial_pos) ||
+                         !src.Pull(kMinHeaderSize))) {
+    return absl::nullopt;
+  }
+  const uint8_t flags = static_cast<uint8_t>(src.cursor()[4]);
+  if (ReadLittleEndian32(src.cursor()) != kFrameMagic ||
+      (flags & kBlockIndependenceFlag) == 0 ||
+      HeaderSize(flags) != header_size) {
+    return absl::nullopt;
+  }
+  index.block_checksum_ = (flags & kBlockChecksumFlag) != 0;
+  index.content_checksum_size_ = trailer_size - kBlockSizeSize;
+  index.complete_ = true;
+  index.compressed_size_ = *size - initial_pos;
+  return index;
+}
+
+absl::optional<Lz4BlockIndex> Lz4BlockIndex::BeginScan(Reader& src,
+                                                       Position initial_pos) {
+  if (ABSL_PREDICT_FALSE(!src.Seek(initial_pos) ||
+                         !src.Pull(kMinHeaderSize, kMaxHeaderSize))) {
+    return absl::nullopt;
+  }
+  const uint8_t flags = static_cast<uint8_t>(src.cursor()[4]);
+  if (ReadLittleEndian32(src.cursor()) != kFrameMagic ||
+      (flags & kBlockIndependenceFlag) == 0) {
+    return absl::nullopt;
+  }
+  const size_t header_size = HeaderSize(flags);
+  if (ABSL_PREDICT_FALSE(!src.Pull(header_size))) return absl::nullopt;
+  Lz4BlockIndex index;
+  index.compressed_starts_.push_back(header_size);
+  index.decompressed_starts_.push_back(0);
+  index.block_checksum_ = (flags & kBlockChecksumFlag) != 0;
+  index.content_checksum_size_ =
+      (flags & kContentChecksumFlag) != 0 ? kChecksumSize : 0;
+  return index;
+}
+
+bool Lz4BlockIndex::ScanUntil(Reader& src, Position initial_pos,
+                              Position pos) {
+  RIEGELI_ASSERT(!complete())
+      << "Failed precondition of Lz4BlockIndex::ScanUntil(): "
+         "index already complete";
+  Position compressed_pos = compressed_starts_.back();
+  Position decompressed_pos = decompressed_starts_.back();
+  if (ABSL_PREDICT_FALSE(!src.Seek(initial_pos + compressed_pos))) {
+    return false;
+  }
+  while (decompressed_pos <= pos) {
+    if (ABSL_PREDICT_FALSE(!src.Pull(kBlockSizeSize))) return false;
+    uint32_t block_size = ReadLittleEndian32(src.cursor());
+    src.move_cursor(kBlockSizeSize);
+    // A zero block size is the end mark.
+    if (block_size == 0) {
+      complete_ = true;
+      compressed_size_ =
+          compressed_pos + kBlockSizeSize + content_checksum_size_;
+      return true;
+    }
+    const bool uncompressed = (block_size & kUncompressedBlockFlag) != 0;
+    block_size &= ~kUncompressedBlockFlag;
+    if (ABSL_PREDICT_FALSE(block_size > kMaxBlockSize) ||
+        ABSL_PREDICT_FALSE(!src.Pull(block_size))) {
+      return false;
+    }
+    size_t decompressed_size = block_size;
+    if (!uncompressed) {
+      const absl::optional<size_t> size =
+          BlockDecompressedSize(absl::string_view(src.cursor(), block_size));
+      if (ABSL_PREDICT_FALSE(size == absl::nullopt)) return false;
+      decompressed_size = *size;
+    }
+    src.move_cursor(block_size);
+    if (block_checksum_) {
+      if (ABSL_PREDICT_FALSE(!src.Skip(kChecksumSize))) return false;
+    }
+    compressed_pos +=
+        kBlockSizeSize + block_size + (block_checksum_ ? kChecksumSize : 0);
+    decompressed_pos += decompressed_size;
+    compressed_starts_.push_back(compressed_pos);
+    decompressed_starts_.push_back(decompressed_pos);
+  }
+  return true;
+}
+
+bool Lz4BlockIndex::SkipIfPresent(Reader& src) {
+  if (!src.Pull(kSkippableFrameHeaderSize) ||
+      ReadLittleEndian32(src.cursor()) != kSkippableFrameMagic) {
+    return false;
+  }
+  const uint32_t frame_size = ReadLittleEndian32(src.cursor() + 4);
+  if (frame_size < kFooterSize) return false;
+  // Other skippable frames can use the same magic number. Verify the footer
+  // before skipping.
+  const Position index_size = kSkippableFrameHeaderSize + Position{frame_size};
+  if (src.SupportsRandomAccess()) {
+    const Position index_pos = src.pos();
+    if (!src.Seek(index_pos + index_size - kFooterSize) ||
+        !src.Pull(kFooterSize) || !IsFooter(src.cursor(), frame_size)) {
+      src.Seek(index_pos);
+      return false;
+    }
+    src.move_cursor(kFooterSize);
+    return true;
+  }
+  if (index_size > std::numeric_limits<size_t>::max() ||
+      !src.Pull(IntCast<size_t>(index_size)) ||
+      !IsFooter(src.cursor() + (index_size - kFooterSize), frame_size)) {
+    return false;
+  }
+  src.move_cursor(IntCast<size_t>(index_size));
+  return true;
+}
+
+std::string Lz4BlockIndex::RestartHeader(absl::string_view header) {
+  RIEGELI_ASSERT_GE(header.size(), kMinHeaderSize)
+      << "Failed precondition of Lz4BlockIndex::RestartHeader(): "
+         "header too short";
+  // Magic number, flags, block descriptor.
+  const size_t kPrefixSize = 6;
+  const uint8_t flags = static_cast<uint8_t>(header[4]);
+  std::string restart_header(header.data(), kPrefixSize);
+  restart_header[4] = static_cast<char>(
+      flags & ~(kContentSizeFlag | kContentChecksumFlag));
+  size_t pos = kPrefixSize;
+  if ((flags & kContentSizeFlag) != 0) pos += kContentSizeSize;
+  // The dictionary ID if present, without the header checksum.
+  restart_header.append(header.data() + pos, header.size() - 1 - pos);
+  Xxh32 header_checksum;
+  header_checksum.Update(absl::string_view(restart_header).substr(4));
+  restart_header.push_back(
+      static_cast<char>((header_checksum.Digest() >> 8) & 0xff));
+  return restart_header;
+}
+
+size_t Lz4BlockIndex::BlockContaining(Position pos) const {
+  RIEGELI_ASSERT_LT(pos, decompressed_size())
+      << "Failed precondition of Lz4BlockIndex::BlockContaining(): "
+         "position out of range";
+  return IntCast<size_t>(std::upper_bound(decompressed_starts_.begin(),
+                                          decompressed_starts_.end(), pos) -
+                         decompressed_starts_.begin()) -
+         1;
+}
+
+}  // namespace lz4_internal
+}  // namespace riegeli
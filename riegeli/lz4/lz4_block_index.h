@@ -0,0 +1,189 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef RIEGELI_LZ4_LZ4_BLOCK_INDEX_H_
+#define RIEGELI_LZ4_LZ4_BLOCK_INDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "riegeli/base/arithmetic.h"
+#include "riegeli/base/assert.h"
+#include "riegeli/base/types.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/writer.h"
+
+namespace riegeli {
+namespace lz4_internal {
+
+// Index of blocks of an Lz4 frame with independent blocks, which allows
+// `Lz4Reader` to begin decompression at any block.
+//
+// The index is written by `Lz4Writer` after the frame, as a skippable frame:
+//  * skippable frame header (8 bytes): magic `0x184d2a5c`, frame size
+//  * for each block (8 bytes): compressed size (including the block size
+//    field and the block checksum if present), decompressed size
+//  * footer (10 bytes): number of blocks, frame header size (1 byte),
+//    frame trailer size (1 byte), magic `0x49345a4c`
+//
+// All numbers are little endian 32-bit unless stated otherwise.
+//
+// An equivalent index can also be built by scanning the frame, incrementally:
+// a partial index covers a prefix of blocks.
+class Lz4BlockIndex {
+ public:
+  struct Entry {
+    uint32_t compressed_size;
+    uint32_t decompressed_size;
+  };
+
+  // The maximum number of blocks, limited by the size of the skippable frame.
+  static constexpr size_t kMaxNumBlocks = (uint32_t{0xffffffff} - 10) / 8;
+
+  // Writes an index of a frame with a header of `header_size` bytes, blocks
+  // described by `entries`, and a trailer of `trailer_size` bytes (the end mark
+  // and the content checksum if present).
+  //
+  // Precondition: `entries.size() <= kMaxNumBlocks`
+  //
+  // Return values:
+  //  * `true`  - success (`dest.ok()`)
+  //  * `false` - failure (`!dest.ok()`)
+  static bool Write(size_t header_size, absl::Span<const Entry> entries,
+                    size_t trailer_size, Writer& dest);
+
+  // Reads an index from the end of `src`, which must support random access,
+  // for a frame beginning at `initial_pos`.
+  //
+  // Returns `absl::nullopt` if `src` does not end with an index consistent
+  // with the size and the header of the frame, or if reading failed.
+  //
+  // The position of `src` is undefined afterwards.
+  static absl::optional<Lz4BlockIndex> Read(Reader& src, Position initial_pos);
+
+  // Begins building an index by scanning blocks of a frame beginning at
+  // `initial_pos`. The index covers no blocks until `ScanUntil()` is called.
+  //
+  // Returns `absl::nullopt` if the frame does not have independent blocks, if
+  // its header is invalid or truncated, or if reading failed.
+  //
+  // The position of `src` is undefined afterwards.
+  static absl::optional<Lz4BlockIndex> BeginScan(Reader& src,
+                                                 Position initial_pos);
+
+  // Continues scanning blocks of the frame beginning at `initial_pos`, until
+  // the index covers the decompressed position `pos` or the whole frame.
+  // Compressed blocks are parsed, but not decompressed, to find their
+  // decompressed sizes.
+  //
+  // Returns `false` if the frame is invalid or truncated, or if reading failed.
+  // Blocks scanned before remain valid.
+  //
+  // The position of `src` is undefined afterwards.
+  //
+  // Precondition: `!complete()`
+  bool ScanUntil(Reader& src, Position initial_pos, Position pos);
+
+  // If `src` is positioned at an index, skips it. A skippable frame is
+  // recognized as an index by its footer, which must be consistent with the
+  // size of the frame.
+  //
+  // Returns `false` if an index was not found, which is not an error. In this
+  // case the position of `src` is unchanged.
+  static bool SkipIfPresent(Reader& src);
+
+  // Returns a frame header equivalent to `header`, but without the content
+  // size and the content checksum flag, which makes it valid for a frame
+  // consisting of a suffix of blocks of the original frame.
+  //
+  // Precondition: `header` is a valid frame header with independent blocks.
+  static std::string RestartHeader(absl::string_view header);
+
+  // Returns `true` if the index covers all blocks of the frame. This is always
+  // the case for an index which was read.
+  bool complete() const { return complete_; }
+
+  // Returns the number of blocks covered by the index.
+  size_t num_blocks() const { return decompressed_starts_.size() - 1; }
+
+  // Returns the position of the beginning of a block, relative to the
+  // beginning of the frame or of the decompressed data.
+  //
+  // `block == num_blocks()` gives the end of the last block, i.e. the
+  // beginning of the trailer.
+  Position compressed_start(size_t block) const {
+    RIEGELI_ASSERT_LE(block, num_blocks())
+        << "Failed precondition of Lz4BlockIndex::compressed_start(): "
+           "block index out of range";
+    return compressed_starts_[block];
+  }
+  Position decompressed_start(size_t block) const {
+    RIEGELI_ASSERT_LE(block, num_blocks())
+        << "Failed precondition of Lz4BlockIndex::decompressed_start(): "
+           "block index out of range";
+    return decompressed_starts_[block];
+  }
+
+  // Returns the size of the frame header.
+  size_t header_size() const { return IntCast<size_t>(compressed_starts_[0]); }
+
+  // Returns the size of the content checksum following the end mark: 4 if it
+  // is present, otherwise 0.
+  size_t content_checksum_size() const { return content_checksum_size_; }
+
+  // Returns the size of the compressed stream, including the trailer and the
+  // index if it was read from the stream.
+  //
+  // Precondition: `complete()`
+  Position compressed_size() const {
+    RIEGELI_ASSERT(complete())
+        << "Failed precondition of Lz4BlockIndex::compressed_size(): "
+           "index not complete";
+    return compressed_size_;
+  }
+
+  // Returns the total decompressed size of blocks covered by the index.
+  Position decompressed_size() const { return decompressed_starts_.back(); }
+
+  // Returns the index of the block which contains the decompressed position
+  // `pos`.
+  //
+  // Precondition: `pos < decompressed_size()`
+  size_t BlockContaining(Position pos) const;
+
+ private:
+  Lz4BlockIndex() = default;
+
+  // Cumulative sizes of blocks, with `num_blocks() + 1` elements.
+  // `compressed_starts_` begins with the header size, `decompressed_starts_`
+  // begins with 0.
+  std::vector<Position> compressed_starts_;
+  std::vector<Position> decompressed_starts_;
+  bool block_checksum_ = false;
+  size_t content_checksum_size_ = 0;
+  bool complete_ = false;
+  Position compressed_size_ = 0;
+};
+
+}  // namespace lz4_internal
+}  // namespace riegeli
+
+#endif  // RIEGELI_LZ4_LZ4_BLOCK_INDEX_H_
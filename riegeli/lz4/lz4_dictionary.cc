@@ -19,12 +19,18 @@
 
 #include "riegeli/lz4/lz4_dictionary.h"
 
+#include <stddef.h>
+
 #include <memory>
 
 #include "absl/base/attributes.h"
 #include "absl/base/call_once.h"
 #include "absl/strings/string_view.h"
+#include "lz4.h"
 #include "lz4frame.h"
+#include "lz4hc.h"
+#include "riegeli/base/arithmetic.h"
+#include "riegeli/base/dictionary_cache.h"
 #include "riegeli/base/shared_ptr.h"
 
 namespace riegeli {
@@ -36,9 +42,23 @@ void Lz4Dictionary::Repr::LZ4F_CDictDeleter::operator()(LZ4F_CDict* ptr) const {
 inline const LZ4F_CDict* Lz4Dictionary::Repr::PrepareCompressionDictionary()
     const {
   absl::call_once(compression_once_, [&] {
-    compression_dictionary_.reset(LZ4F_createCDict(data_.data(), data_.size()));
+    compression_dictionary_ =
+        DictionaryCache::global().Get<LZ4F_CDict, LZ4F_CDictDeleter>(
+            "LZ4F_CDict", {}, data_,
+            [](absl::string_view data) {
+              return std::unique_ptr<LZ4F_CDict, LZ4F_CDictDeleter>(
+                  LZ4F_createCDict(data.data(), data.size()));
+            },
+            [&](ABSL_ATTRIBUTE_UNUSED const LZ4F_CDict* dictionary) {
+              // `LZ4F_CDict` is opaque. It holds the last 64K of the data and
+              // states of both fast and high compression.
+              return UnsignedMin(data_.size(), size_t{64 << 10}) +
+                     IntCast<size_t>(LZ4_sizeofState()) +
+                     IntCast<size_t>(LZ4_sizeofStateHC());
+            });
   });
-  return compression_dictionary_.get();
+  if (compression_dictionary_ == nullptr) return nullptr;
+  return compression_dictionary_->prepared<LZ4F_CDict>();
 }
 
 const LZ4F_CDict* Lz4Dictionary::PrepareCompressionDictionary() const
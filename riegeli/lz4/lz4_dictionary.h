@@ -29,6 +29,7 @@
 #include "absl/base/call_once.h"
 #include "absl/strings/string_view.h"
 #include "lz4frame.h"
+#include "riegeli/base/dictionary_cache.h"
 #include "riegeli/base/initializer.h"
 #include "riegeli/base/maker.h"
 #include "riegeli/base/shared_ptr.h"
@@ -163,8 +164,9 @@ class Lz4Dictionary::Repr {
   uint32_t dict_id_;
 
   mutable absl::once_flag compression_once_;
-  mutable std::unique_ptr<LZ4F_CDict, LZ4F_CDictDeleter>
-      compression_dictionary_;
+  // Owns the `LZ4F_CDict`, shared through `DictionaryCache::global()` with
+  // other dictionaries with the same contents.
+  mutable SharedPtr<const DictionaryCache::Entry> compression_dictionary_;
 };
 
 inline Lz4Dictionary& Lz4Dictionary::Reset() & ABSL_ATTRIBUTE_LIFETIME_BOUND {
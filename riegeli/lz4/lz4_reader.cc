@@ -22,6 +22,7 @@
 
 #include <limits>
 #include <memory>
+#include <string>
 #include <utility>
 
 #include "absl/base/optimization.h"
@@ -37,6 +38,7 @@
 #include "riegeli/base/types.h"
 #include "riegeli/bytes/buffered_reader.h"
 #include "riegeli/bytes/reader.h"
+#include "riegeli/lz4/lz4_block_index.h"
 
 namespace riegeli {
 
@@ -48,10 +50,32 @@ void Lz4ReaderBase::Initialize(Reader* src) {
     return;
   }
   initial_compressed_pos_ = src->pos();
+  // The block index is looked for lazily by `ProbeBlockIndex()`, unless it was
+  // already read by the `Lz4Reader` which created this one with `NewReader()`.
+  block_index_probed_ = block_index_ != nullptr || growing_source_;
   InitializeDecompressor(*src);
 }
 
-inline void Lz4ReaderBase::InitializeDecompressor(Reader& src) {
+bool Lz4ReaderBase::ProbeBlockIndex() {
+  if (block_index_probed_) return true;
+  block_index_probed_ = true;
+  if (ABSL_PREDICT_FALSE(!ok())) return false;
+  Reader& src = *SrcReader();
+  if (restart_header_.empty() || !src.SupportsRandomAccess()) return true;
+  const Position compressed_pos = src.pos();
+  absl::optional<lz4_internal::Lz4BlockIndex> block_index =
+      lz4_internal::Lz4BlockIndex::Read(src, initial_compressed_pos_);
+  if (ABSL_PREDICT_FALSE(!src.Seek(compressed_pos))) {
+    return FailWithoutAnnotation(AnnotateOverSrc(src.StatusOrAnnotate(
+        absl::DataLossError("Lz4-compressed stream got truncated"))));
+  }
+  if (block_index == absl::nullopt) return true;
+  block_index_.Reset(std::move(*block_index));
+  set_exact_size(block_index_->decompressed_size());
+  return true;
+}
+
+inline bool Lz4ReaderBase::GetDecompressor() {
   LZ4F_errorCode_t result = 0;
   decompressor_ = RecyclingPool<LZ4F_dctx, LZ4F_dctxDeleter>::global(
                       recycling_pool_options_)
@@ -67,11 +91,16 @@ inline void Lz4ReaderBase::InitializeDecompressor(Reader& src) {
                             LZ4F_resetDecompressionContext(decompressor);
                           });
   if (ABSL_PREDICT_FALSE(LZ4F_isError(result))) {
-    Fail(absl::InternalError(
+    return Fail(absl::InternalError(
         absl::StrCat("LZ4F_createDecompressionContext() failed: ",
                      LZ4F_getErrorName(result))));
-    return;
   }
+  return true;
+}
+
+inline void Lz4ReaderBase::InitializeDecompressor(Reader& src) {
+  restarted_ = false;
+  if (ABSL_PREDICT_FALSE(!GetDecompressor())) return;
   ReadHeader(src);
 }
 
@@ -110,10 +139,25 @@ inline bool Lz4ReaderBase::ReadHeader(Reader& src) {
     return Fail(absl::InvalidArgumentError(absl::StrCat(
         "LZ4F_getFrameInfo() failed: ", LZ4F_getErrorName(result))));
   }
+  if (frame_info.blockMode == LZ4F_blockIndependent) {
+    restart_header_ = lz4_internal::Lz4BlockIndex::RestartHeader(
+        absl::string_view(src.cursor(), length));
+  } else {
+    restart_header_.clear();
+  }
   src.move_cursor(length);
   header_read_ = true;
 
-  if (frame_info.contentSize > 0) set_exact_size(frame_info.contentSize);
+  if (block_index_ != nullptr &&
+      (restart_header_.empty() || block_index_->header_size() != length)) {
+    // The block index does not describe this frame.
+    block_index_.Reset();
+  }
+  if (block_index_ != nullptr) {
+    set_exact_size(block_index_->decompressed_size());
+  } else if (frame_info.contentSize > 0) {
+    set_exact_size(frame_info.contentSize);
+  }
   if (frame_info.dictID > 0 &&
       ABSL_PREDICT_FALSE(frame_info.dictID != dictionary_.dict_id())) {
     if (dictionary_.empty()) {
@@ -131,6 +175,26 @@ inline bool Lz4ReaderBase::ReadHeader(Reader& src) {
   return true;
 }
 
+inline bool Lz4ReaderBase::RestartDecompressor() {
+  if (ABSL_PREDICT_FALSE(!GetDecompressor())) return false;
+  char dest[1];
+  size_t dest_length = 0;
+  size_t src_length = restart_header_.size();
+  const size_t result = LZ4F_decompress_usingDict(
+      decompressor_.get(), dest, &dest_length, restart_header_.data(),
+      &src_length, dictionary_.data().data(), dictionary_.data().size(),
+      nullptr);
+  if (ABSL_PREDICT_FALSE(LZ4F_isError(result))) {
+    return Fail(absl::InvalidArgumentError(absl::StrCat(
+        "LZ4F_decompress_usingDict() failed: ", LZ4F_getErrorName(result))));
+  }
+  RIEGELI_ASSERT_EQ(src_length, restart_header_.size())
+      << "LZ4F_decompress_usingDict() did not consume the whole frame header";
+  header_read_ = true;
+  restarted_ = true;
+  return true;
+}
+
 void Lz4ReaderBase::Done() {
   if (ABSL_PREDICT_FALSE(truncated_) && growing_source_) {
     Reader& src = *SrcReader();
@@ -202,6 +266,31 @@ bool Lz4ReaderBase::ReadInternal(size_t min_length, size_t max_length,
       decompressor_.reset();
       // Avoid `BufferedReader` allocating another buffer.
       set_exact_size(limit_pos());
+      if (block_index_ != nullptr) {
+        // Skip the content checksum if decompression began at a later block,
+        // and the block index if it is stored.
+        if (ABSL_PREDICT_FALSE(!src.Seek(initial_compressed_pos_ +
+                                         block_index_->compressed_size()))) {
+          FailWithoutAnnotation(AnnotateOverSrc(src.StatusOrAnnotate(
+              absl::DataLossError("Lz4-compressed stream got truncated"))));
+        }
+      } else {
+        if (restarted_ && partial_block_index_ != absl::nullopt) {
+          // Skip the content checksum if decompression began at a later block
+          // of a partially scanned frame.
+          if (ABSL_PREDICT_FALSE(
+                  !src.Skip(partial_block_index_->content_checksum_size()))) {
+            FailWithoutAnnotation(AnnotateOverSrc(src.StatusOrAnnotate(
+                absl::InvalidArgumentError(
+                    "Truncated Lz4-compressed stream"))));
+            return dest_length >= min_length;
+          }
+        }
+        if (src.ToleratesReadingAhead() || src.SupportsRandomAccess()) {
+          // Skip the block index if it is stored but was not read.
+          lz4_internal::Lz4BlockIndex::SkipIfPresent(src);
+        }
+      }
       return dest_length >= min_length;
     }
     if (ABSL_PREDICT_FALSE(LZ4F_isError(result))) {
@@ -257,6 +346,10 @@ bool Lz4ReaderBase::ToleratesReadingAhead() {
   return src != nullptr && src->ToleratesReadingAhead();
 }
 
+bool Lz4ReaderBase::SupportsRandomAccess() {
+  return ProbeBlockIndex() && block_index_ != nullptr;
+}
+
 bool Lz4ReaderBase::SupportsRewind() {
   Reader* const src = SrcReader();
   return src != nullptr && src->SupportsRewind();
@@ -269,6 +362,23 @@ bool Lz4ReaderBase::SeekBehindBuffer(Position new_pos) {
   RIEGELI_ASSERT_EQ(start_to_limit(), 0u)
       << "Failed precondition of BufferedReader::SeekBehindBuffer(): "
          "buffer not empty";
+  if (new_pos <= limit_pos()) {
+    // Seeking backwards. A block index avoids decompressing from the
+    // beginning.
+    if (ABSL_PREDICT_FALSE(!ProbeBlockIndex())) return false;
+    if (block_index_ == nullptr && new_pos > 0 && ABSL_PREDICT_TRUE(ok())) {
+      // Not seeking to the beginning. Try to extend a block index so that this
+      // and later seeks do not decompress from the beginning.
+      ScanBlockIndex(*SrcReader(), new_pos);
+    }
+  }
+  if (block_index_ != nullptr) {
+    return SeekWithBlockIndex(*block_index_, new_pos);
+  }
+  if (partial_block_index_ != absl::nullopt &&
+      new_pos < partial_block_index_->decompressed_size()) {
+    return SeekWithBlockIndex(*partial_block_index_, new_pos);
+  }
   if (new_pos <= limit_pos()) {
     // Seeking backwards.
     if (ABSL_PREDICT_FALSE(!ok())) return false;
@@ -276,6 +386,7 @@ bool Lz4ReaderBase::SeekBehindBuffer(Position new_pos) {
     truncated_ = false;
     set_buffer();
     set_limit_pos(0);
+    BeginRun();
     decompressor_.reset();
     if (ABSL_PREDICT_FALSE(!src.Seek(initial_compressed_pos_))) {
       return FailWithoutAnnotation(AnnotateOverSrc(src.StatusOrAnnotate(
@@ -288,6 +399,101 @@ bool Lz4ReaderBase::SeekBehindBuffer(Position new_pos) {
   return BufferedReader::SeekBehindBuffer(new_pos);
 }
 
+inline void Lz4ReaderBase::ScanBlockIndex(Reader& src, Position new_pos) {
+  if (scan_failed_) return;
+  if (partial_block_index_ == absl::nullopt) {
+    if (restart_header_.empty() || growing_source_ ||
+        !src.SupportsRandomAccess()) {
+      scan_failed_ = true;
+      return;
+    }
+    partial_block_index_ =
+        lz4_internal::Lz4BlockIndex::BeginScan(src, initial_compressed_pos_);
+    if (partial_block_index_ == absl::nullopt) {
+      scan_failed_ = true;
+      return;
+    }
+  } else if (new_pos < partial_block_index_->decompressed_size()) {
+    return;
+  }
+  if (!partial_block_index_->ScanUntil(src, initial_compressed_pos_,
+                                       new_pos)) {
+    scan_failed_ = true;
+    return;
+  }
+  if (partial_block_index_->complete()) {
+    block_index_.Reset(std::move(*partial_block_index_));
+    partial_block_index_ = absl::nullopt;
+    set_exact_size(block_index_->decompressed_size());
+  }
+}
+
+inline bool Lz4ReaderBase::SeekWithBlockIndex(
+    const lz4_internal::Lz4BlockIndex& block_index, Position new_pos) {
+  if (ABSL_PREDICT_FALSE(!ok())) return false;
+  Reader& src = *SrcReader();
+  const Position size = block_index.decompressed_size();
+  if (new_pos >= size) {
+    // Seeking to the end or beyond.
+    RIEGELI_ASSERT(block_index.complete())
+        << "Failed precondition of Lz4ReaderBase::SeekWithBlockIndex(): "
+           "position not covered by a partial block index";
+    truncated_ = false;
+    set_buffer();
+    set_limit_pos(size);
+    BeginRun();
+    decompressor_.reset();
+    if (ABSL_PREDICT_FALSE(!src.Seek(initial_compressed_pos_ +
+                                     block_index.compressed_size()))) {
+      return FailWithoutAnnotation(AnnotateOverSrc(src.StatusOrAnnotate(
+          absl::DataLossError("Lz4-compressed stream got truncated"))));
+    }
+    return new_pos == size;
+  }
+  const size_t block = block_index.BlockContaining(new_pos);
+  if (new_pos < limit_pos() || decompressor_ == nullptr ||
+      limit_pos() < block_index.decompressed_start(block)) {
+    // Decompress the block containing `new_pos` from its beginning. Otherwise
+    // `new_pos` is in the block being decompressed, ahead of the current
+    // position, and it is faster to continue.
+    truncated_ = false;
+    set_buffer();
+    set_limit_pos(block_index.decompressed_start(block));
+    BeginRun();
+    decompressor_.reset();
+    if (block == 0) {
+      // Begin with the original frame header, so that the content checksum is
+      // verified if present.
+      if (ABSL_PREDICT_FALSE(!src.Seek(initial_compressed_pos_))) {
+        return FailWithoutAnnotation(AnnotateOverSrc(src.StatusOrAnnotate(
+            absl::DataLossError("Lz4-compressed stream got truncated"))));
+      }
+      InitializeDecompressor(src);
+      if (ABSL_PREDICT_FALSE(!ok())) return false;
+    } else {
+      if (ABSL_PREDICT_FALSE(
+              !src.Seek(initial_compressed_pos_ +
+                        block_index.compressed_start(block)))) {
+        return FailWithoutAnnotation(AnnotateOverSrc(src.StatusOrAnnotate(
+            absl::DataLossError("Lz4-compressed stream got truncated"))));
+      }
+      if (ABSL_PREDICT_FALSE(!RestartDecompressor())) return false;
+    }
+    if (new_pos == limit_pos()) return true;
+  }
+  return BufferedReader::SeekBehindBuffer(new_pos);
+}
+
+bool Lz4ReaderBase::SupportsSize() {
+  if (ABSL_PREDICT_FALSE(!ProbeBlockIndex())) return false;
+  return BufferedReader::SupportsSize();
+}
+
+absl::optional<Position> Lz4ReaderBase::SizeImpl() {
+  if (ABSL_PREDICT_FALSE(!ProbeBlockIndex())) return absl::nullopt;
+  return BufferedReader::SizeImpl();
+}
+
 bool Lz4ReaderBase::SupportsNewReader() {
   Reader* const src = SrcReader();
   return src != nullptr && src->SupportsNewReader();
@@ -296,7 +502,9 @@ bool Lz4ReaderBase::SupportsNewReader() {
 std::unique_ptr<Reader> Lz4ReaderBase::NewReaderImpl(Position initial_pos) {
   if (ABSL_PREDICT_FALSE(!ok())) return nullptr;
   // `NewReaderImpl()` is thread-safe from this point
-  // if `SrcReader()->SupportsNewReader()`.
+  // if `SrcReader()->SupportsNewReader()`. Hence the block index is not looked
+  // for here. If it is not known yet, the new `Lz4Reader` looks for it when
+  // needed.
   Reader& src = *SrcReader();
   std::unique_ptr<Reader> compressed_reader =
       src.NewReader(initial_compressed_pos_);
@@ -304,14 +512,15 @@ std::unique_ptr<Reader> Lz4ReaderBase::NewReaderImpl(Position initial_pos) {
     FailWithoutAnnotation(AnnotateOverSrc(src.status()));
     return nullptr;
   }
+  Lz4ReaderBase::Options options;
+  options.set_growing_source(growing_source_)
+      .set_dictionary(dictionary_)
+      .set_buffer_options(buffer_options())
+      .set_recycling_pool_options(recycling_pool_options_);
+  options.block_index_ = block_index_;
   std::unique_ptr<Reader> reader =
       std::make_unique<Lz4Reader<std::unique_ptr<Reader>>>(
-          std::move(compressed_reader),
-          Lz4ReaderBase::Options()
-              .set_growing_source(growing_source_)
-              .set_dictionary(dictionary_)
-              .set_buffer_options(buffer_options())
-              .set_recycling_pool_options(recycling_pool_options_));
+          std::move(compressed_reader), std::move(options));
   reader->Seek(initial_pos);
   return reader;
 }
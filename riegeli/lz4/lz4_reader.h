@@ -18,6 +18,7 @@
 #include <stddef.h>
 
 #include <memory>
+#include <string>
 #include <utility>
 
 #include "absl/base/attributes.h"
@@ -31,10 +32,12 @@
 #include "riegeli/base/initializer.h"
 #include "riegeli/base/object.h"
 #include "riegeli/base/recycling_pool.h"
+#include "riegeli/base/shared_ptr.h"
 #include "riegeli/base/types.h"
 #include "riegeli/bytes/buffer_options.h"
 #include "riegeli/bytes/buffered_reader.h"
 #include "riegeli/bytes/reader.h"
+#include "riegeli/lz4/lz4_block_index.h"
 #include "riegeli/lz4/lz4_dictionary.h"  // IWYU pragma: export
 
 namespace riegeli {
@@ -113,6 +116,10 @@ class Lz4ReaderBase : public BufferedReader {
     }
 
    private:
+    friend class Lz4ReaderBase;  // For `block_index_`.
+    template <typename Src>
+    friend class Lz4Reader;  // For `block_index_`.
+
     bool growing_source_ = false;
     Lz4Dictionary dictionary_;
     RecyclingPoolOptions recycling_pool_options_
@@ -121,6 +128,9 @@ class Lz4ReaderBase : public BufferedReader {
         = RecyclingPoolOptions().set_max_size(0)
 #endif
         ;
+    // Block index already read or built by another `Lz4Reader` from the same
+    // source, so that `NewReader()` does not read it again.
+    SharedPtr<const lz4_internal::Lz4BlockIndex> block_index_;
   };
 
   // Returns the compressed `Reader`. Unchanged by `Close()`.
@@ -132,15 +142,19 @@ class Lz4ReaderBase : public BufferedReader {
   bool truncated() const { return truncated_ && available() == 0; }
 
   bool ToleratesReadingAhead() override;
+  bool SupportsRandomAccess() override;
   bool SupportsRewind() override;
+  bool SupportsSize() override;
   bool SupportsNewReader() override;
 
  protected:
   explicit Lz4ReaderBase(Closed) noexcept : BufferedReader(kClosed) {}
 
-  explicit Lz4ReaderBase(BufferOptions buffer_options, bool growing_source,
-                         Lz4Dictionary&& dictionary,
-                         const RecyclingPoolOptions& recycling_pool_options);
+  explicit Lz4ReaderBase(
+      BufferOptions buffer_options, bool growing_source,
+      Lz4Dictionary&& dictionary,
+      const RecyclingPoolOptions& recycling_pool_options,
+      SharedPtr<const lz4_internal::Lz4BlockIndex>&& block_index);
 
   Lz4ReaderBase(Lz4ReaderBase&& that) noexcept;
   Lz4ReaderBase& operator=(Lz4ReaderBase&& that) noexcept;
@@ -148,7 +162,8 @@ class Lz4ReaderBase : public BufferedReader {
   void Reset(Closed);
   void Reset(BufferOptions buffer_options, bool growing_source,
              Lz4Dictionary&& dictionary,
-             const RecyclingPoolOptions& recycling_pool_options);
+             const RecyclingPoolOptions& recycling_pool_options,
+             SharedPtr<const lz4_internal::Lz4BlockIndex>&& block_index);
   void Initialize(Reader* src);
   ABSL_ATTRIBUTE_COLD absl::Status AnnotateOverSrc(absl::Status status);
 
@@ -158,6 +173,7 @@ class Lz4ReaderBase : public BufferedReader {
   bool ReadInternal(size_t min_length, size_t max_length, char* dest) override;
   void ExactSizeReached() override;
   bool SeekBehindBuffer(Position new_pos) override;
+  absl::optional<Position> SizeImpl() override;
   std::unique_ptr<Reader> NewReaderImpl(Position initial_pos) override;
 
  private:
@@ -175,8 +191,20 @@ class Lz4ReaderBase : public BufferedReader {
     }
   };
 
+  bool GetDecompressor();
   void InitializeDecompressor(Reader& src);
   bool ReadHeader(Reader& src);
+  bool RestartDecompressor();
+  // Looks for a stored block index if this was not done yet, preserving the
+  // position of the source. Returns `false` on failure (`!ok()`).
+  bool ProbeBlockIndex();
+  // Extends `partial_block_index_` by scanning the frame, so that it covers
+  // `new_pos` if possible. Moves it to `block_index_` if it becomes complete.
+  void ScanBlockIndex(Reader& src, Position new_pos);
+  // Precondition: `new_pos < block_index.decompressed_size()` or
+  // `block_index.complete()`
+  bool SeekWithBlockIndex(const lz4_internal::Lz4BlockIndex& block_index,
+                          Position new_pos);
 
   // If `true`, supports decompressing as much as possible from a truncated
   // source, then retrying when the source has grown.
@@ -187,9 +215,27 @@ class Lz4ReaderBase : public BufferedReader {
   bool truncated_ = false;
   // If `true`, the frame header has been read.
   bool header_read_ = false;
+  // If `true`, decompression began at a later block, and the content checksum
+  // is not verified.
+  bool restarted_ = false;
   Lz4Dictionary dictionary_;
   RecyclingPoolOptions recycling_pool_options_;
   Position initial_compressed_pos_ = 0;
+  // If not empty, the frame has independent blocks, and this is a frame header
+  // which lets the decompressor begin at any block.
+  std::string restart_header_;
+  // If `false`, it is not known yet whether the source ends with a block index,
+  // and `block_index_ == nullptr`.
+  bool block_index_probed_ = false;
+  // If not `nullptr`, `exact_size()` is the total decompressed size, and
+  // decompression can begin at any block.
+  SharedPtr<const lz4_internal::Lz4BlockIndex> block_index_;
+  // If `block_index_ == nullptr`, blocks scanned so far, or `absl::nullopt` if
+  // scanning did not begin.
+  absl::optional<lz4_internal::Lz4BlockIndex> partial_block_index_;
+  // If `true`, scanning the frame is not possible or failed, and it is not
+  // attempted again.
+  bool scan_failed_ = false;
   // If `ok()` but `decompressor_ == nullptr` then all data have been
   // decompressed, `exact_size() == limit_pos()`, and `ReadInternal()` must not
   // be called again.
@@ -210,6 +256,19 @@ class Lz4ReaderBase : public BufferedReader {
 // `InitializerTargetT` of the type of the first constructor argument.
 // This requires C++17.
 //
+// If the compressed `Reader` supports random access and the frame was written
+// with `Lz4WriterBase::Options::set_block_index()`, `Lz4Reader` supports random
+// access, and seeking decompresses only the blocks containing the new position.
+// If the frame has independent blocks but no block index, a block index is
+// built by scanning the frame when seeking backwards, only up to the block
+// containing the new position.
+//
+// A stored block index is looked for only when needed: by
+// `SupportsRandomAccess()`, `SupportsSize()`, `Size()`, or seeking backwards.
+// Decompressing sequentially does not pay for it.
+// Decompression which does not begin at the beginning of the frame does not
+// verify the content checksum.
+//
 // The compressed `Reader` must not be accessed until the `Lz4Reader` is closed
 // or no longer used.
 template <typename Src = Reader*>
@@ -281,20 +340,28 @@ absl::optional<Position> Lz4UncompressedSize(
 inline Lz4ReaderBase::Lz4ReaderBase(
     BufferOptions buffer_options, bool growing_source,
     Lz4Dictionary&& dictionary,
-    const RecyclingPoolOptions& recycling_pool_options)
+    const RecyclingPoolOptions& recycling_pool_options,
+    SharedPtr<const lz4_internal::Lz4BlockIndex>&& block_index)
     : BufferedReader(buffer_options),
       growing_source_(growing_source),
       dictionary_(std::move(dictionary)),
-      recycling_pool_options_(recycling_pool_options) {}
+      recycling_pool_options_(recycling_pool_options),
+      block_index_(std::move(block_index)) {}
 
 inline Lz4ReaderBase::Lz4ReaderBase(Lz4ReaderBase&& that) noexcept
     : BufferedReader(static_cast<BufferedReader&&>(that)),
       growing_source_(that.growing_source_),
       truncated_(that.truncated_),
       header_read_(that.header_read_),
+      restarted_(that.restarted_),
       dictionary_(std::move(that.dictionary_)),
       recycling_pool_options_(that.recycling_pool_options_),
       initial_compressed_pos_(that.initial_compressed_pos_),
+      restart_header_(std::move(that.restart_header_)),
+      block_index_probed_(that.block_index_probed_),
+      block_index_(std::move(that.block_index_)),
+      partial_block_index_(std::move(that.partial_block_index_)),
+      scan_failed_(that.scan_failed_),
       decompressor_(std::move(that.decompressor_)) {}
 
 inline Lz4ReaderBase& Lz4ReaderBase::operator=(Lz4ReaderBase&& that) noexcept {
@@ -302,9 +369,15 @@ inline Lz4ReaderBase& Lz4ReaderBase::operator=(Lz4ReaderBase&& that) noexcept {
   growing_source_ = that.growing_source_;
   truncated_ = that.truncated_;
   header_read_ = that.header_read_;
+  restarted_ = that.restarted_;
   dictionary_ = std::move(that.dictionary_);
   recycling_pool_options_ = that.recycling_pool_options_;
   initial_compressed_pos_ = that.initial_compressed_pos_;
+  restart_header_ = std::move(that.restart_header_);
+  block_index_probed_ = that.block_index_probed_;
+  block_index_ = std::move(that.block_index_);
+  partial_block_index_ = std::move(that.partial_block_index_);
+  scan_failed_ = that.scan_failed_;
   decompressor_ = std::move(that.decompressor_);
   return *this;
 }
@@ -314,8 +387,14 @@ inline void Lz4ReaderBase::Reset(Closed) {
   growing_source_ = false;
   truncated_ = false;
   header_read_ = false;
+  restarted_ = false;
   recycling_pool_options_ = RecyclingPoolOptions();
   initial_compressed_pos_ = 0;
+  restart_header_ = std::string();
+  block_index_probed_ = false;
+  block_index_.Reset();
+  partial_block_index_ = absl::nullopt;
+  scan_failed_ = false;
   decompressor_.reset();
   dictionary_ = Lz4Dictionary();
 }
@@ -323,13 +402,20 @@ inline void Lz4ReaderBase::Reset(Closed) {
 inline void Lz4ReaderBase::Reset(
     BufferOptions buffer_options, bool growing_source,
     Lz4Dictionary&& dictionary,
-    const RecyclingPoolOptions& recycling_pool_options) {
+    const RecyclingPoolOptions& recycling_pool_options,
+    SharedPtr<const lz4_internal::Lz4BlockIndex>&& block_index) {
   BufferedReader::Reset(buffer_options);
   growing_source_ = growing_source;
   truncated_ = false;
   header_read_ = false;
+  restarted_ = false;
   recycling_pool_options_ = recycling_pool_options;
   initial_compressed_pos_ = 0;
+  restart_header_.clear();
+  block_index_probed_ = false;
+  block_index_ = std::move(block_index);
+  partial_block_index_ = absl::nullopt;
+  scan_failed_ = false;
   decompressor_.reset();
   dictionary_ = std::move(dictionary);
 }
@@ -338,7 +424,8 @@ template <typename Src>
 inline Lz4Reader<Src>::Lz4Reader(Initializer<Src> src, Options options)
     : Lz4ReaderBase(options.buffer_options(), options.growing_source(),
                     std::move(options.dictionary()),
-                    options.recycling_pool_options()),
+                    options.recycling_pool_options(),
+                    std::move(options.block_index_)),
       src_(std::move(src)) {
   Initialize(src_.get());
 }
@@ -353,7 +440,8 @@ template <typename Src>
 inline void Lz4Reader<Src>::Reset(Initializer<Src> src, Options options) {
   Lz4ReaderBase::Reset(options.buffer_options(), options.growing_source(),
                        std::move(options.dictionary()),
-                       options.recycling_pool_options());
+                       options.recycling_pool_options(),
+                       std::move(options.block_index_));
   src_.Reset(std::move(src));
   Initialize(src_.get());
 }
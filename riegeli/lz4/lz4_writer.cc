@@ -19,10 +19,15 @@
 #include "riegeli/lz4/lz4_writer.h"
 
 #include <stddef.h>
+#include <stdint.h>
 
+#include <deque>
+#include <future>
 #include <limits>
 #include <memory>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
@@ -32,13 +37,18 @@
 #include "lz4frame.h"
 #include "riegeli/base/arithmetic.h"
 #include "riegeli/base/assert.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/base/recycling_pool.h"
 #include "riegeli/base/status.h"
 #include "riegeli/base/types.h"
 #include "riegeli/bytes/buffered_writer.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/bytes/writer.h"
+#include "riegeli/endian/endian_writing.h"
+#include "riegeli/lz4/lz4_block_index.h"
+#include "riegeli/lz4/lz4_dictionary.h"
 #include "riegeli/lz4/lz4_reader.h"
+#include "riegeli/lz4/lz4_xxh32.h"
 
 namespace riegeli {
 
@@ -54,9 +64,227 @@ constexpr int Lz4WriterBase::Options::kMaxWindowLog;
 constexpr int Lz4WriterBase::Options::kDefaultWindowLog;
 #endif
 
+class Lz4WriterBase::ParallelCompressor {
+ public:
+  explicit ParallelCompressor(
+      int parallelism, const LZ4F_preferences_t& preferences,
+      const Lz4Dictionary& dictionary,
+      const RecyclingPoolOptions& recycling_pool_options, size_t block_size,
+      bool store_block_index, size_t header_size);
+
+  // Compresses `src`, writing compressed blocks to `dest` when they are ready.
+  // If `flush`, ends the current block, and writes all remaining compressed
+  // blocks.
+  //
+  // Returns `false` on failure: of `dest`, or with `status()`.
+  bool Write(absl::string_view src, Writer& dest, bool flush);
+
+  // Writes all remaining compressed blocks, the end mark, the content checksum
+  // if enabled, and the block index if enabled.
+  //
+  // Returns `false` on failure: of `dest`, or with `status()`.
+  bool Finish(Writer& dest);
+
+  const absl::Status& status() const { return status_; }
+
+ private:
+  struct CompressedBlock {
+    absl::Status status;
+    // The block with its header and its checksum if enabled.
+    std::string data;
+    uint32_t decompressed_size = 0;
+  };
+
+  // Compresses a block by starting a frame in a separate `LZ4F_cctx` with the
+  // same preferences, with the frame header discarded.
+  static CompressedBlock CompressBlock(
+      const LZ4F_preferences_t& preferences, const Lz4Dictionary& dictionary,
+      const RecyclingPoolOptions& recycling_pool_options,
+      const std::string& src);
+
+  bool ScheduleBlock(Writer& dest);
+  bool WriteBlock(Writer& dest);
+
+  size_t parallelism_;
+  // Preferences for compressing individual blocks.
+  LZ4F_preferences_t block_preferences_;
+  Lz4Dictionary dictionary_;
+  RecyclingPoolOptions recycling_pool_options_;
+  size_t block_size_;
+  bool store_block_index_;
+  size_t header_size_;
+  // If not `absl::nullopt`, the content checksum is stored.
+  absl::optional<lz4_internal::Xxh32> content_checksum_;
+  // Uncompressed data of the current block.
+  std::string block_;
+  // Blocks being compressed, in order.
+  std::deque<std::future<CompressedBlock>> compressed_blocks_;
+  // Sizes of blocks written so far, if `store_block_index_`.
+  std::vector<lz4_internal::Lz4BlockIndex::Entry> block_index_entries_;
+  absl::Status status_;
+};
+
+void Lz4WriterBase::ParallelCompressorDeleter::operator()(
+    ParallelCompressor* ptr) const {
+  delete ptr;
+}
+
+Lz4WriterBase::ParallelCompressor::ParallelCompressor(
+    int parallelism, const LZ4F_preferences_t& preferences,
+    const Lz4Dictionary& dictionary,
+    const RecyclingPoolOptions& recycling_pool_options, size_t block_size,
+    bool store_block_index, size_t header_size)
+    : parallelism_(IntCast<size_t>(parallelism)),
+      block_preferences_(preferences),
+      dictionary_(dictionary),
+      recycling_pool_options_(recycling_pool_options),
+      block_size_(block_size),
+      store_block_index_(store_block_index),
+      header_size_(header_size) {
+  if (preferences.frameInfo.contentChecksumFlag ==
+      LZ4F_contentChecksumEnabled) {
+    content_checksum_.emplace();
+  }
+  block_preferences_.frameInfo.blockMode = LZ4F_blockIndependent;
+  block_preferences_.frameInfo.contentChecksumFlag = LZ4F_noContentChecksum;
+  block_preferences_.frameInfo.contentSize = 0;
+  block_preferences_.autoFlush = 1;
+}
+
+Lz4WriterBase::ParallelCompressor::CompressedBlock
+Lz4WriterBase::ParallelCompressor::CompressBlock(
+    const LZ4F_preferences_t& preferences, const Lz4Dictionary& dictionary,
+    const RecyclingPoolOptions& recycling_pool_options,
+    const std::string& src) {
+  CompressedBlock block;
+  block.decompressed_size = IntCast<uint32_t>(src.size());
+  LZ4F_errorCode_t create_result = 0;
+  const RecyclingPool<LZ4F_cctx, LZ4F_cctxDeleter>::Handle compressor =
+      RecyclingPool<LZ4F_cctx, LZ4F_cctxDeleter>::global(
+          recycling_pool_options)
+          .Get([&create_result] {
+            LZ4F_cctx* compressor = nullptr;
+            create_result =
+                LZ4F_createCompressionContext(&compressor, LZ4F_VERSION);
+            return std::unique_ptr<LZ4F_cctx, LZ4F_cctxDeleter>(compressor);
+          });
+  if (ABSL_PREDICT_FALSE(LZ4F_isError(create_result))) {
+    block.status = absl::InternalError(
+        absl::StrCat("LZ4F_createCompressionContext() failed: ",
+                     LZ4F_getErrorName(create_result)));
+    return block;
+  }
+  char header[LZ4F_HEADER_SIZE_MAX];
+  const size_t begin_result = LZ4F_compressBegin_usingCDict(
+      compressor.get(), header, sizeof(header),
+      dictionary.PrepareCompressionDictionary(), &preferences);
+  if (ABSL_PREDICT_FALSE(LZ4F_isError(begin_result))) {
+    block.status = absl::InternalError(
+        absl::StrCat("LZ4F_compressBegin_usingCDict() failed: ",
+                     LZ4F_getErrorName(begin_result)));
+    return block;
+  }
+  block.data.resize(LZ4F_compressBound(src.size(), &preferences));
+  LZ4F_compressOptions_t compress_options{};
+  compress_options.stableSrc = 1;
+  // With `autoFlush`, the block is written immediately.
+  const size_t result = LZ4F_compressUpdate(
+      compressor.get(), &block.data[0], block.data.size(), src.data(),
+      src.size(), &compress_options);
+  if (ABSL_PREDICT_FALSE(LZ4F_isError(result))) {
+    block.status = absl::InternalError(absl::StrCat(
+        "LZ4F_compressUpdate() failed: ", LZ4F_getErrorName(result)));
+    return block;
+  }
+  block.data.resize(result);
+  return block;
+}
+
+bool Lz4WriterBase::ParallelCompressor::Write(absl::string_view src,
+                                              Writer& dest, bool flush) {
+  if (content_checksum_ != absl::nullopt) content_checksum_->Update(src);
+  while (!src.empty()) {
+    if (block_.empty()) block_.reserve(block_size_);
+    const size_t length = UnsignedMin(src.size(), block_size_ - block_.size());
+    block_.append(src.data(), length);
+    src.remove_prefix(length);
+    if (block_.size() == block_size_) {
+      if (ABSL_PREDICT_FALSE(!ScheduleBlock(dest))) return false;
+    }
+  }
+  if (!flush) return true;
+  if (!block_.empty()) {
+    if (ABSL_PREDICT_FALSE(!ScheduleBlock(dest))) return false;
+  }
+  while (!compressed_blocks_.empty()) {
+    if (ABSL_PREDICT_FALSE(!WriteBlock(dest))) return false;
+  }
+  return true;
+}
+
+bool Lz4WriterBase::ParallelCompressor::Finish(Writer& dest) {
+  if (ABSL_PREDICT_FALSE(!Write(absl::string_view(), dest, true))) {
+    return false;
+  }
+  // End mark.
+  if (ABSL_PREDICT_FALSE(!WriteLittleEndian32(0, dest))) return false;
+  size_t trailer_size = sizeof(uint32_t);
+  if (content_checksum_ != absl::nullopt) {
+    if (ABSL_PREDICT_FALSE(
+            !WriteLittleEndian32(content_checksum_->Digest(), dest))) {
+      return false;
+    }
+    trailer_size += sizeof(uint32_t);
+  }
+  if (store_block_index_) {
+    return lz4_internal::Lz4BlockIndex::Write(
+        header_size_, block_index_entries_, trailer_size, dest);
+  }
+  return true;
+}
+
+bool Lz4WriterBase::ParallelCompressor::ScheduleBlock(Writer& dest) {
+  while (compressed_blocks_.size() >= parallelism_) {
+    if (ABSL_PREDICT_FALSE(!WriteBlock(dest))) return false;
+  }
+  std::promise<CompressedBlock> promise;
+  compressed_blocks_.push_back(promise.get_future());
+  internal::ThreadPool::global().Schedule(
+      [promise = std::move(promise), preferences = block_preferences_,
+       dictionary = dictionary_,
+       recycling_pool_options = recycling_pool_options_,
+       block = std::move(block_)]() mutable {
+        promise.set_value(CompressBlock(preferences, dictionary,
+                                        recycling_pool_options, block));
+      });
+  block_ = std::string();
+  return true;
+}
+
+bool Lz4WriterBase::ParallelCompressor::WriteBlock(Writer& dest) {
+  const CompressedBlock block = compressed_blocks_.front().get();
+  compressed_blocks_.pop_front();
+  if (ABSL_PREDICT_FALSE(!block.status.ok())) {
+    status_ = block.status;
+    return false;
+  }
+  if (store_block_index_) {
+    if (ABSL_PREDICT_FALSE(block_index_entries_.size() ==
+                           lz4_internal::Lz4BlockIndex::kMaxNumBlocks)) {
+      status_ = absl::ResourceExhaustedError(
+          "Too many blocks for an Lz4 block index");
+      return false;
+    }
+    block_index_entries_.push_back(lz4_internal::Lz4BlockIndex::Entry{
+        IntCast<uint32_t>(block.data.size()), block.decompressed_size});
+  }
+  return dest.Write(block.data);
+}
+
 void Lz4WriterBase::Initialize(Writer* dest, int compression_level,
                                int window_log, bool store_content_checksum,
-                               bool store_block_checksum) {
+                               bool store_block_checksum, int parallelism,
+                               bool block_index) {
   RIEGELI_ASSERT(dest != nullptr)
       << "Failed precondition of Lz4Writer: null Writer pointer";
   if (ABSL_PREDICT_FALSE(!dest->ok())) {
@@ -107,6 +335,10 @@ void Lz4WriterBase::Initialize(Writer* dest, int compression_level,
   preferences_.frameInfo.dictID = dictionary_.dict_id();
   preferences_.frameInfo.blockChecksumFlag =
       store_block_checksum ? LZ4F_blockChecksumEnabled : LZ4F_noBlockChecksum;
+  if (block_index) parallelism = SignedMax(parallelism, 1);
+  if (parallelism > 0) {
+    preferences_.frameInfo.blockMode = LZ4F_blockIndependent;
+  }
 
   BufferedWriter::SetWriteSizeHintImpl(pledged_size_);
   if (ABSL_PREDICT_FALSE(!dest->Push(LZ4F_HEADER_SIZE_MAX))) {
@@ -123,6 +355,13 @@ void Lz4WriterBase::Initialize(Writer* dest, int compression_level,
     return;
   }
   dest->move_cursor(result);
+  if (parallelism > 0) {
+    parallel_compressor_.reset(
+        new ParallelCompressor(parallelism, preferences_, dictionary_,
+                               recycling_pool_options_, BlockSize(),
+                               block_index, result));
+    compressor_.reset();
+  }
 }
 
 void Lz4WriterBase::Done() {
@@ -134,12 +373,22 @@ void Lz4WriterBase::Done() {
       Fail(absl::FailedPreconditionError(
           absl::StrCat("Actual size does not match pledged size: ", start_pos(),
                        " < ", *pledged_size_)));
+    } else if (parallel_compressor_ != nullptr) {
+      Writer& dest = *DestWriter();
+      if (ABSL_PREDICT_FALSE(!parallel_compressor_->Finish(dest))) {
+        if (!dest.ok()) {
+          FailWithoutAnnotation(AnnotateOverDest(dest.status()));
+        } else {
+          Fail(parallel_compressor_->status());
+        }
+      }
     } else if (compressor_ != nullptr) {
       Writer& dest = *DestWriter();
       DoneCompression(dest);
     }
   }
   compressor_.reset();
+  parallel_compressor_.reset();
   dictionary_ = Lz4Dictionary();
   associated_reader_.Reset();
 }
@@ -196,28 +445,11 @@ bool Lz4WriterBase::WriteInternal(absl::string_view src) {
       stable_src_ = true;
     }
   }
+  if (parallel_compressor_ != nullptr) return WriteInternalParallel(src, dest);
   RIEGELI_ASSERT(compressor_ != nullptr)
       << "compressor_ == nullptr when the pledged size was already written, "
          "which was checked above";
-  size_t block_size;
-  switch (preferences_.frameInfo.blockSizeID) {
-    case LZ4F_max64KB:
-      block_size = size_t{64} << 10;
-      break;
-    case LZ4F_max256KB:
-      block_size = size_t{256} << 10;
-      break;
-    case LZ4F_max1MB:
-      block_size = size_t{1} << 20;
-      break;
-    case LZ4F_max4MB:
-      block_size = size_t{4} << 20;
-      break;
-    default:
-      RIEGELI_ASSERT_UNREACHABLE()
-          << "Unexpected preferences_.frameInfo.blockSizeID: "
-          << preferences_.frameInfo.blockSizeID;
-  }
+  const size_t block_size = BlockSize();
   LZ4F_compressOptions_t compress_options{};
   do {
     size_t src_length = src.size();
@@ -256,8 +488,48 @@ bool Lz4WriterBase::WriteInternal(absl::string_view src) {
   return true;
 }
 
+inline size_t Lz4WriterBase::BlockSize() const {
+  switch (preferences_.frameInfo.blockSizeID) {
+    case LZ4F_max64KB:
+      return size_t{64} << 10;
+    case LZ4F_max256KB:
+      return size_t{256} << 10;
+    case LZ4F_max1MB:
+      return size_t{1} << 20;
+    case LZ4F_max4MB:
+      return size_t{4} << 20;
+    default:
+      RIEGELI_ASSERT_UNREACHABLE()
+          << "Unexpected preferences_.frameInfo.blockSizeID: "
+          << preferences_.frameInfo.blockSizeID;
+  }
+}
+
+bool Lz4WriterBase::WriteInternalParallel(absl::string_view src,
+                                          Writer& dest) {
+  if (ABSL_PREDICT_FALSE(!parallel_compressor_->Write(src, dest, false))) {
+    if (!dest.ok()) {
+      return FailWithoutAnnotation(AnnotateOverDest(dest.status()));
+    }
+    return Fail(parallel_compressor_->status());
+  }
+  move_start_pos(src.size());
+  return true;
+}
+
 bool Lz4WriterBase::FlushImpl(FlushType flush_type) {
   if (ABSL_PREDICT_FALSE(!BufferedWriter::FlushImpl(flush_type))) return false;
+  if (parallel_compressor_ != nullptr) {
+    Writer& dest = *DestWriter();
+    if (ABSL_PREDICT_FALSE(!parallel_compressor_->Write(absl::string_view(),
+                                                        dest, true))) {
+      if (!dest.ok()) {
+        return FailWithoutAnnotation(AnnotateOverDest(dest.status()));
+      }
+      return Fail(parallel_compressor_->status());
+    }
+    return true;
+  }
   if (compressor_ == nullptr) return true;
   Writer& dest = *DestWriter();
   if (ABSL_PREDICT_FALSE(!dest.Push(LZ4F_compressBound(0, &preferences_)))) {
@@ -17,6 +17,7 @@
 
 #include <stddef.h>
 
+#include <memory>
 #include <utility>
 
 #include "absl/base/attributes.h"
@@ -235,6 +236,53 @@ class Lz4WriterBase : public BufferedWriter {
       return recycling_pool_options_;
     }
 
+    // Number of blocks to compress concurrently in background threads.
+    // `parallelism() == 0` compresses in the current thread.
+    //
+    // If `parallelism() > 0`, data are split into blocks of the size implied
+    // by `window_log()`, which are compressed independently of each other
+    // (`LZ4F_blockIndependent`) and written in order. This is a valid Lz4 frame
+    // readable by any Lz4 decoder, but compression density is slightly lower
+    // because blocks do not refer to previous blocks. At most `parallelism()`
+    // blocks are being compressed at a time.
+    //
+    // Default: 0.
+    Options& set_parallelism(int parallelism) & ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      RIEGELI_ASSERT_GE(parallelism, 0)
+          << "Failed precondition of "
+             "Lz4WriterBase::Options::set_parallelism(): "
+             "negative parallelism";
+      parallelism_ = parallelism;
+      return *this;
+    }
+    Options&& set_parallelism(int parallelism) &&
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      return std::move(set_parallelism(parallelism));
+    }
+    int parallelism() const { return parallelism_; }
+
+    // If `true`, blocks are compressed independently of each other, and an
+    // index of blocks is appended after the frame, in a skippable frame. This
+    // lets `Lz4Reader` seek by decompressing only the blocks containing the
+    // target position, if the source supports random access.
+    //
+    // Other Lz4 decoders skip the index if they support concatenated frames.
+    //
+    // This implies the block layout of `parallelism() > 0`. If
+    // `parallelism() == 0`, blocks are compressed in a background thread one
+    // at a time.
+    //
+    // Default: `false`.
+    Options& set_block_index(bool block_index) & ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      block_index_ = block_index;
+      return *this;
+    }
+    Options&& set_block_index(bool block_index) &&
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      return std::move(set_block_index(block_index));
+    }
+    bool block_index() const { return block_index_; }
+
    private:
     int compression_level_ = kDefaultCompressionLevel;
     int window_log_ = kDefaultWindowLog;
@@ -244,6 +292,8 @@ class Lz4WriterBase : public BufferedWriter {
     absl::optional<Position> pledged_size_;
     bool reserve_max_size_ = false;
     RecyclingPoolOptions recycling_pool_options_;
+    int parallelism_ = 0;
+    bool block_index_ = false;
   };
 
   // Returns the compressed `Writer`. Unchanged by `Close()`.
@@ -268,7 +318,8 @@ class Lz4WriterBase : public BufferedWriter {
              absl::optional<Position> pledged_size, bool reserve_max_size,
              const RecyclingPoolOptions& recycling_pool_options);
   void Initialize(Writer* dest, int compression_level, int window_log,
-                  bool store_content_checksum, bool store_block_checksum);
+                  bool store_content_checksum, bool store_block_checksum,
+                  int parallelism, bool block_index);
   ABSL_ATTRIBUTE_COLD absl::Status AnnotateOverDest(absl::Status status);
 
   void Done() override;
@@ -288,7 +339,14 @@ class Lz4WriterBase : public BufferedWriter {
     }
   };
 
+  class ParallelCompressor;
+  struct ParallelCompressorDeleter {
+    void operator()(ParallelCompressor* ptr) const;
+  };
+
   bool DoneCompression(Writer& dest);
+  size_t BlockSize() const;
+  bool WriteInternalParallel(absl::string_view src, Writer& dest);
 
   Lz4Dictionary dictionary_;
   absl::optional<Position> pledged_size_;
@@ -305,6 +363,11 @@ class Lz4WriterBase : public BufferedWriter {
   // The amount of uncompressed data buffered in `LZ4F_cctx`. This allows to
   // reduce data copying by aligning source boundaries appropriately.
   size_t buffered_length_ = 0;
+  // Used instead of `compressor_` if `Options::parallelism() > 0` or
+  // `Options::block_index()`. The frame header is written by `compressor_`
+  // which is then released.
+  std::unique_ptr<ParallelCompressor, ParallelCompressorDeleter>
+      parallel_compressor_;
 
   AssociatedReader<Lz4Reader<Reader*>> associated_reader_;
 };
@@ -394,6 +457,7 @@ inline Lz4WriterBase::Lz4WriterBase(Lz4WriterBase&& that) noexcept
       compressor_(std::move(that.compressor_)),
       stable_src_(that.stable_src_),
       buffered_length_(that.buffered_length_),
+      parallel_compressor_(std::move(that.parallel_compressor_)),
       associated_reader_(std::move(that.associated_reader_)) {}
 
 inline Lz4WriterBase& Lz4WriterBase::operator=(Lz4WriterBase&& that) noexcept {
@@ -407,6 +471,7 @@ inline Lz4WriterBase& Lz4WriterBase::operator=(Lz4WriterBase&& that) noexcept {
   compressor_ = std::move(that.compressor_);
   stable_src_ = that.stable_src_;
   buffered_length_ = that.buffered_length_;
+  parallel_compressor_ = std::move(that.parallel_compressor_);
   associated_reader_ = std::move(that.associated_reader_);
   return *this;
 }
@@ -422,6 +487,7 @@ inline void Lz4WriterBase::Reset(Closed) {
   dictionary_ = Lz4Dictionary();
   stable_src_ = false;
   buffered_length_ = 0;
+  parallel_compressor_.reset();
   associated_reader_.Reset();
 }
 
@@ -439,6 +505,7 @@ inline void Lz4WriterBase::Reset(
   dictionary_ = std::move(dictionary);
   stable_src_ = false;
   buffered_length_ = 0;
+  parallel_compressor_.reset();
   associated_reader_.Reset();
 }
 
@@ -450,7 +517,8 @@ inline Lz4Writer<Dest>::Lz4Writer(Initializer<Dest> dest, Options options)
                     options.recycling_pool_options()),
       dest_(std::move(dest)) {
   Initialize(dest_.get(), options.compression_level(), options.window_log(),
-             options.store_content_checksum(), options.store_block_checksum());
+             options.store_content_checksum(), options.store_block_checksum(),
+             options.parallelism(), options.block_index());
 }
 
 template <typename Dest>
@@ -467,7 +535,8 @@ inline void Lz4Writer<Dest>::Reset(Initializer<Dest> dest, Options options) {
                        options.recycling_pool_options());
   dest_.Reset(std::move(dest));
   Initialize(dest_.get(), options.compression_level(), options.window_log(),
-             options.store_content_checksum(), options.store_block_checksum());
+             options.store_content_checksum(), options.store_block_checksum(),
+             options.parallelism(), options.block_index());
 }
 
 template <typename Dest>
@@ -0,0 +1,83 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "riegeli/lz4/lz4_xxh32.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cstring>
+
+#include "absl/numeric/bits.h"
+#include "absl/strings/string_view.h"
+#include "riegeli/base/arithmetic.h"
+#include "riegeli/endian/endian_reading.h"
+
+namespace riegeli {
+namespace lz4_internal {
+
+inline void Xxh32::UpdateStripe(const char* src) {
+  for (size_t i = 0; i < 4; ++i) {
+    acc_[i] += ReadLittleEndian32(src + i * sizeof(uint32_t)) * kPrime2;
+    acc_[i] = absl::rotl(acc_[i], 13) * kPrime1;
+  }
+}
+
+void Xxh32::Update(absl::string_view src) {
+  length_ += src.size();
+  if (buffered_length_ > 0) {
+    const size_t length =
+        UnsignedMin(src.size(), kStripeSize - buffered_length_);
+    std::memcpy(buffer_ + buffered_length_, src.data(), length);
+    buffered_length_ += length;
+    src.remove_prefix(length);
+    if (buffered_length_ < kStripeSize) return;
+    UpdateStripe(buffer_);
+    buffered_length_ = 0;
+  }
+  while (src.size() >= kStripeSize) {
+    UpdateStripe(src.data());
+    src.remove_prefix(kStripeSize);
+  }
+  std::memcpy(buffer_, src.data(), src.size());
+  buffered_length_ = src.size();
+}
+
+uint32_t Xxh32::Digest() const {
+  uint32_t hash = length_ >= kStripeSize
+                      ? absl::rotl(acc_[0], 1) + absl::rotl(acc_[1], 7) +
+                            absl::rotl(acc_[2], 12) + absl::rotl(acc_[3], 18)
+                      : kPrime5;
+  hash += static_cast<uint32_t>(length_);
+  const char* cursor = buffer_;
+  const char* const limit = buffer_ + buffered_length_;
+  for (; limit - cursor >= 4; cursor += 4) {
+    hash += ReadLittleEndian32(cursor) * kPrime3;
+    hash = absl::rotl(hash, 17) * kPrime4;
+  }
+  for (; cursor < limit; ++cursor) {
+    hash += uint32_t{static_cast<uint8_t>(*cursor)} * kPrime5;
+    hash = absl::rotl(hash, 11) * kPrime1;
+  }
+  hash ^= hash >> 15;
+  hash *= kPrime2;
+  hash ^= hash >> 13;
+  hash *= kPrime3;
+  hash ^= hash >> 16;
+  return hash;
+}
+
+}  // namespace lz4_internal
+}  // namespace riegeli
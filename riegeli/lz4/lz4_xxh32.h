@@ -0,0 +1,54 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef RIEGELI_LZ4_LZ4_XXH32_H_
+#define RIEGELI_LZ4_LZ4_XXH32_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "absl/strings/string_view.h"
+
+namespace riegeli {
+namespace lz4_internal {
+
+// Streaming XXH32 with seed 0, which is used for checksums of an Lz4 frame.
+// The Lz4 library does not expose its implementation.
+class Xxh32 {
+ public:
+  void Update(absl::string_view src);
+  uint32_t Digest() const;
+
+ private:
+  static constexpr uint32_t kPrime1 = 0x9e3779b1;
+  static constexpr uint32_t kPrime2 = 0x85ebca77;
+  static constexpr uint32_t kPrime3 = 0xc2b2ae3d;
+  static constexpr uint32_t kPrime4 = 0x27d4eb2f;
+  static constexpr uint32_t kPrime5 = 0x165667b1;
+  static constexpr size_t kStripeSize = 16;
+
+  void UpdateStripe(const char* src);
+
+  uint32_t acc_[4] = {kPrime1 + kPrime2, kPrime2, 0, 0 - kPrime1};
+  uint64_t length_ = 0;
+  // Data not processed yet, if they do not fill a stripe.
+  char buffer_[kStripeSize];
+  size_t buffered_length_ = 0;
+};
+
+}  // namespace lz4_internal
+}  // namespace riegeli
+
+#endif  // RIEGELI_LZ4_LZ4_XXH32_H_
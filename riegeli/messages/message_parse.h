@@ -23,9 +23,11 @@
 
 #include "absl/base/attributes.h"
 #include "absl/base/optimization.h"
+#include "absl/meta/type_traits.h"
 #include "absl/status/status.h"
 #include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
+#include "google/protobuf/arena.h"
 #include "google/protobuf/io/coded_stream.h"
 #include "google/protobuf/io/zero_copy_stream.h"
 #include "google/protobuf/message_lite.h"
@@ -114,6 +116,38 @@ template <typename Src,
 absl::Status ParseFromReader(Src&& src, google::protobuf::MessageLite& dest,
                              ParseOptions options = ParseOptions());
 
+// Reads a message in binary format from the given `Reader` into a new message
+// allocated on `arena`. If successful, the entire input will be consumed.
+//
+// The message has the type of `prototype`, or `Message` for the overload
+// without `prototype`. It is owned by `arena`, and so are its submessages and
+// strings, which avoids allocating them separately. Reusing the `arena` for a
+// batch of messages (with `arena.Reset()` between batches) amortizes the cost
+// of allocation further.
+//
+// `dest` is set to the new message, even on failure.
+//
+// Returns status:
+//  * `status.ok()`  - success (`*dest` is filled)
+//  * `!status.ok()` - failure (`*dest` is unspecified)
+template <typename Src,
+          std::enable_if_t<IsValidDependency<Reader*, Src&&>::value, int> = 0>
+absl::Status ParseFromReader(Src&& src,
+                             const google::protobuf::MessageLite& prototype,
+                             google::protobuf::Arena& arena,
+                             google::protobuf::MessageLite*& dest,
+                             ParseOptions options = ParseOptions());
+template <
+    typename Message, typename Src,
+    std::enable_if_t<
+        absl::conjunction<
+            std::is_base_of<google::protobuf::MessageLite, Message>,
+            IsValidDependency<Reader*, Src&&>>::value,
+        int> = 0>
+absl::Status ParseFromReader(Src&& src, google::protobuf::Arena& arena,
+                             Message*& dest,
+                             ParseOptions options = ParseOptions());
+
 // Reads a message in binary format with the given `length` from the given
 // `Reader`. If successful, exactly `length` bytes will be consumed.
 //
@@ -221,6 +255,29 @@ inline absl::Status ParseFromReader(Src&& src,
   return status;
 }
 
+template <typename Src,
+          std::enable_if_t<IsValidDependency<Reader*, Src&&>::value, int>>
+inline absl::Status ParseFromReader(
+    Src&& src, const google::protobuf::MessageLite& prototype,
+    google::protobuf::Arena& arena, google::protobuf::MessageLite*& dest,
+    ParseOptions options) {
+  dest = prototype.New(&arena);
+  return ParseFromReader(std::forward<Src>(src), *dest, std::move(options));
+}
+
+template <
+    typename Message, typename Src,
+    std::enable_if_t<
+        absl::conjunction<
+            std::is_base_of<google::protobuf::MessageLite, Message>,
+            IsValidDependency<Reader*, Src&&>>::value,
+        int>>
+inline absl::Status ParseFromReader(Src&& src, google::protobuf::Arena& arena,
+                                    Message*& dest, ParseOptions options) {
+  dest = google::protobuf::Arena::Create<Message>(&arena);
+  return ParseFromReader(std::forward<Src>(src), *dest, std::move(options));
+}
+
 }  // namespace riegeli
 
 #endif  // RIEGELI_MESSAGES_MESSAGE_PARSE_H_
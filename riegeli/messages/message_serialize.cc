@@ -85,10 +85,11 @@ inline absl::Status SerializeToWriterUsingStream(
 inline absl::Status SerializeToWriterHavingSize(
     const google::protobuf::MessageLite& src, Writer& dest, bool deterministic,
     size_t size) {
-  if (size <= kMaxBytesToCopy &&
+  if ((size <= kMaxBytesToCopy || dest.available() >= size) &&
       deterministic == google::protobuf::io::CodedOutputStream::
                            IsDefaultSerializationDeterministic()) {
-    // The data are small, so making a flat output is harmless.
+    // The data are small, so making a flat output is harmless, or the buffer
+    // already has room for them, so the output is flat anyway.
     // `SerializeWithCachedSizesToArray()` is faster than
     // `SerializeWithCachedSizes()`.
     if (ABSL_PREDICT_FALSE(!dest.Push(size))) return dest.status();
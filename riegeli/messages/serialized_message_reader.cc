@@ -0,0 +1,370 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/messages/serialized_message_reader.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+
+#include "absl/base/attributes.h"
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/arithmetic.h"
+#include "riegeli/base/assert.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/base/maker.h"
+#include "riegeli/base/shared_ptr.h"
+#include "riegeli/base/types.h"
+#include "riegeli/bytes/chain_reader.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/string_reader.h"
+#include "riegeli/endian/endian_reading.h"
+#include "riegeli/messages/message_wire_format.h"
+#include "riegeli/varint/varint_reading.h"
+
+namespace riegeli {
+
+// Before C++17 if a constexpr static data member is ODR-used, its definition at
+// namespace scope is required. Since C++17 these definitions are deprecated:
+// http://en.cppreference.com/w/cpp/language/static
+#if !__cpp_inline_variables
+constexpr int SerializedMessageReader::kDefaultRecursionLimit;
+#endif
+
+namespace {
+
+ABSL_ATTRIBUTE_COLD absl::Status MalformedError(Reader& src,
+                                                absl::string_view message) {
+  return src.AnnotateStatus(absl::InvalidArgumentError(
+      absl::StrCat("Malformed serialized message: ", message)));
+}
+
+// Reports a failure of reading `what`, either because `src` failed or because
+// it ended too early.
+ABSL_ATTRIBUTE_COLD absl::Status ReadError(Reader& src,
+                                           absl::string_view what) {
+  if (!src.ok()) return src.status();
+  return MalformedError(src, absl::StrCat("truncated ", what));
+}
+
+inline bool FitsInLimit(Reader& src, Position length,
+                        absl::optional<Position> limit) {
+  return limit == absl::nullopt || length <= SaturatingSub(*limit, src.pos());
+}
+
+// Skips a field which is not a group, after its `tag` has been read.
+absl::Status SkipValue(Reader& src, uint32_t tag,
+                       absl::optional<Position> limit) {
+  switch (GetTagWireType(tag)) {
+    case WireType::kVarint: {
+      uint64_t value;
+      if (ABSL_PREDICT_FALSE(!ReadVarint64(src, value))) {
+        return ReadError(src, "varint field");
+      }
+      return absl::OkStatus();
+    }
+    case WireType::kFixed32:
+      if (ABSL_PREDICT_FALSE(!src.Skip(sizeof(uint32_t)))) {
+        return ReadError(src, "fixed32 field");
+      }
+      return absl::OkStatus();
+    case WireType::kFixed64:
+      if (ABSL_PREDICT_FALSE(!src.Skip(sizeof(uint64_t)))) {
+        return ReadError(src, "fixed64 field");
+      }
+      return absl::OkStatus();
+    case WireType::kLengthDelimited: {
+      uint32_t length;
+      if (ABSL_PREDICT_FALSE(!ReadVarint32(src, length))) {
+        return ReadError(src, "field length");
+      }
+      if (ABSL_PREDICT_FALSE(!FitsInLimit(src, length, limit))) {
+        return MalformedError(src, "field exceeds the enclosing submessage");
+      }
+      if (ABSL_PREDICT_FALSE(!src.Skip(length))) {
+        return ReadError(src, "length-delimited field");
+      }
+      return absl::OkStatus();
+    }
+    case WireType::kEndGroup:
+      return MalformedError(src, "unexpected end group");
+    default:
+      return MalformedError(
+          src, absl::StrCat("invalid wire type: ",
+                            static_cast<uint32_t>(GetTagWireType(tag))));
+  }
+}
+
+// Skips a group with `field_number`, after its start group tag has been read.
+absl::Status SkipGroup(Reader& src, int field_number,
+                       absl::optional<Position> limit, int recursion_budget) {
+  if (ABSL_PREDICT_FALSE(recursion_budget == 0)) {
+    return MalformedError(src, "recursion limit exceeded");
+  }
+  for (;;) {
+    if (limit != absl::nullopt && ABSL_PREDICT_FALSE(src.pos() >= *limit)) {
+      return MalformedError(src, "group exceeds the enclosing submessage");
+    }
+    uint32_t tag;
+    if (ABSL_PREDICT_FALSE(!ReadVarint32(src, tag))) {
+      return ReadError(src, "group");
+    }
+    if (GetTagWireType(tag) == WireType::kEndGroup) {
+      if (ABSL_PREDICT_FALSE(GetTagFieldNumber(tag) != field_number)) {
+        return MalformedError(src, "mismatched end group");
+      }
+      return absl::OkStatus();
+    }
+    absl::Status status =
+        GetTagWireType(tag) == WireType::kStartGroup
+            ? SkipGroup(src, GetTagFieldNumber(tag), limit,
+                        recursion_budget - 1)
+            : SkipValue(src, tag, limit);
+    if (ABSL_PREDICT_FALSE(!status.ok())) return status;
+  }
+}
+
+}  // namespace
+
+SerializedMessageReader::Action& SerializedMessageReader::NewAction(
+    int field_number, ActionType type) {
+  RIEGELI_ASSERT_GT(field_number, 0)
+      << "Failed precondition of SerializedMessageReader: "
+         "field number out of range";
+  Action& action = actions_[field_number];
+  action = Action();
+  action.type = type;
+  return action;
+}
+
+SerializedMessageReader& SerializedMessageReader::OnVarint(
+    int field_number, VarintAction action) & {
+  NewAction(field_number, ActionType::kVarint).on_varint = std::move(action);
+  return *this;
+}
+
+SerializedMessageReader& SerializedMessageReader::OnFixed32(
+    int field_number, Fixed32Action action) & {
+  NewAction(field_number, ActionType::kFixed32).on_fixed32 = std::move(action);
+  return *this;
+}
+
+SerializedMessageReader& SerializedMessageReader::OnFixed64(
+    int field_number, Fixed64Action action) & {
+  NewAction(field_number, ActionType::kFixed64).on_fixed64 = std::move(action);
+  return *this;
+}
+
+SerializedMessageReader& SerializedMessageReader::OnString(
+    int field_number, StringAction action) & {
+  NewAction(field_number, ActionType::kString).on_string = std::move(action);
+  return *this;
+}
+
+SerializedMessageReader& SerializedMessageReader::OnChain(
+    int field_number, ChainAction action) & {
+  NewAction(field_number, ActionType::kChain).on_chain = std::move(action);
+  return *this;
+}
+
+SerializedMessageReader& SerializedMessageReader::OnMessage(
+    int field_number, SerializedMessageReader message_reader) & {
+  NewAction(field_number, ActionType::kMessage)
+      .on_message.Reset(riegeli::Maker(std::move(message_reader)));
+  return *this;
+}
+
+absl::Status SerializedMessageReader::ReadFromReaderImpl(Reader& src) const {
+  return ReadFields(src, absl::nullopt, recursion_limit_);
+}
+
+absl::Status SerializedMessageReader::ReadFromReaderWithLength(
+    Reader& src, Position length) const {
+  return ReadFields(src, SaturatingAdd(src.pos(), length), recursion_limit_);
+}
+
+absl::Status SerializedMessageReader::ReadFromString(
+    absl::string_view src) const {
+  return ReadFromReader(StringReader<>(src));
+}
+
+absl::Status SerializedMessageReader::ReadFromChain(const Chain& src) const {
+  return ReadFromReader(ChainReader<>(&src));
+}
+
+absl::Status SerializedMessageReader::ReadFields(
+    Reader& src, absl::optional<Position> limit, int recursion_budget) const {
+  for (;;) {
+    if (limit == absl::nullopt) {
+      if (!src.Pull()) {
+        if (ABSL_PREDICT_FALSE(!src.ok())) return src.status();
+        return absl::OkStatus();
+      }
+    } else if (src.pos() >= *limit) {
+      if (ABSL_PREDICT_FALSE(src.pos() > *limit)) {
+        return MalformedError(src, "field exceeds the enclosing submessage");
+      }
+      return absl::OkStatus();
+    }
+    uint32_t tag;
+    if (ABSL_PREDICT_FALSE(!ReadVarint32(src, tag))) {
+      return ReadError(src, "field tag");
+    }
+    const int field_number = GetTagFieldNumber(tag);
+    if (ABSL_PREDICT_FALSE(field_number == 0)) {
+      return MalformedError(src, "invalid field number: 0");
+    }
+    const auto iter = actions_.find(field_number);
+    if (iter == actions_.end()) {
+      absl::Status status =
+          GetTagWireType(tag) == WireType::kStartGroup
+              ? SkipGroup(src, field_number, limit, recursion_budget)
+              : SkipValue(src, tag, limit);
+      if (ABSL_PREDICT_FALSE(!status.ok())) return status;
+      continue;
+    }
+    const Action& action = iter->second;
+    absl::Status status;
+    switch (GetTagWireType(tag)) {
+      case WireType::kVarint: {
+        uint64_t value;
+        if (ABSL_PREDICT_FALSE(!ReadVarint64(src, value))) {
+          return ReadError(src, "varint field");
+        }
+        if (action.type == ActionType::kVarint) {
+          status = action.on_varint(value);
+        }
+      } break;
+      case WireType::kFixed32: {
+        uint32_t value;
+        if (ABSL_PREDICT_FALSE(!ReadLittleEndian32(src, value))) {
+          return ReadError(src, "fixed32 field");
+        }
+        if (action.type == ActionType::kFixed32) {
+          status = action.on_fixed32(value);
+        }
+      } break;
+      case WireType::kFixed64: {
+        uint64_t value;
+        if (ABSL_PREDICT_FALSE(!ReadLittleEndian64(src, value))) {
+          return ReadError(src, "fixed64 field");
+        }
+        if (action.type == ActionType::kFixed64) {
+          status = action.on_fixed64(value);
+        }
+      } break;
+      case WireType::kLengthDelimited: {
+        uint32_t length;
+        if (ABSL_PREDICT_FALSE(!ReadVarint32(src, length))) {
+          return ReadError(src, "field length");
+        }
+        if (ABSL_PREDICT_FALSE(!FitsInLimit(src, length, limit))) {
+          return MalformedError(src, "field exceeds the enclosing submessage");
+        }
+        status = ReadLengthDelimited(src, length, action, recursion_budget);
+      } break;
+      case WireType::kStartGroup:
+        status = SkipGroup(src, field_number, limit, recursion_budget);
+        break;
+      default:
+        status = SkipValue(src, tag, limit);
+        break;
+    }
+    if (ABSL_PREDICT_FALSE(!status.ok())) return status;
+  }
+}
+
+absl::Status SerializedMessageReader::ReadLengthDelimited(
+    Reader& src, Position length, const Action& action,
+    int recursion_budget) const {
+  switch (action.type) {
+    case ActionType::kVarint: {
+      // Packed repeated field.
+      const Position end = src.pos() + length;
+      while (src.pos() < end) {
+        uint64_t value;
+        if (ABSL_PREDICT_FALSE(!ReadVarint64(src, value))) {
+          return ReadError(src, "packed varint field");
+        }
+        absl::Status status = action.on_varint(value);
+        if (ABSL_PREDICT_FALSE(!status.ok())) return status;
+      }
+      if (ABSL_PREDICT_FALSE(src.pos() > end)) {
+        return MalformedError(src, "varint exceeds the packed field");
+      }
+      return absl::OkStatus();
+    }
+    case ActionType::kFixed32: {
+      // Packed repeated field.
+      if (ABSL_PREDICT_FALSE(length % sizeof(uint32_t) != 0)) {
+        return MalformedError(src, "invalid length of packed fixed32 field");
+      }
+      for (Position remaining = length / sizeof(uint32_t); remaining > 0;
+           --remaining) {
+        uint32_t value;
+        if (ABSL_PREDICT_FALSE(!ReadLittleEndian32(src, value))) {
+          return ReadError(src, "packed fixed32 field");
+        }
+        absl::Status status = action.on_fixed32(value);
+        if (ABSL_PREDICT_FALSE(!status.ok())) return status;
+      }
+      return absl::OkStatus();
+    }
+    case ActionType::kFixed64: {
+      // Packed repeated field.
+      if (ABSL_PREDICT_FALSE(length % sizeof(uint64_t) != 0)) {
+        return MalformedError(src, "invalid length of packed fixed64 field");
+      }
+      for (Position remaining = length / sizeof(uint64_t); remaining > 0;
+           --remaining) {
+        uint64_t value;
+        if (ABSL_PREDICT_FALSE(!ReadLittleEndian64(src, value))) {
+          return ReadError(src, "packed fixed64 field");
+        }
+        absl::Status status = action.on_fixed64(value);
+        if (ABSL_PREDICT_FALSE(!status.ok())) return status;
+      }
+      return absl::OkStatus();
+    }
+    case ActionType::kString: {
+      absl::string_view value;
+      if (ABSL_PREDICT_FALSE(!src.Read(IntCast<size_t>(length), value))) {
+        return ReadError(src, "length-delimited field");
+      }
+      return action.on_string(value);
+    }
+    case ActionType::kChain: {
+      Chain value;
+      if (ABSL_PREDICT_FALSE(!src.Read(IntCast<size_t>(length), value))) {
+        return ReadError(src, "length-delimited field");
+      }
+      return action.on_chain(std::move(value));
+    }
+    case ActionType::kMessage:
+      if (ABSL_PREDICT_FALSE(recursion_budget == 0)) {
+        return MalformedError(src, "recursion limit exceeded");
+      }
+      return action.on_message->ReadFields(src, src.pos() + length,
+                                           recursion_budget - 1);
+  }
+  RIEGELI_ASSERT_UNREACHABLE()
+      << "Unknown action type: " << static_cast<int>(action.type);
+}
+
+}  // namespace riegeli
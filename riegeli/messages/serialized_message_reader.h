@@ -0,0 +1,278 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_MESSAGES_SERIALIZED_MESSAGE_READER_H_
+#define RIEGELI_MESSAGES_SERIALIZED_MESSAGE_READER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+#include "absl/base/attributes.h"
+#include "absl/base/optimization.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/assert.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/base/dependency.h"
+#include "riegeli/base/shared_ptr.h"
+#include "riegeli/base/types.h"
+#include "riegeli/bytes/reader.h"
+
+namespace riegeli {
+
+// Reads a serialized proto message field by field, without parsing it into a
+// `google::protobuf::MessageLite`, calling actions registered for selected
+// field numbers. Other fields are skipped.
+//
+// This is useful for extracting a few fields from large messages, e.g. to
+// filter records read by `RecordReader`.
+//
+// Each field number has at most one action; registering another action for
+// the same field number replaces the previous one. Actions return
+// `absl::Status`; a failure stops reading and is returned from `Read*()`.
+//
+// Actions for varint and fixed width fields accept both the regular and the
+// packed encoding of repeated fields. A field whose wire type does not match
+// the registered action is skipped, like an unknown field.
+//
+// Example:
+//
+// ```
+//   std::string name;
+//   uint64_t id = 0;
+//   riegeli::SerializedMessageReader message_reader;
+//   message_reader
+//       .OnVarint(1, [&](uint64_t value) {
+//         id = value;
+//         return absl::OkStatus();
+//       })
+//       .OnString(2, [&](absl::string_view value) {
+//         name = std::string(value);
+//         return absl::OkStatus();
+//       });
+//   absl::string_view record;
+//   while (record_reader.ReadRecord(record)) {
+//     const absl::Status status = message_reader.ReadFromString(record);
+//     if (!status.ok()) {
+//       ...
+//     }
+//   }
+// ```
+class SerializedMessageReader {
+ public:
+  // Receives a varint field: `int32`, `int64`, `uint32`, `uint64`, `sint32`,
+  // `sint64`, `bool`, or `enum`. Values of `int32` and `enum` fields should be
+  // cast to `int32_t`. Values of `sint32` and `sint64` fields are zigzag
+  // encoded.
+  using VarintAction = std::function<absl::Status(uint64_t value)>;
+  // Receives a `fixed32`, `sfixed32`, or `float` field (convert it with
+  // `absl::bit_cast<float>()`).
+  using Fixed32Action = std::function<absl::Status(uint32_t value)>;
+  // Receives a `fixed64`, `sfixed64`, or `double` field (convert it with
+  // `absl::bit_cast<double>()`).
+  using Fixed64Action = std::function<absl::Status(uint64_t value)>;
+  // Receives a `string` or `bytes` field, or a serialized submessage.
+  //
+  // `value` is valid only during the call. It points to the buffer of the
+  // source `Reader` if the field is contained in the buffer.
+  using StringAction = std::function<absl::Status(absl::string_view value)>;
+  // Receives a `string` or `bytes` field, or a serialized submessage.
+  //
+  // If the source is a `Chain`, blocks are shared with it instead of copied.
+  using ChainAction = std::function<absl::Status(Chain&& value)>;
+
+  // Creates a `SerializedMessageReader` without actions, which skips all
+  // fields.
+  SerializedMessageReader() = default;
+
+  SerializedMessageReader(const SerializedMessageReader& that) = default;
+  SerializedMessageReader& operator=(const SerializedMessageReader& that) =
+      default;
+
+  SerializedMessageReader(SerializedMessageReader&& that) = default;
+  SerializedMessageReader& operator=(SerializedMessageReader&& that) = default;
+
+  // Registers an action for a varint field.
+  SerializedMessageReader& OnVarint(int field_number, VarintAction action) &
+      ABSL_ATTRIBUTE_LIFETIME_BOUND;
+  SerializedMessageReader&& OnVarint(int field_number, VarintAction action) &&
+      ABSL_ATTRIBUTE_LIFETIME_BOUND {
+    return std::move(OnVarint(field_number, std::move(action)));
+  }
+
+  // Registers an action for a fixed width 32-bit field.
+  SerializedMessageReader& OnFixed32(int field_number, Fixed32Action action) &
+      ABSL_ATTRIBUTE_LIFETIME_BOUND;
+  SerializedMessageReader&& OnFixed32(int field_number,
+                                      Fixed32Action action) &&
+      ABSL_ATTRIBUTE_LIFETIME_BOUND {
+    return std::move(OnFixed32(field_number, std::move(action)));
+  }
+
+  // Registers an action for a fixed width 64-bit field.
+  SerializedMessageReader& OnFixed64(int field_number, Fixed64Action action) &
+      ABSL_ATTRIBUTE_LIFETIME_BOUND;
+  SerializedMessageReader&& OnFixed64(int field_number,
+                                      Fixed64Action action) &&
+      ABSL_ATTRIBUTE_LIFETIME_BOUND {
+    return std::move(OnFixed64(field_number, std::move(action)));
+  }
+
+  // Registers an action for a length-delimited field, receiving it as
+  // `absl::string_view`.
+  SerializedMessageReader& OnString(int field_number, StringAction action) &
+      ABSL_ATTRIBUTE_LIFETIME_BOUND;
+  SerializedMessageReader&& OnString(int field_number, StringAction action) &&
+      ABSL_ATTRIBUTE_LIFETIME_BOUND {
+    return std::move(OnString(field_number, std::move(action)));
+  }
+
+  // Registers an action for a length-delimited field, receiving it as `Chain`.
+  SerializedMessageReader& OnChain(int field_number, ChainAction action) &
+      ABSL_ATTRIBUTE_LIFETIME_BOUND;
+  SerializedMessageReader&& OnChain(int field_number, ChainAction action) &&
+      ABSL_ATTRIBUTE_LIFETIME_BOUND {
+    return std::move(OnChain(field_number, std::move(action)));
+  }
+
+  // Registers reading a submessage field with `message_reader`, which is
+  // copied. The submessage is read in place, without copying its contents.
+  SerializedMessageReader& OnMessage(
+      int field_number, SerializedMessageReader message_reader) &
+      ABSL_ATTRIBUTE_LIFETIME_BOUND;
+  SerializedMessageReader&& OnMessage(
+      int field_number, SerializedMessageReader message_reader) &&
+      ABSL_ATTRIBUTE_LIFETIME_BOUND {
+    return std::move(OnMessage(field_number, std::move(message_reader)));
+  }
+
+  // Maximum depth of submessages and groups allowed.
+  //
+  // `recursion_limit` must be non-negative.
+  // Default: `kDefaultRecursionLimit` (100).
+  static constexpr int kDefaultRecursionLimit = 100;
+  SerializedMessageReader& set_recursion_limit(int recursion_limit) &
+      ABSL_ATTRIBUTE_LIFETIME_BOUND {
+    RIEGELI_ASSERT_GE(recursion_limit, 0)
+        << "Failed precondition of "
+           "SerializedMessageReader::set_recursion_limit(): "
+           "recursion limit out of range";
+    recursion_limit_ = recursion_limit;
+    return *this;
+  }
+  SerializedMessageReader&& set_recursion_limit(int recursion_limit) &&
+      ABSL_ATTRIBUTE_LIFETIME_BOUND {
+    return std::move(set_recursion_limit(recursion_limit));
+  }
+  int recursion_limit() const { return recursion_limit_; }
+
+  // Reads a message in binary format from the given `Reader`. If successful,
+  // the entire input will be consumed.
+  //
+  // The `Src` template parameter specifies the type of the object providing and
+  // possibly owning the `Reader`. `Src` must support
+  // `Dependency<Reader*, Src&&>`, e.g. `Reader&` (not owned),
+  // `ChainReader<>` (owned), `std::unique_ptr<Reader>` (owned),
+  // `Any<Reader*>` (maybe owned).
+  //
+  // Returns status:
+  //  * `status.ok()`  - success
+  //  * `!status.ok()` - failure, or an action failed
+  template <typename Src,
+            std::enable_if_t<IsValidDependency<Reader*, Src&&>::value, int> = 0>
+  absl::Status ReadFromReader(Src&& src) const;
+
+  // Reads a message in binary format with the given `length` from the given
+  // `Reader`. If successful, exactly `length` bytes will be consumed.
+  //
+  // Returns status:
+  //  * `status.ok()`  - success
+  //  * `!status.ok()` - failure, or an action failed
+  absl::Status ReadFromReaderWithLength(Reader& src, Position length) const;
+
+  // Reads a message in binary format from the given `absl::string_view`.
+  //
+  // Returns status:
+  //  * `status.ok()`  - success
+  //  * `!status.ok()` - failure, or an action failed
+  absl::Status ReadFromString(absl::string_view src) const;
+
+  // Reads a message in binary format from the given `Chain`.
+  //
+  // Returns status:
+  //  * `status.ok()`  - success
+  //  * `!status.ok()` - failure, or an action failed
+  absl::Status ReadFromChain(const Chain& src) const;
+
+ private:
+  enum class ActionType {
+    kVarint,
+    kFixed32,
+    kFixed64,
+    kString,
+    kChain,
+    kMessage,
+  };
+
+  struct Action {
+    ActionType type;
+    VarintAction on_varint;
+    Fixed32Action on_fixed32;
+    Fixed64Action on_fixed64;
+    StringAction on_string;
+    ChainAction on_chain;
+    SharedPtr<const SerializedMessageReader> on_message;
+  };
+
+  Action& NewAction(int field_number, ActionType type);
+
+  absl::Status ReadFromReaderImpl(Reader& src) const;
+  // Reads fields until `limit`, or until the end of `src` if `limit` is
+  // `absl::nullopt`. `recursion_budget` is the remaining number of levels of
+  // submessages and groups allowed.
+  absl::Status ReadFields(Reader& src, absl::optional<Position> limit,
+                          int recursion_budget) const;
+  // Reads the contents of a length-delimited field with `action`.
+  absl::Status ReadLengthDelimited(Reader& src, Position length,
+                                   const Action& action,
+                                   int recursion_budget) const;
+
+  absl::flat_hash_map<int, Action> actions_;
+  int recursion_limit_ = kDefaultRecursionLimit;
+};
+
+// Implementation details follow.
+
+template <typename Src,
+          std::enable_if_t<IsValidDependency<Reader*, Src&&>::value, int>>
+inline absl::Status SerializedMessageReader::ReadFromReader(Src&& src) const {
+  Dependency<Reader*, Src&&> src_dep(std::forward<Src>(src));
+  if (src_dep.IsOwning()) src_dep->SetReadAllHint(true);
+  absl::Status status = ReadFromReaderImpl(*src_dep);
+  if (src_dep.IsOwning()) {
+    if (ABSL_PREDICT_TRUE(status.ok())) src_dep->VerifyEnd();
+    if (ABSL_PREDICT_FALSE(!src_dep->Close())) status.Update(src_dep->status());
+  }
+  return status;
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_MESSAGES_SERIALIZED_MESSAGE_READER_H_
@@ -30,6 +30,7 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
+#include "google/protobuf/arena.h"
 #include "google/protobuf/descriptor.h"
 #include "google/protobuf/descriptor.pb.h"
 #include "google/protobuf/message.h"
@@ -341,6 +342,40 @@ bool RecordReaderBase::ReadRecord(absl::Cord& record) {
   return ReadRecordImpl(record);
 }
 
+bool RecordReaderBase::ReadRecords(
+    const google::protobuf::MessageLite& prototype,
+    google::protobuf::Arena& arena, size_t max_records,
+    std::vector<google::protobuf::MessageLite*>& records) {
+  return ReadRecordsImpl([&] { return prototype.New(&arena); }, max_records,
+                         [&](google::protobuf::MessageLite* record) {
+                           records.push_back(record);
+                         });
+}
+
+bool RecordReaderBase::ReadRecordsImpl(
+    absl::FunctionRef<google::protobuf::MessageLite*()> new_record,
+    size_t max_records,
+    absl::FunctionRef<void(google::protobuf::MessageLite* record)> add) {
+  RIEGELI_ASSERT_GT(max_records, 0u)
+      << "Failed precondition of RecordReaderBase::ReadRecords(): "
+         "no records requested";
+  flatten_ = false;
+  google::protobuf::MessageLite* record = new_record();
+  // The first record may need reading the next chunk, or recovery.
+  if (ABSL_PREDICT_FALSE(!ReadRecordImpl(*record))) return false;
+  add(record);
+  // Further records are parsed directly from the current chunk.
+  while (--max_records > 0 &&
+         chunk_decoder_.index() < chunk_decoder_.num_records()) {
+    record = new_record();
+    // On failure `chunk_decoder_` remains failed, and the next call reports
+    // this after the records read so far are returned.
+    if (ABSL_PREDICT_FALSE(!chunk_decoder_.ReadRecord(*record))) break;
+    add(record);
+  }
+  return true;
+}
+
 template <typename Record>
 inline bool RecordReaderBase::ReadRecordImpl(Record& record) {
   last_record_is_valid_ = false;
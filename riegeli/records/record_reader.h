@@ -15,13 +15,16 @@
 #ifndef RIEGELI_RECORDS_RECORD_READER_H_
 #define RIEGELI_RECORDS_RECORD_READER_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include <functional>
 #include <initializer_list>
 #include <memory>
 #include <string>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "absl/base/attributes.h"
 #include "absl/base/optimization.h"
@@ -30,6 +33,7 @@
 #include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
+#include "google/protobuf/arena.h"
 #include "google/protobuf/descriptor.h"
 #include "google/protobuf/message_lite.h"
 #include "riegeli/base/arithmetic.h"
@@ -258,6 +262,39 @@ class RecordReaderBase : public Object {
   bool ReadRecord(Chain& record);
   bool ReadRecord(absl::Cord& record);
 
+  // Reads a batch of records, parsing them to new messages allocated on
+  // `arena`, and appends pointers to them to `records`.
+  //
+  // The messages have the type of `prototype`, or `Message` for the overload
+  // without `prototype`. They are owned by `arena`, and so are their
+  // submessages and strings, which avoids allocating them separately. After the
+  // messages are no longer needed, `arena.Reset()` lets the next batch reuse
+  // the memory.
+  //
+  // At least one record is read if available. Further records are read until
+  // `max_records` records are read or the current chunk ends, so that reading
+  // a batch does not wait for the next chunk. A whole chunk is read with
+  // `max_records` being `std::numeric_limits<size_t>::max()`.
+  //
+  // If reading a record fails after some records were read, the records read
+  // so far are returned, and the failure is reported by the next call.
+  //
+  // `max_records` must be positive.
+  //
+  // Return values:
+  //  * `true`                 - success (at least one record is appended)
+  //  * `false` (when `ok()`)  - source ends
+  //  * `false` (when `!ok()`) - failure
+  bool ReadRecords(const google::protobuf::MessageLite& prototype,
+                   google::protobuf::Arena& arena, size_t max_records,
+                   std::vector<google::protobuf::MessageLite*>& records);
+  template <typename Message,
+            std::enable_if_t<
+                std::is_base_of<google::protobuf::MessageLite, Message>::value,
+                int> = 0>
+  bool ReadRecords(google::protobuf::Arena& arena, size_t max_records,
+                   std::vector<Message*>& records);
+
   // Like `Options::set_field_projection()`, but can be done at any time.
   //
   // This may cause reading the current chunk again.
@@ -519,6 +556,11 @@ class RecordReaderBase : public Object {
   template <typename Record>
   bool ReadRecordImpl(Record& record);
 
+  bool ReadRecordsImpl(
+      absl::FunctionRef<google::protobuf::MessageLite*()> new_record,
+      size_t max_records,
+      absl::FunctionRef<void(google::protobuf::MessageLite* record)> add);
+
   // Reads the next chunk from `chunk_reader_` and decodes it into
   // `chunk_decoder_` and `chunk_begin_`. On failure resets `chunk_decoder_`.
   //
@@ -671,6 +713,20 @@ inline bool RecordReaderBase::TryRecovery() {
   return Recover(&skipped_region) && recovery_(skipped_region, *this);
 }
 
+template <typename Message,
+          std::enable_if_t<
+              std::is_base_of<google::protobuf::MessageLite, Message>::value,
+              int>>
+inline bool RecordReaderBase::ReadRecords(google::protobuf::Arena& arena,
+                                          size_t max_records,
+                                          std::vector<Message*>& records) {
+  return ReadRecordsImpl(
+      [&] { return google::protobuf::Arena::Create<Message>(&arena); },
+      max_records, [&](google::protobuf::MessageLite* record) {
+        records.push_back(static_cast<Message*>(record));
+      });
+}
+
 inline RecordPosition RecordReaderBase::last_pos() const {
   RIEGELI_ASSERT(last_record_is_valid())
       << "Failed precondition of RecordReaderBase::last_pos(): "
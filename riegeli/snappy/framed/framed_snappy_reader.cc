@@ -22,7 +22,6 @@
 #include <utility>
 
 #include "absl/base/optimization.h"
-#include "absl/crc/crc32c.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
@@ -34,15 +33,105 @@
 #include "riegeli/bytes/pullable_reader.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/endian/endian_reading.h"
+#include "riegeli/snappy/parallel_snappy_decompressor.h"
 #include "snappy.h"
 
 namespace riegeli {
 
 namespace {
 
-// https://github.com/google/snappy/blob/e9e11b84e629c3e06fbaa4f0a86de02ceb9d6992/framing_format.txt#L39
-inline uint32_t MaskChecksum(uint32_t x) {
-  return ((x >> 15) | (x << 17)) + 0xa282ead8;
+enum class ChunkResult { kData, kEnd, kTruncated, kSrcFailed, kInvalid };
+
+// A chunk with compressed or uncompressed data.
+struct DataChunk {
+  bool compressed;
+  // Compressed data if `compressed`, otherwise uncompressed data.
+  absl::string_view data;
+  size_t uncompressed_length;
+  uint32_t masked_checksum;
+  // Length of the whole chunk, including its header.
+  size_t chunk_length;
+};
+
+// Skips the stream identifier and skippable chunks, and locates the next chunk
+// with data without decompressing it.
+//
+// Returns:
+//  * `ChunkResult::kData`       - `chunk` is filled; its data are valid until
+//                                 `src` is accessed again; the cursor of `src`
+//                                 is at the beginning of the chunk
+//  * `ChunkResult::kEnd`        - there are no more chunks
+//  * `ChunkResult::kTruncated`  - the source ends in the middle of a chunk
+//  * `ChunkResult::kSrcFailed`  - reading from `src` failed
+//  * `ChunkResult::kInvalid`    - the stream is invalid, `message` says why
+ChunkResult ReadDataChunk(Reader& src, DataChunk& chunk,
+                          absl::string_view& message) {
+  while (src.Pull(sizeof(uint32_t))) {
+    const uint32_t chunk_header = ReadLittleEndian32(src.cursor());
+    const uint8_t chunk_type = static_cast<uint8_t>(chunk_header);
+    const size_t chunk_length = IntCast<size_t>(chunk_header >> 8);
+    if (ABSL_PREDICT_FALSE(!src.Pull(sizeof(uint32_t) + chunk_length))) {
+      if (ABSL_PREDICT_FALSE(!src.ok())) return ChunkResult::kSrcFailed;
+      return ChunkResult::kTruncated;
+    }
+    if (ABSL_PREDICT_FALSE(src.pos() == 0 &&
+                           chunk_type != 0xff /* Stream identifier */)) {
+      message = "missing stream identifier";
+      return ChunkResult::kInvalid;
+    }
+    switch (chunk_type) {
+      case 0x00:    // Compressed data.
+      case 0x01: {  // Uncompressed data.
+        if (ABSL_PREDICT_FALSE(chunk_length < sizeof(uint32_t))) {
+          message = chunk_type == 0x00 ? "compressed data too short"
+                                       : "uncompressed data too short";
+          return ChunkResult::kInvalid;
+        }
+        chunk.compressed = chunk_type == 0x00;
+        chunk.data = absl::string_view(src.cursor() + 2 * sizeof(uint32_t),
+                                       chunk_length - sizeof(uint32_t));
+        if (chunk.compressed) {
+          if (ABSL_PREDICT_FALSE(!snappy::GetUncompressedLength(
+                  chunk.data.data(), chunk.data.size(),
+                  &chunk.uncompressed_length))) {
+            message = "invalid uncompressed length";
+            return ChunkResult::kInvalid;
+          }
+        } else {
+          chunk.uncompressed_length = chunk.data.size();
+        }
+        if (ABSL_PREDICT_FALSE(chunk.uncompressed_length >
+                               snappy::kBlockSize)) {
+          message = "uncompressed length too large";
+          return ChunkResult::kInvalid;
+        }
+        chunk.masked_checksum =
+            ReadLittleEndian32(src.cursor() + sizeof(uint32_t));
+        chunk.chunk_length = sizeof(uint32_t) + chunk_length;
+        return ChunkResult::kData;
+      }
+      case 0xff:  // Stream identifier.
+        if (ABSL_PREDICT_FALSE(
+                absl::string_view(src.cursor() + sizeof(uint32_t),
+                                  chunk_length) !=
+                absl::string_view("sNaPpY", 6))) {
+          message = "invalid stream identifier";
+          return ChunkResult::kInvalid;
+        }
+        src.move_cursor(sizeof(uint32_t) + chunk_length);
+        continue;
+      default:
+        if (ABSL_PREDICT_FALSE(chunk_type < 0x80)) {
+          message = "reserved unskippable chunk";
+          return ChunkResult::kInvalid;
+        }
+        src.move_cursor(sizeof(uint32_t) + chunk_length);
+        continue;
+    }
+  }
+  if (ABSL_PREDICT_FALSE(!src.ok())) return ChunkResult::kSrcFailed;
+  if (ABSL_PREDICT_FALSE(src.available() > 0)) return ChunkResult::kTruncated;
+  return ChunkResult::kEnd;
 }
 
 }  // namespace
@@ -55,6 +144,11 @@ void FramedSnappyReaderBase::Initialize(Reader* src) {
     return;
   }
   initial_compressed_pos_ = src->pos();
+  if (parallelism_ > 0) {
+    parallel_decompressor_ =
+        std::make_unique<snappy_internal::ParallelSnappyDecompressor>(
+            parallelism_);
+  }
 }
 
 void FramedSnappyReaderBase::Done() {
@@ -66,6 +160,7 @@ void FramedSnappyReaderBase::Done() {
   }
   PullableReader::Done();
   uncompressed_ = Buffer();
+  parallel_decompressor_.reset();
 }
 
 inline bool FramedSnappyReaderBase::FailInvalidStream(
@@ -104,131 +199,118 @@ bool FramedSnappyReaderBase::PullBehindScratch(size_t recommended_length) {
       << "Failed precondition of PullableReader::PullBehindScratch(): "
          "scratch used";
   if (ABSL_PREDICT_FALSE(!ok())) return false;
+  if (parallel_decompressor_ != nullptr) return PullBehindScratchParallel();
   Reader& src = *SrcReader();
   truncated_ = false;
-  while (src.Pull(sizeof(uint32_t))) {
-    const uint32_t chunk_header = ReadLittleEndian32(src.cursor());
-    const uint8_t chunk_type = static_cast<uint8_t>(chunk_header);
-    const size_t chunk_length = IntCast<size_t>(chunk_header >> 8);
-    if (ABSL_PREDICT_FALSE(!src.Pull(sizeof(uint32_t) + chunk_length))) {
-      set_buffer();
-      if (ABSL_PREDICT_FALSE(!src.ok())) {
+  for (;;) {
+    DataChunk chunk;
+    absl::string_view message;
+    switch (ReadDataChunk(src, chunk, message)) {
+      case ChunkResult::kData:
+        break;
+      case ChunkResult::kEnd:
+        set_buffer();
+        return false;
+      case ChunkResult::kTruncated:
+        set_buffer();
+        truncated_ = true;
+        return false;
+      case ChunkResult::kSrcFailed:
+        set_buffer();
         return FailWithoutAnnotation(AnnotateOverSrc(src.status()));
+      case ChunkResult::kInvalid:
+        set_buffer();
+        return FailInvalidStream(message);
+    }
+    const char* uncompressed_data;
+    if (chunk.compressed) {
+      uncompressed_.Reset(chunk.uncompressed_length);
+      if (ABSL_PREDICT_FALSE(!snappy::RawUncompress(
+              chunk.data.data(), chunk.data.size(), uncompressed_.data()))) {
+        set_buffer();
+        return FailInvalidStream("invalid compressed data");
       }
-      truncated_ = true;
-      return false;
+      uncompressed_data = uncompressed_.data();
+    } else {
+      uncompressed_data = chunk.data.data();
     }
-    if (ABSL_PREDICT_FALSE(src.pos() == 0 &&
-                           chunk_type != 0xff /* Stream identifier */)) {
+    if (ABSL_PREDICT_FALSE(
+            snappy_internal::MaskedCrc32c(absl::string_view(
+                uncompressed_data, chunk.uncompressed_length)) !=
+            chunk.masked_checksum)) {
       set_buffer();
-      return FailInvalidStream("missing stream identifier");
+      return FailInvalidStream("wrong checksum");
     }
-    switch (chunk_type) {
-      case 0x00: {  // Compressed data.
-        if (ABSL_PREDICT_FALSE(chunk_length < sizeof(uint32_t))) {
-          set_buffer();
-          return FailInvalidStream("compressed data too short");
-        }
-        const uint32_t checksum =
-            ReadLittleEndian32(src.cursor() + sizeof(uint32_t));
-        const char* const compressed_data = src.cursor() + 2 * sizeof(uint32_t);
-        const size_t compressed_length = chunk_length - sizeof(uint32_t);
-        size_t uncompressed_length;
-        if (ABSL_PREDICT_FALSE(!snappy::GetUncompressedLength(
-                compressed_data, compressed_length, &uncompressed_length))) {
-          set_buffer();
-          return FailInvalidStream("invalid uncompressed length");
-        }
-        if (ABSL_PREDICT_FALSE(uncompressed_length > snappy::kBlockSize)) {
-          set_buffer();
-          return FailInvalidStream("uncompressed length too large");
-        }
-        uncompressed_.Reset(uncompressed_length);
-        if (ABSL_PREDICT_FALSE(!snappy::RawUncompress(
-                compressed_data, compressed_length, uncompressed_.data()))) {
-          set_buffer();
-          return FailInvalidStream("invalid compressed data");
-        }
-        if (ABSL_PREDICT_FALSE(
-                MaskChecksum(static_cast<uint32_t>(absl::ComputeCrc32c(
-                    absl::string_view(uncompressed_.data(),
-                                      uncompressed_length)))) != checksum)) {
-          set_buffer();
-          return FailInvalidStream(
-              "Invalid FramedSnappy-compressed stream: wrong checksum");
-        }
-        src.move_cursor(sizeof(uint32_t) + chunk_length);
-        if (ABSL_PREDICT_FALSE(uncompressed_length == 0)) continue;
-        const Position max_length =
-            std::numeric_limits<Position>::max() - limit_pos();
-        if (ABSL_PREDICT_FALSE(uncompressed_length > max_length)) {
-          set_buffer(uncompressed_.data(), IntCast<size_t>(max_length));
-          move_limit_pos(available());
-          return FailOverflow();
-        }
-        set_buffer(uncompressed_.data(), uncompressed_length);
-        move_limit_pos(available());
-        return true;
-      }
-      case 0x01: {  // Uncompressed data.
-        if (ABSL_PREDICT_FALSE(chunk_length < sizeof(uint32_t))) {
-          set_buffer();
-          return FailInvalidStream("uncompressed data too short");
-        }
-        const uint32_t checksum =
-            ReadLittleEndian32(src.cursor() + sizeof(uint32_t));
-        const char* const uncompressed_data =
-            src.cursor() + 2 * sizeof(uint32_t);
-        const size_t uncompressed_length = chunk_length - sizeof(uint32_t);
-        if (ABSL_PREDICT_FALSE(uncompressed_length > snappy::kBlockSize)) {
-          set_buffer();
-          return FailInvalidStream("uncompressed length too large");
-        }
-        if (ABSL_PREDICT_FALSE(
-                MaskChecksum(static_cast<uint32_t>(absl::ComputeCrc32c(
-                    absl::string_view(uncompressed_data,
-                                      uncompressed_length)))) != checksum)) {
-          set_buffer();
-          return FailInvalidStream("wrong checksum");
-        }
-        src.move_cursor(sizeof(uint32_t) + chunk_length);
-        if (ABSL_PREDICT_FALSE(uncompressed_length == 0)) continue;
-        const Position max_length =
-            std::numeric_limits<Position>::max() - limit_pos();
-        if (ABSL_PREDICT_FALSE(uncompressed_length > max_length)) {
-          set_buffer(uncompressed_data, IntCast<size_t>(max_length));
-          move_limit_pos(available());
-          return FailOverflow();
-        }
-        set_buffer(uncompressed_data, uncompressed_length);
-        move_limit_pos(available());
-        return true;
-      }
-      case 0xff:  // Stream identifier.
-        if (ABSL_PREDICT_FALSE(
-                absl::string_view(src.cursor() + sizeof(uint32_t),
-                                  chunk_length) !=
-                absl::string_view("sNaPpY", 6))) {
-          set_buffer();
-          return FailInvalidStream("invalid stream identifier");
-        }
-        src.move_cursor(sizeof(uint32_t) + chunk_length);
-        continue;
-      default:
-        if (ABSL_PREDICT_FALSE(chunk_type < 0x80)) {
-          set_buffer();
-          return FailInvalidStream("reserved unskippable chunk");
-        }
-        src.move_cursor(sizeof(uint32_t) + chunk_length);
-        continue;
+    src.move_cursor(chunk.chunk_length);
+    if (ABSL_PREDICT_FALSE(chunk.uncompressed_length == 0)) continue;
+    const Position max_length =
+        std::numeric_limits<Position>::max() - limit_pos();
+    if (ABSL_PREDICT_FALSE(chunk.uncompressed_length > max_length)) {
+      set_buffer(uncompressed_data, IntCast<size_t>(max_length));
+      move_limit_pos(available());
+      return FailOverflow();
     }
+    set_buffer(uncompressed_data, chunk.uncompressed_length);
+    move_limit_pos(available());
+    return true;
   }
-  set_buffer();
-  if (ABSL_PREDICT_FALSE(!src.ok())) {
-    return FailWithoutAnnotation(AnnotateOverSrc(src.status()));
+}
+
+bool FramedSnappyReaderBase::PullBehindScratchParallel() {
+  Reader& src = *SrcReader();
+  truncated_ = false;
+  for (;;) {
+    // Read ahead as many chunks as allowed. Reading stops at the first chunk
+    // which is not available. Its status is reported only after pending chunks
+    // are returned, and then it is determined again because the source might
+    // have grown meanwhile.
+    ChunkResult result = ChunkResult::kData;
+    absl::string_view message;
+    while (parallel_decompressor_->HasCapacity()) {
+      DataChunk chunk;
+      result = ReadDataChunk(src, chunk, message);
+      if (result != ChunkResult::kData) break;
+      parallel_decompressor_->Add(chunk.data, chunk.compressed,
+                                  chunk.uncompressed_length,
+                                  chunk.masked_checksum);
+      src.move_cursor(chunk.chunk_length);
+    }
+    if (parallel_decompressor_->empty()) {
+      set_buffer();
+      switch (result) {
+        case ChunkResult::kData:
+          RIEGELI_ASSERT_UNREACHABLE() << "No chunks read ahead";
+        case ChunkResult::kEnd:
+          return false;
+        case ChunkResult::kTruncated:
+          truncated_ = true;
+          return false;
+        case ChunkResult::kSrcFailed:
+          return FailWithoutAnnotation(AnnotateOverSrc(src.status()));
+        case ChunkResult::kInvalid:
+          return FailInvalidStream(message);
+      }
+      RIEGELI_ASSERT_UNREACHABLE()
+          << "Unknown chunk result: " << static_cast<int>(result);
+    }
+    absl::string_view uncompressed;
+    const absl::Status status = parallel_decompressor_->Next(uncompressed);
+    if (ABSL_PREDICT_FALSE(!status.ok())) {
+      set_buffer();
+      return FailInvalidStream(status.message());
+    }
+    if (ABSL_PREDICT_FALSE(uncompressed.empty())) continue;
+    const Position max_length =
+        std::numeric_limits<Position>::max() - limit_pos();
+    if (ABSL_PREDICT_FALSE(uncompressed.size() > max_length)) {
+      set_buffer(uncompressed.data(), IntCast<size_t>(max_length));
+      move_limit_pos(available());
+      return FailOverflow();
+    }
+    set_buffer(uncompressed.data(), uncompressed.size());
+    move_limit_pos(available());
+    return true;
   }
-  if (ABSL_PREDICT_FALSE(src.available() > 0)) truncated_ = true;
-  return false;
 }
 
 bool FramedSnappyReaderBase::ToleratesReadingAhead() {
@@ -261,11 +343,43 @@ bool FramedSnappyReaderBase::SeekBehindScratch(Position new_pos) {
               "FramedSnappy-compressed stream got truncated"))));
     }
     if (ABSL_PREDICT_FALSE(!ok())) return false;
+    if (parallel_decompressor_ != nullptr) parallel_decompressor_->Clear();
     if (new_pos == 0) return true;
+  } else if (ABSL_PREDICT_FALSE(!SkipChunks(new_pos))) {
+    return false;
   }
   return PullableReader::SeekBehindScratch(new_pos);
 }
 
+bool FramedSnappyReaderBase::SkipChunks(Position new_pos) {
+  RIEGELI_ASSERT_GT(new_pos, limit_pos())
+      << "Failed precondition of FramedSnappyReaderBase::SkipChunks(): "
+         "not seeking forwards";
+  if (ABSL_PREDICT_FALSE(!ok())) return false;
+  set_buffer();
+  // Skip chunks read ahead which end before `new_pos`.
+  if (parallel_decompressor_ != nullptr) {
+    while (!parallel_decompressor_->empty() &&
+           parallel_decompressor_->FrontLength() <= new_pos - limit_pos()) {
+      move_limit_pos(parallel_decompressor_->FrontLength());
+      parallel_decompressor_->PopFront();
+    }
+    if (!parallel_decompressor_->empty()) return true;
+  }
+  // Skip chunks which end before `new_pos`, without decompressing them and
+  // verifying their checksums. Anything else, including errors, is left for
+  // `PullBehindScratch()`.
+  Reader& src = *SrcReader();
+  DataChunk chunk;
+  absl::string_view message;
+  while (ReadDataChunk(src, chunk, message) == ChunkResult::kData &&
+         chunk.uncompressed_length <= new_pos - limit_pos()) {
+    src.move_cursor(chunk.chunk_length);
+    move_limit_pos(chunk.uncompressed_length);
+  }
+  return true;
+}
+
 bool FramedSnappyReaderBase::SupportsNewReader() {
   Reader* const src = SrcReader();
   return src != nullptr && src->SupportsNewReader();
@@ -285,7 +399,8 @@ std::unique_ptr<Reader> FramedSnappyReaderBase::NewReaderImpl(
   }
   std::unique_ptr<Reader> reader =
       std::make_unique<FramedSnappyReader<std::unique_ptr<Reader>>>(
-          std::move(compressed_reader));
+          std::move(compressed_reader),
+          FramedSnappyReaderBase::Options().set_parallelism(parallelism_));
   reader->Seek(initial_pos);
   return reader;
 }
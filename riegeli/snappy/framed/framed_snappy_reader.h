@@ -24,6 +24,7 @@
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
 #include "absl/strings/string_view.h"
+#include "riegeli/base/assert.h"
 #include "riegeli/base/buffer.h"
 #include "riegeli/base/dependency.h"
 #include "riegeli/base/initializer.h"
@@ -32,13 +33,43 @@
 #include "riegeli/base/types.h"
 #include "riegeli/bytes/pullable_reader.h"
 #include "riegeli/bytes/reader.h"
+#include "riegeli/snappy/parallel_snappy_decompressor.h"
 
 namespace riegeli {
 
 // Template parameter independent part of `FramedSnappyReader`.
 class FramedSnappyReaderBase : public PullableReader {
  public:
-  class Options {};
+  class Options {
+   public:
+    Options() noexcept {}
+
+    // Number of chunks to decompress concurrently in background threads.
+    // `parallelism() == 0` decompresses in the current thread.
+    //
+    // If `parallelism() > 0`, up to `parallelism()` chunks are read ahead from
+    // the compressed `Reader`, and they are decompressed and their checksums
+    // are verified independently. Each chunk holds up to 64 KiB of
+    // uncompressed data.
+    //
+    // Default: 0.
+    Options& set_parallelism(int parallelism) & ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      RIEGELI_ASSERT_GE(parallelism, 0)
+          << "Failed precondition of "
+             "FramedSnappyReaderBase::Options::set_parallelism(): "
+             "negative parallelism";
+      parallelism_ = parallelism;
+      return *this;
+    }
+    Options&& set_parallelism(int parallelism) &&
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      return std::move(set_parallelism(parallelism));
+    }
+    int parallelism() const { return parallelism_; }
+
+   private:
+    int parallelism_ = 0;
+  };
 
   // Returns the compressed `Reader`. Unchanged by `Close()`.
   virtual Reader* SrcReader() const ABSL_ATTRIBUTE_LIFETIME_BOUND = 0;
@@ -48,13 +79,15 @@ class FramedSnappyReaderBase : public PullableReader {
   bool SupportsNewReader() override;
 
  protected:
-  using PullableReader::PullableReader;
+  explicit FramedSnappyReaderBase(Closed) noexcept : PullableReader(kClosed) {}
+
+  explicit FramedSnappyReaderBase(int parallelism);
 
   FramedSnappyReaderBase(FramedSnappyReaderBase&& that) noexcept;
   FramedSnappyReaderBase& operator=(FramedSnappyReaderBase&& that) noexcept;
 
   void Reset(Closed);
-  void Reset();
+  void Reset(int parallelism);
   void Initialize(Reader* src);
   ABSL_ATTRIBUTE_COLD absl::Status AnnotateOverSrc(absl::Status status);
 
@@ -67,7 +100,10 @@ class FramedSnappyReaderBase : public PullableReader {
 
  private:
   ABSL_ATTRIBUTE_COLD bool FailInvalidStream(absl::string_view message);
+  bool PullBehindScratchParallel();
+  bool SkipChunks(Position new_pos);
 
+  int parallelism_ = 0;
   // If `true`, the source is truncated (without a clean end of the compressed
   // stream) at the current position. If the source does not grow, `Close()`
   // will fail.
@@ -75,10 +111,15 @@ class FramedSnappyReaderBase : public PullableReader {
   Position initial_compressed_pos_ = 0;
   // Buffered uncompressed data.
   Buffer uncompressed_;
+  // Chunks read ahead, if `parallelism_ > 0`.
+  std::unique_ptr<snappy_internal::ParallelSnappyDecompressor>
+      parallel_decompressor_;
 
   // Invariant if scratch is not used:
   //   `start() == nullptr` or `start() == uncompressed_.data()` or
-  //   `limit() == SrcReader()->cursor()`
+  //   `limit() == SrcReader()->cursor()` or
+  //   `start()` points to the data last returned by
+  //   `parallel_decompressor_->Next()`
 };
 
 // A `Reader` which decompresses data with framed Snappy format after getting
@@ -155,33 +196,44 @@ bool RecognizeFramedSnappy(Reader& src);
 
 // Implementation details follow.
 
+inline FramedSnappyReaderBase::FramedSnappyReaderBase(int parallelism)
+    : parallelism_(parallelism) {}
+
 inline FramedSnappyReaderBase::FramedSnappyReaderBase(
     FramedSnappyReaderBase&& that) noexcept
     : PullableReader(static_cast<PullableReader&&>(that)),
+      parallelism_(that.parallelism_),
       truncated_(that.truncated_),
       initial_compressed_pos_(that.initial_compressed_pos_),
-      uncompressed_(std::move(that.uncompressed_)) {}
+      uncompressed_(std::move(that.uncompressed_)),
+      parallel_decompressor_(std::move(that.parallel_decompressor_)) {}
 
 inline FramedSnappyReaderBase& FramedSnappyReaderBase::operator=(
     FramedSnappyReaderBase&& that) noexcept {
   PullableReader::operator=(static_cast<PullableReader&&>(that));
+  parallelism_ = that.parallelism_;
   truncated_ = that.truncated_;
   initial_compressed_pos_ = that.initial_compressed_pos_;
   uncompressed_ = std::move(that.uncompressed_);
+  parallel_decompressor_ = std::move(that.parallel_decompressor_);
   return *this;
 }
 
 inline void FramedSnappyReaderBase::Reset(Closed) {
   PullableReader::Reset(kClosed);
+  parallelism_ = 0;
   truncated_ = false;
   initial_compressed_pos_ = 0;
   uncompressed_ = Buffer();
+  parallel_decompressor_.reset();
 }
 
-inline void FramedSnappyReaderBase::Reset() {
+inline void FramedSnappyReaderBase::Reset(int parallelism) {
   PullableReader::Reset();
+  parallelism_ = parallelism;
   truncated_ = false;
   initial_compressed_pos_ = 0;
+  parallel_decompressor_.reset();
 }
 
 template <typename Src>
@@ -219,9 +271,9 @@ class FramedSnappyReader<Src>::Mover {
 };
 
 template <typename Src>
-inline FramedSnappyReader<Src>::FramedSnappyReader(
-    Initializer<Src> src, ABSL_ATTRIBUTE_UNUSED Options options)
-    : src_(std::move(src)) {
+inline FramedSnappyReader<Src>::FramedSnappyReader(Initializer<Src> src,
+                                                   Options options)
+    : FramedSnappyReaderBase(options.parallelism()), src_(std::move(src)) {
   Initialize(src_.get());
 }
 
@@ -232,9 +284,9 @@ inline void FramedSnappyReader<Src>::Reset(Closed) {
 }
 
 template <typename Src>
-inline void FramedSnappyReader<Src>::Reset(
-    Initializer<Src> src, ABSL_ATTRIBUTE_UNUSED Options options) {
-  FramedSnappyReaderBase::Reset();
+inline void FramedSnappyReader<Src>::Reset(Initializer<Src> src,
+                                           Options options) {
+  FramedSnappyReaderBase::Reset(options.parallelism());
   src_.Reset(std::move(src));
   Initialize(src_.get());
 }
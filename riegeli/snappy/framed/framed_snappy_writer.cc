@@ -18,7 +18,9 @@
 #include <stdint.h>
 
 #include <cstring>
+#include <future>
 #include <limits>
+#include <string>
 #include <utility>
 
 #include "absl/base/optimization.h"
@@ -30,6 +32,7 @@
 #include "riegeli/base/assert.h"
 #include "riegeli/base/buffer.h"
 #include "riegeli/base/buffering.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/base/status.h"
 #include "riegeli/base/types.h"
 #include "riegeli/bytes/pushable_writer.h"
@@ -43,10 +46,46 @@
 
 namespace riegeli {
 
-void FramedSnappyWriterBase::Initialize(Writer* dest, int compression_level) {
+namespace {
+
+// Returns the maximum length of a chunk holding `uncompressed_length` bytes.
+inline size_t MaxChunkLength(size_t uncompressed_length) {
+  return 2 * sizeof(uint32_t) +
+         snappy::MaxCompressedLength(uncompressed_length);
+}
+
+// Writes a chunk with `src` compressed to `dest`, which must have at least
+// `MaxChunkLength(src.size())` bytes available. Returns the chunk length.
+size_t WriteChunk(absl::string_view src, int compression_level, char* dest) {
+  size_t compressed_length;
+  snappy::RawCompress(src.data(), src.size(), dest + 2 * sizeof(uint32_t),
+                      &compressed_length, {/*level=*/compression_level});
+  if (compressed_length < src.size()) {
+    WriteLittleEndian32(
+        IntCast<uint32_t>(0x00 /* Compressed data */ |
+                          ((sizeof(uint32_t) + compressed_length) << 8)),
+        dest);
+  } else {
+    std::memcpy(dest + 2 * sizeof(uint32_t), src.data(), src.size());
+    compressed_length = src.size();
+    WriteLittleEndian32(
+        IntCast<uint32_t>(0x01 /* Uncompressed data */ |
+                          ((sizeof(uint32_t) + compressed_length) << 8)),
+        dest);
+  }
+  WriteLittleEndian32(MaskCrc32c(DigestFrom(src, Crc32cDigester())),
+                      dest + sizeof(uint32_t));
+  return 2 * sizeof(uint32_t) + compressed_length;
+}
+
+}  // namespace
+
+void FramedSnappyWriterBase::Initialize(Writer* dest, int compression_level,
+                                        int parallelism) {
   RIEGELI_ASSERT(dest != nullptr)
       << "Failed precondition of FramedSnappyWriter: null Writer pointer";
   compression_level_ = compression_level;
+  parallelism_ = parallelism;
   if (ABSL_PREDICT_FALSE(!dest->ok())) {
     FailWithoutAnnotation(AnnotateOverDest(dest->status()));
     return;
@@ -65,6 +104,7 @@ void FramedSnappyWriterBase::Initialize(Writer* dest, int compression_level) {
 void FramedSnappyWriterBase::Done() {
   PushableWriter::Done();
   uncompressed_ = Buffer();
+  compressed_chunks_.clear();
   associated_reader_.Reset();
 }
 
@@ -123,39 +163,52 @@ inline bool FramedSnappyWriterBase::PushInternal(Writer& dest) {
   RIEGELI_ASSERT_LE(uncompressed_length, snappy::kBlockSize)
       << "Failed invariant of FramedSnappyWriterBase: buffer too large";
   if (uncompressed_length == 0) return true;
+  if (parallelism_ > 0) return PushInternalParallel(dest);
   set_cursor(start());
-  const char* const uncompressed_data = cursor();
-  if (ABSL_PREDICT_FALSE(
-          !dest.Push(2 * sizeof(uint32_t) +
-                     snappy::MaxCompressedLength(uncompressed_length)))) {
+  if (ABSL_PREDICT_FALSE(!dest.Push(MaxChunkLength(uncompressed_length)))) {
     return FailWithoutAnnotation(AnnotateOverDest(dest.status()));
   }
-  char* const compressed_chunk = dest.cursor();
-  size_t compressed_length;
-  snappy::RawCompress(uncompressed_data, uncompressed_length,
-                      compressed_chunk + 2 * sizeof(uint32_t),
-                      &compressed_length, {/*level=*/compression_level_});
-  if (compressed_length < uncompressed_length) {
-    WriteLittleEndian32(
-        IntCast<uint32_t>(0x00 /* Compressed data */ |
-                          ((sizeof(uint32_t) + compressed_length) << 8)),
-        compressed_chunk);
-  } else {
-    std::memcpy(compressed_chunk + 2 * sizeof(uint32_t), uncompressed_data,
-                uncompressed_length);
-    compressed_length = uncompressed_length;
-    WriteLittleEndian32(
-        IntCast<uint32_t>(0x01 /* Uncompressed data */ |
-                          ((sizeof(uint32_t) + compressed_length) << 8)),
-        compressed_chunk);
+  dest.move_cursor(WriteChunk(absl::string_view(start(), uncompressed_length),
+                              compression_level_, dest.cursor()));
+  move_start_pos(uncompressed_length);
+  return true;
+}
+
+bool FramedSnappyWriterBase::PushInternalParallel(Writer& dest) {
+  while (compressed_chunks_.size() >= IntCast<size_t>(parallelism_)) {
+    if (ABSL_PREDICT_FALSE(!WriteCompressedChunk(dest))) return false;
   }
-  WriteLittleEndian32(
-      MaskCrc32c(
-          DigestFrom(absl::string_view(uncompressed_data, uncompressed_length),
-                     Crc32cDigester())),
-      compressed_chunk + sizeof(uint32_t));
-  dest.move_cursor(2 * sizeof(uint32_t) + compressed_length);
+  const size_t uncompressed_length = start_to_cursor();
+  // The background thread takes over `uncompressed_`. The next
+  // `PushBehindScratch()` allocates a new buffer.
+  set_buffer();
   move_start_pos(uncompressed_length);
+  std::promise<std::string> promise;
+  compressed_chunks_.push_back(promise.get_future());
+  internal::ThreadPool::global().Schedule(
+      [promise = std::move(promise), uncompressed = std::move(uncompressed_),
+       uncompressed_length,
+       compression_level = compression_level_]() mutable {
+        std::string chunk(MaxChunkLength(uncompressed_length), '\0');
+        chunk.resize(WriteChunk(
+            absl::string_view(uncompressed.data(), uncompressed_length),
+            compression_level, &chunk[0]));
+        promise.set_value(std::move(chunk));
+      });
+  uncompressed_ = Buffer();
+  return true;
+}
+
+bool FramedSnappyWriterBase::WriteCompressedChunk(Writer& dest) {
+  RIEGELI_ASSERT(!compressed_chunks_.empty())
+      << "Failed precondition of "
+         "FramedSnappyWriterBase::WriteCompressedChunk(): "
+         "no pending chunks";
+  const std::string chunk = compressed_chunks_.front().get();
+  compressed_chunks_.pop_front();
+  if (ABSL_PREDICT_FALSE(!dest.Write(chunk))) {
+    return FailWithoutAnnotation(AnnotateOverDest(dest.status()));
+  }
   return true;
 }
 
@@ -165,7 +218,11 @@ bool FramedSnappyWriterBase::FlushBehindScratch(FlushType flush_type) {
          "scratch used";
   if (ABSL_PREDICT_FALSE(!ok())) return false;
   Writer& dest = *DestWriter();
-  return PushInternal(dest);
+  if (ABSL_PREDICT_FALSE(!PushInternal(dest))) return false;
+  while (!compressed_chunks_.empty()) {
+    if (ABSL_PREDICT_FALSE(!WriteCompressedChunk(dest))) return false;
+  }
+  return true;
 }
 
 bool FramedSnappyWriterBase::SupportsReadMode() {
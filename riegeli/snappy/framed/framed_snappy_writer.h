@@ -17,6 +17,9 @@
 
 #include <stddef.h>
 
+#include <deque>
+#include <future>
+#include <string>
 #include <utility>
 
 #include "absl/base/attributes.h"
@@ -76,8 +79,31 @@ class FramedSnappyWriterBase : public PushableWriter {
     }
     int compression_level() const { return compression_level_; }
 
+    // Number of chunks to compress concurrently in background threads.
+    // `parallelism() == 0` compresses in the current thread.
+    //
+    // If `parallelism() > 0`, filled chunks of 64 KiB are compressed
+    // independently and written in order, so the compressed stream is the same.
+    // At most `parallelism()` chunks are being compressed at a time.
+    //
+    // Default: 0.
+    Options& set_parallelism(int parallelism) & ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      RIEGELI_ASSERT_GE(parallelism, 0)
+          << "Failed precondition of "
+             "FramedSnappyWriterBase::Options::set_parallelism(): "
+             "negative parallelism";
+      parallelism_ = parallelism;
+      return *this;
+    }
+    Options&& set_parallelism(int parallelism) &&
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      return std::move(set_parallelism(parallelism));
+    }
+    int parallelism() const { return parallelism_; }
+
    private:
     int compression_level_ = kDefaultCompressionLevel;
+    int parallelism_ = 0;
   };
 
   // Returns the compressed `Writer`. Unchanged by `Close()`.
@@ -95,7 +121,7 @@ class FramedSnappyWriterBase : public PushableWriter {
 
   void Reset(Closed);
   void Reset();
-  void Initialize(Writer* dest, int compression_level);
+  void Initialize(Writer* dest, int compression_level, int parallelism);
   ABSL_ATTRIBUTE_COLD absl::Status AnnotateOverDest(absl::Status status);
 
   void Done() override;
@@ -115,11 +141,27 @@ class FramedSnappyWriterBase : public PushableWriter {
   // Postcondition: `start_to_cursor() == 0`
   bool PushInternal(Writer& dest);
 
+  // Schedules compression of buffered data in a background thread, writing
+  // chunks compressed earlier to keep at most `parallelism_` chunks pending.
+  //
+  // Precondition: `ok()`
+  //
+  // Postcondition: `start_to_limit() == 0`
+  bool PushInternalParallel(Writer& dest);
+
+  // Writes the first pending compressed chunk.
+  //
+  // Precondition: `!compressed_chunks_.empty()`
+  bool WriteCompressedChunk(Writer& dest);
+
   int compression_level_ = Options::kDefaultCompressionLevel;
+  int parallelism_ = 0;
   absl::optional<Position> size_hint_;
   Position initial_compressed_pos_ = 0;
   // Buffered uncompressed data.
   Buffer uncompressed_;
+  // Chunks being compressed if `parallelism_ > 0`, in order.
+  std::deque<std::future<std::string>> compressed_chunks_;
 
   AssociatedReader<FramedSnappyReader<Reader*>> associated_reader_;
 
@@ -199,18 +241,22 @@ inline FramedSnappyWriterBase::FramedSnappyWriterBase(
     FramedSnappyWriterBase&& that) noexcept
     : PushableWriter(static_cast<PushableWriter&&>(that)),
       compression_level_(that.compression_level_),
+      parallelism_(that.parallelism_),
       size_hint_(that.size_hint_),
       initial_compressed_pos_(that.initial_compressed_pos_),
       uncompressed_(std::move(that.uncompressed_)),
+      compressed_chunks_(std::move(that.compressed_chunks_)),
       associated_reader_(std::move(that.associated_reader_)) {}
 
 inline FramedSnappyWriterBase& FramedSnappyWriterBase::operator=(
     FramedSnappyWriterBase&& that) noexcept {
   PushableWriter::operator=(static_cast<PushableWriter&&>(that));
   compression_level_ = that.compression_level_;
+  parallelism_ = that.parallelism_;
   size_hint_ = that.size_hint_;
   initial_compressed_pos_ = that.initial_compressed_pos_;
   uncompressed_ = std::move(that.uncompressed_);
+  compressed_chunks_ = std::move(that.compressed_chunks_);
   associated_reader_ = std::move(that.associated_reader_);
   return *this;
 }
@@ -218,17 +264,21 @@ inline FramedSnappyWriterBase& FramedSnappyWriterBase::operator=(
 inline void FramedSnappyWriterBase::Reset(Closed) {
   PushableWriter::Reset(kClosed);
   compression_level_ = Options::kDefaultCompressionLevel;
+  parallelism_ = 0;
   size_hint_ = absl::nullopt;
   initial_compressed_pos_ = 0;
   uncompressed_ = Buffer();
+  compressed_chunks_.clear();
   associated_reader_.Reset();
 }
 
 inline void FramedSnappyWriterBase::Reset() {
   PushableWriter::Reset();
   compression_level_ = Options::kDefaultCompressionLevel;
+  parallelism_ = 0;
   size_hint_ = absl::nullopt;
   initial_compressed_pos_ = 0;
+  compressed_chunks_.clear();
   associated_reader_.Reset();
 }
 
@@ -236,7 +286,7 @@ template <typename Dest>
 inline FramedSnappyWriter<Dest>::FramedSnappyWriter(Initializer<Dest> dest,
                                                     Options options)
     : dest_(std::move(dest)) {
-  Initialize(dest_.get(), options.compression_level());
+  Initialize(dest_.get(), options.compression_level(), options.parallelism());
 }
 
 template <typename Dest>
@@ -250,7 +300,7 @@ inline void FramedSnappyWriter<Dest>::Reset(Initializer<Dest> dest,
                                             Options options) {
   FramedSnappyWriterBase::Reset();
   dest_.Reset(std::move(dest));
-  Initialize(dest_.get(), options.compression_level());
+  Initialize(dest_.get(), options.compression_level(), options.parallelism());
 }
 
 template <typename Dest>
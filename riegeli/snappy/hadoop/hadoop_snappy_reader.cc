@@ -25,6 +25,7 @@
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
 #include "riegeli/base/arithmetic.h"
 #include "riegeli/base/assert.h"
 #include "riegeli/base/buffer.h"
@@ -33,10 +34,80 @@
 #include "riegeli/bytes/pullable_reader.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/endian/endian_reading.h"
+#include "riegeli/snappy/parallel_snappy_decompressor.h"
 #include "snappy.h"
 
 namespace riegeli {
 
+namespace {
+
+enum class BlockResult { kData, kEnd, kTruncated, kSrcFailed, kInvalid };
+
+// A compressed block.
+struct Block {
+  absl::string_view compressed_data;
+  size_t uncompressed_length;
+  // Length of the whole block, including its header.
+  size_t block_length;
+};
+
+// Reads chunk headers if `remaining_chunk_length == 0`, and locates the next
+// compressed block without decompressing it.
+//
+// Returns:
+//  * `BlockResult::kData`       - `block` is filled; its data are valid until
+//                                 `src` is accessed again; the cursor of `src`
+//                                 is at the beginning of the block
+//  * `BlockResult::kEnd`        - there are no more blocks
+//  * `BlockResult::kTruncated`  - the source ends in the middle of a chunk
+//  * `BlockResult::kSrcFailed`  - reading from `src` failed
+//  * `BlockResult::kInvalid`    - the stream is invalid, `message` says why
+BlockResult ReadBlock(Reader& src, uint32_t& remaining_chunk_length,
+                      Block& block, absl::string_view& message) {
+  while (remaining_chunk_length == 0) {
+    if (ABSL_PREDICT_FALSE(!src.Pull(sizeof(uint32_t)))) {
+      if (ABSL_PREDICT_FALSE(!src.ok())) return BlockResult::kSrcFailed;
+      if (ABSL_PREDICT_FALSE(src.available() > 0)) {
+        return BlockResult::kTruncated;
+      }
+      return BlockResult::kEnd;
+    }
+    remaining_chunk_length = ReadBigEndian32(src.cursor());
+    src.move_cursor(sizeof(uint32_t));
+  }
+  if (ABSL_PREDICT_FALSE(!src.Pull(sizeof(uint32_t)))) {
+    if (ABSL_PREDICT_FALSE(!src.ok())) return BlockResult::kSrcFailed;
+    return BlockResult::kTruncated;
+  }
+  const uint32_t compressed_length = ReadBigEndian32(src.cursor());
+  if (ABSL_PREDICT_FALSE(compressed_length >
+                         std::numeric_limits<uint32_t>::max() -
+                             sizeof(uint32_t))) {
+    message = "compressed length too large";
+    return BlockResult::kInvalid;
+  }
+  if (ABSL_PREDICT_FALSE(!src.Pull(sizeof(uint32_t) + compressed_length))) {
+    if (ABSL_PREDICT_FALSE(!src.ok())) return BlockResult::kSrcFailed;
+    return BlockResult::kTruncated;
+  }
+  block.compressed_data =
+      absl::string_view(src.cursor() + sizeof(uint32_t), compressed_length);
+  if (ABSL_PREDICT_FALSE(!snappy::GetUncompressedLength(
+          block.compressed_data.data(), block.compressed_data.size(),
+          &block.uncompressed_length))) {
+    message = "invalid uncompressed length";
+    return BlockResult::kInvalid;
+  }
+  if (ABSL_PREDICT_FALSE(block.uncompressed_length > remaining_chunk_length)) {
+    message = "uncompressed length too large";
+    return BlockResult::kInvalid;
+  }
+  block.block_length = sizeof(uint32_t) + compressed_length;
+  return BlockResult::kData;
+}
+
+}  // namespace
+
 void HadoopSnappyReaderBase::Initialize(Reader* src) {
   RIEGELI_ASSERT(src != nullptr)
       << "Failed precondition of HadoopSnappyReader: null Reader pointer";
@@ -45,6 +116,11 @@ void HadoopSnappyReaderBase::Initialize(Reader* src) {
     return;
   }
   initial_compressed_pos_ = src->pos();
+  if (parallelism_ > 0) {
+    parallel_decompressor_ =
+        std::make_unique<snappy_internal::ParallelSnappyDecompressor>(
+            parallelism_);
+  }
 }
 
 void HadoopSnappyReaderBase::Done() {
@@ -56,6 +132,7 @@ void HadoopSnappyReaderBase::Done() {
   }
   PullableReader::Done();
   uncompressed_ = Buffer();
+  parallel_decompressor_.reset();
 }
 
 inline bool HadoopSnappyReaderBase::FailInvalidStream(
@@ -94,78 +171,108 @@ bool HadoopSnappyReaderBase::PullBehindScratch(size_t recommended_length) {
       << "Failed precondition of PullableReader::PullBehindScratch(): "
          "scratch used";
   if (ABSL_PREDICT_FALSE(!ok())) return false;
+  if (parallel_decompressor_ != nullptr) return PullBehindScratchParallel();
   Reader& src = *SrcReader();
   truncated_ = false;
-  while (remaining_chunk_length_ == 0) {
-    if (ABSL_PREDICT_FALSE(!src.Pull(sizeof(uint32_t)))) {
-      set_buffer();
-      if (ABSL_PREDICT_FALSE(!src.ok())) {
-        return FailWithoutAnnotation(AnnotateOverSrc(src.status()));
-      }
-      if (ABSL_PREDICT_FALSE(src.available() > 0)) truncated_ = true;
-      return false;
-    }
-    remaining_chunk_length_ = ReadBigEndian32(src.cursor());
-    src.move_cursor(sizeof(uint32_t));
-  }
-  size_t uncompressed_length;
-  char* uncompressed_data;
+  Block block;
   do {
-    if (ABSL_PREDICT_FALSE(!src.Pull(sizeof(uint32_t)))) {
-      set_buffer();
-      if (ABSL_PREDICT_FALSE(!src.ok())) {
+    absl::string_view message;
+    switch (ReadBlock(src, remaining_chunk_length_, block, message)) {
+      case BlockResult::kData:
+        break;
+      case BlockResult::kEnd:
+        set_buffer();
+        return false;
+      case BlockResult::kTruncated:
+        set_buffer();
+        truncated_ = true;
+        return false;
+      case BlockResult::kSrcFailed:
+        set_buffer();
         return FailWithoutAnnotation(AnnotateOverSrc(src.status()));
-      }
-      truncated_ = true;
-      return false;
+      case BlockResult::kInvalid:
+        set_buffer();
+        return FailInvalidStream(message);
     }
-    const uint32_t compressed_length = ReadBigEndian32(src.cursor());
-    if (ABSL_PREDICT_FALSE(compressed_length >
-                           std::numeric_limits<uint32_t>::max() -
-                               sizeof(uint32_t))) {
-      set_buffer();
-      return FailInvalidStream("compressed length too large");
-    }
-    if (ABSL_PREDICT_FALSE(!src.Pull(sizeof(uint32_t) + compressed_length))) {
-      set_buffer();
-      if (ABSL_PREDICT_FALSE(!src.ok())) {
-        return FailWithoutAnnotation(AnnotateOverSrc(src.status()));
-      }
-      truncated_ = true;
-      return false;
-    }
-    const char* const compressed_data = src.cursor() + sizeof(uint32_t);
-    if (ABSL_PREDICT_FALSE(!snappy::GetUncompressedLength(
-            compressed_data, compressed_length, &uncompressed_length))) {
-      set_buffer();
-      return FailInvalidStream("invalid uncompressed length");
-    }
-    if (ABSL_PREDICT_FALSE(uncompressed_length > remaining_chunk_length_)) {
-      set_buffer();
-      return FailInvalidStream("uncompressed length too large");
-    }
-    uncompressed_.Reset(uncompressed_length);
-    uncompressed_data = uncompressed_.data();
+    uncompressed_.Reset(block.uncompressed_length);
     if (ABSL_PREDICT_FALSE(!snappy::RawUncompress(
-            compressed_data, compressed_length, uncompressed_data))) {
+            block.compressed_data.data(), block.compressed_data.size(),
+            uncompressed_.data()))) {
       set_buffer();
       return FailInvalidStream("invalid compressed data");
     }
-    src.move_cursor(sizeof(uint32_t) + compressed_length);
-  } while (uncompressed_length == 0);
-  remaining_chunk_length_ -= uncompressed_length;
+    src.move_cursor(block.block_length);
+  } while (block.uncompressed_length == 0);
+  remaining_chunk_length_ -= IntCast<uint32_t>(block.uncompressed_length);
   const Position max_length =
       std::numeric_limits<Position>::max() - limit_pos();
-  if (ABSL_PREDICT_FALSE(uncompressed_length > max_length)) {
-    set_buffer(uncompressed_data, IntCast<size_t>(max_length));
+  if (ABSL_PREDICT_FALSE(block.uncompressed_length > max_length)) {
+    set_buffer(uncompressed_.data(), IntCast<size_t>(max_length));
     move_limit_pos(available());
     return FailOverflow();
   }
-  set_buffer(uncompressed_data, uncompressed_length);
+  set_buffer(uncompressed_.data(), block.uncompressed_length);
   move_limit_pos(available());
   return true;
 }
 
+bool HadoopSnappyReaderBase::PullBehindScratchParallel() {
+  Reader& src = *SrcReader();
+  truncated_ = false;
+  for (;;) {
+    // Read ahead as many blocks as allowed. Reading stops at the first block
+    // which is not available. Its status is reported only after pending blocks
+    // are returned, and then it is determined again because the source might
+    // have grown meanwhile.
+    BlockResult result = BlockResult::kData;
+    absl::string_view message;
+    while (parallel_decompressor_->HasCapacity()) {
+      Block block;
+      result = ReadBlock(src, remaining_chunk_length_, block, message);
+      if (result != BlockResult::kData) break;
+      parallel_decompressor_->Add(block.compressed_data, true,
+                                  block.uncompressed_length, absl::nullopt);
+      remaining_chunk_length_ -= IntCast<uint32_t>(block.uncompressed_length);
+      src.move_cursor(block.block_length);
+    }
+    if (parallel_decompressor_->empty()) {
+      set_buffer();
+      switch (result) {
+        case BlockResult::kData:
+          RIEGELI_ASSERT_UNREACHABLE() << "No blocks read ahead";
+        case BlockResult::kEnd:
+          return false;
+        case BlockResult::kTruncated:
+          truncated_ = true;
+          return false;
+        case BlockResult::kSrcFailed:
+          return FailWithoutAnnotation(AnnotateOverSrc(src.status()));
+        case BlockResult::kInvalid:
+          return FailInvalidStream(message);
+      }
+      RIEGELI_ASSERT_UNREACHABLE()
+          << "Unknown block result: " << static_cast<int>(result);
+    }
+    absl::string_view uncompressed;
+    const absl::Status status = parallel_decompressor_->Next(uncompressed);
+    if (ABSL_PREDICT_FALSE(!status.ok())) {
+      set_buffer();
+      return FailInvalidStream(status.message());
+    }
+    if (ABSL_PREDICT_FALSE(uncompressed.empty())) continue;
+    const Position max_length =
+        std::numeric_limits<Position>::max() - limit_pos();
+    if (ABSL_PREDICT_FALSE(uncompressed.size() > max_length)) {
+      set_buffer(uncompressed.data(), IntCast<size_t>(max_length));
+      move_limit_pos(available());
+      return FailOverflow();
+    }
+    set_buffer(uncompressed.data(), uncompressed.size());
+    move_limit_pos(available());
+    return true;
+  }
+}
+
 bool HadoopSnappyReaderBase::ToleratesReadingAhead() {
   Reader* const src = SrcReader();
   return src != nullptr && src->ToleratesReadingAhead();
@@ -197,11 +304,44 @@ bool HadoopSnappyReaderBase::SeekBehindScratch(Position new_pos) {
               "HadoopSnappy-compressed stream got truncated"))));
     }
     if (ABSL_PREDICT_FALSE(!ok())) return false;
+    if (parallel_decompressor_ != nullptr) parallel_decompressor_->Clear();
     if (new_pos == 0) return true;
+  } else if (ABSL_PREDICT_FALSE(!SkipBlocks(new_pos))) {
+    return false;
   }
   return PullableReader::SeekBehindScratch(new_pos);
 }
 
+bool HadoopSnappyReaderBase::SkipBlocks(Position new_pos) {
+  RIEGELI_ASSERT_GT(new_pos, limit_pos())
+      << "Failed precondition of HadoopSnappyReaderBase::SkipBlocks(): "
+         "not seeking forwards";
+  if (ABSL_PREDICT_FALSE(!ok())) return false;
+  set_buffer();
+  // Skip blocks read ahead which end before `new_pos`.
+  if (parallel_decompressor_ != nullptr) {
+    while (!parallel_decompressor_->empty() &&
+           parallel_decompressor_->FrontLength() <= new_pos - limit_pos()) {
+      move_limit_pos(parallel_decompressor_->FrontLength());
+      parallel_decompressor_->PopFront();
+    }
+    if (!parallel_decompressor_->empty()) return true;
+  }
+  // Skip blocks which end before `new_pos`, without decompressing them.
+  // Anything else, including errors, is left for `PullBehindScratch()`.
+  Reader& src = *SrcReader();
+  Block block;
+  absl::string_view message;
+  while (ReadBlock(src, remaining_chunk_length_, block, message) ==
+             BlockResult::kData &&
+         block.uncompressed_length <= new_pos - limit_pos()) {
+    remaining_chunk_length_ -= IntCast<uint32_t>(block.uncompressed_length);
+    src.move_cursor(block.block_length);
+    move_limit_pos(block.uncompressed_length);
+  }
+  return true;
+}
+
 bool HadoopSnappyReaderBase::SupportsNewReader() {
   Reader* const src = SrcReader();
   return src != nullptr && src->SupportsNewReader();
@@ -221,7 +361,8 @@ std::unique_ptr<Reader> HadoopSnappyReaderBase::NewReaderImpl(
   }
   std::unique_ptr<Reader> reader =
       std::make_unique<HadoopSnappyReader<std::unique_ptr<Reader>>>(
-          std::move(compressed_reader));
+          std::move(compressed_reader),
+          HadoopSnappyReaderBase::Options().set_parallelism(parallelism_));
   reader->Seek(initial_pos);
   return reader;
 }
@@ -25,6 +25,7 @@
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
 #include "absl/strings/string_view.h"
+#include "riegeli/base/assert.h"
 #include "riegeli/base/buffer.h"
 #include "riegeli/base/dependency.h"
 #include "riegeli/base/initializer.h"
@@ -32,13 +33,42 @@
 #include "riegeli/base/types.h"
 #include "riegeli/bytes/pullable_reader.h"
 #include "riegeli/bytes/reader.h"
+#include "riegeli/snappy/parallel_snappy_decompressor.h"
 
 namespace riegeli {
 
 // Template parameter independent part of `HadoopSnappyReader`.
 class HadoopSnappyReaderBase : public PullableReader {
  public:
-  class Options {};
+  class Options {
+   public:
+    Options() noexcept {}
+
+    // Number of blocks to decompress concurrently in background threads.
+    // `parallelism() == 0` decompresses in the current thread.
+    //
+    // If `parallelism() > 0`, up to `parallelism()` compressed blocks are read
+    // ahead from the compressed `Reader`, and they are decompressed
+    // independently.
+    //
+    // Default: 0.
+    Options& set_parallelism(int parallelism) & ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      RIEGELI_ASSERT_GE(parallelism, 0)
+          << "Failed precondition of "
+             "HadoopSnappyReaderBase::Options::set_parallelism(): "
+             "negative parallelism";
+      parallelism_ = parallelism;
+      return *this;
+    }
+    Options&& set_parallelism(int parallelism) &&
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      return std::move(set_parallelism(parallelism));
+    }
+    int parallelism() const { return parallelism_; }
+
+   private:
+    int parallelism_ = 0;
+  };
 
   // Returns the compressed `Reader`. Unchanged by `Close()`.
   virtual Reader* SrcReader() const ABSL_ATTRIBUTE_LIFETIME_BOUND = 0;
@@ -48,13 +78,15 @@ class HadoopSnappyReaderBase : public PullableReader {
   bool SupportsNewReader() override;
 
  protected:
-  using PullableReader::PullableReader;
+  explicit HadoopSnappyReaderBase(Closed) noexcept : PullableReader(kClosed) {}
+
+  explicit HadoopSnappyReaderBase(int parallelism);
 
   HadoopSnappyReaderBase(HadoopSnappyReaderBase&& that) noexcept;
   HadoopSnappyReaderBase& operator=(HadoopSnappyReaderBase&& that) noexcept;
 
   void Reset(Closed);
-  void Reset();
+  void Reset(int parallelism);
   void Initialize(Reader* src);
   ABSL_ATTRIBUTE_COLD absl::Status AnnotateOverSrc(absl::Status status);
 
@@ -67,19 +99,28 @@ class HadoopSnappyReaderBase : public PullableReader {
 
  private:
   ABSL_ATTRIBUTE_COLD bool FailInvalidStream(absl::string_view message);
+  bool PullBehindScratchParallel();
+  bool SkipBlocks(Position new_pos);
 
+  int parallelism_ = 0;
   // If `true`, the source is truncated (without a clean end of the compressed
   // stream) at the current position. If the source does not grow, `Close()`
   // will fail.
   bool truncated_ = false;
-  // Remaining number of uncompressed bytes in the current chunk.
+  // Remaining number of uncompressed bytes in the current chunk, excluding
+  // blocks read ahead.
   uint32_t remaining_chunk_length_ = 0;
   Position initial_compressed_pos_ = 0;
   // Buffered uncompressed data.
   Buffer uncompressed_;
+  // Blocks read ahead, if `parallelism_ > 0`.
+  std::unique_ptr<snappy_internal::ParallelSnappyDecompressor>
+      parallel_decompressor_;
 
   // Invariant if scratch is not used:
-  //   `start() == nullptr` or `start() == uncompressed_.data()`
+  //   `start() == nullptr` or `start() == uncompressed_.data()` or
+  //   `start()` points to the data last returned by
+  //   `parallel_decompressor_->Next()`
 };
 
 // A `Reader` which decompresses data with Hadoop Snappy format after getting
@@ -149,43 +190,54 @@ explicit HadoopSnappyReader(Src&& src, HadoopSnappyReaderBase::Options options =
 
 // Implementation details follow.
 
+inline HadoopSnappyReaderBase::HadoopSnappyReaderBase(int parallelism)
+    : parallelism_(parallelism) {}
+
 inline HadoopSnappyReaderBase::HadoopSnappyReaderBase(
     HadoopSnappyReaderBase&& that) noexcept
     : PullableReader(static_cast<PullableReader&&>(that)),
+      parallelism_(that.parallelism_),
       truncated_(that.truncated_),
       remaining_chunk_length_(that.remaining_chunk_length_),
       initial_compressed_pos_(that.initial_compressed_pos_),
-      uncompressed_(std::move(that.uncompressed_)) {}
+      uncompressed_(std::move(that.uncompressed_)),
+      parallel_decompressor_(std::move(that.parallel_decompressor_)) {}
 
 inline HadoopSnappyReaderBase& HadoopSnappyReaderBase::operator=(
     HadoopSnappyReaderBase&& that) noexcept {
   PullableReader::operator=(static_cast<PullableReader&&>(that));
+  parallelism_ = that.parallelism_;
   truncated_ = that.truncated_;
   remaining_chunk_length_ = that.remaining_chunk_length_;
   initial_compressed_pos_ = that.initial_compressed_pos_;
   uncompressed_ = std::move(that.uncompressed_);
+  parallel_decompressor_ = std::move(that.parallel_decompressor_);
   return *this;
 }
 
 inline void HadoopSnappyReaderBase::Reset(Closed) {
   PullableReader::Reset(kClosed);
+  parallelism_ = 0;
   truncated_ = false;
   remaining_chunk_length_ = 0;
   initial_compressed_pos_ = 0;
   uncompressed_ = Buffer();
+  parallel_decompressor_.reset();
 }
 
-inline void HadoopSnappyReaderBase::Reset() {
+inline void HadoopSnappyReaderBase::Reset(int parallelism) {
   PullableReader::Reset();
+  parallelism_ = parallelism;
   truncated_ = false;
   remaining_chunk_length_ = 0;
   initial_compressed_pos_ = 0;
+  parallel_decompressor_.reset();
 }
 
 template <typename Src>
-inline HadoopSnappyReader<Src>::HadoopSnappyReader(
-    Initializer<Src> src, ABSL_ATTRIBUTE_UNUSED Options options)
-    : src_(std::move(src)) {
+inline HadoopSnappyReader<Src>::HadoopSnappyReader(Initializer<Src> src,
+                                                   Options options)
+    : HadoopSnappyReaderBase(options.parallelism()), src_(std::move(src)) {
   Initialize(src_.get());
 }
 
@@ -196,9 +248,9 @@ inline void HadoopSnappyReader<Src>::Reset(Closed) {
 }
 
 template <typename Src>
-inline void HadoopSnappyReader<Src>::Reset(
-    Initializer<Src> src, ABSL_ATTRIBUTE_UNUSED Options options) {
-  HadoopSnappyReaderBase::Reset();
+inline void HadoopSnappyReader<Src>::Reset(Initializer<Src> src,
+                                           Options options) {
+  HadoopSnappyReaderBase::Reset(options.parallelism());
   src_.Reset(std::move(src));
   Initialize(src_.get());
 }
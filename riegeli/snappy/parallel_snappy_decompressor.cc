@@ -0,0 +1,105 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/snappy/parallel_snappy_decompressor.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <future>
+#include <string>
+#include <utility>
+
+#include "absl/base/optimization.h"
+#include "absl/crc/crc32c.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/arithmetic.h"
+#include "riegeli/base/assert.h"
+#include "riegeli/base/parallelism.h"
+#include "snappy.h"
+
+namespace riegeli {
+namespace snappy_internal {
+
+uint32_t MaskedCrc32c(absl::string_view data) {
+  const uint32_t crc = static_cast<uint32_t>(absl::ComputeCrc32c(data));
+  return ((crc >> 15) | (crc << 17)) + 0xa282ead8;
+}
+
+ParallelSnappyDecompressor::ParallelSnappyDecompressor(int parallelism)
+    : parallelism_(IntCast<size_t>(parallelism)) {}
+
+void ParallelSnappyDecompressor::Add(absl::string_view data, bool compressed,
+                                     size_t uncompressed_length,
+                                     absl::optional<uint32_t> masked_checksum) {
+  std::promise<DecompressedFrame> promise;
+  frames_.push_back(Frame{uncompressed_length, promise.get_future()});
+  internal::ThreadPool::global().Schedule(
+      [promise = std::move(promise), data = std::string(data), compressed,
+       uncompressed_length, masked_checksum]() mutable {
+        promise.set_value(Decompress(std::move(data), compressed,
+                                     uncompressed_length, masked_checksum));
+      });
+}
+
+ParallelSnappyDecompressor::DecompressedFrame
+ParallelSnappyDecompressor::Decompress(
+    std::string data, bool compressed, size_t uncompressed_length,
+    absl::optional<uint32_t> masked_checksum) {
+  DecompressedFrame frame;
+  if (compressed) {
+    frame.data.resize(uncompressed_length);
+    if (ABSL_PREDICT_FALSE(
+            !snappy::RawUncompress(data.data(), data.size(), &frame.data[0]))) {
+      frame.error = "invalid compressed data";
+      return frame;
+    }
+  } else {
+    frame.data = std::move(data);
+  }
+  if (masked_checksum != absl::nullopt &&
+      ABSL_PREDICT_FALSE(MaskedCrc32c(frame.data) != *masked_checksum)) {
+    frame.error = "wrong checksum";
+  }
+  return frame;
+}
+
+void ParallelSnappyDecompressor::PopFront() {
+  RIEGELI_ASSERT(!empty())
+      << "Failed precondition of ParallelSnappyDecompressor::PopFront(): "
+         "no pending frames";
+  // The background task finishes on its own, its result is discarded.
+  frames_.pop_front();
+}
+
+void ParallelSnappyDecompressor::Clear() { frames_.clear(); }
+
+absl::Status ParallelSnappyDecompressor::Next(absl::string_view& data) {
+  RIEGELI_ASSERT(!empty())
+      << "Failed precondition of ParallelSnappyDecompressor::Next(): "
+         "no pending frames";
+  DecompressedFrame frame = frames_.front().decompressed.get();
+  frames_.pop_front();
+  if (ABSL_PREDICT_FALSE(frame.error != nullptr)) {
+    return absl::InvalidArgumentError(frame.error);
+  }
+  current_ = std::move(frame.data);
+  data = current_;
+  return absl::OkStatus();
+}
+
+}  // namespace snappy_internal
+}  // namespace riegeli
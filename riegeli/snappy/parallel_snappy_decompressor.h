@@ -0,0 +1,110 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_SNAPPY_PARALLEL_SNAPPY_DECOMPRESSOR_H_
+#define RIEGELI_SNAPPY_PARALLEL_SNAPPY_DECOMPRESSOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <future>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+
+namespace riegeli {
+namespace snappy_internal {
+
+// Decompresses independent Snappy frames in background threads, returning
+// them in order. Used by readers of framed Snappy formats to read ahead.
+class ParallelSnappyDecompressor {
+ public:
+  explicit ParallelSnappyDecompressor(int parallelism);
+
+  ParallelSnappyDecompressor(const ParallelSnappyDecompressor&) = delete;
+  ParallelSnappyDecompressor& operator=(const ParallelSnappyDecompressor&) =
+      delete;
+
+  // Returns `true` if no frames are pending.
+  bool empty() const { return frames_.empty(); }
+
+  // Returns `true` if another frame can be added without exceeding the
+  // parallelism.
+  bool HasCapacity() const { return frames_.size() < parallelism_; }
+
+  // Schedules decompression of a frame.
+  //
+  // If `compressed` is `false`, `data` are already uncompressed and are
+  // returned as is. `uncompressed_length` must have been obtained from
+  // `snappy::GetUncompressedLength()` or be `data.size()` respectively.
+  //
+  // If `masked_checksum` is not `absl::nullopt`, the masked CRC32C of the
+  // uncompressed data is verified against it.
+  void Add(absl::string_view data, bool compressed, size_t uncompressed_length,
+           absl::optional<uint32_t> masked_checksum);
+
+  // Returns the uncompressed length of the first pending frame.
+  //
+  // Precondition: `!empty()`
+  size_t FrontLength() const { return frames_.front().uncompressed_length; }
+
+  // Discards the first pending frame without waiting for it.
+  //
+  // Precondition: `!empty()`
+  void PopFront();
+
+  // Discards all pending frames.
+  void Clear();
+
+  // Waits for the first pending frame and removes it from pending frames.
+  // On success sets `data` to its uncompressed data, valid until the next
+  // non-const call. On failure returns `absl::InvalidArgumentError()` whose
+  // message describes what is invalid.
+  //
+  // Precondition: `!empty()`
+  absl::Status Next(absl::string_view& data);
+
+ private:
+  struct DecompressedFrame {
+    std::string data;
+    // `nullptr` on success, otherwise the reason of failure.
+    const char* error = nullptr;
+  };
+
+  struct Frame {
+    size_t uncompressed_length;
+    std::future<DecompressedFrame> decompressed;
+  };
+
+  static DecompressedFrame Decompress(std::string data, bool compressed,
+                                      size_t uncompressed_length,
+                                      absl::optional<uint32_t> masked_checksum);
+
+  size_t parallelism_;
+  std::deque<Frame> frames_;
+  // The frame returned by the last `Next()`.
+  std::string current_;
+};
+
+// Returns the masked CRC32C of `data`, as stored by the framed Snappy format:
+// https://github.com/google/snappy/blob/e9e11b84e629c3e06fbaa4f0a86de02ceb9d6992/framing_format.txt#L39
+uint32_t MaskedCrc32c(absl::string_view data);
+
+}  // namespace snappy_internal
+}  // namespace riegeli
+
+#endif  // RIEGELI_SNAPPY_PARALLEL_SNAPPY_DECOMPRESSOR_H_
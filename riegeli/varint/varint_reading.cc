@@ -17,8 +17,17 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#ifdef __SSSE3__
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#endif
+
 #include "absl/base/optimization.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "riegeli/base/arithmetic.h"
+#include "riegeli/base/assert.h"
+#include "riegeli/base/global.h"  // IWYU pragma: keep
 #include "riegeli/bytes/reader.h"
 
 namespace riegeli {
@@ -197,5 +206,209 @@ absl::optional<const char*> ReadVarint64Slow(const char* src, const char* limit,
   return src;
 }
 
+namespace {
+
+#ifdef __SSSE3__
+
+// Byte shuffles which move varints of up to 4 bytes, found among the first 12
+// bytes of a block, to separate 32-bit lanes.
+class VarintShuffles {
+ public:
+  // The number of leading bytes of a block whose continuation bits select
+  // the shuffle.
+  static constexpr size_t kMaskBits = 12;
+
+  struct Shuffle {
+    // Moves byte `j` of varint `i` to byte `j` of lane `i`, and clears other
+    // bytes.
+    __m128i pattern;
+    // The number of complete varints of up to 4 bytes at the beginning of the
+    // block, at most 4.
+    uint8_t num_values;
+    // Their total length.
+    uint8_t length;
+  };
+
+  VarintShuffles();
+
+  // Returns the shuffle for the continuation bits of the leading
+  // `kMaskBits` bytes.
+  const Shuffle& operator[](uint32_t mask) const {
+    return shuffles_[shuffle_indices_[mask & ((1u << kMaskBits) - 1)]];
+  }
+
+ private:
+  // An upper bound of the number of sequences of 0 to 4 varint lengths between
+  // 1 and 4: 1 + 4 + 16 + 64 + 256. Not all of them fit in `kMaskBits` bytes.
+  static constexpr size_t kNumShuffles = 341;
+
+  Shuffle shuffles_[kNumShuffles];
+  uint16_t shuffle_indices_[size_t{1} << kMaskBits];
+};
+
+VarintShuffles::VarintShuffles() {
+  size_t num_shuffles = 0;
+  // Maps a sequence of varint lengths, written as a base-5 number, to the index
+  // of its shuffle. Lengths are never 0, so sequences of different sizes are
+  // distinguished.
+  uint16_t shuffle_by_lengths[5 * 5 * 5 * 5];
+  for (uint16_t& index : shuffle_by_lengths) index = kNumShuffles;
+  for (uint32_t mask = 0; mask < (1u << kMaskBits); ++mask) {
+    size_t lengths[4];
+    size_t num_values = 0;
+    size_t lengths_key = 0;
+    size_t pos = 0;
+    while (num_values < 4) {
+      size_t end = pos;
+      while (end < kMaskBits && (mask & (1u << end)) != 0) ++end;
+      // The varint does not end within the leading `kMaskBits` bytes.
+      if (end == kMaskBits) break;
+      const size_t length = end + 1 - pos;
+      // The varint is too long for a 4-byte lane.
+      if (length > 4) break;
+      lengths[num_values++] = length;
+      lengths_key = lengths_key * 5 + length;
+      pos = end + 1;
+    }
+    uint16_t& index = shuffle_by_lengths[lengths_key];
+    if (index == kNumShuffles) {
+      RIEGELI_ASSERT_LT(num_shuffles, kNumShuffles)
+          << "Too many varint shuffles";
+      alignas(__m128i) int8_t pattern[16];
+      for (int8_t& byte : pattern) byte = -1;
+      size_t src_index = 0;
+      for (size_t i = 0; i < num_values; ++i) {
+        for (size_t j = 0; j < lengths[i]; ++j) {
+          pattern[i * 4 + j] = static_cast<int8_t>(src_index++);
+        }
+      }
+      Shuffle& shuffle = shuffles_[num_shuffles];
+      shuffle.pattern =
+          _mm_load_si128(reinterpret_cast<const __m128i*>(pattern));
+      shuffle.num_values = static_cast<uint8_t>(num_values);
+      shuffle.length = static_cast<uint8_t>(src_index);
+      index = static_cast<uint16_t>(num_shuffles++);
+    }
+    shuffle_indices_[mask] = index;
+  }
+}
+
+// Decodes up to 4 varints of up to 4 bytes each from 16 bytes at `src`, into
+// 32-bit lanes of the result.
+//
+// Sets `num_values` to the number of varints decoded, which is 0 if the first
+// varint is longer than 4 bytes or does not end in the first 12 bytes, and sets
+// `length` to their total length.
+inline __m128i DecodeVarint32Block(const VarintShuffles& shuffles,
+                                   const char* src, size_t& num_values,
+                                   size_t& length) {
+  const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+  const VarintShuffles::Shuffle& shuffle =
+      shuffles[static_cast<uint32_t>(_mm_movemask_epi8(data))];
+  num_values = shuffle.num_values;
+  length = shuffle.length;
+  // Move varints to lanes and clear continuation bits.
+  const __m128i spread = _mm_and_si128(_mm_shuffle_epi8(data, shuffle.pattern),
+                                       _mm_set1_epi8(0x7f));
+  // Join 7-bit groups within each lane.
+  return _mm_or_si128(
+      _mm_or_si128(
+          _mm_and_si128(spread, _mm_set1_epi32(0x0000007f)),
+          _mm_srli_epi32(_mm_and_si128(spread, _mm_set1_epi32(0x00007f00)), 1)),
+      _mm_or_si128(
+          _mm_srli_epi32(_mm_and_si128(spread, _mm_set1_epi32(0x007f0000)), 2),
+          _mm_srli_epi32(_mm_and_si128(spread, _mm_set1_epi32(0x7f000000)),
+                         3)));
+}
+
+inline void StoreValues(__m128i values, uint32_t* dest) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), values);
+}
+
+inline void StoreValues(__m128i values, uint64_t* dest) {
+  const __m128i zero = _mm_setzero_si128();
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dest),
+                   _mm_unpacklo_epi32(values, zero));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + 2),
+                   _mm_unpackhi_epi32(values, zero));
+}
+
+#endif  // __SSSE3__
+
+inline bool ReadVarint(Reader& src, uint32_t& dest) {
+  return ReadVarint32(src, dest);
+}
+
+inline bool ReadVarint(Reader& src, uint64_t& dest) {
+  return ReadVarint64(src, dest);
+}
+
+inline absl::optional<const char*> ReadVarint(const char* src,
+                                              const char* limit,
+                                              uint32_t& dest) {
+  return ReadVarint32(src, limit, dest);
+}
+
+inline absl::optional<const char*> ReadVarint(const char* src,
+                                              const char* limit,
+                                              uint64_t& dest) {
+  return ReadVarint64(src, limit, dest);
+}
+
+template <typename T>
+inline bool ReadVarintsImpl(Reader& src, absl::Span<T> dest) {
+  T* dest_ptr = dest.data();
+  T* const dest_end = dest.data() + dest.size();
+#ifdef __SSSE3__
+  if (dest.size() >= 4) {
+    const VarintShuffles& shuffles = Global<const VarintShuffles>();
+    // Blocks are decoded while 16 bytes can be loaded and 4 values can be
+    // stored.
+    T* const dest_limit = dest_end - 4;
+    while (dest_ptr <= dest_limit &&
+           (src.available() >= sizeof(__m128i) || src.Pull(sizeof(__m128i)))) {
+      const char* cursor = src.cursor();
+      const char* const cursor_limit = src.limit() - sizeof(__m128i);
+      do {
+        size_t num_values, length;
+        const __m128i values =
+            DecodeVarint32Block(shuffles, cursor, num_values, length);
+        if (ABSL_PREDICT_FALSE(num_values == 0)) {
+          // The varint is longer than 4 bytes. At least `kMaxLengthVarint64`
+          // bytes are available, so failure means an invalid varint.
+          const absl::optional<const char*> next =
+              ReadVarint(cursor, src.limit(), *dest_ptr);
+          if (ABSL_PREDICT_FALSE(next == absl::nullopt)) {
+            src.set_cursor(cursor);
+            return false;
+          }
+          cursor = *next;
+          ++dest_ptr;
+          continue;
+        }
+        StoreValues(values, dest_ptr);
+        dest_ptr += num_values;
+        cursor += length;
+      } while (cursor <= cursor_limit && dest_ptr <= dest_limit);
+      src.set_cursor(cursor);
+    }
+  }
+#endif
+  for (; dest_ptr != dest_end; ++dest_ptr) {
+    if (ABSL_PREDICT_FALSE(!ReadVarint(src, *dest_ptr))) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
 }  // namespace varint_internal
+
+bool ReadVarint32s(Reader& src, absl::Span<uint32_t> dest) {
+  return varint_internal::ReadVarintsImpl(src, dest);
+}
+
+bool ReadVarint64s(Reader& src, absl::Span<uint64_t> dest) {
+  return varint_internal::ReadVarintsImpl(src, dest);
+}
 }  // namespace riegeli
@@ -20,6 +20,7 @@
 
 #include "absl/base/optimization.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "riegeli/base/arithmetic.h"
 #include "riegeli/base/constexpr.h"
 #include "riegeli/bytes/reader.h"
@@ -86,6 +87,25 @@ bool ReadVarintSigned64(Reader& src, uint64_t& dest);
 bool ReadCanonicalVarint32(Reader& src, uint32_t& dest);
 bool ReadCanonicalVarint64(Reader& src, uint64_t& dest);
 
+// Reads an array of varints. This corresponds to packed protobuf fields of
+// types `{int,uint}{32,64}` (with a cast needed in the case of `int{32,64}`).
+//
+// This is faster than reading them individually. When at least 16 bytes are
+// buffered and SSSE3 is available, up to 4 varints of up to 4 bytes each are
+// decoded at once with a byte shuffle selected by their continuation bits.
+// Longer varints are decoded individually.
+//
+// Return values:
+//  * `true`                     - success (`dest[]` is filled)
+//  * `false` (when `src.ok()`)  - source ends too early
+//                                 (`src` position is undefined,
+//                                 `dest[]` is undefined)
+//  * `false` (when `!src.ok()`) - failure
+//                                 (`src` position is undefined,
+//                                 `dest[]` is undefined)
+bool ReadVarint32s(Reader& src, absl::Span<uint32_t> dest);
+bool ReadVarint64s(Reader& src, absl::Span<uint64_t> dest);
+
 // Reads a varint from an array. This corresponds to protobuf types
 // `{int,uint}{32,64}` (with a cast needed in the case of `int{32,64}`).
 //
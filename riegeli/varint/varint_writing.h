@@ -18,8 +18,11 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <limits>
+
 #include "absl/base/optimization.h"
 #include "absl/numeric/bits.h"
+#include "absl/types/span.h"
 #include "riegeli/base/arithmetic.h"
 #include "riegeli/base/constexpr.h"
 #include "riegeli/bytes/backward_writer.h"
@@ -55,6 +58,18 @@ bool WriteVarintSigned64(int64_t data, Writer& dest);
 bool WriteVarintSigned32(int32_t data, BackwardWriter& dest);
 bool WriteVarintSigned64(int64_t data, BackwardWriter& dest);
 
+// Writes an array of varints. This corresponds to packed protobuf fields of
+// types `{int,uint}{32,64}` (with a cast needed in the case of `int{32,64}`).
+//
+// This is faster than writing them individually because buffer space is
+// ensured once for many values.
+//
+// Return values:
+//  * `true`  - success (`dest.ok()`)
+//  * `false` - failure (`!dest.ok()`)
+bool WriteVarint32s(absl::Span<const uint32_t> data, Writer& dest);
+bool WriteVarint64s(absl::Span<const uint64_t> data, Writer& dest);
+
 // Returns the length needed to write a given value as a varint.
 // This corresponds to protobuf types `{int,uint}{32,64}` (with a cast needed in
 // the case of `int{32,64}`).
@@ -150,6 +165,48 @@ inline bool WriteVarint64(uint64_t data, BackwardWriter& dest) {
   return true;
 }
 
+inline bool WriteVarint32s(absl::Span<const uint32_t> data, Writer& dest) {
+  while (!data.empty()) {
+    if (ABSL_PREDICT_FALSE(!dest.Push(
+            kMaxLengthVarint32,
+            UnsignedMin(data.size(), std::numeric_limits<size_t>::max() /
+                                         kMaxLengthVarint32) *
+                kMaxLengthVarint32))) {
+      return false;
+    }
+    const size_t length =
+        UnsignedMin(data.size(), dest.available() / kMaxLengthVarint32);
+    char* cursor = dest.cursor();
+    for (const uint32_t value : data.subspan(0, length)) {
+      cursor = WriteVarint32(value, cursor);
+    }
+    dest.set_cursor(cursor);
+    data.remove_prefix(length);
+  }
+  return true;
+}
+
+inline bool WriteVarint64s(absl::Span<const uint64_t> data, Writer& dest) {
+  while (!data.empty()) {
+    if (ABSL_PREDICT_FALSE(!dest.Push(
+            kMaxLengthVarint64,
+            UnsignedMin(data.size(), std::numeric_limits<size_t>::max() /
+                                         kMaxLengthVarint64) *
+                kMaxLengthVarint64))) {
+      return false;
+    }
+    const size_t length =
+        UnsignedMin(data.size(), dest.available() / kMaxLengthVarint64);
+    char* cursor = dest.cursor();
+    for (const uint64_t value : data.subspan(0, length)) {
+      cursor = WriteVarint64(value, cursor);
+    }
+    dest.set_cursor(cursor);
+    data.remove_prefix(length);
+  }
+  return true;
+}
+
 inline bool WriteVarintSigned32(int32_t data, Writer& dest) {
   return WriteVarint32(varint_internal::EncodeSint32(data), dest);
 }
@@ -26,6 +26,7 @@
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
 #include "lzma.h"
 #include "riegeli/base/arithmetic.h"
 #include "riegeli/base/assert.h"
@@ -53,19 +54,49 @@ void XzReaderBase::Initialize(Reader* src) {
     return;
   }
   initial_compressed_pos_ = src->pos();
-  InitializeDecompressor();
+  InitializeDecompressor(*src);
 }
 
-inline void XzReaderBase::InitializeDecompressor() {
+inline void XzReaderBase::InitializeDecompressor(Reader& src) {
+  Container container = container_;
+  int parallelism = 0;
+#if LZMA_VERSION >= UINT32_C(50040002)
+  if (parallelism_ > 0) {
+    // `lzma_auto_decoder()` does not support multi-threaded decompression.
+    if (container == Container::kXzOrLzma && RecognizeXz(src)) {
+      container = Container::kXz;
+    }
+    if (container == Container::kXz) parallelism = parallelism_;
+  }
+#endif
   decompressor_ =
       KeyedRecyclingPool<lzma_stream, LzmaStreamKey, LzmaStreamDeleter>::global(
           recycling_pool_options_)
-          .Get(LzmaStreamKey(container_), [] {
+          .Get(LzmaStreamKey(container, parallelism), [] {
             return std::unique_ptr<lzma_stream, LzmaStreamDeleter>(
                 new lzma_stream());
           });
-  switch (container_) {
+  switch (container) {
     case Container::kXz: {
+#if LZMA_VERSION >= UINT32_C(50040002)
+      if (parallelism > 0) {
+        lzma_mt mt_options{};
+        mt_options.flags = flags_;
+        mt_options.threads = SaturatingIntCast<uint32_t>(parallelism);
+        mt_options.memlimit_threading =
+            threading_memory_limit_ != absl::nullopt
+                ? *threading_memory_limit_
+                : lzma_physmem() / 4;
+        mt_options.memlimit_stop = std::numeric_limits<uint64_t>::max();
+        const lzma_ret liblzma_code =
+            lzma_stream_decoder_mt(decompressor_.get(), &mt_options);
+        if (ABSL_PREDICT_FALSE(liblzma_code != LZMA_OK)) {
+          FailOperation("lzma_stream_decoder_mt()", liblzma_code);
+        }
+        return;
+      }
+#endif
+
       const lzma_ret liblzma_code = lzma_stream_decoder(
           decompressor_.get(), std::numeric_limits<uint64_t>::max(), flags_);
       if (ABSL_PREDICT_FALSE(liblzma_code != LZMA_OK)) {
@@ -91,7 +122,7 @@ inline void XzReaderBase::InitializeDecompressor() {
     }
   }
   RIEGELI_ASSERT_UNREACHABLE()
-      << "Unknown container format: " << static_cast<int>(container_);
+      << "Unknown container format: " << static_cast<int>(container);
 }
 
 void XzReaderBase::Done() {
@@ -269,7 +300,7 @@ bool XzReaderBase::SeekBehindBuffer(Position new_pos) {
       return FailWithoutAnnotation(AnnotateOverSrc(src.StatusOrAnnotate(
           absl::DataLossError("Xz-compressed stream got truncated"))));
     }
-    InitializeDecompressor();
+    InitializeDecompressor(src);
     if (ABSL_PREDICT_FALSE(!ok())) return false;
     if (new_pos == 0) return true;
   }
@@ -298,6 +329,8 @@ std::unique_ptr<Reader> XzReaderBase::NewReaderImpl(Position initial_pos) {
           XzReaderBase::Options()
               .set_container(container_)
               .set_concatenate((flags_ & LZMA_CONCATENATED) != 0)
+              .set_parallelism(parallelism_)
+              .set_threading_memory_limit(threading_memory_limit_)
               .set_buffer_options(buffer_options())
               .set_recycling_pool_options(recycling_pool_options_));
   reader->Seek(initial_pos);
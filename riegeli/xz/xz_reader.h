@@ -25,6 +25,7 @@
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
 #include "lzma.h"
 #include "riegeli/base/assert.h"
 #include "riegeli/base/compare.h"
@@ -88,7 +89,55 @@ class XzReaderBase : public BufferedReader {
     }
     bool concatenate() const { return concatenate_; }
 
-    // Options for a global `RecyclingPool` of decompression contexts.
+    // Number of background threads to use. Larger parallelism can increase
+    // throughput, up to a point where it no longer matters; smaller parallelism
+    // reduces memory usage. `parallelism() == 0` disables background threads.
+    //
+    // `parallelism() > 0` is effective only with `Container::kXz` and
+    // `Container::kXzOrLzma` (if the actual format is `kXz`), and only if
+    // liblzma supports multi-threaded decompression (since version 5.4.0).
+    // Blocks are decompressed in parallel only if their sizes are stored in
+    // block headers, which is the case for data compressed by `XzWriter` with
+    // `parallelism() > 0`, and by `xz --threads`.
+    //
+    // Default: 0.
+    Options& set_parallelism(int parallelism) & ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      RIEGELI_ASSERT_GE(parallelism, 0)
+          << "Failed precondition of XzReaderBase::Options::set_parallelism(): "
+             "negative parallelism";
+      parallelism_ = parallelism;
+      return *this;
+    }
+    Options&& set_parallelism(int parallelism) &&
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      return std::move(set_parallelism(parallelism));
+    }
+    int parallelism() const { return parallelism_; }
+
+    // Memory usage limit for multi-threaded decompression. If decompressing
+    // with `parallelism()` threads would need more memory, fewer threads are
+    // used, down to decompressing in the current thread, which ignores this
+    // limit.
+    //
+    // `absl::nullopt` means a quarter of physical memory.
+    //
+    // Default: `absl::nullopt`.
+    Options& set_threading_memory_limit(
+        absl::optional<uint64_t> threading_memory_limit) &
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      threading_memory_limit_ = threading_memory_limit;
+      return *this;
+    }
+    Options&& set_threading_memory_limit(
+        absl::optional<uint64_t> threading_memory_limit) &&
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      return std::move(set_threading_memory_limit(threading_memory_limit));
+    }
+    absl::optional<uint64_t> threading_memory_limit() const {
+      return threading_memory_limit_;
+    }
+
+    // Options for a global `KeyedRecyclingPool` of decompression contexts.
     //
     // They tune the amount of memory which is kept to speed up creation of new
     // decompression sessions, and usage of a background thread to clean it.
@@ -113,6 +162,8 @@ class XzReaderBase : public BufferedReader {
    private:
     Container container_ = kDefaultContainer;
     bool concatenate_ = false;
+    int parallelism_ = 0;
+    absl::optional<uint64_t> threading_memory_limit_;
     RecyclingPoolOptions recycling_pool_options_;
   };
 
@@ -139,7 +190,8 @@ class XzReaderBase : public BufferedReader {
   explicit XzReaderBase(Closed) noexcept : BufferedReader(kClosed) {}
 
   explicit XzReaderBase(BufferOptions buffer_options, Container container,
-                        uint32_t flags,
+                        uint32_t flags, int parallelism,
+                        absl::optional<uint64_t> threading_memory_limit,
                         const RecyclingPoolOptions& recycling_pool_options);
 
   XzReaderBase(XzReaderBase&& that) noexcept;
@@ -147,6 +199,7 @@ class XzReaderBase : public BufferedReader {
 
   void Reset(Closed);
   void Reset(BufferOptions buffer_options, Container container, uint32_t flags,
+             int parallelism, absl::optional<uint64_t> threading_memory_limit,
              const RecyclingPoolOptions& recycling_pool_options);
   static int GetWindowBits(const Options& options);
   void Initialize(Reader* src);
@@ -170,25 +223,30 @@ class XzReaderBase : public BufferedReader {
 
   struct LzmaStreamKey : WithEqual<LzmaStreamKey> {
     LzmaStreamKey() = default;
-    explicit LzmaStreamKey(Container container) : container(container) {}
+    explicit LzmaStreamKey(Container container, int parallelism)
+        : container(container), parallelism(parallelism) {}
 
     friend bool operator==(LzmaStreamKey a, LzmaStreamKey b) {
-      return a.container == b.container;
+      return a.container == b.container && a.parallelism == b.parallelism;
     }
     template <typename HashState>
     friend HashState AbslHashValue(HashState hash_state, LzmaStreamKey self) {
-      return HashState::combine(std::move(hash_state), self.container);
+      return HashState::combine(std::move(hash_state), self.container,
+                                self.parallelism);
     }
 
     Container container;
+    int parallelism;
   };
 
-  void InitializeDecompressor();
+  void InitializeDecompressor(Reader& src);
   ABSL_ATTRIBUTE_COLD bool FailOperation(absl::string_view operation,
                                          lzma_ret liblzma_code);
 
   Container container_ = Options::kDefaultContainer;
   uint32_t flags_ = 0;
+  int parallelism_ = 0;
+  absl::optional<uint64_t> threading_memory_limit_;
   RecyclingPoolOptions recycling_pool_options_;
   // If `true`, the source is truncated (without a clean end of the compressed
   // stream) at the current position. If the source does not grow, `Close()`
@@ -274,16 +332,21 @@ bool RecognizeXz(Reader& src);
 
 inline XzReaderBase::XzReaderBase(
     BufferOptions buffer_options, Container container, uint32_t flags,
+    int parallelism, absl::optional<uint64_t> threading_memory_limit,
     const RecyclingPoolOptions& recycling_pool_options)
     : BufferedReader(buffer_options),
       container_(container),
       flags_(flags),
+      parallelism_(parallelism),
+      threading_memory_limit_(threading_memory_limit),
       recycling_pool_options_(recycling_pool_options) {}
 
 inline XzReaderBase::XzReaderBase(XzReaderBase&& that) noexcept
     : BufferedReader(static_cast<BufferedReader&&>(that)),
       container_(that.container_),
       flags_(that.flags_),
+      parallelism_(that.parallelism_),
+      threading_memory_limit_(that.threading_memory_limit_),
       recycling_pool_options_(that.recycling_pool_options_),
       truncated_(that.truncated_),
       initial_compressed_pos_(that.initial_compressed_pos_),
@@ -293,6 +356,8 @@ inline XzReaderBase& XzReaderBase::operator=(XzReaderBase&& that) noexcept {
   BufferedReader::operator=(static_cast<BufferedReader&&>(that));
   container_ = that.container_;
   flags_ = that.flags_;
+  parallelism_ = that.parallelism_;
+  threading_memory_limit_ = that.threading_memory_limit_;
   recycling_pool_options_ = that.recycling_pool_options_;
   truncated_ = that.truncated_;
   initial_compressed_pos_ = that.initial_compressed_pos_;
@@ -304,6 +369,8 @@ inline void XzReaderBase::Reset(Closed) {
   BufferedReader::Reset(kClosed);
   container_ = Options::kDefaultContainer;
   flags_ = 0;
+  parallelism_ = 0;
+  threading_memory_limit_ = absl::nullopt;
   recycling_pool_options_ = RecyclingPoolOptions();
   truncated_ = false;
   initial_compressed_pos_ = 0;
@@ -312,10 +379,13 @@ inline void XzReaderBase::Reset(Closed) {
 
 inline void XzReaderBase::Reset(
     BufferOptions buffer_options, Container container, uint32_t flags,
+    int parallelism, absl::optional<uint64_t> threading_memory_limit,
     const RecyclingPoolOptions& recycling_pool_options) {
   BufferedReader::Reset(buffer_options);
   container_ = container;
   flags_ = flags;
+  parallelism_ = parallelism;
+  threading_memory_limit_ = threading_memory_limit;
   recycling_pool_options_ = recycling_pool_options;
   truncated_ = false;
   initial_compressed_pos_ = 0;
@@ -326,6 +396,7 @@ template <typename Src>
 inline XzReader<Src>::XzReader(Initializer<Src> src, Options options)
     : XzReaderBase(options.buffer_options(), options.container(),
                    options.concatenate() ? LZMA_CONCATENATED : 0,
+                   options.parallelism(), options.threading_memory_limit(),
                    options.recycling_pool_options()),
       src_(std::move(src)) {
   Initialize(src_.get());
@@ -341,6 +412,7 @@ template <typename Src>
 inline void XzReader<Src>::Reset(Initializer<Src> src, Options options) {
   XzReaderBase::Reset(options.buffer_options(), options.container(),
                       options.concatenate() ? LZMA_CONCATENATED : 0,
+                      options.parallelism(), options.threading_memory_limit(),
                       options.recycling_pool_options());
   src_.Reset(std::move(src));
   Initialize(src_.get());
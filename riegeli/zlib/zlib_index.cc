@@ -0,0 +1,142 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/zlib/zlib_index.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "absl/strings/cord.h"
+#include "riegeli/base/arithmetic.h"
+#include "riegeli/base/types.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/varint/varint_reading.h"
+#include "riegeli/varint/varint_writing.h"
+
+namespace riegeli {
+
+namespace {
+
+// The largest window of Deflate.
+constexpr size_t kMaxWindowSize = size_t{1} << 15;
+
+// The largest trailer: Gzip.
+constexpr uint64_t kMaxTrailerSize = 8;
+
+}  // namespace
+
+const ZlibIndex::Checkpoint* ZlibIndex::CheckpointBefore(Position pos) const {
+  const std::vector<Checkpoint>::const_iterator iter = std::upper_bound(
+      checkpoints_.begin(), checkpoints_.end(), pos,
+      [](Position pos, const Checkpoint& checkpoint) {
+        return pos < checkpoint.uncompressed_pos;
+      });
+  if (iter == checkpoints_.begin()) return nullptr;
+  return &*(iter - 1);
+}
+
+absl::Status ZlibIndex::EncodeImpl(Writer& dest) const {
+  if (ABSL_PREDICT_FALSE(!WriteVarint64(trailer_size_, dest) ||
+                         !WriteVarint64(checkpoints_.size(), dest))) {
+    return dest.status();
+  }
+  Position uncompressed_pos = 0;
+  Position compressed_pos = 0;
+  for (const Checkpoint& checkpoint : checkpoints_) {
+    if (ABSL_PREDICT_FALSE(
+            !WriteVarint64(checkpoint.uncompressed_pos - uncompressed_pos,
+                           dest) ||
+            !WriteVarint64(checkpoint.compressed_pos - compressed_pos, dest) ||
+            !dest.WriteByte(IntCast<uint8_t>(checkpoint.bits)) ||
+            !WriteVarint64(checkpoint.window.size(), dest) ||
+            !dest.Write(checkpoint.window))) {
+      return dest.status();
+    }
+    uncompressed_pos = checkpoint.uncompressed_pos;
+    compressed_pos = checkpoint.compressed_pos;
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ZlibIndex::DecodeImpl(Reader& src) {
+  uint64_t trailer_size;
+  if (ABSL_PREDICT_FALSE(!ReadVarint64(src, trailer_size) ||
+                         trailer_size > kMaxTrailerSize)) {
+    return src.StatusOrAnnotate(absl::InvalidArgumentError(
+        "Malformed ZlibIndex encoding (trailer_size)"));
+  }
+  uint64_t num_checkpoints;
+  if (ABSL_PREDICT_FALSE(!ReadVarint64(src, num_checkpoints))) {
+    return src.StatusOrAnnotate(absl::InvalidArgumentError(
+        "Malformed ZlibIndex encoding (num_checkpoints)"));
+  }
+  std::vector<Checkpoint> checkpoints;
+  Position uncompressed_pos = 0;
+  Position compressed_pos = 0;
+  for (uint64_t i = 0; i < num_checkpoints; ++i) {
+    uint64_t uncompressed_delta, compressed_delta;
+    if (ABSL_PREDICT_FALSE(!ReadVarint64(src, uncompressed_delta) ||
+                           !ReadVarint64(src, compressed_delta))) {
+      return src.StatusOrAnnotate(absl::InvalidArgumentError(
+          "Malformed ZlibIndex encoding (position)"));
+    }
+    // Uncompressed positions are strictly increasing.
+    if (ABSL_PREDICT_FALSE(uncompressed_delta == 0 ||
+                           uncompressed_delta >
+                               std::numeric_limits<Position>::max() -
+                                   uncompressed_pos ||
+                           compressed_delta >
+                               std::numeric_limits<Position>::max() -
+                                   compressed_pos)) {
+      return src.AnnotateStatus(absl::InvalidArgumentError(
+          "Malformed ZlibIndex encoding (position out of order)"));
+    }
+    uncompressed_pos += uncompressed_delta;
+    compressed_pos += compressed_delta;
+    uint8_t bits;
+    if (ABSL_PREDICT_FALSE(!src.ReadByte(bits) || bits > 7 ||
+                           (bits > 0 && compressed_pos == 0))) {
+      return src.StatusOrAnnotate(
+          absl::InvalidArgumentError("Malformed ZlibIndex encoding (bits)"));
+    }
+    uint64_t window_size;
+    if (ABSL_PREDICT_FALSE(!ReadVarint64(src, window_size) ||
+                           window_size > kMaxWindowSize)) {
+      return src.StatusOrAnnotate(absl::InvalidArgumentError(
+          "Malformed ZlibIndex encoding (window_size)"));
+    }
+    std::string window;
+    if (ABSL_PREDICT_FALSE(!src.Read(IntCast<size_t>(window_size), window))) {
+      return src.StatusOrAnnotate(
+          absl::InvalidArgumentError("Malformed ZlibIndex encoding (window)"));
+    }
+    checkpoints.push_back(Checkpoint{uncompressed_pos, compressed_pos,
+                                     static_cast<int>(bits),
+                                     absl::Cord(std::move(window))});
+  }
+  trailer_size_ = IntCast<size_t>(trailer_size);
+  checkpoints_ = std::move(checkpoints);
+  return absl::OkStatus();
+}
+
+}  // namespace riegeli
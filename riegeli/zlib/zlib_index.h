@@ -0,0 +1,142 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_ZLIB_ZLIB_INDEX_H_
+#define RIEGELI_ZLIB_ZLIB_INDEX_H_
+
+#include <stddef.h>
+
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "absl/strings/cord.h"
+#include "absl/types/span.h"
+#include "riegeli/base/dependency.h"
+#include "riegeli/base/types.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/writer.h"
+
+namespace riegeli {
+
+// An index of checkpoints in a Zlib-compressed stream, which allows
+// `ZlibReader` to start decompression in the middle of the stream.
+//
+// A checkpoint is taken at a boundary of a Deflate block. It stores positions
+// in the compressed and uncompressed streams, and the preceding 32 KiB of
+// uncompressed data, i.e. the window needed to decompress further.
+//
+// An index is built by `ZlibReader` reading the stream sequentially, with
+// `ZlibReaderBase::Options::set_checkpoint_interval()`, and is retrieved by
+// `ZlibReaderBase::index()`. It can be stored with `Encode()`, e.g. in a file
+// alongside the compressed file, and loaded with `Decode()`, to be given to
+// `ZlibReaderBase::Options::set_index()` when reading the same compressed
+// stream again.
+//
+// Copying a `ZlibIndex` shares the windows.
+class ZlibIndex {
+ public:
+  struct Checkpoint {
+    // Position in the uncompressed stream.
+    Position uncompressed_pos;
+    // Position in the compressed stream, relative to the beginning of the
+    // compressed stream, of the first byte which is not consumed yet.
+    Position compressed_pos;
+    // Number of bits of the byte before `compressed_pos` which belong to the
+    // next Deflate block, between 0 and 7.
+    int bits;
+    // Up to 32 KiB of uncompressed data before `uncompressed_pos`.
+    absl::Cord window;
+  };
+
+  // Creates an empty `ZlibIndex`.
+  ZlibIndex() = default;
+
+  ZlibIndex(const ZlibIndex& that) = default;
+  ZlibIndex& operator=(const ZlibIndex& that) = default;
+
+  ZlibIndex(ZlibIndex&& that) = default;
+  ZlibIndex& operator=(ZlibIndex&& that) = default;
+
+  // Returns `true` if there are no checkpoints.
+  bool empty() const { return checkpoints_.empty(); }
+
+  // Returns checkpoints, sorted by position.
+  absl::Span<const Checkpoint> checkpoints() const { return checkpoints_; }
+
+  // Returns the length of the trailer following compressed data of each
+  // stream: 8 for Gzip, 4 for Zlib, 0 for raw Deflate.
+  size_t trailer_size() const { return trailer_size_; }
+
+  // Returns the last checkpoint with `uncompressed_pos <= pos`, or `nullptr`
+  // if there is none.
+  const Checkpoint* CheckpointBefore(Position pos) const;
+
+  // Encodes the index to a sequence of bytes.
+  //
+  // The index contains windows of uncompressed data. They are not compressed
+  // by `Encode()`, but they tend to be compressible.
+  template <
+      typename Dest,
+      std::enable_if_t<IsValidDependency<Writer*, Dest&&>::value, int> = 0>
+  absl::Status Encode(Dest&& dest) const;
+
+  // Decodes the index from the encoded form.
+  template <typename Src,
+            std::enable_if_t<IsValidDependency<Reader*, Src&&>::value, int> = 0>
+  absl::Status Decode(Src&& src);
+
+ private:
+  friend class ZlibReaderBase;  // For `trailer_size_` and `checkpoints_`.
+
+  absl::Status EncodeImpl(Writer& dest) const;
+  absl::Status DecodeImpl(Reader& src);
+
+  size_t trailer_size_ = 0;
+  std::vector<Checkpoint> checkpoints_;
+};
+
+// Implementation details follow.
+
+template <typename Dest,
+          std::enable_if_t<IsValidDependency<Writer*, Dest&&>::value, int>>
+inline absl::Status ZlibIndex::Encode(Dest&& dest) const {
+  Dependency<Writer*, Dest&&> dest_dep(std::forward<Dest>(dest));
+  absl::Status status = EncodeImpl(*dest_dep);
+  if (dest_dep.IsOwning()) {
+    if (ABSL_PREDICT_FALSE(!dest_dep->Close())) {
+      status.Update(dest_dep->status());
+    }
+  }
+  return status;
+}
+
+template <typename Src,
+          std::enable_if_t<IsValidDependency<Reader*, Src&&>::value, int>>
+inline absl::Status ZlibIndex::Decode(Src&& src) {
+  Dependency<Reader*, Src&&> src_dep(std::forward<Src>(src));
+  if (src_dep.IsOwning()) src_dep->SetReadAllHint(true);
+  absl::Status status = DecodeImpl(*src_dep);
+  if (src_dep.IsOwning()) {
+    if (ABSL_PREDICT_TRUE(status.ok())) src_dep->VerifyEnd();
+    if (ABSL_PREDICT_FALSE(!src_dep->Close())) status.Update(src_dep->status());
+  }
+  return status;
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_ZLIB_ZLIB_INDEX_H_
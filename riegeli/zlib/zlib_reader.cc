@@ -19,11 +19,13 @@
 
 #include <limits>
 #include <memory>
+#include <string>
 #include <utility>
 
 #include "absl/base/attributes.h"
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
+#include "absl/strings/cord.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
@@ -36,6 +38,7 @@
 #include "riegeli/bytes/reader.h"
 #include "riegeli/endian/endian_reading.h"
 #include "riegeli/zlib/zlib_error.h"
+#include "riegeli/zlib/zlib_index.h"
 #include "zconf.h"
 #include "zlib.h"
 
@@ -70,23 +73,37 @@ void ZlibReaderBase::Initialize(Reader* src) {
     return;
   }
   initial_compressed_pos_ = src->pos();
-  InitializeDecompressor();
+  if (checkpoint_interval_ != absl::nullopt && index_.empty()) {
+    index_.trailer_size_ = TrailerSize(*src);
+  }
+  InitializeDecompressor(window_bits_);
+}
+
+inline size_t ZlibReaderBase::TrailerSize(Reader& src) const {
+  if (window_bits_ < 0) return 0;
+  if (window_bits_ < static_cast<int>(Header::kGzip)) return 4;
+  if (window_bits_ < static_cast<int>(Header::kZlibOrGzip)) return 8;
+  // Recognize the Gzip header by its magic bytes.
+  return src.Pull(2) && static_cast<uint8_t>(src.cursor()[0]) == 0x1f &&
+                 static_cast<uint8_t>(src.cursor()[1]) == 0x8b
+             ? 8
+             : 4;
 }
 
-inline void ZlibReaderBase::InitializeDecompressor() {
+inline void ZlibReaderBase::InitializeDecompressor(int window_bits) {
   decompressor_ =
       RecyclingPool<z_stream, ZStreamDeleter>::global(recycling_pool_options_)
           .Get(
               [&] {
                 std::unique_ptr<z_stream, ZStreamDeleter> ptr(new z_stream());
-                const int zlib_code = inflateInit2(ptr.get(), window_bits_);
+                const int zlib_code = inflateInit2(ptr.get(), window_bits);
                 if (ABSL_PREDICT_FALSE(zlib_code != Z_OK)) {
                   FailOperation("inflateInit2()", zlib_code);
                 }
                 return ptr;
               },
               [&](z_stream* ptr) {
-                const int zlib_code = inflateReset2(ptr, window_bits_);
+                const int zlib_code = inflateReset2(ptr, window_bits);
                 if (ABSL_PREDICT_FALSE(zlib_code != Z_OK)) {
                   FailOperation("inflateReset2()", zlib_code);
                 }
@@ -151,6 +168,10 @@ bool ZlibReaderBase::ReadInternal(size_t min_length, size_t max_length,
   truncated_ = false;
   max_length = UnsignedMin(max_length,
                            std::numeric_limits<Position>::max() - limit_pos());
+  // `Z_BLOCK` stops at Deflate block boundaries, where checkpoints can be
+  // added.
+  const int flush =
+      checkpoint_interval_ != absl::nullopt ? Z_BLOCK : Z_NO_FLUSH;
   decompressor_->next_out = reinterpret_cast<Bytef*>(dest);
   for (;;) {
     decompressor_->avail_out = SaturatingIntCast<uInt>(PtrDistance(
@@ -159,13 +180,21 @@ bool ZlibReaderBase::ReadInternal(size_t min_length, size_t max_length,
         reinterpret_cast<const Bytef*>(src.cursor()));
     decompressor_->avail_in = SaturatingIntCast<uInt>(src.available());
     if (decompressor_->avail_in > 0) stream_had_data_ = true;
-    int zlib_code = inflate(decompressor_.get(), Z_NO_FLUSH);
+    int zlib_code = inflate(decompressor_.get(), flush);
     src.set_cursor(reinterpret_cast<const char*>(decompressor_->next_in));
     const size_t length_read =
         PtrDistance(dest, reinterpret_cast<char*>(decompressor_->next_out));
     switch (zlib_code) {
       case Z_OK:
+        if (flush == Z_BLOCK && (decompressor_->data_type & 192) == 128) {
+          // At a block boundary, which is not after the last block.
+          MaybeAddCheckpoint(limit_pos() + length_read, src);
+        }
         if (length_read >= min_length) break;
+        if (decompressor_->avail_in > 0 && decompressor_->avail_out > 0) {
+          // `Z_BLOCK` stopped at a block boundary.
+          continue;
+        }
         ABSL_FALLTHROUGH_INTENDED;
       case Z_BUF_ERROR:
         if (ABSL_PREDICT_FALSE(decompressor_->avail_in > 0)) {
@@ -193,10 +222,24 @@ bool ZlibReaderBase::ReadInternal(size_t min_length, size_t max_length,
         }
         continue;
       case Z_STREAM_END:
+        if (resumed_from_checkpoint_) {
+          // Raw Deflate ended before the trailer, which is skipped without
+          // verification.
+          resumed_from_checkpoint_ = false;
+          if (ABSL_PREDICT_FALSE(!src.Skip(index_.trailer_size()))) {
+            move_limit_pos(length_read);
+            if (ABSL_PREDICT_FALSE(!src.ok())) {
+              return FailWithoutAnnotation(AnnotateOverSrc(src.status()));
+            }
+            truncated_ = true;
+            return length_read >= min_length;
+          }
+        }
         if (concatenate_) {
-          const int zlib_code = inflateReset(decompressor_.get());
+          const int zlib_code =
+              inflateReset2(decompressor_.get(), window_bits_);
           if (ABSL_PREDICT_FALSE(zlib_code != Z_OK)) {
-            FailOperation("inflateReset()", zlib_code);
+            FailOperation("inflateReset2()", zlib_code);
             break;
           }
           stream_had_data_ = false;
@@ -231,6 +274,31 @@ bool ZlibReaderBase::ReadInternal(size_t min_length, size_t max_length,
   }
 }
 
+inline void ZlibReaderBase::MaybeAddCheckpoint(Position uncompressed_pos,
+                                               Reader& src) {
+  if (!index_.checkpoints_.empty()) {
+    const Position last_pos = index_.checkpoints_.back().uncompressed_pos;
+    if (uncompressed_pos < last_pos ||
+        uncompressed_pos - last_pos < *checkpoint_interval_) {
+      return;
+    }
+  } else if (uncompressed_pos < *checkpoint_interval_) {
+    return;
+  }
+  uInt window_length = 0;
+  int zlib_code =
+      inflateGetDictionary(decompressor_.get(), nullptr, &window_length);
+  if (ABSL_PREDICT_FALSE(zlib_code != Z_OK)) return;
+  std::string window(window_length, '\0');
+  zlib_code = inflateGetDictionary(
+      decompressor_.get(), reinterpret_cast<Bytef*>(&window[0]),
+      &window_length);
+  if (ABSL_PREDICT_FALSE(zlib_code != Z_OK)) return;
+  index_.checkpoints_.push_back(ZlibIndex::Checkpoint{
+      uncompressed_pos, src.pos() - initial_compressed_pos_,
+      decompressor_->data_type & 7, absl::Cord(std::move(window))});
+}
+
 void ZlibReaderBase::ExactSizeReached() {
   if (decompressor_ == nullptr) return;
   char buffer[1];
@@ -260,12 +328,16 @@ bool ZlibReaderBase::SeekBehindBuffer(Position new_pos) {
   RIEGELI_ASSERT_EQ(start_to_limit(), 0u)
       << "Failed precondition of BufferedReader::SeekBehindBuffer(): "
          "buffer not empty";
+  const ZlibIndex::Checkpoint* const checkpoint =
+      index_.CheckpointBefore(new_pos);
   if (new_pos <= limit_pos()) {
     // Seeking backwards.
     if (ABSL_PREDICT_FALSE(!ok())) return false;
+    if (checkpoint != nullptr) return SeekToCheckpoint(*checkpoint, new_pos);
     Reader& src = *SrcReader();
     truncated_ = false;
     stream_had_data_ = false;
+    resumed_from_checkpoint_ = false;
     set_buffer();
     set_limit_pos(0);
     decompressor_.reset();
@@ -273,10 +345,65 @@ bool ZlibReaderBase::SeekBehindBuffer(Position new_pos) {
       return FailWithoutAnnotation(AnnotateOverSrc(src.StatusOrAnnotate(
           absl::DataLossError("Zlib-compressed stream got truncated"))));
     }
-    InitializeDecompressor();
+    InitializeDecompressor(window_bits_);
     if (ABSL_PREDICT_FALSE(!ok())) return false;
     if (new_pos == 0) return true;
+  } else if (checkpoint != nullptr &&
+             checkpoint->uncompressed_pos > limit_pos()) {
+    // Seeking forwards past a checkpoint.
+    if (ABSL_PREDICT_FALSE(!ok())) return false;
+    return SeekToCheckpoint(*checkpoint, new_pos);
+  }
+  return BufferedReader::SeekBehindBuffer(new_pos);
+}
+
+bool ZlibReaderBase::SeekToCheckpoint(const ZlibIndex::Checkpoint& checkpoint,
+                                      Position new_pos) {
+  Reader& src = *SrcReader();
+  truncated_ = false;
+  stream_had_data_ = true;
+  set_buffer();
+  set_limit_pos(checkpoint.uncompressed_pos);
+  decompressor_.reset();
+  // If the checkpoint is in the middle of a byte, its remaining bits are read
+  // from the previous byte.
+  uint8_t partial_byte = 0;
+  if (ABSL_PREDICT_FALSE(
+          !src.Seek(initial_compressed_pos_ + checkpoint.compressed_pos -
+                    (checkpoint.bits > 0 ? 1 : 0)) ||
+          (checkpoint.bits > 0 && !src.ReadByte(partial_byte)))) {
+    return FailWithoutAnnotation(AnnotateOverSrc(src.StatusOrAnnotate(
+        absl::DataLossError("Zlib-compressed stream got truncated"))));
+  }
+  // Resume decompression as raw Deflate, which starts at a block boundary.
+  InitializeDecompressor(window_bits_ < 0 ? window_bits_
+                                          : -(window_bits_ & 15));
+  if (ABSL_PREDICT_FALSE(!ok())) return false;
+  resumed_from_checkpoint_ = true;
+  if (checkpoint.bits > 0) {
+    const int zlib_code = inflatePrime(decompressor_.get(), checkpoint.bits,
+                                       partial_byte >> (8 - checkpoint.bits));
+    if (ABSL_PREDICT_FALSE(zlib_code != Z_OK)) {
+      return FailOperation("inflatePrime()", zlib_code);
+    }
+  }
+  if (!checkpoint.window.empty()) {
+    std::string flat_window;
+    absl::optional<absl::string_view> window = checkpoint.window.TryFlat();
+    if (window == absl::nullopt) {
+      absl::CopyCordToString(checkpoint.window, &flat_window);
+      window = flat_window;
+    }
+    const int zlib_code = inflateSetDictionary(
+        decompressor_.get(),
+        const_cast<z_const Bytef*>(
+            reinterpret_cast<const Bytef*>(window->data())),
+        SaturatingIntCast<uInt>(window->size()));
+    if (ABSL_PREDICT_FALSE(zlib_code != Z_OK)) {
+      return FailOperation("inflateSetDictionary()", zlib_code);
+    }
   }
+  if (new_pos == limit_pos()) return true;
   return BufferedReader::SeekBehindBuffer(new_pos);
 }
 
@@ -307,6 +434,7 @@ std::unique_ptr<Reader> ZlibReaderBase::NewReaderImpl(Position initial_pos) {
                                                : window_bits_ & 15)
               .set_dictionary(dictionary_)
               .set_concatenate(concatenate_)
+              .set_index(index_)
               .set_buffer_options(buffer_options())
               .set_recycling_pool_options(recycling_pool_options_));
   reader->Seek(initial_pos);
@@ -36,6 +36,7 @@
 #include "riegeli/bytes/buffered_reader.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/zlib/zlib_dictionary.h"  // IWYU pragma: export
+#include "riegeli/zlib/zlib_index.h"  // IWYU pragma: export
 
 struct z_stream_s;  // `zlib.h` has `typedef struct z_stream_s z_stream`.
 
@@ -131,6 +132,59 @@ class ZlibReaderBase : public BufferedReader {
     }
     bool concatenate() const { return concatenate_; }
 
+    // If not `absl::nullopt`, while decompressing, checkpoints are added to
+    // `index()`, at the first Deflate block boundary after each
+    // `*checkpoint_interval` bytes of uncompressed data since the previous
+    // checkpoint. Checkpoints are added only past the last checkpoint, so
+    // reading the stream sequentially once builds a complete index, which can
+    // be stored with `ZlibIndex::Encode()` and passed to `set_index()` later.
+    //
+    // Each checkpoint keeps 32 KiB of uncompressed data. Typical values of
+    // `checkpoint_interval` are a few MiB.
+    //
+    // Default: `absl::nullopt`.
+    Options& set_checkpoint_interval(
+        absl::optional<Position> checkpoint_interval) &
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      if (checkpoint_interval != absl::nullopt) {
+        RIEGELI_ASSERT_GT(*checkpoint_interval, 0u)
+            << "Failed precondition of "
+               "ZlibReaderBase::Options::set_checkpoint_interval(): "
+               "zero checkpoint interval";
+      }
+      checkpoint_interval_ = checkpoint_interval;
+      return *this;
+    }
+    Options&& set_checkpoint_interval(
+        absl::optional<Position> checkpoint_interval) &&
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      return std::move(set_checkpoint_interval(checkpoint_interval));
+    }
+    absl::optional<Position> checkpoint_interval() const {
+      return checkpoint_interval_;
+    }
+
+    // Checkpoints in the compressed stream, which let `Seek()` and
+    // `NewReader()` start decompression from the last checkpoint before the
+    // target position, instead of from the beginning of the stream.
+    //
+    // The index must have been built from the same compressed stream, with the
+    // same `header()` and `dictionary()`. Data decompressed after starting from
+    // a checkpoint are not verified against the checksum in the trailer.
+    //
+    // Default: `ZlibIndex()`.
+    Options& set_index(ZlibIndex index) & ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      index_ = std::move(index);
+      return *this;
+    }
+    Options&& set_index(ZlibIndex index) && ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      return std::move(set_index(std::move(index)));
+    }
+    ZlibIndex& index() ABSL_ATTRIBUTE_LIFETIME_BOUND { return index_; }
+    const ZlibIndex& index() const ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      return index_;
+    }
+
     // Options for a global `RecyclingPool` of decompression contexts.
     //
     // They tune the amount of memory which is kept to speed up creation of new
@@ -158,6 +212,8 @@ class ZlibReaderBase : public BufferedReader {
     int window_log_ = kDefaultWindowLog;
     ZlibDictionary dictionary_;
     bool concatenate_ = false;
+    absl::optional<Position> checkpoint_interval_;
+    ZlibIndex index_;
     RecyclingPoolOptions recycling_pool_options_;
   };
 
@@ -176,6 +232,13 @@ class ZlibReaderBase : public BufferedReader {
     return truncated_ && available() == 0;
   }
 
+  // Returns the checkpoint index: `Options::index()`, extended with checkpoints
+  // added while decompressing if `Options::checkpoint_interval()` is not
+  // `absl::nullopt`. Unchanged by `Close()`.
+  const ZlibIndex& index() const ABSL_ATTRIBUTE_LIFETIME_BOUND {
+    return index_;
+  }
+
   bool ToleratesReadingAhead() override;
   bool SupportsRewind() override;
   bool SupportsNewReader() override;
@@ -185,6 +248,8 @@ class ZlibReaderBase : public BufferedReader {
 
   explicit ZlibReaderBase(BufferOptions buffer_options, int window_bits,
                           ZlibDictionary&& dictionary, bool concatenate,
+                          absl::optional<Position> checkpoint_interval,
+                          ZlibIndex&& index,
                           const RecyclingPoolOptions& recycling_pool_options);
 
   ZlibReaderBase(ZlibReaderBase&& that) noexcept;
@@ -193,6 +258,7 @@ class ZlibReaderBase : public BufferedReader {
   void Reset(Closed);
   void Reset(BufferOptions buffer_options, int window_bits,
              ZlibDictionary&& dictionary, bool concatenate,
+             absl::optional<Position> checkpoint_interval, ZlibIndex&& index,
              const RecyclingPoolOptions& recycling_pool_options);
   static int GetWindowBits(const Options& options);
   void Initialize(Reader* src);
@@ -215,9 +281,13 @@ class ZlibReaderBase : public BufferedReader {
     void operator()(z_stream_s* ptr) const;
   };
 
-  void InitializeDecompressor();
+  void InitializeDecompressor(int window_bits);
   ABSL_ATTRIBUTE_COLD bool FailOperation(absl::string_view operation,
                                          int zlib_code);
+  size_t TrailerSize(Reader& src) const;
+  void MaybeAddCheckpoint(Position uncompressed_pos, Reader& src);
+  bool SeekToCheckpoint(const ZlibIndex::Checkpoint& checkpoint,
+                        Position new_pos);
 
   int window_bits_ = 0;
   bool concatenate_ = false;
@@ -229,7 +299,13 @@ class ZlibReaderBase : public BufferedReader {
   // If `concatenate_` and `!stream_had_data_`, an end of the source is
   // legitimate, it does not imply that the source is truncated.
   bool stream_had_data_ = false;
+  // If `true`, decompression of the current stream started from a checkpoint,
+  // as raw Deflate, so the trailer must be skipped after the end of compressed
+  // data.
+  bool resumed_from_checkpoint_ = false;
   ZlibDictionary dictionary_;
+  absl::optional<Position> checkpoint_interval_;
+  ZlibIndex index_;
   RecyclingPoolOptions recycling_pool_options_;
   Position initial_compressed_pos_ = 0;
   // If `ok()` but `decompressor_ == nullptr` then all data have been
@@ -331,11 +407,14 @@ absl::optional<uint32_t> GzipUncompressedSizeModulo4G(Reader& src);
 
 inline ZlibReaderBase::ZlibReaderBase(
     BufferOptions buffer_options, int window_bits, ZlibDictionary&& dictionary,
-    bool concatenate, const RecyclingPoolOptions& recycling_pool_options)
+    bool concatenate, absl::optional<Position> checkpoint_interval,
+    ZlibIndex&& index, const RecyclingPoolOptions& recycling_pool_options)
     : BufferedReader(buffer_options),
       window_bits_(window_bits),
       concatenate_(concatenate),
       dictionary_(std::move(dictionary)),
+      checkpoint_interval_(checkpoint_interval),
+      index_(std::move(index)),
       recycling_pool_options_(recycling_pool_options) {}
 
 inline ZlibReaderBase::ZlibReaderBase(ZlibReaderBase&& that) noexcept
@@ -344,7 +423,10 @@ inline ZlibReaderBase::ZlibReaderBase(ZlibReaderBase&& that) noexcept
       concatenate_(that.concatenate_),
       truncated_(that.truncated_),
       stream_had_data_(that.stream_had_data_),
+      resumed_from_checkpoint_(that.resumed_from_checkpoint_),
       dictionary_(std::move(that.dictionary_)),
+      checkpoint_interval_(that.checkpoint_interval_),
+      index_(std::move(that.index_)),
       recycling_pool_options_(that.recycling_pool_options_),
       initial_compressed_pos_(that.initial_compressed_pos_),
       decompressor_(std::move(that.decompressor_)) {}
@@ -356,7 +438,10 @@ inline ZlibReaderBase& ZlibReaderBase::operator=(
   concatenate_ = that.concatenate_;
   truncated_ = that.truncated_;
   stream_had_data_ = that.stream_had_data_;
+  resumed_from_checkpoint_ = that.resumed_from_checkpoint_;
   dictionary_ = std::move(that.dictionary_);
+  checkpoint_interval_ = that.checkpoint_interval_;
+  index_ = std::move(that.index_);
   recycling_pool_options_ = that.recycling_pool_options_;
   initial_compressed_pos_ = that.initial_compressed_pos_;
   decompressor_ = std::move(that.decompressor_);
@@ -369,24 +454,31 @@ inline void ZlibReaderBase::Reset(Closed) {
   concatenate_ = false;
   truncated_ = false;
   stream_had_data_ = false;
+  resumed_from_checkpoint_ = false;
+  checkpoint_interval_ = absl::nullopt;
   recycling_pool_options_ = RecyclingPoolOptions();
   initial_compressed_pos_ = 0;
   decompressor_.reset();
   dictionary_ = ZlibDictionary();
+  index_ = ZlibIndex();
 }
 
 inline void ZlibReaderBase::Reset(
     BufferOptions buffer_options, int window_bits, ZlibDictionary&& dictionary,
-    bool concatenate, const RecyclingPoolOptions& recycling_pool_options) {
+    bool concatenate, absl::optional<Position> checkpoint_interval,
+    ZlibIndex&& index, const RecyclingPoolOptions& recycling_pool_options) {
   BufferedReader::Reset(buffer_options);
   window_bits_ = window_bits;
   concatenate_ = concatenate;
   truncated_ = false;
   stream_had_data_ = false;
+  resumed_from_checkpoint_ = false;
+  checkpoint_interval_ = checkpoint_interval;
   recycling_pool_options_ = recycling_pool_options;
   initial_compressed_pos_ = 0;
   decompressor_.reset();
   dictionary_ = std::move(dictionary);
+  index_ = std::move(index);
 }
 
 inline int ZlibReaderBase::GetWindowBits(const Options& options) {
@@ -399,6 +491,7 @@ template <typename Src>
 inline ZlibReader<Src>::ZlibReader(Initializer<Src> src, Options options)
     : ZlibReaderBase(options.buffer_options(), GetWindowBits(options),
                      std::move(options.dictionary()), options.concatenate(),
+                     options.checkpoint_interval(), std::move(options.index()),
                      options.recycling_pool_options()),
       src_(std::move(src)) {
   Initialize(src_.get());
@@ -414,6 +507,8 @@ template <typename Src>
 inline void ZlibReader<Src>::Reset(Initializer<Src> src, Options options) {
   ZlibReaderBase::Reset(options.buffer_options(), GetWindowBits(options),
                         std::move(options.dictionary()), options.concatenate(),
+                        options.checkpoint_interval(),
+                        std::move(options.index()),
                         options.recycling_pool_options());
   src_.Reset(std::move(src));
   Initialize(src_.get());
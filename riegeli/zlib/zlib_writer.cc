@@ -15,9 +15,13 @@
 #include "riegeli/zlib/zlib_writer.h"
 
 #include <stddef.h>
+#include <stdint.h>
 
+#include <deque>
+#include <future>
 #include <limits>
 #include <memory>
+#include <string>
 #include <utility>
 
 #include "absl/base/optimization.h"
@@ -26,12 +30,15 @@
 #include "absl/strings/string_view.h"
 #include "riegeli/base/arithmetic.h"
 #include "riegeli/base/assert.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/base/recycling_pool.h"
 #include "riegeli/base/status.h"
 #include "riegeli/base/types.h"
 #include "riegeli/bytes/buffered_writer.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/bytes/writer.h"
+#include "riegeli/digests/crc32.h"
+#include "riegeli/endian/endian_writing.h"
 #include "riegeli/zlib/zlib_error.h"
 #include "riegeli/zlib/zlib_reader.h"
 #include "zconf.h"
@@ -69,7 +76,281 @@ void ZlibWriterBase::ZStreamDeleter::operator()(z_stream* ptr) const {
   delete ptr;
 }
 
-void ZlibWriterBase::Initialize(Writer* dest, int compression_level) {
+namespace {
+
+// Size of uncompressed blocks compressed in parallel, as in `pigz`.
+constexpr size_t kParallelBlockSize = size_t{128} << 10;
+
+}  // namespace
+
+class ZlibWriterBase::ParallelCompressor {
+ public:
+  explicit ParallelCompressor(
+      int parallelism, int compression_level, int window_bits,
+      absl::string_view dictionary,
+      const RecyclingPoolOptions& recycling_pool_options);
+
+  // Compresses `src`, writing compressed blocks to `dest` when they are ready.
+  // If `flush != Z_NO_FLUSH`, ends the current block, and writes all remaining
+  // compressed blocks. If `flush == Z_FINISH`, also ends the stream.
+  //
+  // Returns `false` on failure: of `dest`, or with `zlib_code()`.
+  bool Write(absl::string_view src, Writer& dest, int flush);
+
+  int zlib_code() const { return zlib_code_; }
+
+ private:
+  struct CompressedBlock {
+    // `Z_OK` on success.
+    int zlib_code = Z_OK;
+    std::string data;
+    // CRC-32 for Gzip, Adler-32 for Zlib, of uncompressed data.
+    uLong check = 0;
+    size_t uncompressed_size = 0;
+  };
+
+  // Compresses a block to raw Deflate, ending it with a sync flush marker,
+  // or with the final block if `last`.
+  static CompressedBlock CompressBlock(
+      int compression_level, int window_bits,
+      const RecyclingPoolOptions& recycling_pool_options,
+      const std::string& dictionary, const std::string& src, bool last);
+
+  bool ScheduleBlock(Writer& dest, bool last);
+  bool WriteBlock(Writer& dest);
+
+  size_t parallelism_;
+  int compression_level_;
+  int window_bits_;
+  RecyclingPoolOptions recycling_pool_options_;
+  size_t window_size_;
+  // Not written yet if not empty.
+  std::string header_;
+  // Uncompressed data of the current block.
+  std::string block_;
+  // Up to `window_size_` bytes of uncompressed data preceding `block_`,
+  // beginning with the dictionary.
+  std::string history_;
+  // Blocks being compressed, in order.
+  std::deque<std::future<CompressedBlock>> compressed_blocks_;
+  // CRC-32 for Gzip, Adler-32 for Zlib, of uncompressed data written so far.
+  uLong check_;
+  Position uncompressed_size_ = 0;
+  int zlib_code_ = Z_OK;
+};
+
+void ZlibWriterBase::ParallelCompressorDeleter::operator()(
+    ParallelCompressor* ptr) const {
+  delete ptr;
+}
+
+ZlibWriterBase::ParallelCompressor::ParallelCompressor(
+    int parallelism, int compression_level, int window_bits,
+    absl::string_view dictionary,
+    const RecyclingPoolOptions& recycling_pool_options)
+    : parallelism_(IntCast<size_t>(parallelism)),
+      compression_level_(compression_level),
+      window_bits_(window_bits),
+      recycling_pool_options_(recycling_pool_options),
+      window_size_(size_t{1}
+                   << (window_bits < 0 ? -window_bits : window_bits & 15)),
+      check_(window_bits > 15 ? uLong{0} : adler32(0, nullptr, 0)) {
+  if (dictionary.size() > window_size_) {
+    dictionary.remove_prefix(dictionary.size() - window_size_);
+  }
+  history_.assign(dictionary.data(), dictionary.size());
+  // Headers are written as by `deflate()`.
+  if (window_bits_ > 15) {
+    // Gzip header with no file name and no modification time, and the Unix
+    // operating system.
+    header_.assign({'\x1f', '\x8b', Z_DEFLATED, 0, 0, 0, 0, 0,
+                    static_cast<char>(compression_level_ == 9  ? 2
+                                      : compression_level_ < 2 ? 4
+                                                               : 0),
+                    3});
+  } else if (window_bits_ >= 0) {
+    const uint32_t level_flags = compression_level_ < 2   ? 0
+                                 : compression_level_ < 6 ? 1
+                                 : compression_level_ == 6
+                                     ? 2
+                                     : 3;
+    uint32_t header =
+        ((Z_DEFLATED + ((IntCast<uint32_t>(window_bits_) - 8) << 4)) << 8) |
+        (level_flags << 6);
+    if (!dictionary.empty()) header |= 0x20;
+    header += 31 - header % 31;
+    header_.push_back(static_cast<char>(header >> 8));
+    header_.push_back(static_cast<char>(header));
+    if (!dictionary.empty()) {
+      // The dictionary identifier is computed from the whole dictionary,
+      // not only from its part used for compression.
+      const uint32_t dictionary_id = IntCast<uint32_t>(
+          adler32(adler32(0, nullptr, 0),
+                  reinterpret_cast<const Bytef*>(dictionary.data()),
+                  IntCast<uInt>(dictionary.size())));
+      for (int shift = 24; shift >= 0; shift -= 8) {
+        header_.push_back(static_cast<char>(dictionary_id >> shift));
+      }
+    }
+  }
+}
+
+ZlibWriterBase::ParallelCompressor::CompressedBlock
+ZlibWriterBase::ParallelCompressor::CompressBlock(
+    int compression_level, int window_bits,
+    const RecyclingPoolOptions& recycling_pool_options,
+    const std::string& dictionary, const std::string& src, bool last) {
+  CompressedBlock block;
+  block.uncompressed_size = src.size();
+  if (window_bits > 15) {
+    block.check = ExtendCrc32(0, src);
+  } else if (window_bits >= 0) {
+    block.check = adler32(adler32(0, nullptr, 0),
+                          reinterpret_cast<const Bytef*>(src.data()),
+                          IntCast<uInt>(src.size()));
+  }
+  const int raw_window_bits =
+      window_bits < 0 ? window_bits : -(window_bits & 15);
+  KeyedRecyclingPool<z_stream, ZStreamKey, ZStreamDeleter>::Handle compressor =
+      KeyedRecyclingPool<z_stream, ZStreamKey, ZStreamDeleter>::global(
+          recycling_pool_options)
+          .Get(
+              ZStreamKey(compression_level, raw_window_bits),
+              [&] {
+                std::unique_ptr<z_stream, ZStreamDeleter> ptr(new z_stream());
+                block.zlib_code =
+                    deflateInit2(ptr.get(), compression_level, Z_DEFLATED,
+                                 raw_window_bits, 8, Z_DEFAULT_STRATEGY);
+                return ptr;
+              },
+              [&](z_stream* ptr) { block.zlib_code = deflateReset(ptr); });
+  if (ABSL_PREDICT_FALSE(block.zlib_code != Z_OK)) return block;
+  if (!dictionary.empty()) {
+    block.zlib_code = deflateSetDictionary(
+        compressor.get(), reinterpret_cast<const Bytef*>(dictionary.data()),
+        IntCast<uInt>(dictionary.size()));
+    if (ABSL_PREDICT_FALSE(block.zlib_code != Z_OK)) return block;
+  }
+  compressor->next_in =
+      const_cast<z_const Bytef*>(reinterpret_cast<const Bytef*>(src.data()));
+  compressor->avail_in = IntCast<uInt>(src.size());
+  // A sync flush marker takes at most 10 bytes beyond `deflateBound()`.
+  block.data.resize(deflateBound(compressor.get(), src.size()) + 10);
+  size_t length = 0;
+  for (;;) {
+    compressor->next_out = reinterpret_cast<Bytef*>(&block.data[length]);
+    compressor->avail_out = IntCast<uInt>(block.data.size() - length);
+    const int zlib_code =
+        deflate(compressor.get(), last ? Z_FINISH : Z_SYNC_FLUSH);
+    length = block.data.size() - compressor->avail_out;
+    if (last ? zlib_code == Z_STREAM_END
+             : zlib_code == Z_OK && compressor->avail_out > 0) {
+      break;
+    }
+    if (ABSL_PREDICT_FALSE(zlib_code != Z_OK && zlib_code != Z_BUF_ERROR)) {
+      block.zlib_code = zlib_code;
+      break;
+    }
+    block.data.resize(block.data.size() * 2);
+  }
+  block.data.resize(length);
+  return block;
+}
+
+bool ZlibWriterBase::ParallelCompressor::Write(absl::string_view src,
+                                               Writer& dest, int flush) {
+  if (!header_.empty()) {
+    if (ABSL_PREDICT_FALSE(!dest.Write(header_))) return false;
+    header_ = std::string();
+  }
+  while (!src.empty()) {
+    if (block_.empty()) block_.reserve(kParallelBlockSize);
+    const size_t length =
+        UnsignedMin(src.size(), kParallelBlockSize - block_.size());
+    block_.append(src.data(), length);
+    src.remove_prefix(length);
+    if (block_.size() == kParallelBlockSize) {
+      if (ABSL_PREDICT_FALSE(!ScheduleBlock(dest, false))) return false;
+    }
+  }
+  if (flush == Z_NO_FLUSH) return true;
+  if (flush == Z_FINISH || !block_.empty()) {
+    if (ABSL_PREDICT_FALSE(!ScheduleBlock(dest, flush == Z_FINISH))) {
+      return false;
+    }
+  }
+  while (!compressed_blocks_.empty()) {
+    if (ABSL_PREDICT_FALSE(!WriteBlock(dest))) return false;
+  }
+  if (flush == Z_FINISH) {
+    if (window_bits_ > 15) {
+      if (ABSL_PREDICT_FALSE(
+              !WriteLittleEndian32(IntCast<uint32_t>(check_), dest) ||
+              !WriteLittleEndian32(static_cast<uint32_t>(uncompressed_size_),
+                                   dest))) {
+        return false;
+      }
+    } else if (window_bits_ >= 0) {
+      if (ABSL_PREDICT_FALSE(
+              !WriteBigEndian32(IntCast<uint32_t>(check_), dest))) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool ZlibWriterBase::ParallelCompressor::ScheduleBlock(Writer& dest,
+                                                       bool last) {
+  while (compressed_blocks_.size() >= parallelism_) {
+    if (ABSL_PREDICT_FALSE(!WriteBlock(dest))) return false;
+  }
+  std::string dictionary = history_;
+  if (block_.size() >= window_size_) {
+    history_.assign(block_, block_.size() - window_size_, window_size_);
+  } else {
+    history_.append(block_);
+    if (history_.size() > window_size_) {
+      history_.erase(0, history_.size() - window_size_);
+    }
+  }
+  std::promise<CompressedBlock> promise;
+  compressed_blocks_.push_back(promise.get_future());
+  internal::ThreadPool::global().Schedule(
+      [promise = std::move(promise), compression_level = compression_level_,
+       window_bits = window_bits_,
+       recycling_pool_options = recycling_pool_options_,
+       dictionary = std::move(dictionary), block = std::move(block_),
+       last]() mutable {
+        promise.set_value(CompressBlock(compression_level, window_bits,
+                                        recycling_pool_options, dictionary,
+                                        block, last));
+      });
+  block_ = std::string();
+  return true;
+}
+
+bool ZlibWriterBase::ParallelCompressor::WriteBlock(Writer& dest) {
+  const CompressedBlock block = compressed_blocks_.front().get();
+  compressed_blocks_.pop_front();
+  if (ABSL_PREDICT_FALSE(block.zlib_code != Z_OK)) {
+    zlib_code_ = block.zlib_code;
+    return false;
+  }
+  if (window_bits_ > 15) {
+    check_ = ConcatCrc32(IntCast<uint32_t>(check_),
+                         IntCast<uint32_t>(block.check),
+                         block.uncompressed_size);
+  } else if (window_bits_ >= 0) {
+    check_ = adler32_combine(check_, block.check,
+                             IntCast<z_off_t>(block.uncompressed_size));
+  }
+  uncompressed_size_ += block.uncompressed_size;
+  return dest.Write(block.data);
+}
+
+void ZlibWriterBase::Initialize(Writer* dest, int compression_level,
+                                int parallelism) {
   RIEGELI_ASSERT(dest != nullptr)
       << "Failed precondition of ZlibWriter: null Writer pointer";
   if (ABSL_PREDICT_FALSE(!dest->ok())) {
@@ -77,6 +358,17 @@ void ZlibWriterBase::Initialize(Writer* dest, int compression_level) {
     return;
   }
   initial_compressed_pos_ = dest->pos();
+  if (parallelism > 0) {
+    if (ABSL_PREDICT_FALSE(window_bits_ > 15 && !dictionary_.empty())) {
+      // Gzip does not support a dictionary.
+      FailOperation("deflateSetDictionary()", Z_STREAM_ERROR);
+      return;
+    }
+    parallel_compressor_.reset(new ParallelCompressor(
+        parallelism, compression_level, window_bits_, dictionary_.data(),
+        recycling_pool_options_));
+    return;
+  }
   compressor_ =
       KeyedRecyclingPool<z_stream, ZStreamKey, ZStreamDeleter>::global(
           recycling_pool_options_)
@@ -122,6 +414,7 @@ void ZlibWriterBase::DoneBehindBuffer(absl::string_view src) {
 void ZlibWriterBase::Done() {
   BufferedWriter::Done();
   compressor_.reset();
+  parallel_compressor_.reset();
   dictionary_ = ZlibDictionary();
   associated_reader_.Reset();
 }
@@ -134,8 +427,9 @@ inline bool ZlibWriterBase::FailOperation(absl::string_view operation,
   RIEGELI_ASSERT(is_open())
       << "Failed precondition of ZlibWriterBase::FailOperation(): "
          "Object closed";
-  return Fail(
-      zlib_internal::ZlibErrorToStatus(operation, zlib_code, compressor_->msg));
+  return Fail(zlib_internal::ZlibErrorToStatus(
+      operation, zlib_code,
+      compressor_ == nullptr ? nullptr : compressor_->msg));
 }
 
 absl::Status ZlibWriterBase::AnnotateStatusImpl(absl::Status status) {
@@ -174,6 +468,9 @@ inline bool ZlibWriterBase::WriteInternal(absl::string_view src, Writer& dest,
                          std::numeric_limits<Position>::max() - start_pos())) {
     return FailOverflow();
   }
+  if (parallel_compressor_ != nullptr) {
+    return WriteInternalParallel(src, dest, flush);
+  }
   compressor_->next_in =
       const_cast<z_const Bytef*>(reinterpret_cast<const Bytef*>(src.data()));
   for (;;) {
@@ -221,6 +518,18 @@ inline bool ZlibWriterBase::WriteInternal(absl::string_view src, Writer& dest,
   }
 }
 
+bool ZlibWriterBase::WriteInternalParallel(absl::string_view src,
+                                           Writer& dest, int flush) {
+  if (ABSL_PREDICT_FALSE(!parallel_compressor_->Write(src, dest, flush))) {
+    if (ABSL_PREDICT_FALSE(!dest.ok())) {
+      return FailWithoutAnnotation(AnnotateOverDest(dest.status()));
+    }
+    return FailOperation("deflate()", parallel_compressor_->zlib_code());
+  }
+  move_start_pos(src.size());
+  return true;
+}
+
 bool ZlibWriterBase::FlushBehindBuffer(absl::string_view src,
                                        FlushType flush_type) {
   RIEGELI_ASSERT_EQ(start_to_limit(), 0u)
@@ -15,6 +15,7 @@
 #ifndef RIEGELI_ZLIB_ZLIB_WRITER_H_
 #define RIEGELI_ZLIB_ZLIB_WRITER_H_
 
+#include <memory>
 #include <utility>
 
 #include "absl/base/attributes.h"
@@ -162,12 +163,37 @@ class ZlibWriterBase : public BufferedWriter {
       return recycling_pool_options_;
     }
 
+    // Number of blocks to compress concurrently in background threads.
+    // `parallelism() == 0` compresses in the current thread.
+    //
+    // If `parallelism() > 0`, data are split into blocks of 128 KiB, like by
+    // `pigz`. Each block is compressed independently, with the preceding
+    // window of uncompressed data as the dictionary, and ends with a sync
+    // flush marker. Blocks are joined into a single stream with the header and
+    // the checksum of the whole data. Compression density is slightly worse.
+    //
+    // Default: 0.
+    Options& set_parallelism(int parallelism) & ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      RIEGELI_ASSERT_GE(parallelism, 0)
+          << "Failed precondition of "
+             "ZlibWriterBase::Options::set_parallelism(): "
+             "negative parallelism";
+      parallelism_ = parallelism;
+      return *this;
+    }
+    Options&& set_parallelism(int parallelism) &&
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      return std::move(set_parallelism(parallelism));
+    }
+    int parallelism() const { return parallelism_; }
+
    private:
     Header header_ = kDefaultHeader;
     int compression_level_ = kDefaultCompressionLevel;
     int window_log_ = kDefaultWindowLog;
     ZlibDictionary dictionary_;
     RecyclingPoolOptions recycling_pool_options_;
+    int parallelism_ = 0;
   };
 
   // Returns the compressed `Writer`. Unchanged by `Close()`.
@@ -190,7 +216,7 @@ class ZlibWriterBase : public BufferedWriter {
              ZlibDictionary&& dictionary,
              const RecyclingPoolOptions& recycling_pool_options);
   static int GetWindowBits(const Options& options);
-  void Initialize(Writer* dest, int compression_level);
+  void Initialize(Writer* dest, int compression_level, int parallelism);
   ABSL_ATTRIBUTE_COLD absl::Status AnnotateOverDest(absl::Status status);
 
   void DoneBehindBuffer(absl::string_view src) override;
@@ -225,9 +251,16 @@ class ZlibWriterBase : public BufferedWriter {
     int window_bits;
   };
 
+  // State of compressing blocks in background threads.
+  class ParallelCompressor;
+  struct ParallelCompressorDeleter {
+    void operator()(ParallelCompressor* ptr) const;
+  };
+
   ABSL_ATTRIBUTE_COLD bool FailOperation(absl::string_view operation,
                                          int zlib_code);
   bool WriteInternal(absl::string_view src, Writer& dest, int flush);
+  bool WriteInternalParallel(absl::string_view src, Writer& dest, int flush);
 
   int window_bits_ = 0;
   ZlibDictionary dictionary_;
@@ -235,6 +268,9 @@ class ZlibWriterBase : public BufferedWriter {
   Position initial_compressed_pos_ = 0;
   KeyedRecyclingPool<z_stream_s, ZStreamKey, ZStreamDeleter>::Handle
       compressor_;
+  // Used instead of `compressor_` if `Options::parallelism() > 0`.
+  std::unique_ptr<ParallelCompressor, ParallelCompressorDeleter>
+      parallel_compressor_;
 
   AssociatedReader<ZlibReader<Reader*>> associated_reader_;
 };
@@ -318,6 +354,7 @@ inline ZlibWriterBase::ZlibWriterBase(ZlibWriterBase&& that) noexcept
       recycling_pool_options_(that.recycling_pool_options_),
       initial_compressed_pos_(that.initial_compressed_pos_),
       compressor_(std::move(that.compressor_)),
+      parallel_compressor_(std::move(that.parallel_compressor_)),
       associated_reader_(std::move(that.associated_reader_)) {}
 
 inline ZlibWriterBase& ZlibWriterBase::operator=(
@@ -328,6 +365,7 @@ inline ZlibWriterBase& ZlibWriterBase::operator=(
   recycling_pool_options_ = that.recycling_pool_options_;
   initial_compressed_pos_ = that.initial_compressed_pos_;
   compressor_ = std::move(that.compressor_);
+  parallel_compressor_ = std::move(that.parallel_compressor_);
   associated_reader_ = std::move(that.associated_reader_);
   return *this;
 }
@@ -338,6 +376,7 @@ inline void ZlibWriterBase::Reset(Closed) {
   recycling_pool_options_ = RecyclingPoolOptions();
   initial_compressed_pos_ = 0;
   compressor_.reset();
+  parallel_compressor_.reset();
   dictionary_ = ZlibDictionary();
   associated_reader_.Reset();
 }
@@ -350,6 +389,7 @@ inline void ZlibWriterBase::Reset(
   recycling_pool_options_ = recycling_pool_options;
   initial_compressed_pos_ = 0;
   compressor_.reset();
+  parallel_compressor_.reset();
   dictionary_ = std::move(dictionary);
   associated_reader_.Reset();
 }
@@ -366,7 +406,8 @@ inline ZlibWriter<Dest>::ZlibWriter(Initializer<Dest> dest, Options options)
                      std::move(options.dictionary()),
                      options.recycling_pool_options()),
       dest_(std::move(dest)) {
-  Initialize(dest_.get(), options.compression_level());
+  Initialize(dest_.get(), options.compression_level(),
+             options.parallelism());
 }
 
 template <typename Dest>
@@ -381,7 +422,8 @@ inline void ZlibWriter<Dest>::Reset(Initializer<Dest> dest, Options options) {
                         std::move(options.dictionary()),
                         options.recycling_pool_options());
   dest_.Reset(std::move(dest));
-  Initialize(dest_.get(), options.compression_level());
+  Initialize(dest_.get(), options.compression_level(),
+             options.parallelism());
 }
 
 template <typename Dest>
@@ -0,0 +1,176 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures throughput of `ZstdWriter` depending on `num_workers()`, for several
+// compression levels.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "absl/base/macros.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "riegeli/base/assert.h"
+#include "riegeli/base/maker.h"
+#include "riegeli/bytes/fd_reader.h"
+#include "riegeli/bytes/read_all.h"
+#include "riegeli/bytes/std_io.h"
+#include "riegeli/bytes/string_reader.h"
+#include "riegeli/bytes/string_writer.h"
+#include "riegeli/zstd/zstd_reader.h"
+#include "riegeli/zstd/zstd_writer.h"
+
+ABSL_FLAG(std::string, input, "",
+          "File to compress; if empty, synthetic log lines are generated");
+ABSL_FLAG(uint64_t, data_size, uint64_t{256} << 20,
+          "Size of synthetic data to compress, in bytes");
+ABSL_FLAG(std::vector<std::string>, compression_levels,
+          std::vector<std::string>({"3", "9", "19"}),
+          "Compression levels to benchmark");
+ABSL_FLAG(std::vector<std::string>, num_workers,
+          std::vector<std::string>({"0", "1", "2", "4", "8", "16"}),
+          "Numbers of workers to benchmark");
+ABSL_FLAG(uint64_t, job_size, 0,
+          "Job size; if 0, it is derived from the compression level");
+ABSL_FLAG(uint64_t, write_size, uint64_t{1} << 20,
+          "Size of a single Write() call, in bytes");
+ABSL_FLAG(int32_t, repetitions, 3, "Number of times to repeat each benchmark");
+
+namespace {
+
+// Returns text resembling log lines, which compresses moderately well.
+std::string GenerateLogLines(size_t data_size) {
+  static constexpr absl::string_view kWords[] = {
+      "INFO",    "WARNING", "request", "response", "user",  "session",
+      "latency", "bytes",   "served",  "cache",    "miss",  "hit",
+      "backend", "timeout", "retry",   "shard",    "query", "status"};
+  std::string data;
+  data.reserve(data_size + 256);
+  uint32_t random = 1;
+  uint64_t timestamp = 1700000000000;
+  while (data.size() < data_size) {
+    random = random * 1103515245 + 12345;
+    timestamp += (random >> 16) % 1000;
+    absl::StrAppendFormat(&data, "%d ", timestamp);
+    const size_t num_words = 4 + (random >> 8) % 12;
+    for (size_t i = 0; i < num_words; ++i) {
+      random = random * 1103515245 + 12345;
+      const uint32_t choice = random >> 16;
+      if (choice % 4 == 0) {
+        absl::StrAppendFormat(&data, "%d ", choice % 100000);
+      } else {
+        data.append(kWords[choice % ABSL_ARRAYSIZE(kWords)].data(),
+                    kWords[choice % ABSL_ARRAYSIZE(kWords)].size());
+        data.push_back(' ');
+      }
+    }
+    data.back() = '\n';
+  }
+  return data;
+}
+
+struct Result {
+  double megabytes_per_second;
+  size_t compressed_size;
+};
+
+// Returns the median compression throughput in MB/s and the compressed size.
+Result Measure(absl::string_view data, int compression_level, int num_workers,
+               int repetitions) {
+  riegeli::ZstdWriterBase::Options options;
+  options.set_compression_level(compression_level)
+      .set_num_workers(num_workers);
+  const uint64_t job_size = absl::GetFlag(FLAGS_job_size);
+  if (job_size > 0) options.set_job_size(job_size);
+  const size_t write_size =
+      std::max(absl::GetFlag(FLAGS_write_size), uint64_t{1});
+  std::vector<double> samples;
+  std::string compressed;
+  for (int i = 0; i < repetitions; ++i) {
+    compressed.clear();
+    riegeli::StringWriter<> compressed_writer(&compressed);
+    const absl::Time start = absl::Now();
+    riegeli::ZstdWriter<> writer(&compressed_writer, options);
+    for (size_t pos = 0; pos < data.size(); pos += write_size) {
+      RIEGELI_CHECK(writer.Write(data.substr(pos, write_size)))
+          << writer.status();
+    }
+    RIEGELI_CHECK(writer.Close()) << writer.status();
+    const absl::Duration elapsed = absl::Now() - start;
+    RIEGELI_CHECK(compressed_writer.Close()) << compressed_writer.status();
+    samples.push_back(static_cast<double>(data.size()) /
+                      absl::ToDoubleMicroseconds(elapsed));
+  }
+  std::string decompressed;
+  const absl::Status status = riegeli::ReadAll(
+      riegeli::ZstdReader(riegeli::Maker<riegeli::StringReader>(compressed)),
+      decompressed);
+  RIEGELI_CHECK(status.ok()) << status;
+  RIEGELI_CHECK(decompressed == data) << "Decompressed data do not match";
+  std::nth_element(samples.begin(), samples.begin() + samples.size() / 2,
+                   samples.end());
+  return Result{samples[samples.size() / 2], compressed.size()};
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  std::string data;
+  const std::string& input = absl::GetFlag(FLAGS_input);
+  if (input.empty()) {
+    data = GenerateLogLines(absl::GetFlag(FLAGS_data_size));
+  } else {
+    const absl::Status status =
+        riegeli::ReadAll(riegeli::FdReader(input), data);
+    RIEGELI_CHECK(status.ok()) << status;
+  }
+  const int repetitions = std::max(absl::GetFlag(FLAGS_repetitions), 1);
+  riegeli::StdOut std_out;
+  std_out.Write(absl::StrFormat("%6s %8s %12s %10s %8s\n", "level", "workers",
+                                "MB/s", "speedup", "ratio"));
+  for (const std::string& level_str :
+       absl::GetFlag(FLAGS_compression_levels)) {
+    int compression_level;
+    RIEGELI_CHECK(absl::SimpleAtoi(level_str, &compression_level))
+        << "Invalid compression level: " << level_str;
+    double baseline = 0.0;
+    for (const std::string& num_workers_str :
+         absl::GetFlag(FLAGS_num_workers)) {
+      int num_workers;
+      RIEGELI_CHECK(absl::SimpleAtoi(num_workers_str, &num_workers) &&
+                    num_workers >= 0)
+          << "Invalid number of workers: " << num_workers_str;
+      const Result result =
+          Measure(data, compression_level, num_workers, repetitions);
+      if (baseline == 0.0) baseline = result.megabytes_per_second;
+      std_out.Write(absl::StrFormat(
+          "%6d %8d %12.1f %9.2fx %8.3f\n", compression_level, num_workers,
+          result.megabytes_per_second,
+          result.megabytes_per_second / baseline,
+          static_cast<double>(data.size()) /
+              static_cast<double>(result.compressed_size)));
+    }
+  }
+  std_out.Close();
+}
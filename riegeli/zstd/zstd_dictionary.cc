@@ -29,6 +29,7 @@
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
 #include "riegeli/base/arithmetic.h"
+#include "riegeli/base/dictionary_cache.h"
 #include "riegeli/base/maker.h"
 #include "riegeli/base/shared_ptr.h"
 #include "riegeli/zstd/zstd_dictionary.h"
@@ -61,12 +62,24 @@ ZstdDictionary::Repr::PrepareCompressionDictionary(
     compression_cache = compression_cache_;
   }
   absl::call_once(compression_cache->compression_once, [&] {
-    compression_cache->compression_dictionary.reset(ZSTD_createCDict_advanced(
-        data_.data(), data_.size(), ZSTD_dlm_byRef,
-        static_cast<ZSTD_dictContentType_e>(type_),
-        ZSTD_getCParams(compression_level, 0, data_.size()), ZSTD_defaultCMem));
+    compression_cache->compression_dictionary =
+        DictionaryCache::global().Get<ZSTD_CDict, ZSTD_CDictDeleter>(
+            "ZSTD_CDict", {static_cast<int>(type_), compression_level}, data_,
+            [&](absl::string_view data) {
+              return std::unique_ptr<ZSTD_CDict, ZSTD_CDictDeleter>(
+                  ZSTD_createCDict_advanced(
+                      data.data(), data.size(), ZSTD_dlm_byRef,
+                      static_cast<ZSTD_dictContentType_e>(type_),
+                      ZSTD_getCParams(compression_level, 0, data.size()),
+                      ZSTD_defaultCMem));
+            },
+            [](const ZSTD_CDict* dictionary) {
+              return ZSTD_sizeof_CDict(dictionary);
+            });
   });
-  ZSTD_CDict* const ptr = compression_cache->compression_dictionary.get();
+  if (compression_cache->compression_dictionary == nullptr) return nullptr;
+  ZSTD_CDict* const ptr =
+      compression_cache->compression_dictionary->prepared<ZSTD_CDict>();
   return ZSTD_CDictHandle(ptr,
                           ZSTD_CDictReleaser{std::move(compression_cache)});
 }
@@ -74,11 +87,22 @@ ZstdDictionary::Repr::PrepareCompressionDictionary(
 inline const ZSTD_DDict* ZstdDictionary::Repr::PrepareDecompressionDictionary()
     const {
   absl::call_once(decompression_once_, [&] {
-    decompression_dictionary_.reset(ZSTD_createDDict_advanced(
-        data_.data(), data_.size(), ZSTD_dlm_byRef,
-        static_cast<ZSTD_dictContentType_e>(type_), ZSTD_defaultCMem));
+    decompression_dictionary_ =
+        DictionaryCache::global().Get<ZSTD_DDict, ZSTD_DDictDeleter>(
+            "ZSTD_DDict", {static_cast<int>(type_)}, data_,
+            [&](absl::string_view data) {
+              return std::unique_ptr<ZSTD_DDict, ZSTD_DDictDeleter>(
+                  ZSTD_createDDict_advanced(
+                      data.data(), data.size(), ZSTD_dlm_byRef,
+                      static_cast<ZSTD_dictContentType_e>(type_),
+                      ZSTD_defaultCMem));
+            },
+            [](const ZSTD_DDict* dictionary) {
+              return ZSTD_sizeof_DDict(dictionary);
+            });
   });
-  return decompression_dictionary_.get();
+  if (decompression_dictionary_ == nullptr) return nullptr;
+  return decompression_dictionary_->prepared<ZSTD_DDict>();
 }
 
 ZstdDictionary::ZSTD_CDictHandle ZstdDictionary::PrepareCompressionDictionary(
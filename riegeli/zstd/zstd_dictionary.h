@@ -30,6 +30,7 @@
 #include "absl/base/thread_annotations.h"
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
+#include "riegeli/base/dictionary_cache.h"
 #include "riegeli/base/initializer.h"
 #include "riegeli/base/maker.h"
 #include "riegeli/base/shared_ptr.h"
@@ -201,8 +202,9 @@ class ZstdDictionary::Repr {
       ABSL_GUARDED_BY(compression_cache_mutex_);
 
   mutable absl::once_flag decompression_once_;
-  mutable std::unique_ptr<ZSTD_DDict, ZSTD_DDictDeleter>
-      decompression_dictionary_;
+  // Owns the `ZSTD_DDict`, shared through `DictionaryCache::global()` with
+  // other dictionaries with the same contents.
+  mutable SharedPtr<const DictionaryCache::Entry> decompression_dictionary_;
 };
 
 // Holds a compression dictionary prepared for a particular compression level.
@@ -213,14 +215,17 @@ class ZstdDictionary::Repr {
 //
 // If the callers need it with different compression levels, they do not wait.
 // The dictionary will be prepared again if varying compression levels later
-// repeat, because the cache holds at most one entry.
+// repeat, because the cache holds at most one entry, but then it is usually
+// found in `DictionaryCache::global()`.
 struct ZstdDictionary::ZSTD_CDictCache {
   explicit ZSTD_CDictCache(int compression_level)
       : compression_level(compression_level) {}
 
   int compression_level;
   mutable absl::once_flag compression_once;
-  mutable std::unique_ptr<ZSTD_CDict, ZSTD_CDictDeleter> compression_dictionary;
+  // Owns the `ZSTD_CDict`, shared through `DictionaryCache::global()` with
+  // other dictionaries with the same contents.
+  mutable SharedPtr<const DictionaryCache::Entry> compression_dictionary;
 };
 
 inline ZstdDictionary& ZstdDictionary::Reset() & ABSL_ATTRIBUTE_LIFETIME_BOUND {
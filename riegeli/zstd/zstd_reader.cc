@@ -42,10 +42,44 @@
 #include "riegeli/base/types.h"
 #include "riegeli/bytes/buffered_reader.h"
 #include "riegeli/bytes/reader.h"
+#include "riegeli/zstd/zstd_seek_table.h"
 #include "zstd.h"
 
 namespace riegeli {
 
+namespace zstd_internal {
+
+RecyclingPool<ZSTD_DCtx, ZSTD_DCtxDeleter>::Handle GetDecompressor(
+    const RecyclingPoolOptions& recycling_pool_options) {
+  return RecyclingPool<ZSTD_DCtx, ZSTD_DCtxDeleter>::global(
+             recycling_pool_options)
+      .Get(
+          [] {
+            return std::unique_ptr<ZSTD_DCtx, ZSTD_DCtxDeleter>(
+                ZSTD_createDCtx());
+          },
+          [](ZSTD_DCtx* decompressor) {
+            {
+              const size_t result = ZSTD_DCtx_reset(
+                  decompressor, ZSTD_reset_session_and_parameters);
+              RIEGELI_ASSERT(!ZSTD_isError(result))
+                  << "ZSTD_DCtx_reset() failed: " << ZSTD_getErrorName(result);
+            }
+#if ZSTD_VERSION_NUMBER <= 10405
+            // Workaround for https://github.com/facebook/zstd/issues/2331
+            {
+              const size_t result = ZSTD_DCtx_setParameter(
+                  decompressor, ZSTD_d_stableOutBuffer, 0);
+              RIEGELI_ASSERT(!ZSTD_isError(result))
+                  << "ZSTD_DCtx_setParameter(ZSTD_d_stableOutBuffer) failed: "
+                  << ZSTD_getErrorName(result);
+            }
+#endif
+          });
+}
+
+}  // namespace zstd_internal
+
 void ZstdReaderBase::Initialize(Reader* src) {
   RIEGELI_ASSERT(src != nullptr)
       << "Failed precondition of ZstdReader: null Reader pointer";
@@ -54,38 +88,35 @@ void ZstdReaderBase::Initialize(Reader* src) {
     return;
   }
   initial_compressed_pos_ = src->pos();
+  // The seek table is looked for lazily by `ProbeSeekTable()`, unless it was
+  // already read by the `ZstdReader` which created this one with
+  // `NewReader()`.
+  seek_table_probed_ = seek_table_ != nullptr || growing_source_;
+  if (seek_table_ != nullptr) set_exact_size(seek_table_->decompressed_size());
   InitializeDecompressor(*src);
 }
 
+bool ZstdReaderBase::ProbeSeekTable() {
+  if (seek_table_probed_) return true;
+  seek_table_probed_ = true;
+  if (ABSL_PREDICT_FALSE(!ok())) return false;
+  Reader& src = *SrcReader();
+  if (!src.SupportsRandomAccess()) return true;
+  const Position compressed_pos = src.pos();
+  absl::optional<zstd_internal::ZstdSeekTable> seek_table =
+      zstd_internal::ZstdSeekTable::Read(src, initial_compressed_pos_);
+  if (ABSL_PREDICT_FALSE(!src.Seek(compressed_pos))) {
+    return FailWithoutAnnotation(AnnotateOverSrc(src.StatusOrAnnotate(
+        absl::DataLossError("Zstd-compressed stream got truncated"))));
+  }
+  if (seek_table == absl::nullopt) return true;
+  seek_table_.Reset(std::move(*seek_table));
+  set_exact_size(seek_table_->decompressed_size());
+  return true;
+}
+
 inline void ZstdReaderBase::InitializeDecompressor(Reader& src) {
-  decompressor_ =
-      RecyclingPool<ZSTD_DCtx, ZSTD_DCtxDeleter>::global(
-          recycling_pool_options_)
-          .Get(
-              [] {
-                return std::unique_ptr<ZSTD_DCtx, ZSTD_DCtxDeleter>(
-                    ZSTD_createDCtx());
-              },
-              [](ZSTD_DCtx* decompressor) {
-                {
-                  const size_t result = ZSTD_DCtx_reset(
-                      decompressor, ZSTD_reset_session_and_parameters);
-                  RIEGELI_ASSERT(!ZSTD_isError(result))
-                      << "ZSTD_DCtx_reset() failed: "
-                      << ZSTD_getErrorName(result);
-                }
-#if ZSTD_VERSION_NUMBER <= 10405
-                // Workaround for https://github.com/facebook/zstd/issues/2331
-                {
-                  const size_t result = ZSTD_DCtx_setParameter(
-                      decompressor, ZSTD_d_stableOutBuffer, 0);
-                  RIEGELI_ASSERT(!ZSTD_isError(result))
-                      << "ZSTD_DCtx_setParameter(ZSTD_d_stableOutBuffer) "
-                         "failed: "
-                      << ZSTD_getErrorName(result);
-                }
-#endif
-              });
+  decompressor_ = zstd_internal::GetDecompressor(recycling_pool_options_);
   if (ABSL_PREDICT_FALSE(decompressor_ == nullptr)) {
     Fail(absl::InternalError("ZSTD_createDCtx() failed"));
     return;
@@ -118,7 +149,9 @@ inline void ZstdReaderBase::InitializeDecompressor(Reader& src) {
       return;
     }
   }
-  if (exact_size() == absl::nullopt) set_exact_size(ZstdUncompressedSize(src));
+  if (exact_size() == absl::nullopt && !concatenate_) {
+    set_exact_size(ZstdUncompressedSize(src));
+  }
   just_initialized_ = true;
 }
 
@@ -166,12 +199,13 @@ bool ZstdReaderBase::ReadInternal(size_t min_length, size_t max_length,
       << "Failed precondition of BufferedReader::ReadInternal(): " << status();
   Reader& src = *SrcReader();
   truncated_ = false;
-  if (just_initialized_ && exact_size() == absl::nullopt) {
+  if (just_initialized_ && exact_size() == absl::nullopt && !concatenate_) {
     // Try again in case the source has grown.
     set_exact_size(ZstdUncompressedSize(src));
   }
   size_t effective_min_length = min_length;
-  if (just_initialized_ && !growing_source_ && exact_size() != absl::nullopt &&
+  if (just_initialized_ && !growing_source_ && !concatenate_ &&
+      seek_table_ == nullptr && exact_size() != absl::nullopt &&
       max_length >= *exact_size()) {
     // Avoid a memory copy from an internal buffer of the Zstd engine to `dest`
     // by promising to decompress all remaining data to `dest`.
@@ -194,6 +228,63 @@ bool ZstdReaderBase::ReadInternal(size_t min_length, size_t max_length,
         ZSTD_decompressStream(decompressor_.get(), &output, &input);
     src.set_cursor(static_cast<const char*>(input.src) + input.pos);
     if (ABSL_PREDICT_FALSE(result == 0)) {
+      // The end of a frame.
+      if (!seek_table_probed_ && !concatenate_ && src.SupportsRandomAccess() &&
+          src.Pull()) {
+        // Data follow the frame. If the source is in the Zstd seekable format,
+        // the remaining frames are decoded too.
+        if (ABSL_PREDICT_FALSE(!ProbeSeekTable())) {
+          move_limit_pos(output.pos);
+          return output.pos >= min_length;
+        }
+        if (seek_table_ != nullptr &&
+            effective_min_length == std::numeric_limits<size_t>::max()) {
+          // `dest` was promised to hold only the first frame. The next frame
+          // is decompressed by another `ReadInternal()` call.
+          const size_t result = ZSTD_DCtx_setParameter(
+              decompressor_.get(), ZSTD_d_stableOutBuffer, 0);
+          if (ABSL_PREDICT_FALSE(ZSTD_isError(result))) {
+            Fail(absl::InternalError(absl::StrCat(
+                "ZSTD_DCtx_setParameter(ZSTD_d_stableOutBuffer) failed: ",
+                ZSTD_getErrorName(result))));
+            move_limit_pos(output.pos);
+            return output.pos >= min_length;
+          }
+          effective_min_length = min_length;
+        }
+      }
+      if (seek_table_ != nullptr) {
+        if (limit_pos() + output.pos < seek_table_->decompressed_size()) {
+          // Continue with the next frame.
+          if (output.pos >= effective_min_length) {
+            move_limit_pos(output.pos);
+            return true;
+          }
+          continue;
+        }
+        // Skip remaining empty frames and the seek table.
+        if (ABSL_PREDICT_FALSE(!src.Seek(initial_compressed_pos_ +
+                                         seek_table_->compressed_size()))) {
+          FailWithoutAnnotation(AnnotateOverSrc(src.StatusOrAnnotate(
+              absl::DataLossError("Zstd-compressed stream got truncated"))));
+          move_limit_pos(output.pos);
+          return output.pos >= min_length;
+        }
+      } else if (concatenate_) {
+        if (src.Pull()) {
+          // Continue with the next frame.
+          if (output.pos >= effective_min_length) {
+            move_limit_pos(output.pos);
+            return true;
+          }
+          continue;
+        }
+        if (ABSL_PREDICT_FALSE(!src.ok())) {
+          FailWithoutAnnotation(AnnotateOverSrc(src.status()));
+          move_limit_pos(output.pos);
+          return output.pos >= min_length;
+        }
+      }
       decompressor_.reset();
       move_limit_pos(output.pos);
       // Avoid `BufferedReader` allocating another buffer.
@@ -207,8 +298,16 @@ bool ZstdReaderBase::ReadInternal(size_t min_length, size_t max_length,
       return output.pos >= min_length;
     }
     if (output.pos >= effective_min_length) {
-      move_limit_pos(output.pos);
-      return true;
+      if (ABSL_PREDICT_TRUE(seek_table_probed_ || input.pos < input.size ||
+                            exact_size() == absl::nullopt ||
+                            limit_pos() + output.pos < *exact_size())) {
+        move_limit_pos(output.pos);
+        return true;
+      }
+      // The first frame is fully decompressed but its end was not reached.
+      // Reach it now: data following the frame might be more frames of the
+      // Zstd seekable format, and `exact_size()` would stop reading before
+      // them.
     }
     if (ABSL_PREDICT_FALSE(input.pos < input.size)) {
       RIEGELI_ASSERT_EQ(output.pos, output.size)
@@ -258,6 +357,10 @@ bool ZstdReaderBase::ToleratesReadingAhead() {
   return src != nullptr && src->ToleratesReadingAhead();
 }
 
+bool ZstdReaderBase::SupportsRandomAccess() {
+  return ProbeSeekTable() && seek_table_ != nullptr;
+}
+
 bool ZstdReaderBase::SupportsRewind() {
   Reader* const src = SrcReader();
   return src != nullptr && src->SupportsRewind();
@@ -270,6 +373,11 @@ bool ZstdReaderBase::SeekBehindBuffer(Position new_pos) {
   RIEGELI_ASSERT_EQ(start_to_limit(), 0u)
       << "Failed precondition of BufferedReader::SeekBehindBuffer(): "
          "buffer not empty";
+  if (new_pos <= limit_pos()) {
+    // Seeking backwards. A seek table avoids decompressing from the beginning.
+    if (ABSL_PREDICT_FALSE(!ProbeSeekTable())) return false;
+  }
+  if (seek_table_ != nullptr) return SeekWithSeekTable(new_pos);
   if (new_pos <= limit_pos()) {
     // Seeking backwards.
     if (ABSL_PREDICT_FALSE(!ok())) return false;
@@ -277,6 +385,7 @@ bool ZstdReaderBase::SeekBehindBuffer(Position new_pos) {
     truncated_ = false;
     set_buffer();
     set_limit_pos(0);
+    BeginRun();
     decompressor_.reset();
     if (ABSL_PREDICT_FALSE(!src.Seek(initial_compressed_pos_))) {
       return FailWithoutAnnotation(AnnotateOverSrc(src.StatusOrAnnotate(
@@ -289,6 +398,57 @@ bool ZstdReaderBase::SeekBehindBuffer(Position new_pos) {
   return BufferedReader::SeekBehindBuffer(new_pos);
 }
 
+inline bool ZstdReaderBase::SeekWithSeekTable(Position new_pos) {
+  if (ABSL_PREDICT_FALSE(!ok())) return false;
+  Reader& src = *SrcReader();
+  const Position size = seek_table_->decompressed_size();
+  if (new_pos >= size) {
+    // Seeking to the end or beyond.
+    truncated_ = false;
+    set_buffer();
+    set_limit_pos(size);
+    BeginRun();
+    decompressor_.reset();
+    if (ABSL_PREDICT_FALSE(!src.Seek(initial_compressed_pos_ +
+                                     seek_table_->compressed_size()))) {
+      return FailWithoutAnnotation(AnnotateOverSrc(src.StatusOrAnnotate(
+          absl::DataLossError("Zstd-compressed stream got truncated"))));
+    }
+    return new_pos == size;
+  }
+  const size_t frame = seek_table_->FrameContaining(new_pos);
+  if (new_pos < limit_pos() || decompressor_ == nullptr ||
+      limit_pos() < seek_table_->decompressed_start(frame)) {
+    // Decompress the frame containing `new_pos` from its beginning. Otherwise
+    // `new_pos` is in the frame being decompressed, ahead of the current
+    // position, and it is faster to continue.
+    truncated_ = false;
+    set_buffer();
+    set_limit_pos(seek_table_->decompressed_start(frame));
+    BeginRun();
+    decompressor_.reset();
+    if (ABSL_PREDICT_FALSE(!src.Seek(initial_compressed_pos_ +
+                                     seek_table_->compressed_start(frame)))) {
+      return FailWithoutAnnotation(AnnotateOverSrc(src.StatusOrAnnotate(
+          absl::DataLossError("Zstd-compressed stream got truncated"))));
+    }
+    InitializeDecompressor(src);
+    if (ABSL_PREDICT_FALSE(!ok())) return false;
+    if (new_pos == limit_pos()) return true;
+  }
+  return BufferedReader::SeekBehindBuffer(new_pos);
+}
+
+bool ZstdReaderBase::SupportsSize() {
+  if (ABSL_PREDICT_FALSE(!ProbeSeekTable())) return false;
+  return BufferedReader::SupportsSize();
+}
+
+absl::optional<Position> ZstdReaderBase::SizeImpl() {
+  if (ABSL_PREDICT_FALSE(!ProbeSeekTable())) return absl::nullopt;
+  return BufferedReader::SizeImpl();
+}
+
 bool ZstdReaderBase::SupportsNewReader() {
   Reader* const src = SrcReader();
   return src != nullptr && src->SupportsNewReader();
@@ -297,7 +457,9 @@ bool ZstdReaderBase::SupportsNewReader() {
 std::unique_ptr<Reader> ZstdReaderBase::NewReaderImpl(Position initial_pos) {
   if (ABSL_PREDICT_FALSE(!ok())) return nullptr;
   // `NewReaderImpl()` is thread-safe from this point
-  // if `SrcReader()->SupportsNewReader()`.
+  // if `SrcReader()->SupportsNewReader()`. Hence the seek table is not looked
+  // for here. If it is not known yet, the new `ZstdReader` looks for it when
+  // needed.
   Reader& src = *SrcReader();
   std::unique_ptr<Reader> compressed_reader =
       src.NewReader(initial_compressed_pos_);
@@ -305,14 +467,16 @@ std::unique_ptr<Reader> ZstdReaderBase::NewReaderImpl(Position initial_pos) {
     FailWithoutAnnotation(AnnotateOverSrc(src.status()));
     return nullptr;
   }
+  ZstdReaderBase::Options options;
+  options.set_growing_source(growing_source_)
+      .set_concatenate(concatenate_)
+      .set_dictionary(dictionary_)
+      .set_buffer_options(buffer_options())
+      .set_recycling_pool_options(recycling_pool_options_);
+  options.seek_table_ = seek_table_;
   std::unique_ptr<Reader> reader =
       std::make_unique<ZstdReader<std::unique_ptr<Reader>>>(
-          std::move(compressed_reader),
-          ZstdReaderBase::Options()
-              .set_growing_source(growing_source_)
-              .set_dictionary(dictionary_)
-              .set_buffer_options(buffer_options())
-              .set_recycling_pool_options(recycling_pool_options_));
+          std::move(compressed_reader), std::move(options));
   reader->Seek(initial_pos);
   return reader;
 }
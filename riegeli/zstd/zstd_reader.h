@@ -29,15 +29,31 @@
 #include "riegeli/base/initializer.h"
 #include "riegeli/base/object.h"
 #include "riegeli/base/recycling_pool.h"
+#include "riegeli/base/shared_ptr.h"
 #include "riegeli/base/types.h"
 #include "riegeli/bytes/buffer_options.h"
 #include "riegeli/bytes/buffered_reader.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/zstd/zstd_dictionary.h"  // IWYU pragma: export
+#include "riegeli/zstd/zstd_seek_table.h"
 #include "zstd.h"
 
 namespace riegeli {
 
+namespace zstd_internal {
+
+struct ZSTD_DCtxDeleter {
+  void operator()(ZSTD_DCtx* ptr) const { ZSTD_freeDCtx(ptr); }
+};
+
+// Returns a reset decompression context from the global `RecyclingPool` shared
+// by `ZstdReader` and one-shot decompression, or `nullptr` if
+// `ZSTD_createDCtx()` failed.
+RecyclingPool<ZSTD_DCtx, ZSTD_DCtxDeleter>::Handle GetDecompressor(
+    const RecyclingPoolOptions& recycling_pool_options);
+
+}  // namespace zstd_internal
+
 // Template parameter independent part of `ZstdReader`.
 class ZstdReaderBase : public BufferedReader {
  public:
@@ -61,6 +77,34 @@ class ZstdReaderBase : public BufferedReader {
     }
     bool growing_source() const { return growing_source_; }
 
+    // If `true`, concatenated compressed frames are decoded to concatenation of
+    // their decompressed contents. Skippable frames are skipped.
+    //
+    // If `false`, exactly one compressed frame is consumed, unless the source
+    // is in the Zstd seekable format (see below).
+    //
+    // If the source supports random access, is not growing, and ends with a
+    // seek table of the Zstd seekable format (e.g. written with
+    // `ZstdWriterBase::Options::seekable_frame_size() != absl::nullopt`), then
+    // all frames are always decoded, and `ZstdReader` supports random access
+    // which decompresses only the frame containing the target position.
+    //
+    // The seek table is looked for only when needed: by
+    // `SupportsRandomAccess()`, `SupportsSize()`, `Size()`, seeking backwards,
+    // or when data follow the first frame. Decompressing sequentially does not
+    // pay for it.
+    //
+    // Default: `false`.
+    Options& set_concatenate(bool concatenate) & ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      concatenate_ = concatenate;
+      return *this;
+    }
+    Options&& set_concatenate(bool concatenate) &&
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      return std::move(set_concatenate(concatenate));
+    }
+    bool concatenate() const { return concatenate_; }
+
     // Zstd dictionary. The same dictionary must have been used for compression,
     // except that it is allowed to supply a dictionary for decompression even
     // if no dictionary was used for compression.
@@ -105,9 +149,17 @@ class ZstdReaderBase : public BufferedReader {
     }
 
    private:
+    friend class ZstdReaderBase;  // For `seek_table_`.
+    template <typename Src>
+    friend class ZstdReader;  // For `seek_table_`.
+
     bool growing_source_ = false;
+    bool concatenate_ = false;
     ZstdDictionary dictionary_;
     RecyclingPoolOptions recycling_pool_options_;
+    // Seek table already read by another `ZstdReader` from the same source, so
+    // that `NewReader()` does not read it again.
+    SharedPtr<const zstd_internal::ZstdSeekTable> seek_table_;
   };
 
   // Returns the compressed `Reader`. Unchanged by `Close()`.
@@ -119,23 +171,28 @@ class ZstdReaderBase : public BufferedReader {
   bool truncated() const { return truncated_ && available() == 0; }
 
   bool ToleratesReadingAhead() override;
+  bool SupportsRandomAccess() override;
   bool SupportsRewind() override;
+  bool SupportsSize() override;
   bool SupportsNewReader() override;
 
  protected:
   explicit ZstdReaderBase(Closed) noexcept : BufferedReader(kClosed) {}
 
-  explicit ZstdReaderBase(BufferOptions buffer_options, bool growing_source,
-                          ZstdDictionary&& dictionary,
-                          const RecyclingPoolOptions& recycling_pool_options);
+  explicit ZstdReaderBase(
+      BufferOptions buffer_options, bool growing_source, bool concatenate,
+      ZstdDictionary&& dictionary,
+      const RecyclingPoolOptions& recycling_pool_options,
+      SharedPtr<const zstd_internal::ZstdSeekTable>&& seek_table);
 
   ZstdReaderBase(ZstdReaderBase&& that) noexcept;
   ZstdReaderBase& operator=(ZstdReaderBase&& that) noexcept;
 
   void Reset(Closed);
   void Reset(BufferOptions buffer_options, bool growing_source,
-             ZstdDictionary&& dictionary,
-             const RecyclingPoolOptions& recycling_pool_options);
+             bool concatenate, ZstdDictionary&& dictionary,
+             const RecyclingPoolOptions& recycling_pool_options,
+             SharedPtr<const zstd_internal::ZstdSeekTable>&& seek_table);
   void Initialize(Reader* src);
   ABSL_ATTRIBUTE_COLD absl::Status AnnotateOverSrc(absl::Status status);
 
@@ -145,18 +202,21 @@ class ZstdReaderBase : public BufferedReader {
   bool ReadInternal(size_t min_length, size_t max_length, char* dest) override;
   void ExactSizeReached() override;
   bool SeekBehindBuffer(Position new_pos) override;
+  absl::optional<Position> SizeImpl() override;
   std::unique_ptr<Reader> NewReaderImpl(Position initial_pos) override;
 
  private:
-  struct ZSTD_DCtxDeleter {
-    void operator()(ZSTD_DCtx* ptr) const { ZSTD_freeDCtx(ptr); }
-  };
-
   void InitializeDecompressor(Reader& src);
+  // Looks for the seek table if this was not done yet, preserving the position
+  // of the source. Returns `false` on failure (`!ok()`).
+  bool ProbeSeekTable();
+  bool SeekWithSeekTable(Position new_pos);
 
   // If `true`, supports decompressing as much as possible from a truncated
   // source, then retrying when the source has grown.
   bool growing_source_ = false;
+  // If `true`, concatenated compressed frames are decoded.
+  bool concatenate_ = false;
   // If `true`, the source is truncated (without a clean end of the compressed
   // stream) at the current position. If the source does not grow, `Close()`
   // will fail.
@@ -166,10 +226,17 @@ class ZstdReaderBase : public BufferedReader {
   ZstdDictionary dictionary_;
   RecyclingPoolOptions recycling_pool_options_;
   Position initial_compressed_pos_ = 0;
+  // If `false`, it is not known yet whether the source ends with a seek table,
+  // and `seek_table_ == nullptr`.
+  bool seek_table_probed_ = false;
+  // If not `nullptr`, the source is in the Zstd seekable format, and
+  // `exact_size()` is the total decompressed size.
+  SharedPtr<const zstd_internal::ZstdSeekTable> seek_table_;
   // If `ok()` but `decompressor_ == nullptr` then all data have been
   // decompressed, `exact_size() == limit_pos()`, and `ReadInternal()` must not
   // be called again.
-  RecyclingPool<ZSTD_DCtx, ZSTD_DCtxDeleter>::Handle decompressor_;
+  RecyclingPool<ZSTD_DCtx, zstd_internal::ZSTD_DCtxDeleter>::Handle
+      decompressor_;
 };
 
 // A `Reader` which decompresses data with Zstd after getting it from another
@@ -257,33 +324,42 @@ absl::optional<uint32_t> ZstdDictId(Reader& src);
 // Implementation details follow.
 
 inline ZstdReaderBase::ZstdReaderBase(
-    BufferOptions buffer_options, bool growing_source,
+    BufferOptions buffer_options, bool growing_source, bool concatenate,
     ZstdDictionary&& dictionary,
-    const RecyclingPoolOptions& recycling_pool_options)
+    const RecyclingPoolOptions& recycling_pool_options,
+    SharedPtr<const zstd_internal::ZstdSeekTable>&& seek_table)
     : BufferedReader(buffer_options),
       growing_source_(growing_source),
+      concatenate_(concatenate),
       dictionary_(std::move(dictionary)),
-      recycling_pool_options_(recycling_pool_options) {}
+      recycling_pool_options_(recycling_pool_options),
+      seek_table_(std::move(seek_table)) {}
 
 inline ZstdReaderBase::ZstdReaderBase(ZstdReaderBase&& that) noexcept
     : BufferedReader(static_cast<BufferedReader&&>(that)),
       growing_source_(that.growing_source_),
+      concatenate_(that.concatenate_),
       truncated_(that.truncated_),
       just_initialized_(that.just_initialized_),
       dictionary_(std::move(that.dictionary_)),
       recycling_pool_options_(that.recycling_pool_options_),
       initial_compressed_pos_(that.initial_compressed_pos_),
+      seek_table_probed_(that.seek_table_probed_),
+      seek_table_(std::move(that.seek_table_)),
       decompressor_(std::move(that.decompressor_)) {}
 
 inline ZstdReaderBase& ZstdReaderBase::operator=(
     ZstdReaderBase&& that) noexcept {
   BufferedReader::operator=(static_cast<BufferedReader&&>(that));
   growing_source_ = that.growing_source_;
+  concatenate_ = that.concatenate_;
   truncated_ = that.truncated_;
   just_initialized_ = that.just_initialized_;
   dictionary_ = std::move(that.dictionary_);
   recycling_pool_options_ = that.recycling_pool_options_;
   initial_compressed_pos_ = that.initial_compressed_pos_;
+  seek_table_probed_ = that.seek_table_probed_;
+  seek_table_ = std::move(that.seek_table_);
   decompressor_ = std::move(that.decompressor_);
   return *this;
 }
@@ -291,24 +367,31 @@ inline ZstdReaderBase& ZstdReaderBase::operator=(
 inline void ZstdReaderBase::Reset(Closed) {
   BufferedReader::Reset(kClosed);
   growing_source_ = false;
+  concatenate_ = false;
   truncated_ = false;
   just_initialized_ = false;
   recycling_pool_options_ = RecyclingPoolOptions();
   initial_compressed_pos_ = 0;
+  seek_table_probed_ = false;
+  seek_table_.Reset();
   decompressor_.reset();
   dictionary_ = ZstdDictionary();
 }
 
 inline void ZstdReaderBase::Reset(
-    BufferOptions buffer_options, bool growing_source,
+    BufferOptions buffer_options, bool growing_source, bool concatenate,
     ZstdDictionary&& dictionary,
-    const RecyclingPoolOptions& recycling_pool_options) {
+    const RecyclingPoolOptions& recycling_pool_options,
+    SharedPtr<const zstd_internal::ZstdSeekTable>&& seek_table) {
   BufferedReader::Reset(buffer_options);
   growing_source_ = growing_source;
+  concatenate_ = concatenate;
   truncated_ = false;
   just_initialized_ = false;
   recycling_pool_options_ = recycling_pool_options;
   initial_compressed_pos_ = 0;
+  seek_table_probed_ = false;
+  seek_table_ = std::move(seek_table);
   decompressor_.reset();
   dictionary_ = std::move(dictionary);
 }
@@ -316,8 +399,9 @@ inline void ZstdReaderBase::Reset(
 template <typename Src>
 inline ZstdReader<Src>::ZstdReader(Initializer<Src> src, Options options)
     : ZstdReaderBase(options.buffer_options(), options.growing_source(),
-                     std::move(options.dictionary()),
-                     options.recycling_pool_options()),
+                     options.concatenate(), std::move(options.dictionary()),
+                     options.recycling_pool_options(),
+                     std::move(options.seek_table_)),
       src_(std::move(src)) {
   Initialize(src_.get());
 }
@@ -331,8 +415,9 @@ inline void ZstdReader<Src>::Reset(Closed) {
 template <typename Src>
 inline void ZstdReader<Src>::Reset(Initializer<Src> src, Options options) {
   ZstdReaderBase::Reset(options.buffer_options(), options.growing_source(),
-                        std::move(options.dictionary()),
-                        options.recycling_pool_options());
+                        options.concatenate(), std::move(options.dictionary()),
+                        options.recycling_pool_options(),
+                        std::move(options.seek_table_));
   src_.Reset(std::move(src));
   Initialize(src_.get());
 }
@@ -0,0 +1,152 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/zstd/zstd_seek_table.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+
+#include "absl/base/optimization.h"
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "riegeli/base/arithmetic.h"
+#include "riegeli/base/assert.h"
+#include "riegeli/base/types.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/endian/endian_reading.h"
+#include "riegeli/endian/endian_writing.h"
+
+namespace riegeli {
+namespace zstd_internal {
+
+// Before C++17 if a constexpr static data member is ODR-used, its definition at
+// namespace scope is required. Since C++17 these definitions are deprecated:
+// http://en.cppreference.com/w/cpp/language/static
+#if !__cpp_inline_variables
+constexpr size_t ZstdSeekTable::kMaxFrameSize;
+constexpr size_t ZstdSeekTable::kMaxNumFrames;
+#endif
+
+namespace {
+
+// `ZSTD_MAGIC_SKIPPABLE_START | 0xe`
+constexpr uint32_t kSkippableFrameMagic = 0x184d2a5e;
+constexpr uint32_t kSeekableMagic = 0x8f92eab1;
+
+constexpr size_t kSkippableFrameHeaderSize = 8;
+constexpr size_t kEntrySize = 8;
+constexpr size_t kEntryWithChecksumSize = 12;
+constexpr size_t kFooterSize = 9;
+
+constexpr uint8_t kChecksumFlag = 0x80;
+constexpr uint8_t kReservedBits = 0x7c;
+
+}  // namespace
+
+bool ZstdSeekTable::Write(absl::Span<const Entry> entries, Writer& dest) {
+  RIEGELI_ASSERT_LE(entries.size(), kMaxNumFrames)
+      << "Failed precondition of ZstdSeekTable::Write(): "
+         "too many frames";
+  const size_t frame_size = entries.size() * kEntrySize + kFooterSize;
+  if (ABSL_PREDICT_FALSE(!dest.Push(kSkippableFrameHeaderSize + frame_size))) {
+    return false;
+  }
+  char* cursor = dest.cursor();
+  WriteLittleEndian32(kSkippableFrameMagic, cursor);
+  WriteLittleEndian32(IntCast<uint32_t>(frame_size), cursor + 4);
+  cursor += kSkippableFrameHeaderSize;
+  for (const Entry& entry : entries) {
+    WriteLittleEndian32(entry.compressed_size, cursor);
+    WriteLittleEndian32(entry.decompressed_size, cursor + 4);
+    cursor += kEntrySize;
+  }
+  WriteLittleEndian32(IntCast<uint32_t>(entries.size()), cursor);
+  cursor[4] = 0;  // Seek table descriptor: no checksums.
+  WriteLittleEndian32(kSeekableMagic, cursor + 5);
+  dest.set_cursor(cursor + kFooterSize);
+  return true;
+}
+
+absl::optional<ZstdSeekTable> ZstdSeekTable::Read(Reader& src,
+                                                  Position initial_pos) {
+  const absl::optional<Position> size = src.Size();
+  if (ABSL_PREDICT_FALSE(size == absl::nullopt) ||
+      *size < initial_pos ||
+      *size - initial_pos < kSkippableFrameHeaderSize + kFooterSize) {
+    return absl::nullopt;
+  }
+  if (ABSL_PREDICT_FALSE(!src.Seek(*size - kFooterSize) ||
+                         !src.Pull(kFooterSize))) {
+    return absl::nullopt;
+  }
+  const uint32_t num_frames = ReadLittleEndian32(src.cursor());
+  const uint8_t descriptor = static_cast<uint8_t>(src.cursor()[4]);
+  if (ReadLittleEndian32(src.cursor() + 5) != kSeekableMagic ||
+      (descriptor & kReservedBits) != 0 || num_frames > kMaxNumFrames) {
+    return absl::nullopt;
+  }
+  const size_t entry_size =
+      (descriptor & kChecksumFlag) != 0 ? kEntryWithChecksumSize : kEntrySize;
+  const Position frame_size = Position{num_frames} * entry_size + kFooterSize;
+  if (*size - initial_pos < kSkippableFrameHeaderSize + frame_size) {
+    return absl::nullopt;
+  }
+  const Position table_pos = *size - (kSkippableFrameHeaderSize + frame_size);
+  if (ABSL_PREDICT_FALSE(!src.Seek(table_pos) ||
+                         !src.Pull(kSkippableFrameHeaderSize))) {
+    return absl::nullopt;
+  }
+  if (ReadLittleEndian32(src.cursor()) != kSkippableFrameMagic ||
+      ReadLittleEndian32(src.cursor() + 4) != frame_size) {
+    return absl::nullopt;
+  }
+  src.move_cursor(kSkippableFrameHeaderSize);
+  ZstdSeekTable seek_table;
+  seek_table.compressed_starts_.reserve(size_t{num_frames} + 1);
+  seek_table.decompressed_starts_.reserve(size_t{num_frames} + 1);
+  seek_table.compressed_starts_.push_back(0);
+  seek_table.decompressed_starts_.push_back(0);
+  Position compressed_pos = 0;
+  Position decompressed_pos = 0;
+  for (uint32_t i = 0; i < num_frames; ++i) {
+    if (ABSL_PREDICT_FALSE(!src.Pull(entry_size))) return absl::nullopt;
+    compressed_pos += ReadLittleEndian32(src.cursor());
+    decompressed_pos += ReadLittleEndian32(src.cursor() + 4);
+    src.move_cursor(entry_size);
+    seek_table.compressed_starts_.push_back(compressed_pos);
+    seek_table.decompressed_starts_.push_back(decompressed_pos);
+  }
+  // Frames must exactly fill the space before the seek table.
+  if (compressed_pos != table_pos - initial_pos) return absl::nullopt;
+  seek_table.compressed_size_ = *size - initial_pos;
+  return seek_table;
+}
+
+size_t ZstdSeekTable::FrameContaining(Position pos) const {
+  RIEGELI_ASSERT_LT(pos, decompressed_size())
+      << "Failed precondition of ZstdSeekTable::FrameContaining(): "
+         "position out of range";
+  // The last frame beginning at or before `pos`. Empty frames are skipped
+  // because the next frame begins at the same position.
+  return IntCast<size_t>(std::upper_bound(decompressed_starts_.begin(),
+                                          decompressed_starts_.end(), pos) -
+                         decompressed_starts_.begin()) -
+         1;
+}
+
+}  // namespace zstd_internal
+}  // namespace riegeli
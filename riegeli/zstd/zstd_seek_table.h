@@ -0,0 +1,115 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_ZSTD_ZSTD_SEEK_TABLE_H_
+#define RIEGELI_ZSTD_ZSTD_SEEK_TABLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "riegeli/base/assert.h"
+#include "riegeli/base/types.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/writer.h"
+
+namespace riegeli {
+namespace zstd_internal {
+
+// Seek table of the Zstd seekable format:
+// https://github.com/facebook/zstd/blob/dev/contrib/seekable_format/zstd_seekable_compression_format.md
+//
+// The seekable format is a sequence of independent Zstd frames followed by a
+// skippable frame with the compressed and decompressed size of each frame.
+class ZstdSeekTable {
+ public:
+  struct Entry {
+    uint32_t compressed_size;
+    uint32_t decompressed_size;
+  };
+
+  // The maximum decompressed size of a frame accepted by the reference
+  // implementation.
+  static constexpr size_t kMaxFrameSize = size_t{1} << 30;
+  // The maximum number of frames accepted by the reference implementation.
+  static constexpr size_t kMaxNumFrames = size_t{1} << 27;
+
+  // Writes a seek table describing frames with sizes given by `entries`, as a
+  // skippable frame. Checksums of frames are not stored in the seek table.
+  //
+  // Precondition: `entries.size() <= kMaxNumFrames`
+  //
+  // Return values:
+  //  * `true`  - success (`dest.ok()`)
+  //  * `false` - failure (`!dest.ok()`)
+  static bool Write(absl::Span<const Entry> entries, Writer& dest);
+
+  // Reads a seek table from the end of `src`, which must support random access,
+  // for a compressed stream beginning at `initial_pos`.
+  //
+  // Returns `absl::nullopt` if `src` does not end with a seek table consistent
+  // with the size of the compressed stream, or if reading failed.
+  //
+  // The position of `src` is undefined afterwards.
+  static absl::optional<ZstdSeekTable> Read(Reader& src, Position initial_pos);
+
+  // Returns the number of frames.
+  size_t num_frames() const { return decompressed_starts_.size() - 1; }
+
+  // Returns the position of the beginning of a frame, relative to the
+  // beginning of the compressed stream or of the decompressed data.
+  //
+  // `frame == num_frames()` gives the end of the last frame.
+  Position compressed_start(size_t frame) const {
+    RIEGELI_ASSERT_LE(frame, num_frames())
+        << "Failed precondition of ZstdSeekTable::compressed_start(): "
+           "frame index out of range";
+    return compressed_starts_[frame];
+  }
+  Position decompressed_start(size_t frame) const {
+    RIEGELI_ASSERT_LE(frame, num_frames())
+        << "Failed precondition of ZstdSeekTable::decompressed_start(): "
+           "frame index out of range";
+    return decompressed_starts_[frame];
+  }
+
+  // Returns the size of the compressed stream, including the seek table.
+  Position compressed_size() const { return compressed_size_; }
+
+  // Returns the total decompressed size.
+  Position decompressed_size() const { return decompressed_starts_.back(); }
+
+  // Returns the index of the frame which contains the decompressed position
+  // `pos`. Empty frames are never returned.
+  //
+  // Precondition: `pos < decompressed_size()`
+  size_t FrameContaining(Position pos) const;
+
+ private:
+  ZstdSeekTable() = default;
+
+  // Cumulative sizes of frames, with `num_frames() + 1` elements beginning with
+  // 0.
+  std::vector<Position> compressed_starts_;
+  std::vector<Position> decompressed_starts_;
+  Position compressed_size_ = 0;
+};
+
+}  // namespace zstd_internal
+}  // namespace riegeli
+
+#endif  // RIEGELI_ZSTD_ZSTD_SEEK_TABLE_H_
@@ -23,6 +23,7 @@
 #include <limits>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
@@ -38,6 +39,7 @@
 #include "riegeli/bytes/reader.h"
 #include "riegeli/bytes/writer.h"
 #include "riegeli/zstd/zstd_reader.h"
+#include "riegeli/zstd/zstd_seek_table.h"
 #include "zstd.h"
 
 namespace riegeli {
@@ -51,11 +53,16 @@ constexpr int ZstdWriterBase::Options::kMaxCompressionLevel;
 constexpr int ZstdWriterBase::Options::kDefaultCompressionLevel;
 constexpr int ZstdWriterBase::Options::kMinWindowLog;
 constexpr int ZstdWriterBase::Options::kMaxWindowLog;
+constexpr int ZstdWriterBase::Options::kMaxNumWorkers;
+constexpr size_t ZstdWriterBase::Options::kMinJobSize;
+constexpr size_t ZstdWriterBase::Options::kMaxJobSize;
+constexpr size_t ZstdWriterBase::Options::kMaxSeekableFrameSize;
 #endif
 
 void ZstdWriterBase::Initialize(Writer* dest, int compression_level,
                                 absl::optional<int> window_log,
-                                bool store_checksum) {
+                                bool store_checksum, int num_workers,
+                                absl::optional<size_t> job_size) {
   RIEGELI_ASSERT(dest != nullptr)
       << "Failed precondition of ZstdWriter: null Writer pointer";
   if (ABSL_PREDICT_FALSE(!dest->ok())) {
@@ -63,20 +70,25 @@ void ZstdWriterBase::Initialize(Writer* dest, int compression_level,
     return;
   }
   initial_compressed_pos_ = dest->pos();
-  compressor_ = RecyclingPool<ZSTD_CCtx, ZSTD_CCtxDeleter>::global(
-                    recycling_pool_options_)
-                    .Get(
-                        [] {
-                          return std::unique_ptr<ZSTD_CCtx, ZSTD_CCtxDeleter>(
-                              ZSTD_createCCtx());
-                        },
-                        [](ZSTD_CCtx* compressor) {
-                          const size_t result = ZSTD_CCtx_reset(
-                              compressor, ZSTD_reset_session_and_parameters);
-                          RIEGELI_ASSERT(!ZSTD_isError(result))
-                              << "ZSTD_CCtx_reset() failed: "
-                              << ZSTD_getErrorName(result);
-                        });
+  frame_compressed_pos_ = initial_compressed_pos_;
+  // Contexts are keyed by `num_workers`. Resetting parameters keeps the worker
+  // threads of a multithreaded context, and they are reused if the number of
+  // workers is set to the same value.
+  compressor_ =
+      KeyedRecyclingPool<ZSTD_CCtx, int, ZSTD_CCtxDeleter>::global(
+          recycling_pool_options_)
+          .Get(num_workers,
+               [] {
+                 return std::unique_ptr<ZSTD_CCtx, ZSTD_CCtxDeleter>(
+                     ZSTD_createCCtx());
+               },
+               [](ZSTD_CCtx* compressor) {
+                 const size_t result = ZSTD_CCtx_reset(
+                     compressor, ZSTD_reset_session_and_parameters);
+                 RIEGELI_ASSERT(!ZSTD_isError(result))
+                     << "ZSTD_CCtx_reset() failed: "
+                     << ZSTD_getErrorName(result);
+               });
   if (ABSL_PREDICT_FALSE(compressor_ == nullptr)) {
     Fail(absl::InternalError("ZSTD_createCCtx() failed"));
     return;
@@ -111,8 +123,28 @@ void ZstdWriterBase::Initialize(Writer* dest, int compression_level,
       return;
     }
   }
+  // Failure of setting `ZSTD_c_nbWorkers` means that the Zstd library was built
+  // without multithreading support. Compression proceeds in the calling thread
+  // then, and `ZSTD_c_jobSize` is not applicable.
+  if (num_workers > 0 &&
+      !ZSTD_isError(ZSTD_CCtx_setParameter(compressor_.get(), ZSTD_c_nbWorkers,
+                                           num_workers)) &&
+      job_size != absl::nullopt) {
+    const size_t result = ZSTD_CCtx_setParameter(
+        compressor_.get(), ZSTD_c_jobSize, SaturatingIntCast<int>(*job_size));
+    if (ABSL_PREDICT_FALSE(ZSTD_isError(result))) {
+      Fail(absl::InternalError(
+          absl::StrCat("ZSTD_CCtx_setParameter(ZSTD_c_jobSize) failed: ",
+                       ZSTD_getErrorName(result))));
+      return;
+    }
+  }
   if (pledged_size_ != absl::nullopt) {
     BufferedWriter::SetWriteSizeHintImpl(*pledged_size_);
+  }
+  // In the seekable format the pledged size applies to the whole stream, not to
+  // the first frame.
+  if (pledged_size_ != absl::nullopt && seekable_frame_size_ == absl::nullopt) {
     const size_t result = ZSTD_CCtx_setPledgedSrcSize(
         compressor_.get(), IntCast<unsigned long long>(*pledged_size_));
     if (ABSL_PREDICT_FALSE(ZSTD_isError(result))) {
@@ -145,13 +177,20 @@ void ZstdWriterBase::DoneBehindBuffer(absl::string_view src) {
          "buffer not empty";
   if (ABSL_PREDICT_FALSE(!ok())) return;
   Writer& dest = *DestWriter();
-  WriteInternal(src, dest, ZSTD_e_end);
+  if (ABSL_PREDICT_FALSE(!WriteInternal(src, dest, ZSTD_e_end))) return;
+  if (seekable_frame_size_ != absl::nullopt) {
+    if (ABSL_PREDICT_FALSE(
+            !zstd_internal::ZstdSeekTable::Write(seek_table_, dest))) {
+      FailWithoutAnnotation(AnnotateOverDest(dest.status()));
+    }
+  }
 }
 
 void ZstdWriterBase::Done() {
   BufferedWriter::Done();
   compressor_.reset();
   dictionary_ = ZstdDictionary();
+  seek_table_ = std::vector<zstd_internal::ZstdSeekTable::Entry>();
   associated_reader_.Reset();
 }
 
@@ -217,10 +256,6 @@ inline bool ZstdWriterBase::WriteInternal(absl::string_view src, Writer& dest,
       // Notify `compressor_` that this is the last fragment. This enables
       // optimizations (compressing directly to a long enough output buffer).
       end_op = ZSTD_e_end;
-      if (reserve_max_size_ && start_pos() == 0) {
-        // Ensure that the output buffer is actually long enough.
-        dest.Push(ZSTD_compressBound(*pledged_size_));
-      }
     }
     if (end_op == ZSTD_e_end) {
       if (ABSL_PREDICT_FALSE(next_pos != *pledged_size_)) {
@@ -230,6 +265,94 @@ inline bool ZstdWriterBase::WriteInternal(absl::string_view src, Writer& dest,
       }
     }
   }
+  if (seekable_frame_size_ != absl::nullopt) {
+    if (ABSL_PREDICT_FALSE(!WriteSeekableInternal(src, dest, end_op))) {
+      return false;
+    }
+  } else if (start_pos() == 0) {
+    // Nothing was given to `compressor_` yet.
+    if (end_op == ZSTD_e_end) {
+      if (ABSL_PREDICT_FALSE(!CompressOneShot(src, dest))) return false;
+    } else if (!src.empty()) {
+      if (ABSL_PREDICT_FALSE(!CompressInternal(src, dest, end_op))) {
+        return false;
+      }
+    }
+    // Otherwise this is flushing before anything was written. Do not begin the
+    // frame, so that the whole data can still be compressed in one shot.
+  } else {
+    if (ABSL_PREDICT_FALSE(!CompressInternal(src, dest, end_op))) return false;
+  }
+  if (end_op == ZSTD_e_end) compressor_.reset();
+  return true;
+}
+
+inline bool ZstdWriterBase::WriteSeekableInternal(absl::string_view src,
+                                                  Writer& dest,
+                                                  ZSTD_EndDirective end_op) {
+  // Split `src` at frame boundaries.
+  for (;;) {
+    const size_t remaining = *seekable_frame_size_ - frame_uncompressed_size_;
+    if (src.size() < remaining) break;
+    if (ABSL_PREDICT_FALSE(
+            !CompressInternal(src.substr(0, remaining), dest, ZSTD_e_end))) {
+      return false;
+    }
+    src.remove_prefix(remaining);
+    frame_uncompressed_size_ += remaining;
+    if (ABSL_PREDICT_FALSE(!FinishSeekableFrame(dest))) return false;
+  }
+  // Do not begin an empty frame only to flush or end it.
+  if (src.empty() &&
+      (end_op == ZSTD_e_continue || frame_uncompressed_size_ == 0)) {
+    return true;
+  }
+  if (ABSL_PREDICT_FALSE(!CompressInternal(src, dest, end_op))) return false;
+  frame_uncompressed_size_ += src.size();
+  if (end_op == ZSTD_e_end) return FinishSeekableFrame(dest);
+  return true;
+}
+
+bool ZstdWriterBase::FinishSeekableFrame(Writer& dest) {
+  if (ABSL_PREDICT_FALSE(seek_table_.size() ==
+                         zstd_internal::ZstdSeekTable::kMaxNumFrames)) {
+    return Fail(absl::ResourceExhaustedError(
+        "Too many frames for the Zstd seekable format"));
+  }
+  seek_table_.push_back(zstd_internal::ZstdSeekTable::Entry{
+      IntCast<uint32_t>(dest.pos() - frame_compressed_pos_),
+      IntCast<uint32_t>(frame_uncompressed_size_)});
+  frame_compressed_pos_ = dest.pos();
+  frame_uncompressed_size_ = 0;
+  return true;
+}
+
+inline bool ZstdWriterBase::CompressOneShot(absl::string_view src,
+                                            Writer& dest) {
+  const size_t max_size = ZSTD_compressBound(src.size());
+  // Ensure that the output buffer is actually long enough.
+  if (reserve_max_size_) dest.Push(max_size);
+  if (dest.available() < max_size) {
+    // Compress to a shorter output buffer by streaming.
+    return CompressInternal(src, dest, ZSTD_e_end);
+  }
+  // The whole data are available and the output buffer is long enough, so
+  // `ZSTD_compress2()` can avoid copying through internal buffers.
+  const size_t result =
+      ZSTD_compress2(compressor_.get(), dest.cursor(), dest.available(),
+                     src.data(), src.size());
+  if (ABSL_PREDICT_FALSE(ZSTD_isError(result))) {
+    return Fail(absl::InternalError(absl::StrCat(
+        "ZSTD_compress2() failed: ", ZSTD_getErrorName(result))));
+  }
+  dest.move_cursor(result);
+  move_start_pos(src.size());
+  return true;
+}
+
+inline bool ZstdWriterBase::CompressInternal(absl::string_view src,
+                                             Writer& dest,
+                                             ZSTD_EndDirective end_op) {
   ZSTD_inBuffer input = {src.data(), src.size(), 0};
   for (;;) {
     ZSTD_outBuffer output = {dest.cursor(), dest.available(), 0};
@@ -240,23 +363,25 @@ inline bool ZstdWriterBase::WriteInternal(absl::string_view src, Writer& dest,
       RIEGELI_ASSERT_EQ(input.pos, input.size)
           << "ZSTD_compressStream2() returned 0 but there are still input data";
       move_start_pos(input.pos);
-      if (end_op == ZSTD_e_end) compressor_.reset();
       return true;
     }
     if (ABSL_PREDICT_FALSE(ZSTD_isError(result))) {
       return Fail(absl::InternalError(absl::StrCat(
           "ZSTD_compressStream2() failed: ", ZSTD_getErrorName(result))));
     }
-    if (output.pos < output.size) {
-      RIEGELI_ASSERT_EQ(input.pos, input.size)
-          << "ZSTD_compressStream2() returned but there are still input data "
-             "and output space";
+    if (end_op == ZSTD_e_continue && input.pos == input.size) {
+      // With `ZSTD_e_continue` compressed data do not have to be written yet.
+      // With workers they might be still being compressed.
       move_start_pos(input.pos);
       return true;
     }
-    if (ABSL_PREDICT_FALSE(!dest.Push(1, result))) {
-      return FailWithoutAnnotation(AnnotateOverDest(dest.status()));
+    if (output.pos == output.size) {
+      if (ABSL_PREDICT_FALSE(!dest.Push(1, result))) {
+        return FailWithoutAnnotation(AnnotateOverDest(dest.status()));
+      }
     }
+    // Otherwise workers have made some progress but there are still input data,
+    // or `ZSTD_e_flush` or `ZSTD_e_end` waits for them.
   }
 }
 
@@ -292,6 +417,7 @@ Reader* ZstdWriterBase::ReadModeBehindBuffer(Position initial_pos) {
   ZstdReader<>* const reader = associated_reader_.ResetReader(
       compressed_reader,
       ZstdReaderBase::Options()
+          .set_concatenate(seekable_frame_size_ != absl::nullopt)
           .set_dictionary(dictionary_)
           .set_buffer_options(buffer_options())
           .set_recycling_pool_options(recycling_pool_options_));
@@ -18,6 +18,7 @@
 #include <stddef.h>
 
 #include <utility>
+#include <vector>
 
 #include "absl/base/attributes.h"
 #include "absl/base/optimization.h"
@@ -35,6 +36,7 @@
 #include "riegeli/bytes/buffered_writer.h"
 #include "riegeli/bytes/writer.h"
 #include "riegeli/zstd/zstd_dictionary.h"  // IWYU pragma: export
+#include "riegeli/zstd/zstd_seek_table.h"
 #include "zstd.h"
 
 namespace riegeli {
@@ -175,6 +177,10 @@ class ZstdWriterBase : public BufferedWriter {
     //    compressed size, as long as the uncompressed size is known before
     //    compression begins, e.g. if `pledged_size()` is not `absl::nullopt`.
     //
+    // If all data are known before compression begins and the destination
+    // buffer is long enough, they are compressed in one shot, without copying
+    // them through internal buffers of the compressor.
+    //
     // This makes compression slightly faster, but increases memory usage.
     //
     // Default: `false`.
@@ -189,6 +195,112 @@ class ZstdWriterBase : public BufferedWriter {
     }
     bool reserve_max_size() const { return reserve_max_size_; }
 
+    // Number of background threads compressing independent jobs. Larger
+    // number of workers can increase throughput, up to a point where it no
+    // longer matters; smaller number of workers reduces memory usage.
+    // `num_workers() == 0` compresses in the calling thread.
+    //
+    // With `num_workers() > 0`, `Write()` returns as soon as data are handed
+    // off to workers, and `Flush()` waits until all data written so far are
+    // compressed and written to the compressed `Writer`. Each `Flush()` ends
+    // the current job early, which degrades compression density and
+    // parallelism.
+    //
+    // Jobs overlap by a part of the window, so compression density is only
+    // slightly worse than with `num_workers() == 0`.
+    //
+    // If the Zstd library was built without multithreading support,
+    // `num_workers()` is ignored and data are compressed in the calling thread.
+    //
+    // `num_workers` must be non-negative. Values above `kMaxNumWorkers`
+    // (64 in 32-bit build, 256 in 64-bit build) are reduced.
+    // Default: 0.
+    static constexpr int kMaxNumWorkers =
+        sizeof(void*) == 4 ? 64 : 256;  // `ZSTDMT_NBWORKERS_MAX`
+    Options& set_num_workers(int num_workers) & ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      RIEGELI_ASSERT_GE(num_workers, 0)
+          << "Failed precondition of "
+             "ZstdWriterBase::Options::set_num_workers(): "
+             "negative number of workers";
+      num_workers_ = num_workers;
+      return *this;
+    }
+    Options&& set_num_workers(int num_workers) &&
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      return std::move(set_num_workers(num_workers));
+    }
+    int num_workers() const { return num_workers_; }
+
+    // Uncompressed size of a job compressed by a single worker. This is
+    // effective only with `num_workers() > 0`.
+    //
+    // Special value `absl::nullopt` means to derive `job_size` from
+    // `compression_level` and `window_log`.
+    //
+    // `job_size` must be `absl::nullopt` or positive. Values below
+    // `kMinJobSize` (512K) are increased, values above `kMaxJobSize` (512M in
+    // 32-bit build, 1G in 64-bit build) are reduced. Default: `absl::nullopt`.
+    static constexpr size_t kMinJobSize =
+        size_t{512} << 10;  // `ZSTDMT_JOBSIZE_MIN`
+    static constexpr size_t kMaxJobSize =
+        sizeof(void*) == 4 ? size_t{512} << 20
+                           : size_t{1} << 30;  // `ZSTDMT_JOBSIZE_MAX`
+    Options& set_job_size(absl::optional<size_t> job_size) &
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      if (job_size != absl::nullopt) {
+        RIEGELI_ASSERT_GT(*job_size, 0u)
+            << "Failed precondition of "
+               "ZstdWriterBase::Options::set_job_size(): "
+               "job size out of range";
+      }
+      job_size_ = job_size;
+      return *this;
+    }
+    Options&& set_job_size(absl::optional<size_t> job_size) &&
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      return std::move(set_job_size(job_size));
+    }
+    absl::optional<size_t> job_size() const { return job_size_; }
+
+    // If not `absl::nullopt`, writes the Zstd seekable format: independent
+    // frames of `seekable_frame_size` uncompressed bytes each (the last frame
+    // can be shorter), followed by a seek table in a skippable frame, written
+    // by `Close()`. This lets `ZstdReader` seek by decompressing only the frame
+    // containing the target position. Smaller frames make seeking faster but
+    // degrade compression density.
+    //
+    // The format is compatible with the Zstd seekable format of the reference
+    // implementation (contrib/seekable_format). Checksums of frames are not
+    // stored in the seek table; frames contain them if `store_checksum()`.
+    //
+    // `seekable_frame_size` must be `absl::nullopt` or between 1 and
+    // `kMaxSeekableFrameSize` (1G). Default: `absl::nullopt`.
+    static constexpr size_t kMaxSeekableFrameSize = size_t{1} << 30;
+    Options& set_seekable_frame_size(
+        absl::optional<size_t> seekable_frame_size) &
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      if (seekable_frame_size != absl::nullopt) {
+        RIEGELI_ASSERT_GT(*seekable_frame_size, 0u)
+            << "Failed precondition of "
+               "ZstdWriterBase::Options::set_seekable_frame_size(): "
+               "frame size out of range";
+        RIEGELI_ASSERT_LE(*seekable_frame_size, kMaxSeekableFrameSize)
+            << "Failed precondition of "
+               "ZstdWriterBase::Options::set_seekable_frame_size(): "
+               "frame size out of range";
+      }
+      seekable_frame_size_ = seekable_frame_size;
+      return *this;
+    }
+    Options&& set_seekable_frame_size(
+        absl::optional<size_t> seekable_frame_size) &&
+        ABSL_ATTRIBUTE_LIFETIME_BOUND {
+      return std::move(set_seekable_frame_size(seekable_frame_size));
+    }
+    absl::optional<size_t> seekable_frame_size() const {
+      return seekable_frame_size_;
+    }
+
     // Returns effective `BufferOptions` as overridden by other options:
     // If `reserve_max_size()` is `true` and `pledged_size()` is not
     // `absl::nullopt`, then `pledged_size()` overrides `buffer_size()`.
@@ -201,7 +313,9 @@ class ZstdWriterBase : public BufferedWriter {
       return options;
     }
 
-    // Options for a global `RecyclingPool` of compression contexts.
+    // Options for a global `KeyedRecyclingPool` of compression contexts.
+    // Contexts are kept separately for each `num_workers()`, so that threads of
+    // a multithreaded context are reused too.
     //
     // They tune the amount of memory which is kept to speed up creation of new
     // compression sessions, and usage of a background thread to clean it.
@@ -230,6 +344,9 @@ class ZstdWriterBase : public BufferedWriter {
     bool store_checksum_ = false;
     absl::optional<Position> pledged_size_;
     bool reserve_max_size_ = false;
+    int num_workers_ = 0;
+    absl::optional<size_t> job_size_;
+    absl::optional<size_t> seekable_frame_size_;
     RecyclingPoolOptions recycling_pool_options_;
   };
 
@@ -245,6 +362,7 @@ class ZstdWriterBase : public BufferedWriter {
                           ZstdDictionary&& dictionary,
                           absl::optional<Position> pledged_size,
                           bool reserve_max_size,
+                          absl::optional<size_t> seekable_frame_size,
                           const RecyclingPoolOptions& recycling_pool_options);
 
   ZstdWriterBase(ZstdWriterBase&& that) noexcept;
@@ -253,9 +371,11 @@ class ZstdWriterBase : public BufferedWriter {
   void Reset(Closed);
   void Reset(BufferOptions buffer_options, ZstdDictionary&& dictionary,
              absl::optional<Position> pledged_size, bool reserve_max_size,
+             absl::optional<size_t> seekable_frame_size,
              const RecyclingPoolOptions& recycling_pool_options);
   void Initialize(Writer* dest, int compression_level,
-                  absl::optional<int> window_log, bool store_checksum);
+                  absl::optional<int> window_log, bool store_checksum,
+                  int num_workers, absl::optional<size_t> job_size);
   ABSL_ATTRIBUTE_COLD absl::Status AnnotateOverDest(absl::Status status);
 
   void DoneBehindBuffer(absl::string_view src) override;
@@ -274,16 +394,29 @@ class ZstdWriterBase : public BufferedWriter {
 
   bool WriteInternal(absl::string_view src, Writer& dest,
                      ZSTD_EndDirective end_op);
+  bool WriteSeekableInternal(absl::string_view src, Writer& dest,
+                             ZSTD_EndDirective end_op);
+  bool CompressOneShot(absl::string_view src, Writer& dest);
+  bool CompressInternal(absl::string_view src, Writer& dest,
+                        ZSTD_EndDirective end_op);
+  bool FinishSeekableFrame(Writer& dest);
 
   ZstdDictionary dictionary_;
   ZstdDictionary::ZSTD_CDictHandle compression_dictionary_;
   absl::optional<Position> pledged_size_;
   bool reserve_max_size_ = false;
+  absl::optional<size_t> seekable_frame_size_;
   RecyclingPoolOptions recycling_pool_options_;
   Position initial_compressed_pos_ = 0;
+  // Seekable format: the compressed position of the beginning of the current
+  // frame, the uncompressed size of the current frame so far, and sizes of
+  // finished frames.
+  Position frame_compressed_pos_ = 0;
+  size_t frame_uncompressed_size_ = 0;
+  std::vector<zstd_internal::ZstdSeekTable::Entry> seek_table_;
   // If `ok()` but `compressor_ == nullptr` then `*pledged_size_` has been
   // reached. In this case `ZSTD_compressStream()` must not be called again.
-  RecyclingPool<ZSTD_CCtx, ZSTD_CCtxDeleter>::Handle compressor_;
+  KeyedRecyclingPool<ZSTD_CCtx, int, ZSTD_CCtxDeleter>::Handle compressor_;
 
   AssociatedReader<ZstdReader<Reader*>> associated_reader_;
 };
@@ -355,11 +488,13 @@ explicit ZstdWriter(Dest&& dest,
 inline ZstdWriterBase::ZstdWriterBase(
     BufferOptions buffer_options, ZstdDictionary&& dictionary,
     absl::optional<Position> pledged_size, bool reserve_max_size,
+    absl::optional<size_t> seekable_frame_size,
     const RecyclingPoolOptions& recycling_pool_options)
     : BufferedWriter(buffer_options),
       dictionary_(std::move(dictionary)),
       pledged_size_(pledged_size),
       reserve_max_size_(reserve_max_size),
+      seekable_frame_size_(seekable_frame_size),
       recycling_pool_options_(recycling_pool_options) {}
 
 inline ZstdWriterBase::ZstdWriterBase(ZstdWriterBase&& that) noexcept
@@ -368,8 +503,12 @@ inline ZstdWriterBase::ZstdWriterBase(ZstdWriterBase&& that) noexcept
       compression_dictionary_(std::move(that.compression_dictionary_)),
       pledged_size_(that.pledged_size_),
       reserve_max_size_(that.reserve_max_size_),
+      seekable_frame_size_(that.seekable_frame_size_),
       recycling_pool_options_(that.recycling_pool_options_),
       initial_compressed_pos_(that.initial_compressed_pos_),
+      frame_compressed_pos_(that.frame_compressed_pos_),
+      frame_uncompressed_size_(that.frame_uncompressed_size_),
+      seek_table_(std::move(that.seek_table_)),
       compressor_(std::move(that.compressor_)),
       associated_reader_(std::move(that.associated_reader_)) {}
 
@@ -380,8 +519,12 @@ inline ZstdWriterBase& ZstdWriterBase::operator=(
   compression_dictionary_ = std::move(that.compression_dictionary_);
   pledged_size_ = that.pledged_size_;
   reserve_max_size_ = that.reserve_max_size_;
+  seekable_frame_size_ = that.seekable_frame_size_;
   recycling_pool_options_ = that.recycling_pool_options_;
   initial_compressed_pos_ = that.initial_compressed_pos_;
+  frame_compressed_pos_ = that.frame_compressed_pos_;
+  frame_uncompressed_size_ = that.frame_uncompressed_size_;
+  seek_table_ = std::move(that.seek_table_);
   compressor_ = std::move(that.compressor_);
   associated_reader_ = std::move(that.associated_reader_);
   return *this;
@@ -391,8 +534,12 @@ inline void ZstdWriterBase::Reset(Closed) {
   BufferedWriter::Reset(kClosed);
   pledged_size_ = absl::nullopt;
   reserve_max_size_ = false;
+  seekable_frame_size_ = absl::nullopt;
   recycling_pool_options_ = RecyclingPoolOptions();
   initial_compressed_pos_ = 0;
+  frame_compressed_pos_ = 0;
+  frame_uncompressed_size_ = 0;
+  seek_table_ = std::vector<zstd_internal::ZstdSeekTable::Entry>();
   compressor_.reset();
   dictionary_ = ZstdDictionary();
   compression_dictionary_.reset();
@@ -402,12 +549,17 @@ inline void ZstdWriterBase::Reset(Closed) {
 inline void ZstdWriterBase::Reset(
     BufferOptions buffer_options, ZstdDictionary&& dictionary,
     absl::optional<Position> pledged_size, bool reserve_max_size,
+    absl::optional<size_t> seekable_frame_size,
     const RecyclingPoolOptions& recycling_pool_options) {
   BufferedWriter::Reset(buffer_options);
   pledged_size_ = pledged_size;
   reserve_max_size_ = reserve_max_size;
+  seekable_frame_size_ = seekable_frame_size;
   recycling_pool_options_ = recycling_pool_options;
   initial_compressed_pos_ = 0;
+  frame_compressed_pos_ = 0;
+  frame_uncompressed_size_ = 0;
+  seek_table_.clear();
   compressor_.reset();
   dictionary_ = std::move(dictionary);
   compression_dictionary_.reset();
@@ -419,10 +571,12 @@ inline ZstdWriter<Dest>::ZstdWriter(Initializer<Dest> dest, Options options)
     : ZstdWriterBase(options.effective_buffer_options(),
                      std::move(options.dictionary()), options.pledged_size(),
                      options.reserve_max_size(),
+                     options.seekable_frame_size(),
                      options.recycling_pool_options()),
       dest_(std::move(dest)) {
   Initialize(dest_.get(), options.compression_level(), options.window_log(),
-             options.store_checksum());
+             options.store_checksum(), options.num_workers(),
+             options.job_size());
 }
 
 template <typename Dest>
@@ -436,10 +590,12 @@ inline void ZstdWriter<Dest>::Reset(Initializer<Dest> dest, Options options) {
   ZstdWriterBase::Reset(options.effective_buffer_options(),
                         std::move(options.dictionary()), options.pledged_size(),
                         options.reserve_max_size(),
+                        options.seekable_frame_size(),
                         options.recycling_pool_options());
   dest_.Reset(std::move(dest));
   Initialize(dest_.get(), options.compression_level(), options.window_log(),
-             options.store_checksum());
+             options.store_checksum(), options.num_workers(),
+             options.job_size());
 }
 
 template <typename Dest>